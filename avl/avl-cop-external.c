@@ -7,12 +7,20 @@
 #include <pthread.h> //> pthread_spinlock_t
 
 #include "alloc.h"
+#include "tm.h"
+#include "clargs.h"
 #include "arch.h"
+#include "key.h"
+#include "rbt/iface.h"
+
+//> Written against int keys only (see key.h).
+#if KEY_BITS != 32 || defined(KEY_CMP)
+#	error "this tree supports only the default int keys"
+#endif
 
 typedef struct {
 	int tid;
-	long long unsigned tx_starts, tx_aborts,
-	                   tx_aborts_validation, lacqs;
+	tm_tdata_t tm;
 } tdata_t;
 
 static inline tdata_t *tdata_new(int tid)
@@ -20,60 +28,20 @@ static inline tdata_t *tdata_new(int tid)
 	tdata_t *ret;
 	XMALLOC(ret, 1);
 	ret->tid = tid;
-	ret->tx_starts = 0;
-	ret->tx_aborts = 0;
-	ret->tx_aborts_validation = 0;
-	ret->lacqs = 0;
+	tm_tdata_init(&ret->tm, tid, clargs.tx_policy, clargs.tx_retries);
 	return ret;
 }
 
 static inline void tdata_print(tdata_t *tdata)
 {
-	printf("TID %3d: %llu %llu %llu ( %llu )\n", tdata->tid, tdata->tx_starts,
-	                               tdata->tx_aborts, tdata->tx_aborts_validation,
-	                               tdata->lacqs);
+	tm_tdata_print(&tdata->tm);
 }
 
 static inline void tdata_add(tdata_t *d1, tdata_t *d2, tdata_t *dst)
 {
-	dst->tx_starts = d1->tx_starts + d2->tx_starts;
-	dst->tx_aborts = d1->tx_aborts + d2->tx_aborts;
-	dst->tx_aborts_validation = d1->tx_aborts_validation +
-	                            d2->tx_aborts_validation;
-	dst->lacqs = d1->lacqs + d2->lacqs;
+	tm_tdata_add(&d1->tm, &d2->tm, &dst->tm);
 }
 
-/* TM Interface. */
-#if !defined(TX_NUM_RETRIES)
-#	define TX_NUM_RETRIES 20
-#endif
-
-#ifdef __POWERPC64__
-#	include <htmintrin.h>
-	typedef int tm_begin_ret_t;
-#	define LOCK_FREE 0
-#	define TM_BEGIN_SUCCESS 1
-#	define ABORT_VALIDATION_FAILURE 0xee
-#	define ABORT_GL_TAKEN           0xff
-#	define TX_ABORT(code) __builtin_tabort(code)
-#	define TX_BEGIN(code) __builtin_tbegin(0)
-#	define TX_END(code)   __builtin_tend(0)
-#else
-#	include "rtm.h"
-	typedef unsigned tm_begin_ret_t;
-#	define LOCK_FREE 1
-#	define TM_BEGIN_SUCCESS _XBEGIN_STARTED
-#	define ABORT_VALIDATION_FAILURE 0xee
-#	define ABORT_GL_TAKEN           0xff
-#	define TX_ABORT(code) _xabort(code)
-#	define TX_BEGIN(code) _xbegin()
-#	define TX_END(code)   _xend()
-#	define TX_TEST()      _xtest()
-#	define _XABORT_EXPLICIT	(1 << 0)
-#	define _XABORT_CODE(x)	(((x) >> 24) & 0xff)
-#endif
-/*****************/
-
 
 #define MAX(a,b) ( (a) >= (b) ? (a) : (b) )
 
@@ -96,7 +64,7 @@ typedef struct avl_node_s {
 typedef struct {
 	avl_node_t *root;
 
-	volatile pthread_spinlock_t avl_lock;
+	tm_fallback_lock_t avl_lock;
 } avl_t;
 
 #define IS_EXTERNAL_NODE(node) \
@@ -140,7 +108,7 @@ static avl_t *_avl_new_helper()
 	XMALLOC(avl, 1);
 	avl->root = NULL;
 
-	pthread_spin_init(&avl->avl_lock, PTHREAD_PROCESS_SHARED);
+	tm_fallback_lock_init(&avl->avl_lock);
 
 	return avl;
 }
@@ -254,15 +222,16 @@ static int _avl_lookup_helper(avl_t *avl, int key, tdata_t *tdata)
 	tm_begin_ret_t status;
 	int ret, retries = -1;
 
+	tm_op_begin(&tdata->tm);
+
 try_from_scratch:
 
 	/* Global lock fallback. */
-	if (++retries >= TX_NUM_RETRIES) {
-		tdata->lacqs++;
-		pthread_spin_lock(&avl->avl_lock);
+	if (!tm_retry_allowed(&tdata->tm, ++retries)) {
+		tm_fallback_lock(&avl->avl_lock, &tdata->tm);
 		leaf = _traverse(avl, key);
 		ret = (leaf && leaf->key == key);
-		pthread_spin_unlock(&avl->avl_lock);
+		tm_fallback_unlock(&avl->avl_lock, &tdata->tm);
 		return ret;
 	}
 
@@ -272,13 +241,12 @@ try_from_scratch:
 	leaf = _traverse(avl, key);
 
 	/* Transactional verification. */
-	while (avl->avl_lock != LOCK_FREE)
-		;
+	tm_fallback_wait(&avl->avl_lock);
 
-	tdata->tx_starts++;
-	status = TX_BEGIN(0);
+	tm_tx_started(&tdata->tm);
+	TX_BEGIN(status);
 	if (status == TM_BEGIN_SUCCESS) {
-		if (avl->avl_lock != LOCK_FREE)
+		if (tm_fallback_is_locked(&avl->avl_lock))
 			TX_ABORT(ABORT_GL_TAKEN);
 
 		/* _lookup_verify() will abort if verification fails. */
@@ -286,8 +254,9 @@ try_from_scratch:
 		ret = (leaf && leaf->key == key);
 
 		TX_END(0);
+		tm_tx_committed(&tdata->tm);
 	} else {
-		tdata->tx_aborts++;
+		tm_tx_aborted(&tdata->tm, status);
 		goto try_from_scratch;
 	}
 
@@ -411,15 +380,16 @@ static int _avl_insert_helper(avl_t *avl, int key, void *value, tdata_t *tdata)
 	new_node[0] = avl_node_new(key, NULL);
 	new_node[1] = avl_node_new(key, value);
 
+	tm_op_begin(&tdata->tm);
+
 try_from_scratch:
 
 	/* Global lock fallback. */
-	if (++retries >= TX_NUM_RETRIES) {
-		tdata->lacqs++;
-		pthread_spin_lock(&avl->avl_lock);
+	if (!tm_retry_allowed(&tdata->tm, ++retries)) {
+		tm_fallback_lock(&avl->avl_lock, &tdata->tm);
 		leaf = _traverse(avl, key);
 		ret = _insert(avl, new_node, leaf);
-		pthread_spin_unlock(&avl->avl_lock);
+		tm_fallback_unlock(&avl->avl_lock, &tdata->tm);
 		if (!ret) {
 			free(new_node[0]);
 			free(new_node[1]);
@@ -431,13 +401,12 @@ try_from_scratch:
 	leaf = _traverse(avl, key);
 
 	/* Transactional verification. */
-	while (avl->avl_lock != LOCK_FREE)
-		;
+	tm_fallback_wait(&avl->avl_lock);
 
-	tdata->tx_starts++;
-	status = TX_BEGIN(0);
+	tm_tx_started(&tdata->tm);
+	TX_BEGIN(status);
 	if (status == TM_BEGIN_SUCCESS) {
-		if (avl->avl_lock != LOCK_FREE)
+		if (tm_fallback_is_locked(&avl->avl_lock))
 			TX_ABORT(ABORT_GL_TAKEN); 
 
 		/* _lookup_verify() will abort if verification fails. */
@@ -445,10 +414,9 @@ try_from_scratch:
 		ret = _insert(avl, new_node, leaf);
 
 		TX_END(0);
+		tm_tx_committed(&tdata->tm);
 	} else {
-		if ((status & _XABORT_EXPLICIT) && (_XABORT_CODE(status) == ABORT_VALIDATION_FAILURE))
-			tdata->tx_aborts_validation++;
-		tdata->tx_aborts++;
+		tm_tx_aborted(&tdata->tm, status);
 		goto try_from_scratch;
 	}
 
@@ -609,15 +577,16 @@ static int _avl_delete_helper(avl_t *avl, int key, tdata_t *tdata)
 	tm_begin_ret_t status;
 	int retries = -1, ret = 0;
 
+	tm_op_begin(&tdata->tm);
+
 try_from_scratch:
 
 	/* Global lock fallback. */
-	if (++retries >= TX_NUM_RETRIES) {
-		tdata->lacqs++;
-		pthread_spin_lock(&avl->avl_lock);
+	if (!tm_retry_allowed(&tdata->tm, ++retries)) {
+		tm_fallback_lock(&avl->avl_lock, &tdata->tm);
 		leaf = _traverse(avl, key);
 		ret = _delete(avl, key, leaf);
-		pthread_spin_unlock(&avl->avl_lock);
+		tm_fallback_unlock(&avl->avl_lock, &tdata->tm);
 		return ret;
 	}
 
@@ -625,13 +594,12 @@ try_from_scratch:
 	leaf = _traverse(avl, key);
 
 	/* Transactional verification. */
-	while (avl->avl_lock != LOCK_FREE)
-		;
+	tm_fallback_wait(&avl->avl_lock);
 
-	tdata->tx_starts++;
-	status = TX_BEGIN(0);
+	tm_tx_started(&tdata->tm);
+	TX_BEGIN(status);
 	if (status == TM_BEGIN_SUCCESS) {
-		if (avl->avl_lock != LOCK_FREE)
+		if (tm_fallback_is_locked(&avl->avl_lock))
 			TX_ABORT(ABORT_GL_TAKEN);
 
 		/* _lookup_verify() will abort if verification fails. */
@@ -639,10 +607,9 @@ try_from_scratch:
 		ret = _delete(avl, key, leaf);
 
 		TX_END(0);
+		tm_tx_committed(&tdata->tm);
 	} else {
-		if ((status & _XABORT_EXPLICIT) && (_XABORT_CODE(status) == ABORT_VALIDATION_FAILURE))
-			tdata->tx_aborts_validation++;
-		tdata->tx_aborts++;
+		tm_tx_aborted(&tdata->tm, status);
 		goto try_from_scratch;
 	}
 
@@ -797,6 +764,18 @@ void rbt_thread_data_add(void *d1, void *d2, void *dst)
 	tdata_add(d1, d2, dst);
 }
 
+void rbt_thread_data_free(void *thread_data)
+{
+	free(thread_data);
+}
+
+int rbt_thread_data_tx_stats(void *thread_data, rbt_tx_stats_t *stats)
+{
+	tdata_t *tdata = thread_data;
+	TM_STATS_COPY(stats, &tdata->tm.stats);
+	return 0;
+}
+
 int rbt_lookup(void *rbt, void *thread_data, int key)
 {
 	int ret = 0;
@@ -818,6 +797,24 @@ int rbt_delete(void *rbt, void *thread_data, int key)
 	return ret;
 }
 
+//> Key-value accessors are not supported.
+int rbt_get(void *rbt, void *thread_data, int key, void **value)
+{
+	return -1;
+}
+
+int rbt_update(void *rbt, void *thread_data, int key, void *value)
+{
+	return -1;
+}
+
+//> Range scans are not supported.
+int rbt_range(void *rbt, void *thread_data, int lo, int hi,
+              void (*cb)(int key, void *value, void *arg), void *arg)
+{
+	return -1;
+}
+
 int rbt_validate(void *rbt)
 {
 	int ret = 0;
@@ -825,6 +822,21 @@ int rbt_validate(void *rbt)
 	return ret;
 }
 
+static void _avl_free_nodes(avl_node_t *root)
+{
+	if (!root)
+		return;
+	_avl_free_nodes(root->left);
+	_avl_free_nodes(root->right);
+	free(root);
+}
+
+void rbt_free(void *rbt)
+{
+	_avl_free_nodes(((avl_t *)rbt)->root);
+	free(rbt);
+}
+
 int rbt_warmup(void *rbt, int nr_nodes, int max_key, 
                unsigned int seed, int force)
 {
@@ -833,6 +845,18 @@ int rbt_warmup(void *rbt, int nr_nodes, int max_key,
 	return ret;
 }
 
+//> Bulk loading is not supported, the benchmark falls back to rbt_warmup().
+int rbt_bulk_load(void *rbt, void *thread_data, bulk_load_t *bl, int tid)
+{
+	return -1;
+}
+
+//> Node memory is not accounted for.
+int rbt_mem_stats(void *rbt, rbt_mem_stats_t *stats)
+{
+	return -1;
+}
+
 char *rbt_name()
 {
 	return "avl-cop-external";
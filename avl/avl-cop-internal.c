@@ -7,12 +7,21 @@
 #include <pthread.h> //> pthread_spinlock_t
 
 #include "alloc.h"
+#include "tm.h"
+#include "clargs.h"
 #include "arch.h"
+#include "key.h"
+#include "rbt/iface.h"
+#include "node_stats.h"
+
+//> Written against int keys only (see key.h).
+#if KEY_BITS != 32 || defined(KEY_CMP)
+#	error "this tree supports only the default int keys"
+#endif
 
 typedef struct {
 	int tid;
-	long long unsigned tx_starts, tx_aborts,
-	                   tx_aborts_validation, lacqs;
+	tm_tdata_t tm;
 } tdata_t;
 
 static inline tdata_t *tdata_new(int tid)
@@ -20,60 +29,20 @@ static inline tdata_t *tdata_new(int tid)
 	tdata_t *ret;
 	XMALLOC(ret, 1);
 	ret->tid = tid;
-	ret->tx_starts = 0;
-	ret->tx_aborts = 0;
-	ret->tx_aborts_validation = 0;
-	ret->lacqs = 0;
+	tm_tdata_init(&ret->tm, tid, clargs.tx_policy, clargs.tx_retries);
 	return ret;
 }
 
 static inline void tdata_print(tdata_t *tdata)
 {
-	printf("TID %3d: %llu %llu %llu ( %llu )\n", tdata->tid, tdata->tx_starts,
-	                               tdata->tx_aborts, tdata->tx_aborts_validation,
-	                               tdata->lacqs);
+	tm_tdata_print(&tdata->tm);
 }
 
 static inline void tdata_add(tdata_t *d1, tdata_t *d2, tdata_t *dst)
 {
-	dst->tx_starts = d1->tx_starts + d2->tx_starts;
-	dst->tx_aborts = d1->tx_aborts + d2->tx_aborts;
-	dst->tx_aborts_validation = d1->tx_aborts_validation +
-	                            d2->tx_aborts_validation;
-	dst->lacqs = d1->lacqs + d2->lacqs;
+	tm_tdata_add(&d1->tm, &d2->tm, &dst->tm);
 }
 
-/* TM Interface. */
-#if !defined(TX_NUM_RETRIES)
-#	define TX_NUM_RETRIES 20
-#endif
-
-#ifdef __POWERPC64__
-#	include <htmintrin.h>
-	typedef int tm_begin_ret_t;
-#	define LOCK_FREE 0
-#	define TM_BEGIN_SUCCESS 1
-#	define ABORT_VALIDATION_FAILURE 0xee
-#	define ABORT_GL_TAKEN           0xff
-#	define TX_ABORT(code) __builtin_tabort(code)
-#	define TX_BEGIN(code) __builtin_tbegin(0)
-#	define TX_END(code)   __builtin_tend(0)
-#else
-#	include "rtm.h"
-	typedef unsigned tm_begin_ret_t;
-#	define LOCK_FREE 1
-#	define TM_BEGIN_SUCCESS _XBEGIN_STARTED
-#	define ABORT_VALIDATION_FAILURE 0xee
-#	define ABORT_GL_TAKEN           0xff
-#	define TX_ABORT(code) _xabort(code)
-#	define TX_BEGIN(code) _xbegin()
-#	define TX_END(code)   _xend()
-#	define TX_TEST()      _xtest()
-#	define _XABORT_EXPLICIT	(1 << 0)
-#	define _XABORT_CODE(x)	(((x) >> 24) & 0xff)
-#endif
-/*****************/
-
 
 #define MAX(a,b) ( (a) >= (b) ? (a) : (b) )
 #define MAX_HEIGHT 50
@@ -104,14 +73,18 @@ typedef struct {
 	// same cache line with the lock.
 	char padding[CACHE_LINE_SIZE - sizeof(avl_node_t *)];
 
-	volatile pthread_spinlock_t avl_lock;
+	tm_fallback_lock_t avl_lock;
 } avl_t;
 
+//> Nodes of failed insertions are freed, deleted ones leak.
+static node_stats_t avl_node_stats;
+
 static avl_node_t *avl_node_new(int key, void *data)
 {
 	avl_node_t *node;
 
 	XMALLOC(node, 1);
+	node_stats_alloc(&avl_node_stats, 1);
 	node->key = key;
 	node->data = data;
 	node->height = 1; // new nodes have height 1 and NULL has height 0.
@@ -122,6 +95,12 @@ static avl_node_t *avl_node_new(int key, void *data)
 	return node;
 }
 
+static void avl_node_free(avl_node_t *node)
+{
+	free(node);
+	node_stats_free(&avl_node_stats, 1);
+}
+
 static inline int node_height(avl_node_t *n)
 {
 	if (!n)
@@ -144,7 +123,7 @@ static avl_t *_avl_new_helper()
 
 	XMALLOC(avl, 1);
 	avl->root = NULL;
-	pthread_spin_init(&avl->avl_lock, PTHREAD_PROCESS_SHARED);
+	tm_fallback_lock_init(&avl->avl_lock);
 
 	return avl;
 }
@@ -255,15 +234,16 @@ static int _avl_lookup_helper(avl_t *avl, int key, tdata_t *tdata)
 	tm_begin_ret_t status;
 	int ret, retries = -1;
 
+	tm_op_begin(&tdata->tm);
+
 try_from_scratch:
 
 	/* Global lock fallback. */
-	if (++retries >= TX_NUM_RETRIES) {
-		tdata->lacqs++;
-		pthread_spin_lock(&avl->avl_lock);
+	if (!tm_retry_allowed(&tdata->tm, ++retries)) {
+		tm_fallback_lock(&avl->avl_lock, &tdata->tm);
 		place = _traverse(avl, key);
 		ret = (place && place->key == key);
-		pthread_spin_unlock(&avl->avl_lock);
+		tm_fallback_unlock(&avl->avl_lock, &tdata->tm);
 		return ret;
 	}
 
@@ -273,13 +253,12 @@ try_from_scratch:
 	place = _traverse(avl, key);
 
 	/* Transactional verification. */
-	while (avl->avl_lock != LOCK_FREE)
-		;
+	tm_fallback_wait(&avl->avl_lock);
 
-	tdata->tx_starts++;
-	status = TX_BEGIN(0);
+	tm_tx_started(&tdata->tm);
+	TX_BEGIN(status);
 	if (status == TM_BEGIN_SUCCESS) {
-		if (avl->avl_lock != LOCK_FREE)
+		if (tm_fallback_is_locked(&avl->avl_lock))
 			TX_ABORT(ABORT_GL_TAKEN);
 
 		/* _lookup_verify() will abort if verification fails. */
@@ -287,8 +266,9 @@ try_from_scratch:
 		ret = (place && place->key == key);
 
 		TX_END(0);
+		tm_tx_committed(&tdata->tm);
 	} else {
-		tdata->tx_aborts++;
+		tm_tx_aborted(&tdata->tm, status);
 		goto try_from_scratch;
 	}
 
@@ -396,18 +376,19 @@ static int _avl_insert_helper(avl_t *avl, int key, void *value, tdata_t *tdata)
 
 	avl_node_t *new_node = avl_node_new(key, value);
 
+	tm_op_begin(&tdata->tm);
+
 try_from_scratch:
 
 	/* Global lock fallback. */
-	if (++retries >= TX_NUM_RETRIES) {
-		tdata->lacqs++;
-		pthread_spin_lock(&avl->avl_lock);
+	if (!tm_retry_allowed(&tdata->tm, ++retries)) {
+		tm_fallback_lock(&avl->avl_lock, &tdata->tm);
 //		volatile int j; for (j=0; j < 10000000; j++) ; // XXX DEBUG
 		place = _traverse(avl, key);
 		ret = _insert(avl, new_node, place);
-		pthread_spin_unlock(&avl->avl_lock);
+		tm_fallback_unlock(&avl->avl_lock, &tdata->tm);
 		if (!ret)
-			free(new_node);
+			avl_node_free(new_node);
 		return ret;
 	}
 
@@ -415,13 +396,12 @@ try_from_scratch:
 	place = _traverse(avl, key);
 
 	/* Transactional verification. */
-	while (avl->avl_lock != LOCK_FREE)
-		;
+	tm_fallback_wait(&avl->avl_lock);
 
-	tdata->tx_starts++;
-	status = TX_BEGIN(0);
+	tm_tx_started(&tdata->tm);
+	TX_BEGIN(status);
 	if (status == TM_BEGIN_SUCCESS) {
-		if (avl->avl_lock != LOCK_FREE)
+		if (tm_fallback_is_locked(&avl->avl_lock))
 			TX_ABORT(ABORT_GL_TAKEN); 
 
 		/* _insert_verify() will abort if verification fails. */
@@ -429,15 +409,14 @@ try_from_scratch:
 		ret = _insert(avl, new_node, place);
 
 		TX_END(0);
+		tm_tx_committed(&tdata->tm);
 	} else {
-		if ((status & _XABORT_EXPLICIT) && (_XABORT_CODE(status) == ABORT_VALIDATION_FAILURE))
-			tdata->tx_aborts_validation++;
-		tdata->tx_aborts++;
+		tm_tx_aborted(&tdata->tm, status);
 		goto try_from_scratch;
 	}
 
 	if (!ret)
-		free(new_node);
+		avl_node_free(new_node);
 
 	return ret;
 }
@@ -450,7 +429,7 @@ static int _avl_insert_warmup_helper(avl_t *avl, int key, void *value)
 	place = _traverse(avl, key);
 	int ret = _insert(avl, new_node, place);
 	if (!ret)
-		free(new_node);
+		avl_node_free(new_node);
 	return ret;
 }
 
@@ -586,16 +565,17 @@ static int _avl_delete_helper(avl_t *avl, int key, tdata_t *tdata)
 	tm_begin_ret_t status;
 	int retries = -1, ret = 0;
 
+	tm_op_begin(&tdata->tm);
+
 try_from_scratch:
 
 	/* Global lock fallback. */
-	if (++retries >= TX_NUM_RETRIES) {
-		tdata->lacqs++;
-		pthread_spin_lock(&avl->avl_lock);
+	if (!tm_retry_allowed(&tdata->tm, ++retries)) {
+		tm_fallback_lock(&avl->avl_lock, &tdata->tm);
 //		volatile int j; for (j=0; j < 10000000; j++) ; // XXX DEBUG
 		place = _traverse(avl, key);
 		ret = _delete(avl, key, place);
-		pthread_spin_unlock(&avl->avl_lock);
+		tm_fallback_unlock(&avl->avl_lock, &tdata->tm);
 		return ret;
 	}
 
@@ -603,13 +583,12 @@ try_from_scratch:
 	place = _traverse(avl, key);
 
 	/* Transactional verification. */
-	while (avl->avl_lock != LOCK_FREE)
-		;
+	tm_fallback_wait(&avl->avl_lock);
 
-	tdata->tx_starts++;
-	status = TX_BEGIN(0);
+	tm_tx_started(&tdata->tm);
+	TX_BEGIN(status);
 	if (status == TM_BEGIN_SUCCESS) {
-		if (avl->avl_lock != LOCK_FREE)
+		if (tm_fallback_is_locked(&avl->avl_lock))
 			TX_ABORT(ABORT_GL_TAKEN);
 
 		/* _delete_verify() will abort if verification fails. */
@@ -617,10 +596,9 @@ try_from_scratch:
 		ret = _delete(avl, key, place);
 
 		TX_END(0);
+		tm_tx_committed(&tdata->tm);
 	} else {
-		if ((status & _XABORT_EXPLICIT) && (_XABORT_CODE(status) == ABORT_VALIDATION_FAILURE))
-			tdata->tx_aborts_validation++;
-		tdata->tx_aborts++;
+		tm_tx_aborted(&tdata->tm, status);
 		goto try_from_scratch;
 	}
 
@@ -643,6 +621,77 @@ static inline int _avl_warmup_helper(avl_t *avl, int nr_nodes, int max_key,
 	return nodes_inserted;
 }
 
+/**
+ * The in-order neighbours of a node are the last node of its left subtree
+ * and the first of its right one, so each node links itself to them. The
+ * walks down these paths cost O(nr_keys) in total.
+ **/
+static avl_node_t *_avl_bulk_build(bulk_load_t *bl, int lo, int hi,
+                                   int depth, int idx)
+{
+	avl_node_t *node, *n;
+	int mid;
+
+	if (lo >= hi)
+		return NULL;
+	if (bulk_load_is_built(bl, depth))
+		return bl->roots[idx];
+
+	mid = bulk_load_mid(lo, hi);
+	node = avl_node_new(bl->keys[mid], NULL);
+	node->live = 1;
+	node->left = _avl_bulk_build(bl, lo, mid, depth + 1, 2 * idx);
+	node->right = _avl_bulk_build(bl, mid + 1, hi, depth + 1, 2 * idx + 1);
+	node->height = MAX(node_height(node->left), node_height(node->right)) + 1;
+
+	if ((n = node->left)) {
+		n->parent = node;
+		while (n->right)
+			n = n->right;
+		node->prev = n;
+		n->succ = node;
+	}
+	if ((n = node->right)) {
+		n->parent = node;
+		while (n->left)
+			n = n->left;
+		node->succ = n;
+		n->prev = node;
+	}
+	return node;
+}
+
+static inline int _avl_bulk_load_helper(avl_t *avl, bulk_load_t *bl, int tid)
+{
+	int i, lo, hi;
+
+	for (i=tid; i < bulk_load_nr_subtrees(bl); i += bl->nthreads) {
+		bulk_load_subtree_range(bl, i, &lo, &hi);
+		bl->roots[i] = _avl_bulk_build(bl, lo, hi, bl->levels, i);
+	}
+	if (bulk_load_join(bl))
+		avl->root = _avl_bulk_build(bl, 0, bl->nr_keys, 0, 0);
+	bulk_load_wait(bl);
+
+	return bl->nr_keys;
+}
+
+static long long _avl_count_nodes(avl_node_t *root)
+{
+	if (!root)
+		return 0;
+	return 1 + _avl_count_nodes(root->left) + _avl_count_nodes(root->right);
+}
+
+static void _avl_free_nodes(avl_node_t *root)
+{
+	if (!root)
+		return;
+	_avl_free_nodes(root->left);
+	_avl_free_nodes(root->right);
+	free(root);
+}
+
 static int total_paths, total_nodes, bst_violations, avl_violations;
 static int min_path_len, max_path_len;
 static void _avl_validate_rec(avl_node_t *root, int _th)
@@ -755,11 +804,13 @@ int rbt_print(void *rbt)
 void *rbt_new()
 {
 	printf("Size of tree node is %lu\n", sizeof(avl_node_t));
+	node_stats_reset(&avl_node_stats);
 	return _avl_new_helper();
 }
 
 void *rbt_thread_data_new(int tid)
 {
+	node_stats_register(&avl_node_stats, tid);
 	return tdata_new(tid);
 }
 
@@ -775,6 +826,18 @@ void rbt_thread_data_add(void *d1, void *d2, void *dst)
 	tdata_add(d1, d2, dst);
 }
 
+void rbt_thread_data_free(void *thread_data)
+{
+	free(thread_data);
+}
+
+int rbt_thread_data_tx_stats(void *thread_data, rbt_tx_stats_t *stats)
+{
+	tdata_t *tdata = thread_data;
+	TM_STATS_COPY(stats, &tdata->tm.stats);
+	return 0;
+}
+
 int rbt_lookup(void *rbt, void *thread_data, int key)
 {
 	int ret = 0;
@@ -796,6 +859,24 @@ int rbt_delete(void *rbt, void *thread_data, int key)
 	return ret;
 }
 
+//> Key-value accessors are not supported.
+int rbt_get(void *rbt, void *thread_data, int key, void **value)
+{
+	return -1;
+}
+
+int rbt_update(void *rbt, void *thread_data, int key, void *value)
+{
+	return -1;
+}
+
+//> Range scans are not supported.
+int rbt_range(void *rbt, void *thread_data, int lo, int hi,
+              void (*cb)(int key, void *value, void *arg), void *arg)
+{
+	return -1;
+}
+
 int rbt_validate(void *rbt)
 {
 	int ret = 0;
@@ -803,6 +884,12 @@ int rbt_validate(void *rbt)
 	return ret;
 }
 
+void rbt_free(void *rbt)
+{
+	_avl_free_nodes(((avl_t *)rbt)->root);
+	free(rbt);
+}
+
 int rbt_warmup(void *rbt, int nr_nodes, int max_key, 
                unsigned int seed, int force)
 {
@@ -811,6 +898,25 @@ int rbt_warmup(void *rbt, int nr_nodes, int max_key,
 	return ret;
 }
 
+int rbt_bulk_load(void *rbt, void *thread_data, bulk_load_t *bl, int tid)
+{
+	return _avl_bulk_load_helper(rbt, bl, tid);
+}
+
+int rbt_mem_stats(void *rbt, rbt_mem_stats_t *stats)
+{
+	node_stats_thread_t total;
+
+	node_stats_sum(&avl_node_stats, &total);
+	stats->node_size = sizeof(avl_node_t);
+	stats->nodes_allocated = total.allocated;
+	stats->nodes_live = _avl_count_nodes(((avl_t *)rbt)->root);
+	stats->nodes_retired = stats->nodes_allocated - stats->nodes_live;
+	stats->nodes_free = 0;
+	stats->pool_capacity = total.pool_capacity;
+	return 0;
+}
+
 char *rbt_name()
 {
 	return "avl-cop-internal";
@@ -5,10 +5,18 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <pthread.h>
-#include <string.h>  //> memset() for per thread allocator
+#include <string.h>  //> memset()
 
 #include "alloc.h"
 #include "arch.h"
+#include "key.h"
+#include "rbt/iface.h"
+#include "node_layout.h"
+#include "node_pool.h"
+#include "node_stats.h"
+#include "ebr.h"
+#include "tm.h"
+#include "clargs.h"
 
 /******************************************************************************/
 /* A simple hash table implementation.                                        */
@@ -76,12 +84,31 @@ void ht_print(ht_t *ht)
 }
 /******************************************************************************/
 
-typedef struct {
+#define MAX_HEIGHT 50
+
+//> Upper bound of the nodes that a single insertion or deletion copies.
+//> Each level of a deletion copies at most three nodes.
+#define MAX_NODES_PER_UPDATE (4 * MAX_HEIGHT)
+
+typedef struct tdata_s {
 	int tid;
-	long long unsigned tx_starts, tx_aborts, 
-	                   tx_aborts_explicit_validation, lacqs;
-	unsigned int next_node_to_allocate;
+	tm_tdata_t tm;
+	node_pool_t node_pool;
 	ht_t *ht;
+
+	//> The other threads of the tree, see rbt_free().
+	struct tdata_s *next;
+
+	//> Nodes reclaimed through EBR, ready to be reused by this thread.
+	struct avl_node_s *free_nodes;
+	ebr_thread_t *ebr_thread;
+
+	//> Nodes allocated by the current update attempt and original nodes
+	//> that it replaces. The former go back to the pool if the attempt is
+	//> abandoned, the latter are retired if the attempt commits.
+	int nr_allocated, nr_replaced;
+	struct avl_node_s *allocated[MAX_NODES_PER_UPDATE];
+	struct avl_node_s *replaced[MAX_NODES_PER_UPDATE];
 } tdata_t;
 
 static inline tdata_t *tdata_new(int tid)
@@ -89,78 +116,51 @@ static inline tdata_t *tdata_new(int tid)
 	tdata_t *ret;
 	XMALLOC(ret, 1);
 	ret->tid = tid;
-	ret->tx_starts = 0;
-	ret->tx_aborts = 0;
-	ret->tx_aborts_explicit_validation = 0;
-	ret->lacqs = 0;
-	ret->next_node_to_allocate = 0;
+	tm_tdata_init(&ret->tm, tid, clargs.tx_policy, clargs.tx_retries);
+	node_pool_init(&ret->node_pool, 0, 0);
 	ret->ht = ht_new();
+	ret->next = NULL;
+	ret->free_nodes = NULL;
+	ret->ebr_thread = NULL;
+	ret->nr_allocated = 0;
+	ret->nr_replaced = 0;
 	return ret;
 }
 
 static inline void tdata_print(tdata_t *tdata)
 {
-	printf("TID %3d: %llu %llu %llu ( %llu )\n", tdata->tid, tdata->tx_starts,
-	      tdata->tx_aborts, tdata->tx_aborts_explicit_validation, tdata->lacqs);
+	tm_tdata_print(&tdata->tm);
 }
 
 static inline void tdata_add(tdata_t *d1, tdata_t *d2, tdata_t *dst)
 {
-	dst->tx_starts = d1->tx_starts + d2->tx_starts;
-	dst->tx_aborts = d1->tx_aborts + d2->tx_aborts;
-	dst->tx_aborts_explicit_validation = d1->tx_aborts_explicit_validation +
-	                                     d2->tx_aborts_explicit_validation;
-	dst->lacqs = d1->lacqs + d2->lacqs;
+	tm_tdata_add(&d1->tm, &d2->tm, &dst->tm);
 }
 
-/* TM Interface. */
-#if !defined(TX_NUM_RETRIES)
-#	define TX_NUM_RETRIES 20
-#endif
-
-#ifdef __POWERPC64__
-#	include <htmintrin.h>
-	typedef int tm_begin_ret_t;
-#	define LOCK_FREE 0
-#	define TM_BEGIN_SUCCESS 1
-#	define ABORT_VALIDATION_FAILURE 0xee
-#	define ABORT_GL_TAKEN           0xff
-#	define TX_ABORT(code) __builtin_tabort(code)
-#	define TX_BEGIN(code) __builtin_tbegin(0)
-#	define TX_END(code)   __builtin_tend(0)
-#else
-#	include "rtm.h"
-	typedef unsigned tm_begin_ret_t;
-#	define LOCK_FREE 1
-#	define TM_BEGIN_SUCCESS _XBEGIN_STARTED
-#	define ABORT_VALIDATION_FAILURE 0xee
-#	define ABORT_GL_TAKEN           0xff
-#	define ABORT_IS_CONFLICT(status) ((status) & _XABORT_CONFLICT)
-#	define ABORT_IS_EXPLICIT(status) ((status) & _XABORT_EXPLICIT)
-#	define ABORT_CODE(status) _XABORT_CODE(status)
-#	define TX_ABORT(code) _xabort(code)
-#	define TX_BEGIN(code) _xbegin()
-#	define TX_END(code)   _xend()
-#endif
-/*****************/
 
 #define MAX(a,b) ( (a) >= (b) ? (a) : (b) )
-#define MAX_HEIGHT 50
 
+//> See lib/node_layout.h for the NODE_LAYOUT_* build options.
 typedef struct avl_node_s {
-	int key;
+#if defined(NODE_LAYOUT_SPLIT)
+	//> Hot: read at every level of a traversal.
+	struct avl_node_s *left,
+	                  *right;
+	map_key_t key;
+
+	//> Cold: read only by updaters and when the key is found.
+	int height;
+	void *data;
+#else
+	map_key_t key;
 	void *data;
 
 	int height;
 
 	struct avl_node_s *left,
 	                  *right;
-
-//	char padding[CACHE_LINE_SIZE - 2 * sizeof(int) - sizeof(void *) -
-//	             2 * sizeof(struct node_s *)];
-//} __attribute__((packed)) __attribute__((aligned(CACHE_LINE_SIZE))) avl_node_t;
-} __attribute__((packed)) avl_node_t;
-//} __attribute__((aligned(CACHE_LINE_SIZE))) avl_node_t;
+#endif
+} NODE_ATTRS avl_node_t;
 
 typedef struct {
 	avl_node_t *root;
@@ -169,17 +169,24 @@ typedef struct {
 	// same cache line with the lock.
 	char padding[CACHE_LINE_SIZE - sizeof(avl_node_t *)];
 
-	pthread_spinlock_t avl_lock;
+	tm_fallback_lock_t avl_lock;
 } avl_t;
 
+//> Capacity of each thread's node pool, beyond which nodes are malloc()ed.
 #define NODES_PER_ALLOCATOR 10000000
-avl_node_t *per_thread_node_allocators[88];
 
-static avl_node_t *avl_node_new(int key, void *data)
+//> Reclaims the nodes replaced by committed path copies.
+static ebr_t *avl_ebr;
+static node_stats_t avl_node_stats;
+//> The thread data of all threads, whose pools hold most of the nodes.
+static tdata_t *avl_tdatas;
+
+static avl_node_t *avl_node_new(map_key_t key, void *data)
 {
 	avl_node_t *node;
 
-	XMALLOC(node, 1);
+	XMALLOC_ALIGNED(node, 1, NODE_ALIGN);
+	node_stats_alloc(&avl_node_stats, 1);
 	node->key = key;
 	node->data = data;
 	node->height = 0; // new nodes have height 0 and NULL has height -1.
@@ -187,6 +194,61 @@ static avl_node_t *avl_node_new(int key, void *data)
 	return node;
 }
 
+/**
+ * Per thread node allocation. Nodes are first taken from the reclaimed
+ * ones, then from the thread's pool (lib/node_pool.h) and only then from
+ * malloc().
+ **/
+static avl_node_t *avl_node_alloc(tdata_t *tdata)
+{
+	avl_node_t *node;
+
+	if (tdata->free_nodes) {
+		node = tdata->free_nodes;
+		tdata->free_nodes = node->left;
+	} else {
+		if (!(node = node_pool_alloc(&tdata->node_pool)))
+			XMALLOC_ALIGNED(node, 1, NODE_ALIGN);
+		node_stats_alloc(&avl_node_stats, 1);
+	}
+
+	assert(tdata->nr_allocated < MAX_NODES_PER_UPDATE);
+	tdata->allocated[tdata->nr_allocated++] = node;
+	return node;
+}
+
+//> EBR callback; `arg` is the tdata_t of the thread that retired `obj`.
+static void avl_node_free(void *obj, void *arg)
+{
+	avl_node_t *node = obj;
+	tdata_t *tdata = arg;
+
+	node->left = tdata->free_nodes;
+	tdata->free_nodes = node;
+}
+
+//> Nodes outside the pools were malloc()ed and are free()d one by one.
+static int avl_node_in_pool(avl_node_t *node)
+{
+	tdata_t *tdata;
+
+	for (tdata=avl_tdatas; tdata; tdata=tdata->next)
+		if (node_pool_owns(&tdata->node_pool, node))
+			return 1;
+	return 0;
+}
+
+static avl_node_t *avl_node_new_local(map_key_t key, void *data, tdata_t *tdata)
+{
+	avl_node_t *node = avl_node_alloc(tdata);
+
+	node->key = key;
+	node->data = data;
+	node->height = 0;
+	node->right = node->left = NULL;
+	return node;
+}
+
 static void avl_node_copy(avl_node_t *dest, avl_node_t *src)
 {
 	dest->key = src->key;
@@ -197,17 +259,53 @@ static void avl_node_copy(avl_node_t *dest, avl_node_t *src)
 	__sync_synchronize();
 }
 
+//> `node` will become unreachable if the current update attempt commits.
+static inline void update_attempt_replaces(tdata_t *tdata, avl_node_t *node)
+{
+	assert(tdata->nr_replaced < MAX_NODES_PER_UPDATE);
+	tdata->replaced[tdata->nr_replaced++] = node;
+}
+
 static avl_node_t *avl_node_new_copy(avl_node_t *src, tdata_t *tdata)
 {
-	avl_node_t *node;
-	if (tdata->next_node_to_allocate >= NODES_PER_ALLOCATOR)
-		node = avl_node_new(0, NULL);
-	else
-		node = &per_thread_node_allocators[tdata->tid][tdata->next_node_to_allocate++];
+	avl_node_t *node = avl_node_alloc(tdata);
+	update_attempt_replaces(tdata, src);
 	avl_node_copy(node, src);
+	//> Values are updated in place (_avl_update_helper()), so the copy is
+	//> only valid as long as the original value is still there.
+	ht_insert(tdata->ht, &src->data, node->data);
 	return node;
 }
 
+/**
+ * Called before every update attempt. Nodes allocated by a previous,
+ * abandoned attempt were never published so they go straight back to the pool.
+ **/
+static inline void update_attempt_reset(tdata_t *tdata)
+{
+	int i;
+
+	for (i=0; i < tdata->nr_allocated; i++)
+		avl_node_free(tdata->allocated[i], tdata);
+	tdata->nr_allocated = 0;
+	tdata->nr_replaced = 0;
+	ht_reset(tdata->ht);
+}
+
+/**
+ * Called after the copy has been connected to the tree. The nodes it
+ * replaced are unreachable from now on and are retired.
+ **/
+static inline void update_attempt_commit(tdata_t *tdata)
+{
+	int i;
+
+	for (i=0; i < tdata->nr_replaced; i++)
+		ebr_retire(avl_ebr, tdata->ebr_thread, tdata->replaced[i]);
+	tdata->nr_allocated = 0;
+	tdata->nr_replaced = 0;
+}
+
 static inline int node_height(avl_node_t *n)
 {
 	if (!n)
@@ -230,7 +328,7 @@ static avl_t *_avl_new_helper()
 
 	XMALLOC(avl, 1);
 	avl->root = NULL;
-	pthread_spin_init(&avl->avl_lock, PTHREAD_PROCESS_SHARED);
+	tm_fallback_lock_init(&avl->avl_lock);
 
 	return avl;
 }
@@ -269,44 +367,45 @@ static inline avl_node_t *rotate_left(avl_node_t *node)
  * the node that will be the parent of the inserted node.
  * In the case of an empty tree both `parent` and `leaf` are NULL.
  **/
-static inline void _traverse(avl_t *avl, int key, avl_node_t **parent,
+static inline void _traverse(avl_t *avl, map_key_t key, avl_node_t **parent,
                                                  avl_node_t **leaf)
 {
 	*parent = NULL;
 	*leaf = avl->root;
 
 	while (*leaf) {
-		int leaf_key = (*leaf)->key;
-		if (leaf_key == key)
+		map_key_t leaf_key = (*leaf)->key;
+		if (KEY_EQ(leaf_key, key))
 			return;
 
 		*parent = *leaf;
-		*leaf = (key < leaf_key) ? (*leaf)->left : (*leaf)->right;
+		*leaf = KEY_LT(key, leaf_key) ? (*leaf)->left : (*leaf)->right;
 	}
 }
-static inline void _traverse_with_stack(avl_t *avl, int key,
+static inline void _traverse_with_stack(avl_t *avl, map_key_t key,
                                         avl_node_t *node_stack[MAX_HEIGHT],
-                                        int *stack_top)
+                                        TX_VOLATILE int *stack_top)
 {
 	avl_node_t *parent, *leaf;
+	int top = -1;
 
 	parent = NULL;
 	leaf = avl->root;
-	*stack_top = -1;
 
 	while (leaf) {
-		node_stack[++(*stack_top)] = leaf;
+		node_stack[++top] = leaf;
 
-		int leaf_key = leaf->key;
-		if (leaf_key == key)
-			return;
+		map_key_t leaf_key = leaf->key;
+		if (KEY_EQ(leaf_key, key))
+			break;
 
 		parent = leaf;
-		leaf = (key < leaf_key) ? leaf->left : leaf->right;
+		leaf = KEY_LT(key, leaf_key) ? leaf->left : leaf->right;
 	}
+	*stack_top = top;
 }
 
-static int _avl_lookup_helper(avl_t *avl, int key)
+static int _avl_lookup_helper(avl_t *avl, map_key_t key)
 {
 	avl_node_t *parent, *leaf;
 
@@ -314,7 +413,71 @@ static int _avl_lookup_helper(avl_t *avl, int key)
 	return (leaf != NULL);
 }
 
-static inline void _avl_insert_fixup(avl_t *avl, int key,
+static int _avl_get_helper(avl_t *avl, map_key_t key, void **value)
+{
+	avl_node_t *parent, *leaf;
+
+	_traverse(avl, key, &parent, &leaf);
+	if (!leaf)
+		return 0;
+	*value = leaf->data;
+	return 1;
+}
+
+/**
+ * In-order scan of the keys in [lo, hi) without synchronization.
+ * Insertions and deletions never modify a published node other than
+ * swinging one child pointer of the connection point to a new subtree,
+ * which holds exactly the keys of the one it replaces plus/minus the
+ * updated key. Hence:
+ *  - keys are reported in strictly ascending order, each one at most once,
+ *  - every key that is in the tree throughout the scan is reported,
+ *  - no key that is absent throughout the scan is reported,
+ *  - a key inserted or deleted during the scan may or may not be reported.
+ * Values, on the other hand, are updated in place (see _avl_update_helper())
+ * and a reported value is whichever one the scan read.
+ * The scan is thus atomic per subtree but not a snapshot of the whole range.
+ **/
+static int _avl_range_helper(avl_t *avl, map_key_t lo, map_key_t hi,
+                             void (*cb)(map_key_t, void *, void *), void *arg)
+{
+	avl_node_t *node_stack[MAX_HEIGHT];
+	int stack_top = -1;
+	avl_node_t *curr = avl->root;
+	int nkeys = 0;
+	map_key_t last_key = lo;
+
+	while (curr || stack_top >= 0) {
+		while (curr) {
+			if (KEY_LT(curr->key, lo)) {
+				curr = curr->right;
+				continue;
+			}
+			assert(stack_top < MAX_HEIGHT - 1);
+			node_stack[++stack_top] = curr;
+			curr = curr->left;
+		}
+		//> The rest of the subtree lies below lo.
+		if (stack_top < 0)
+			break;
+
+		curr = node_stack[stack_top--];
+		if (KEY_GE(curr->key, hi))
+			break;
+		//> Guards the ascending order against concurrent restructuring.
+		if (nkeys == 0 || KEY_GT(curr->key, last_key)) {
+			if (cb)
+				cb(curr->key, curr->data, arg);
+			last_key = curr->key;
+			nkeys++;
+		}
+		curr = curr->right;
+	}
+
+	return nkeys;
+}
+
+static inline void _avl_insert_fixup(avl_t *avl, map_key_t key,
                                      avl_node_t *node_stack[MAX_HEIGHT],
                                      int top)
 {
@@ -332,12 +495,12 @@ static inline void _avl_insert_fixup(avl_t *avl, int key,
 
 			if (balance2 == 1) { // LEFT-LEFT case
 				if (!parent)                avl->root = rotate_right(curr);
-				else if (key < parent->key) parent->left = rotate_right(curr);
+				else if (KEY_LT(key, parent->key)) parent->left = rotate_right(curr);
 				else                        parent->right = rotate_right(curr);
 			} else if (balance2 == -1) { // LEFT-RIGHT case
 				curr->left = rotate_left(curr->left);
 				if (!parent)                avl->root = rotate_right(curr); 
-				else if (key < parent->key) parent->left = rotate_right(curr);
+				else if (KEY_LT(key, parent->key)) parent->left = rotate_right(curr);
 				else                        parent->right = rotate_right(curr);
 			} else {
 				assert(0);
@@ -349,12 +512,12 @@ static inline void _avl_insert_fixup(avl_t *avl, int key,
 
 			if (balance2 == -1) { // RIGHT-RIGHT case
 				if (!parent)                avl->root = rotate_left(curr);
-				else if (key < parent->key) parent->left = rotate_left(curr);
+				else if (KEY_LT(key, parent->key)) parent->left = rotate_left(curr);
 				else                        parent->right = rotate_left(curr);
 			} else if (balance2 == 1) { // RIGHT-LEFT case
 				curr->right = rotate_right(curr->right);
 				if (!parent)                avl->root = rotate_left(curr);
-				else if (key < parent->key) parent->left = rotate_left(curr);
+				else if (KEY_LT(key, parent->key)) parent->left = rotate_left(curr);
 				else                        parent->right = rotate_left(curr);
 			} else {
 				assert(0);
@@ -372,7 +535,7 @@ static inline void _avl_insert_fixup(avl_t *avl, int key,
 	}
 }
 
-static inline int _insert(avl_t *avl, int key, void *value,
+static inline int _insert(avl_t *avl, map_key_t key, void *value,
                           avl_node_t *node_stack[MAX_HEIGHT], int stack_top)
 {
 	// Empty tree case
@@ -384,10 +547,10 @@ static inline int _insert(avl_t *avl, int key, void *value,
 	avl_node_t *place = node_stack[stack_top];
 
 	// Key already in the tree.
-	if (place->key == key)
+	if (KEY_EQ(place->key, key))
 		return 0;
 
-	if (key < place->key)
+	if (KEY_LT(key, place->key))
 		place->left = avl_node_new(key, value);
 	else
 		place->right = avl_node_new(key, value);
@@ -395,14 +558,14 @@ static inline int _insert(avl_t *avl, int key, void *value,
 	return 1;
 }
 
-static avl_node_t *_insert_and_rebalance_with_copy(int key, void *value,
+static avl_node_t *_insert_and_rebalance_with_copy(map_key_t key, void *value,
         avl_node_t *node_stack[MAX_HEIGHT], int stack_top, tdata_t *tdata,
         avl_node_t **tree_copy_root_ret, int *connection_point_stack_index)
 {
 	avl_node_t *tree_copy_root, *connection_point;
 
 	/* Start the tree copying with the new node. */
-	tree_copy_root = avl_node_new(key, value);
+	tree_copy_root = avl_node_new_local(key, value, tdata);
 	*connection_point_stack_index = stack_top;
 	connection_point = node_stack[stack_top--];
 
@@ -421,7 +584,7 @@ static avl_node_t *_insert_and_rebalance_with_copy(int key, void *value,
 		ht_insert(tdata->ht, &connection_point->right, curr_cp->right);
 
 		curr_cp->height = tree_copy_root->height + 1;
-		if (key < curr_cp->key) curr_cp->left = tree_copy_root;
+		if (KEY_LT(key, curr_cp->key)) curr_cp->left = tree_copy_root;
 		else                    curr_cp->right = tree_copy_root;
 		tree_copy_root = curr_cp;
 
@@ -432,7 +595,7 @@ static avl_node_t *_insert_and_rebalance_with_copy(int key, void *value,
 		// Get current node's balance
 		avl_node_t *sibling;
 		int curr_balance;
-		if (key < curr_cp->key) {
+		if (KEY_LT(key, curr_cp->key)) {
 			sibling = curr_cp->right;
 			curr_balance = node_height(curr_cp->left) - node_height(sibling);
 		} else {
@@ -473,27 +636,28 @@ static avl_node_t *_insert_and_rebalance_with_copy(int key, void *value,
 	return connection_point;
 }
 
-static int _avl_insert_helper(avl_t *avl, int key, void *value, tdata_t *tdata)
+static int _avl_insert_helper(avl_t *avl, map_key_t key, void *value, tdata_t *tdata)
 {
 	avl_node_t *node_stack[MAX_HEIGHT];
-	int stack_top;
+	TX_VOLATILE int stack_top;
 	tm_begin_ret_t status;
-	int retries = -1;
+	TX_VOLATILE int retries = -1;
 	int i;
 	avl_node_t *tree_copy_root, *connection_point;
 	int connection_point_stack_index;
 
+	tm_op_begin(&tdata->tm);
+
 try_from_scratch:
 
-	ht_reset(tdata->ht);
+	update_attempt_reset(tdata);
 
-	if (++retries >= TX_NUM_RETRIES) {
-		tdata->lacqs++;
-		pthread_spin_lock(&avl->avl_lock);
+	if (!tm_retry_allowed(&tdata->tm, ++retries)) {
+		tm_fallback_lock(&avl->avl_lock, &tdata->tm);
 //		volatile int j; for (j=0; j < 10000000; j++) ; // XXX DEBUG
 		_traverse_with_stack(avl, key, node_stack, &stack_top);
-		if (stack_top >= 0 && node_stack[stack_top]->key == key) {
-			pthread_spin_unlock(&avl->avl_lock);
+		if (stack_top >= 0 && KEY_EQ(node_stack[stack_top]->key, key)) {
+			tm_fallback_unlock(&avl->avl_lock, &tdata->tm);
 			return 0;
 		}
 		connection_point_stack_index = -1;
@@ -503,18 +667,19 @@ try_from_scratch:
 		if (!connection_point) {
 			avl->root = tree_copy_root;
 		} else {
-			if (key <= connection_point->key)
+			if (KEY_LE(key, connection_point->key))
 				connection_point->left = tree_copy_root;
 			else
 				connection_point->right = tree_copy_root;
 		}
-		pthread_spin_unlock(&avl->avl_lock);
+		tm_fallback_unlock(&avl->avl_lock, &tdata->tm);
+		update_attempt_commit(tdata);
 		return 1;
 	}
 
 	/* Asynchronized traversal. If key is not there we can safely return. */
 	_traverse_with_stack(avl, key, node_stack, &stack_top);
-	if (stack_top >= 0 && node_stack[stack_top]->key == key)
+	if (stack_top >= 0 && KEY_EQ(node_stack[stack_top]->key, key))
 		return 0;
 
 	// For now let's ignore empty tree case and case with only one node in the tree.
@@ -525,33 +690,32 @@ try_from_scratch:
 	                             node_stack, stack_top, tdata, &tree_copy_root,
 	                             &connection_point_stack_index);
 
-	int validation_retries = -1;
+	TX_VOLATILE int validation_retries = -1;
 validate_and_connect_copy:
 
-	if (++validation_retries >= TX_NUM_RETRIES)
+	if (!tm_retry_allowed(&tdata->tm, ++validation_retries))
 		goto try_from_scratch;
 
 	/* Transactional verification. */
-	while (avl->avl_lock != LOCK_FREE)
-		;
+	tm_fallback_wait(&avl->avl_lock);
 
-	tdata->tx_starts++;
-	status = TX_BEGIN(0);
+	tm_tx_started(&tdata->tm);
+	TX_BEGIN(status);
 	if (status == TM_BEGIN_SUCCESS) {
-		if (avl->avl_lock != LOCK_FREE)
+		if (tm_fallback_is_locked(&avl->avl_lock))
 			TX_ABORT(ABORT_GL_TAKEN);
 
 		// Validate copy
-		if (key < node_stack[stack_top]->key && node_stack[stack_top]->left != NULL)
+		if (KEY_LT(key, node_stack[stack_top]->key) && node_stack[stack_top]->left != NULL)
 			TX_ABORT(ABORT_VALIDATION_FAILURE);
-		if (key > node_stack[stack_top]->key && node_stack[stack_top]->right != NULL)
+		if (KEY_GT(key, node_stack[stack_top]->key) && node_stack[stack_top]->right != NULL)
 			TX_ABORT(ABORT_VALIDATION_FAILURE);
 		if (avl->root != node_stack[0])
 			TX_ABORT(ABORT_VALIDATION_FAILURE);
 
 		if (connection_point_stack_index <= 0) {
 			for (i=0; i < stack_top; i++) {
-				if (key <= node_stack[i]->key) {
+				if (KEY_LE(key, node_stack[i]->key)) {
 					if (node_stack[i]->left != node_stack[i+1])
 						TX_ABORT(ABORT_VALIDATION_FAILURE);
 				} else {
@@ -562,11 +726,11 @@ validate_and_connect_copy:
 		} else {
 			avl_node_t *curr = avl->root;
 			while (curr && curr != connection_point)
-				curr = (key <= curr->key) ? curr->left : curr->right;
+				curr = KEY_LE(key, curr->key) ? curr->left : curr->right;
 			if (curr != connection_point)
 				TX_ABORT(ABORT_VALIDATION_FAILURE);
 			for (i=connection_point_stack_index; i < stack_top; i++) {
-				if (key <= node_stack[i]->key) {
+				if (KEY_LE(key, node_stack[i]->key)) {
 					if (node_stack[i]->left != node_stack[i+1])
 						TX_ABORT(ABORT_VALIDATION_FAILURE);
 				} else {
@@ -589,20 +753,20 @@ validate_and_connect_copy:
 
 		// Now let's 'commit' the tree copy onto the original tree.
 		if (!connection_point) {
-			avl->root = tree_copy_root;
+			TX_STORE(avl->root, tree_copy_root);
 		} else {
-			if (key <= connection_point->key)
-				connection_point->left = tree_copy_root;
+			if (KEY_LE(key, connection_point->key))
+				TX_STORE(connection_point->left, tree_copy_root);
 			else
-				connection_point->right = tree_copy_root;
+				TX_STORE(connection_point->right, tree_copy_root);
 		}
 
 		TX_END(0);
+		tm_tx_committed(&tdata->tm);
+		update_attempt_commit(tdata);
 	} else {
-		tdata->tx_aborts++;
-		if (ABORT_IS_EXPLICIT(status) && 
-		    ABORT_CODE(status) == ABORT_VALIDATION_FAILURE) {
-			tdata->tx_aborts_explicit_validation++;
+		tm_tx_aborted(&tdata->tm, status);
+		if (ABORT_IS_VALIDATION(status)) {
 			goto try_from_scratch;
 		} else {
 			goto validate_and_connect_copy;
@@ -612,7 +776,7 @@ validate_and_connect_copy:
 	return 1;
 }
 
-static int _avl_insert_helper_warmup(avl_t *avl, int key, void *value)
+static int _avl_insert_helper_warmup(avl_t *avl, map_key_t key, void *value)
 {
 	avl_node_t *node_stack[MAX_HEIGHT];
 	int stack_top;
@@ -648,7 +812,7 @@ static inline void _find_successor_with_stack(avl_node_t *node,
 	}
 }
 
-static avl_node_t *_delete_and_rebalance_with_copy(int key,
+static avl_node_t *_delete_and_rebalance_with_copy(map_key_t key,
                        avl_node_t *node_stack[MAX_HEIGHT], int stack_top,
                        tdata_t *tdata, avl_node_t **tree_copy_root_ret,
                        int *connection_point_stack_index, int *new_stack_top)
@@ -663,9 +827,13 @@ static avl_node_t *_delete_and_rebalance_with_copy(int key,
 	*new_stack_top = stack_top;
 
 	avl_node_t *to_be_deleted = node_stack[stack_top];
+	update_attempt_replaces(tdata, to_be_deleted);
 	l = to_be_deleted->left; r = to_be_deleted->right;
 	ht_insert(tdata->ht, &to_be_deleted->left, l);
 	ht_insert(tdata->ht, &to_be_deleted->right, r);
+	//> The successor's value moves along with its key.
+	void *to_be_deleted_data = to_be_deleted->data;
+	ht_insert(tdata->ht, &to_be_deleted->data, to_be_deleted_data);
 	tree_copy_root = (l != NULL) ? l : r;
 	stack_top--;
 	*connection_point_stack_index = stack_top;
@@ -678,7 +846,7 @@ static avl_node_t *_delete_and_rebalance_with_copy(int key,
 
 		avl_node_t *sibling;
 		int curr_balance;
-		if (key < connection_point->key) {
+		if (KEY_LT(key, connection_point->key)) {
 			sibling = connection_point->right;
 			ht_insert(tdata->ht, &connection_point->right, sibling);
 			curr_balance = node_height(tree_copy_root) - node_height(sibling);
@@ -695,11 +863,13 @@ static avl_node_t *_delete_and_rebalance_with_copy(int key,
 
 			ht_insert(tdata->ht, &connection_point->left, curr_cp->left);
 			ht_insert(tdata->ht, &connection_point->right, curr_cp->right);
-			if (key < curr_cp->key) curr_cp->left = tree_copy_root;
+			if (KEY_LT(key, curr_cp->key)) curr_cp->left = tree_copy_root;
 			else                    curr_cp->right = tree_copy_root;
 			tree_copy_root = curr_cp;
-			if (connection_point == original_to_be_deleted)
+			if (connection_point == original_to_be_deleted) {
 				tree_copy_root->key = to_be_deleted->key;
+				tree_copy_root->data = to_be_deleted_data;
+			}
 			curr_cp = avl_node_new_copy(tree_copy_root->left, tdata);
 			ht_insert(tdata->ht, &tree_copy_root->left->left, curr_cp->left);
 			ht_insert(tdata->ht, &tree_copy_root->left->right, curr_cp->right);
@@ -731,11 +901,13 @@ static avl_node_t *_delete_and_rebalance_with_copy(int key,
 
 			ht_insert(tdata->ht, &connection_point->left, curr_cp->left);
 			ht_insert(tdata->ht, &connection_point->right, curr_cp->right);
-			if (key < curr_cp->key) curr_cp->left = tree_copy_root;
+			if (KEY_LT(key, curr_cp->key)) curr_cp->left = tree_copy_root;
 			else                    curr_cp->right = tree_copy_root;
 			tree_copy_root = curr_cp;
-			if (connection_point == original_to_be_deleted)
+			if (connection_point == original_to_be_deleted) {
 				tree_copy_root->key = to_be_deleted->key;
+				tree_copy_root->data = to_be_deleted_data;
+			}
 			curr_cp = avl_node_new_copy(tree_copy_root->right, tdata);
 			ht_insert(tdata->ht, &tree_copy_root->right->left, curr_cp->left);
 			ht_insert(tdata->ht, &tree_copy_root->right->right, curr_cp->right);
@@ -770,7 +942,7 @@ static avl_node_t *_delete_and_rebalance_with_copy(int key,
 
 		// Copy the current node and link it to the local copy.
 		avl_node_t *curr_cp = avl_node_new_copy(connection_point, tdata);
-		if (key < curr_cp->key) curr_cp->right = sibling;
+		if (KEY_LT(key, curr_cp->key)) curr_cp->right = sibling;
 		else                    curr_cp->left = sibling;
 
 		ht_insert(tdata->ht, &connection_point->left, curr_cp->left);
@@ -778,11 +950,13 @@ static avl_node_t *_delete_and_rebalance_with_copy(int key,
 
 		// Change the height of current node's copy + the key if needed.
 		curr_cp->height = new_height;
-		if (key < curr_cp->key) curr_cp->left = tree_copy_root;
+		if (KEY_LT(key, curr_cp->key)) curr_cp->left = tree_copy_root;
 		else                    curr_cp->right = tree_copy_root;
 		tree_copy_root = curr_cp;
-		if (connection_point == original_to_be_deleted)
+		if (connection_point == original_to_be_deleted) {
 			tree_copy_root->key = to_be_deleted->key;
+			tree_copy_root->data = to_be_deleted_data;
+		}
 
 		// Move one level up
 		*connection_point_stack_index = stack_top;
@@ -799,11 +973,12 @@ static avl_node_t *_delete_and_rebalance_with_copy(int key,
 			ht_insert(tdata->ht, &node_stack[i]->left, curr_cp->left);
 			ht_insert(tdata->ht, &node_stack[i]->right, curr_cp->right);
 
-			if (key < curr_cp->key) curr_cp->left = tree_copy_root;
+			if (KEY_LT(key, curr_cp->key)) curr_cp->left = tree_copy_root;
 			else                    curr_cp->right = tree_copy_root;
 			tree_copy_root = curr_cp;
 		}
 		tree_copy_root->key = to_be_deleted->key;
+		tree_copy_root->data = to_be_deleted_data;
 		connection_point = to_be_deleted_stack_index > 0 ? 
 		                             node_stack[to_be_deleted_stack_index - 1] :
 		                             NULL;
@@ -814,28 +989,29 @@ static avl_node_t *_delete_and_rebalance_with_copy(int key,
 	return connection_point;
 }
 
-static int _avl_delete_helper(avl_t *avl, int key, tdata_t *tdata)
+static int _avl_delete_helper(avl_t *avl, map_key_t key, tdata_t *tdata)
 {
 	avl_node_t *node_stack[MAX_HEIGHT];
 	int stack_top;
 	tm_begin_ret_t status;
-	int retries = -1;
+	TX_VOLATILE int retries = -1;
 	int i;
 	avl_node_t *tree_copy_root, *connection_point;
 	int connection_point_stack_index;
 
+	tm_op_begin(&tdata->tm);
+
 try_from_scratch:
 
-	ht_reset(tdata->ht);
+	update_attempt_reset(tdata);
 
 	/* Global lock fallback.*/
-	if (++retries >= TX_NUM_RETRIES) {
-		tdata->lacqs++;
-		pthread_spin_lock(&avl->avl_lock);
+	if (!tm_retry_allowed(&tdata->tm, ++retries)) {
+		tm_fallback_lock(&avl->avl_lock, &tdata->tm);
 //		volatile int j; for (j=0; j < 10000000; j++) ; // XXX DEBUG
 		_traverse_with_stack(avl, key, node_stack, &stack_top);
-		if (stack_top >= 0 && node_stack[stack_top]->key != key) {
-			pthread_spin_unlock(&avl->avl_lock);
+		if (stack_top >= 0 && !KEY_EQ(node_stack[stack_top]->key, key)) {
+			tm_fallback_unlock(&avl->avl_lock, &tdata->tm);
 			return 0;
 		}
 		connection_point_stack_index = -1;
@@ -845,19 +1021,20 @@ try_from_scratch:
 		if (!connection_point) {
 			avl->root = tree_copy_root;
 		} else {
-			if (key <= connection_point->key)
+			if (KEY_LE(key, connection_point->key))
 				connection_point->left = tree_copy_root;
 			else
 				connection_point->right = tree_copy_root;
 		}
 
-		pthread_spin_unlock(&avl->avl_lock);
+		tm_fallback_unlock(&avl->avl_lock, &tdata->tm);
+		update_attempt_commit(tdata);
 		return 1;
 	}
 
 	/* Asynchronized traversal. If key is not there we can safely return. */
 	_traverse_with_stack(avl, key, node_stack, &stack_top);
-	if (stack_top >= 0 && node_stack[stack_top]->key != key)
+	if (stack_top >= 0 && !KEY_EQ(node_stack[stack_top]->key, key))
 		return 0;
 
 	connection_point_stack_index = -1;
@@ -865,20 +1042,19 @@ try_from_scratch:
 	                             node_stack, stack_top, tdata,
 	                             &tree_copy_root, &connection_point_stack_index, &stack_top);
 
-	int validation_retries = -1;
+	TX_VOLATILE int validation_retries = -1;
 validate_and_connect_copy:
 
-	if (++validation_retries >= TX_NUM_RETRIES)
+	if (!tm_retry_allowed(&tdata->tm, ++validation_retries))
 		goto try_from_scratch;
 
 	/* Transactional verification. */
-	while (avl->avl_lock != LOCK_FREE)
-		;
+	tm_fallback_wait(&avl->avl_lock);
 
-	tdata->tx_starts++;
-	status = TX_BEGIN(0);
+	tm_tx_started(&tdata->tm);
+	TX_BEGIN(status);
 	if (status == TM_BEGIN_SUCCESS) {
-		if (avl->avl_lock != LOCK_FREE)
+		if (tm_fallback_is_locked(&avl->avl_lock))
 			TX_ABORT(ABORT_GL_TAKEN);
 
 		// Validate copy
@@ -889,7 +1065,7 @@ validate_and_connect_copy:
 
 		if (connection_point_stack_index <= 0) {
 			for (i=0; i < stack_top; i++) {
-				if (key < node_stack[i]->key) {
+				if (KEY_LT(key, node_stack[i]->key)) {
 					if (node_stack[i]->left != node_stack[i+1])
 						TX_ABORT(ABORT_VALIDATION_FAILURE);
 				} else {
@@ -900,11 +1076,11 @@ validate_and_connect_copy:
 		} else {
 			avl_node_t *curr = avl->root;
 			while (curr && curr != connection_point)
-				curr = (key <= curr->key) ? curr->left : curr->right;
+				curr = KEY_LE(key, curr->key) ? curr->left : curr->right;
 			if (curr != connection_point)
 				TX_ABORT(ABORT_VALIDATION_FAILURE);
 			for (i=connection_point_stack_index; i < stack_top; i++) {
-				if (key < node_stack[i]->key) {
+				if (KEY_LT(key, node_stack[i]->key)) {
 					if (node_stack[i]->left != node_stack[i+1])
 						TX_ABORT(ABORT_VALIDATION_FAILURE);
 				} else {
@@ -927,20 +1103,20 @@ validate_and_connect_copy:
 
 		// Now let's 'commit' the tree copy onto the original tree.
 		if (!connection_point) {
-			avl->root = tree_copy_root;
+			TX_STORE(avl->root, tree_copy_root);
 		} else {
-			if (key <= connection_point->key)
-				connection_point->left = tree_copy_root;
+			if (KEY_LE(key, connection_point->key))
+				TX_STORE(connection_point->left, tree_copy_root);
 			else
-				connection_point->right = tree_copy_root;
+				TX_STORE(connection_point->right, tree_copy_root);
 		}
 
 		TX_END(0);
+		tm_tx_committed(&tdata->tm);
+		update_attempt_commit(tdata);
 	} else {
-		tdata->tx_aborts++;
-		if (ABORT_IS_EXPLICIT(status) && 
-		    ABORT_CODE(status) == ABORT_VALIDATION_FAILURE) {
-			tdata->tx_aborts_explicit_validation++;
+		tm_tx_aborted(&tdata->tm, status);
+		if (ABORT_IS_VALIDATION(status)) {
 			goto try_from_scratch;
 		} else {
 			goto validate_and_connect_copy;
@@ -950,14 +1126,67 @@ validate_and_connect_copy:
 	return 1;
 }
 
-static inline int _avl_warmup_helper(avl_t *avl, int nr_nodes, int max_key,
+/**
+ * Replaces the value of `key` in place, without copying any node.
+ * The transaction re-traverses the path to `key`, so the node it writes is
+ * still reachable, and the only word it writes is `data`. Path copies that
+ * started from the old value fail their validation of `&node->data` and
+ * are rebuilt from the new one.
+ **/
+static int _avl_update_helper(avl_t *avl, map_key_t key, void *value, tdata_t *tdata)
+{
+	avl_node_t *parent, *leaf;
+	tm_begin_ret_t status;
+	TX_VOLATILE int retries = -1;
+
+	/* Asynchronized traversal. If key is not there we can safely return. */
+	_traverse(avl, key, &parent, &leaf);
+	if (!leaf)
+		return 0;
+
+	tm_op_begin(&tdata->tm);
+
+try_again:
+
+	if (!tm_retry_allowed(&tdata->tm, ++retries)) {
+		tm_fallback_lock(&avl->avl_lock, &tdata->tm);
+		_traverse(avl, key, &parent, &leaf);
+		if (leaf)
+			leaf->data = value;
+		tm_fallback_unlock(&avl->avl_lock, &tdata->tm);
+		return (leaf != NULL);
+	}
+
+	tm_fallback_wait(&avl->avl_lock);
+
+	tm_tx_started(&tdata->tm);
+	TX_BEGIN(status);
+	if (status == TM_BEGIN_SUCCESS) {
+		if (tm_fallback_is_locked(&avl->avl_lock))
+			TX_ABORT(ABORT_GL_TAKEN);
+
+		_traverse(avl, key, &parent, &leaf);
+		if (leaf)
+			TX_STORE(leaf->data, value);
+
+		TX_END(0);
+		tm_tx_committed(&tdata->tm);
+	} else {
+		tm_tx_aborted(&tdata->tm, status);
+		goto try_again;
+	}
+
+	return (leaf != NULL);
+}
+
+static inline int _avl_warmup_helper(avl_t *avl, int nr_nodes, map_key_t max_key,
                                      unsigned int seed, int force)
 {
 	int i = 0, nodes_inserted = 0, ret = 0;
 	
 	srand(seed);
 	while (nodes_inserted < nr_nodes) {
-		int key = rand() % max_key;
+		map_key_t key = key_random(max_key);
 
 		ret = _avl_insert_helper_warmup(avl, key, NULL);
 		nodes_inserted += ret;
@@ -966,9 +1195,69 @@ static inline int _avl_warmup_helper(avl_t *avl, int nr_nodes, int max_key,
 	return nodes_inserted;
 }
 
+//> Nodes of rbt_bulk_load() come straight from the pool, they are never
+//> part of an update attempt.
+static avl_node_t *_avl_bulk_build(bulk_load_t *bl, tdata_t *tdata,
+                                   int lo, int hi, int depth, int idx)
+{
+	avl_node_t *node;
+	int mid;
+
+	if (lo >= hi)
+		return NULL;
+	if (bulk_load_is_built(bl, depth))
+		return bl->roots[idx];
+
+	if (!(node = node_pool_alloc(&tdata->node_pool)))
+		XMALLOC_ALIGNED(node, 1, NODE_ALIGN);
+	node_stats_alloc(&avl_node_stats, 1);
+	mid = bulk_load_mid(lo, hi);
+	node->key = bl->keys[mid];
+	node->data = NULL;
+	node->left = _avl_bulk_build(bl, tdata, lo, mid, depth + 1, 2 * idx);
+	node->right = _avl_bulk_build(bl, tdata, mid + 1, hi, depth + 1, 2 * idx + 1);
+	node->height = MAX(node_height(node->left), node_height(node->right)) + 1;
+	return node;
+}
+
+static inline int _avl_bulk_load_helper(avl_t *avl, tdata_t *tdata,
+                                        bulk_load_t *bl, int tid)
+{
+	int i, lo, hi;
+
+	for (i=tid; i < bulk_load_nr_subtrees(bl); i += bl->nthreads) {
+		bulk_load_subtree_range(bl, i, &lo, &hi);
+		bl->roots[i] = _avl_bulk_build(bl, tdata, lo, hi, bl->levels, i);
+	}
+	if (bulk_load_join(bl))
+		avl->root = _avl_bulk_build(bl, tdata, 0, bl->nr_keys, 0, 0);
+	bulk_load_wait(bl);
+
+	return bl->nr_keys;
+}
+
+static long long _avl_count_nodes(avl_node_t *root)
+{
+	if (!root)
+		return 0;
+	return 1 + _avl_count_nodes(root->left) + _avl_count_nodes(root->right);
+}
+
+static void _avl_free_nodes(avl_node_t *root)
+{
+	if (!root)
+		return;
+	_avl_free_nodes(root->left);
+	_avl_free_nodes(root->right);
+	if (!avl_node_in_pool(root))
+		free(root);
+}
+
 static int total_paths, total_nodes, bst_violations, avl_violations;
 static int min_path_len, max_path_len;
-static void _avl_validate_rec(avl_node_t *root, int _th)
+//> Summed over all nodes, for the cost of finding each key from the root.
+static long long total_depth, total_lines;
+static void _avl_validate_rec(avl_node_t *root, int _th, int _lines)
 {
 	if (!root)
 		return;
@@ -978,11 +1267,14 @@ static void _avl_validate_rec(avl_node_t *root, int _th)
 
 	total_nodes++;
 	_th++;
+	_lines += NODE_TRAVERSAL_LINES(avl_node_t, root);
+	total_depth += _th;
+	total_lines += _lines;
 
 	/* BST violation? */
-	if (left && left->key >= root->key)
+	if (left && KEY_GE(left->key, root->key))
 		bst_violations++;
-	if (right && right->key <= root->key)
+	if (right && KEY_LE(right->key, root->key))
 		bst_violations++;
 
 	/* AVL violation? */
@@ -1002,9 +1294,9 @@ static void _avl_validate_rec(avl_node_t *root, int _th)
 
 	/* Check subtrees. */
 	if (left)
-		_avl_validate_rec(left, _th);
+		_avl_validate_rec(left, _th, _lines);
 	if (right)
-		_avl_validate_rec(right, _th);
+		_avl_validate_rec(right, _th, _lines);
 }
 
 static inline int _avl_validate_helper(avl_node_t *root)
@@ -1016,8 +1308,9 @@ static inline int _avl_validate_helper(avl_node_t *root)
 	total_nodes = 0;
 	bst_violations = 0;
 	avl_violations = 0;
+	total_depth = total_lines = 0;
 
-	_avl_validate_rec(root, 0);
+	_avl_validate_rec(root, 0, 0);
 
 	check_bst = (bst_violations == 0);
 	check_avl = (avl_violations == 0);
@@ -1031,6 +1324,11 @@ static inline int _avl_validate_helper(avl_node_t *root)
 	printf("  Tree size: %8d\n", total_nodes);
 	printf("  Total paths: %d\n", total_paths);
 	printf("  Min/max paths length: %d/%d\n", min_path_len, max_path_len);
+	printf("  Node layout: %s, %lu bytes per node\n", NODE_LAYOUT_NAME,
+	       sizeof(avl_node_t));
+	printf("  Avg nodes / cache lines per traversal: %.2lf / %.2lf\n",
+	       total_nodes ? (double)total_depth / total_nodes : 0.0,
+	       total_nodes ? (double)total_lines / total_nodes : 0.0);
 	printf("\n");
 
 	return check_bst && check_avl;
@@ -1052,7 +1350,7 @@ static void avl_print_rec(avl_node_t *root, int level)
 		return;
 	}
 
-	printf("%d [%d]\n", root->key, root->height);
+	printf(KEY_FMT " [%d]\n", KEY_FMT_ARG(root->key), root->height);
 
 	avl_print_rec(root->left, level + 1);
 }
@@ -1072,18 +1370,32 @@ static void avl_print_struct(avl_t *avl)
 /******************************************************************************/
 void *rbt_new()
 {
-	printf("Size of tree node is %lu\n", sizeof(avl_node_t));
+	printf("Size of tree node is %lu (%s layout)\n", sizeof(avl_node_t),
+	       NODE_LAYOUT_NAME);
+	avl_ebr = ebr_new();
+	node_stats_reset(&avl_node_stats);
 	return _avl_new_helper();
 }
 
 void *rbt_thread_data_new(int tid)
 {
-	// Pre allocate a large amount of nodes for each thread
-	per_thread_node_allocators[tid] = malloc(NODES_PER_ALLOCATOR*sizeof(avl_node_t));
-	memset(per_thread_node_allocators[tid], 0, NODES_PER_ALLOCATOR*sizeof(avl_node_t));
-
 	tdata_t *tdata = tdata_new(tid);
 
+	// tid == -1 is only used to accumulate statistics.
+	if (tid < 0)
+		return tdata;
+
+	//> Only reserved here, the calling thread maps it as it allocates.
+	node_pool_init(&tdata->node_pool, sizeof(avl_node_t), NODES_PER_ALLOCATOR);
+	node_stats_register(&avl_node_stats, tid);
+	node_stats_pool(&avl_node_stats, NODES_PER_ALLOCATOR);
+
+	tdata->ebr_thread = ebr_thread_new(avl_ebr, tid, avl_node_free, tdata);
+
+	do {
+		tdata->next = avl_tdatas;
+	} while (!__sync_bool_compare_and_swap(&avl_tdatas, tdata->next, tdata));
+
 	return tdata;
 }
 
@@ -1099,24 +1411,87 @@ void rbt_thread_data_add(void *d1, void *d2, void *dst)
 	tdata_add(d1, d2, dst);
 }
 
-int rbt_lookup(void *rbt, void *thread_data, int key)
+//> The pool goes with all of its nodes, rbt_free() freed the rest.
+void rbt_thread_data_free(void *thread_data)
+{
+	tdata_t *tdata = thread_data;
+
+	node_pool_destroy(&tdata->node_pool);
+	free(tdata->ht);
+	free(tdata);
+}
+
+int rbt_thread_data_tx_stats(void *thread_data, rbt_tx_stats_t *stats)
+{
+	tdata_t *tdata = thread_data;
+	TM_STATS_COPY(stats, &tdata->tm.stats);
+	return 0;
+}
+
+int rbt_lookup(void *rbt, void *thread_data, map_key_t key)
 {
 	int ret = 0;
+	tdata_t *tdata = thread_data;
+
+	ebr_enter(avl_ebr, tdata->ebr_thread);
 	ret = _avl_lookup_helper(rbt, key);
+	ebr_exit(avl_ebr, tdata->ebr_thread);
 	return ret; 
 }
 
-int rbt_insert(void *rbt, void *thread_data, int key, void *value)
+int rbt_insert(void *rbt, void *thread_data, map_key_t key, void *value)
+{
+	int ret = 0;
+	tdata_t *tdata = thread_data;
+
+	ebr_enter(avl_ebr, tdata->ebr_thread);
+	ret = _avl_insert_helper(rbt, key, value, tdata);
+	ebr_exit(avl_ebr, tdata->ebr_thread);
+	return ret;
+}
+
+int rbt_delete(void *rbt, void *thread_data, map_key_t key)
+{
+	int ret = 0;
+	tdata_t *tdata = thread_data;
+
+	ebr_enter(avl_ebr, tdata->ebr_thread);
+	ret = _avl_delete_helper(rbt, key, tdata);
+	ebr_exit(avl_ebr, tdata->ebr_thread);
+	return ret;
+}
+
+int rbt_get(void *rbt, void *thread_data, map_key_t key, void **value)
 {
 	int ret = 0;
-	ret = _avl_insert_helper(rbt, key, value, thread_data);
+	tdata_t *tdata = thread_data;
+
+	ebr_enter(avl_ebr, tdata->ebr_thread);
+	ret = _avl_get_helper(rbt, key, value);
+	ebr_exit(avl_ebr, tdata->ebr_thread);
 	return ret;
 }
 
-int rbt_delete(void *rbt, void *thread_data, int key)
+int rbt_update(void *rbt, void *thread_data, map_key_t key, void *value)
 {
 	int ret = 0;
-	ret = _avl_delete_helper(rbt, key, thread_data);
+	tdata_t *tdata = thread_data;
+
+	ebr_enter(avl_ebr, tdata->ebr_thread);
+	ret = _avl_update_helper(rbt, key, value, tdata);
+	ebr_exit(avl_ebr, tdata->ebr_thread);
+	return ret;
+}
+
+int rbt_range(void *rbt, void *thread_data, map_key_t lo, map_key_t hi,
+              void (*cb)(map_key_t key, void *value, void *arg), void *arg)
+{
+	int ret = 0;
+	tdata_t *tdata = thread_data;
+
+	ebr_enter(avl_ebr, tdata->ebr_thread);
+	ret = _avl_range_helper(rbt, lo, hi, cb, arg);
+	ebr_exit(avl_ebr, tdata->ebr_thread);
 	return ret;
 }
 
@@ -1127,7 +1502,29 @@ int rbt_validate(void *rbt)
 	return ret;
 }
 
-int rbt_warmup(void *rbt, int nr_nodes, int max_key, 
+void rbt_free(void *rbt)
+{
+	tdata_t *tdata;
+	avl_node_t *node;
+
+	//> The retired nodes go to the free lists of the threads first.
+	ebr_free(avl_ebr);
+	avl_ebr = NULL;
+
+	_avl_free_nodes(((avl_t *)rbt)->root);
+	for (tdata=avl_tdatas; tdata; tdata=tdata->next) {
+		while ((node = tdata->free_nodes)) {
+			tdata->free_nodes = node->left;
+			if (!avl_node_in_pool(node))
+				free(node);
+		}
+		tdata->ebr_thread = NULL;
+	}
+	avl_tdatas = NULL;
+	free(rbt);
+}
+
+int rbt_warmup(void *rbt, int nr_nodes, map_key_t max_key, 
                unsigned int seed, int force)
 {
 	int ret = 0;
@@ -1135,6 +1532,28 @@ int rbt_warmup(void *rbt, int nr_nodes, int max_key,
 	return ret;
 }
 
+int rbt_bulk_load(void *rbt, void *thread_data, bulk_load_t *bl, int tid)
+{
+	return _avl_bulk_load_helper(rbt, thread_data, bl, tid);
+}
+
+//> Replaced nodes wait in the EBR limbo lists, the reclaimed ones in the
+//> threads' free lists.
+int rbt_mem_stats(void *rbt, rbt_mem_stats_t *stats)
+{
+	node_stats_thread_t total;
+
+	node_stats_sum(&avl_node_stats, &total);
+	stats->node_size = sizeof(avl_node_t);
+	stats->nodes_allocated = total.allocated;
+	stats->nodes_live = _avl_count_nodes(((avl_t *)rbt)->root);
+	stats->nodes_retired = ebr_pending(avl_ebr);
+	stats->nodes_free = stats->nodes_allocated - stats->nodes_live -
+	                    stats->nodes_retired;
+	stats->pool_capacity = total.pool_capacity;
+	return 0;
+}
+
 char *rbt_name()
 {
 	return "avl-rcu-htm-internal";
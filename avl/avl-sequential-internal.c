@@ -7,6 +7,14 @@
 
 #include "alloc.h"
 #include "arch.h"
+#include "key.h"
+#include "rbt/iface.h"
+#include "node_stats.h"
+
+//> Written against int keys only (see key.h).
+#if KEY_BITS != 32 || defined(KEY_CMP)
+#	error "this tree supports only the default int keys"
+#endif
 
 #if defined(SYNC_CG_SPINLOCK) || defined(SYNC_CG_HTM)
 #	include <pthread.h> //> pthread_spinlock_t
@@ -14,6 +22,7 @@
 
 #if defined(SYNC_CG_HTM)
 #	include "htm.h"
+#	include "clargs.h"
 #	define TX_NUM_RETRIES 50
 
 //#	if !defined(TX_NUM_RETRIES)
@@ -42,16 +51,22 @@ typedef struct avl_node_s {
 typedef struct {
 	avl_node_t *root;
 
-#	if defined(SYNC_CG_SPINLOCK) || defined(SYNC_CG_HTM)
+#	if defined(SYNC_CG_SPINLOCK)
 	pthread_spinlock_t avl_lock;
+#	elif defined(SYNC_CG_HTM)
+	tm_fallback_lock_t avl_lock;
 #	endif
 } avl_t;
 
+//> Deleted nodes leak.
+static node_stats_t avl_node_stats;
+
 static avl_node_t *avl_node_new(int key, void *data)
 {
 	avl_node_t *node;
 
 	XMALLOC(node, 1);
+	node_stats_alloc(&avl_node_stats, 1);
 	node->key = key;
 	node->data = data;
 	node->height = 0; // new nodes have height 0 and NULL has height -1.
@@ -85,8 +100,10 @@ static avl_t *_avl_new_helper()
 	XMALLOC(avl, 1);
 	avl->root = NULL;
 
-#	if defined(SYNC_CG_SPINLOCK) || defined(SYNC_CG_HTM)
+#	if defined(SYNC_CG_SPINLOCK)
 	pthread_spin_init(&avl->avl_lock, PTHREAD_PROCESS_SHARED);
+#	elif defined(SYNC_CG_HTM)
+	tm_fallback_lock_init(&avl->avl_lock);
 #	endif
 
 	return avl;
@@ -171,6 +188,28 @@ static int _avl_lookup_helper(avl_t *avl, int key)
 	return (leaf != NULL);
 }
 
+static int _avl_get_helper(avl_t *avl, int key, void **value)
+{
+	avl_node_t *parent, *leaf;
+
+	_traverse(avl, key, &parent, &leaf);
+	if (!leaf)
+		return 0;
+	*value = leaf->data;
+	return 1;
+}
+
+static int _avl_update_helper(avl_t *avl, int key, void *value)
+{
+	avl_node_t *parent, *leaf;
+
+	_traverse(avl, key, &parent, &leaf);
+	if (!leaf)
+		return 0;
+	leaf->data = value;
+	return 1;
+}
+
 static inline void _avl_insert_fixup(avl_t *avl, int key,
                                      avl_node_t *node_stack[MAX_HEIGHT],
                                      int top)
@@ -367,6 +406,7 @@ static int _avl_delete_helper(avl_t *avl, int key)
 		succ = node_stack[stack_top];
 
 		place->key = succ->key;
+		place->data = succ->data;
 		if (succ_parent->left == succ) succ_parent->left = succ->right;
 		else succ_parent->right = succ->right;
 
@@ -397,6 +437,56 @@ static inline int _avl_warmup_helper(avl_t *avl, int nr_nodes, int max_key,
 	return nodes_inserted;
 }
 
+static avl_node_t *_avl_bulk_build(bulk_load_t *bl, int lo, int hi,
+                                   int depth, int idx)
+{
+	avl_node_t *node;
+	int mid;
+
+	if (lo >= hi)
+		return NULL;
+	if (bulk_load_is_built(bl, depth))
+		return bl->roots[idx];
+
+	mid = bulk_load_mid(lo, hi);
+	node = avl_node_new(bl->keys[mid], NULL);
+	node->left = _avl_bulk_build(bl, lo, mid, depth + 1, 2 * idx);
+	node->right = _avl_bulk_build(bl, mid + 1, hi, depth + 1, 2 * idx + 1);
+	node->height = MAX(node_height(node->left), node_height(node->right)) + 1;
+	return node;
+}
+
+static inline int _avl_bulk_load_helper(avl_t *avl, bulk_load_t *bl, int tid)
+{
+	int i, lo, hi;
+
+	for (i=tid; i < bulk_load_nr_subtrees(bl); i += bl->nthreads) {
+		bulk_load_subtree_range(bl, i, &lo, &hi);
+		bl->roots[i] = _avl_bulk_build(bl, lo, hi, bl->levels, i);
+	}
+	if (bulk_load_join(bl))
+		avl->root = _avl_bulk_build(bl, 0, bl->nr_keys, 0, 0);
+	bulk_load_wait(bl);
+
+	return bl->nr_keys;
+}
+
+static long long _avl_count_nodes(avl_node_t *root)
+{
+	if (!root)
+		return 0;
+	return 1 + _avl_count_nodes(root->left) + _avl_count_nodes(root->right);
+}
+
+static void _avl_free_nodes(avl_node_t *root)
+{
+	if (!root)
+		return;
+	_avl_free_nodes(root->left);
+	_avl_free_nodes(root->right);
+	free(root);
+}
+
 static int total_paths, total_nodes, bst_violations, avl_violations;
 static int min_path_len, max_path_len;
 static void _avl_validate_rec(avl_node_t *root, int _th)
@@ -504,13 +594,15 @@ static void avl_print_struct(avl_t *avl)
 void *rbt_new()
 {
 	printf("Size of tree node is %lu\n", sizeof(avl_node_t));
+	node_stats_reset(&avl_node_stats);
 	return _avl_new_helper();
 }
 
 void *rbt_thread_data_new(int tid)
 {
+	node_stats_register(&avl_node_stats, tid);
 #	if defined(SYNC_CG_HTM)
-	return tx_thread_data_new(tid);
+	return tx_thread_data_new(tid, clargs.tx_policy, clargs.tx_retries);
 #	else
 	return NULL;
 #	endif
@@ -531,6 +623,24 @@ void rbt_thread_data_add(void *d1, void *d2, void *dst)
 #	endif
 }
 
+void rbt_thread_data_free(void *thread_data)
+{
+#	if defined(SYNC_CG_HTM)
+	tx_thread_data_free(thread_data);
+#	endif
+}
+
+int rbt_thread_data_tx_stats(void *thread_data, rbt_tx_stats_t *stats)
+{
+#	if defined(SYNC_CG_HTM)
+	tx_thread_data_t *tdata = thread_data;
+	TM_STATS_COPY(stats, &tdata->tm.stats);
+	return 0;
+#	else
+	return -1;
+#	endif
+}
+
 int rbt_lookup(void *rbt, void *thread_data, int key)
 {
 	int ret = 0;
@@ -594,6 +704,55 @@ int rbt_delete(void *rbt, void *thread_data, int key)
 	return ret;
 }
 
+int rbt_get(void *rbt, void *thread_data, int key, void **value)
+{
+	int ret = 0;
+
+#	if defined(SYNC_CG_SPINLOCK)
+	pthread_spin_lock(&((avl_t *)rbt)->avl_lock);
+#	elif defined(SYNC_CG_HTM)
+	tx_start(TX_NUM_RETRIES, thread_data, &((avl_t *)rbt)->avl_lock);
+#	endif
+
+	ret = _avl_get_helper(rbt, key, value);
+
+#	if defined(SYNC_CG_SPINLOCK)
+	pthread_spin_unlock(&((avl_t *)rbt)->avl_lock);
+#	elif defined(SYNC_CG_HTM)
+	tx_end(thread_data, &((avl_t *)rbt)->avl_lock);
+#	endif
+
+	return ret;
+}
+
+int rbt_update(void *rbt, void *thread_data, int key, void *value)
+{
+	int ret = 0;
+
+#	if defined(SYNC_CG_SPINLOCK)
+	pthread_spin_lock(&((avl_t *)rbt)->avl_lock);
+#	elif defined(SYNC_CG_HTM)
+	tx_start(TX_NUM_RETRIES, thread_data, &((avl_t *)rbt)->avl_lock);
+#	endif
+
+	ret = _avl_update_helper(rbt, key, value);
+
+#	if defined(SYNC_CG_SPINLOCK)
+	pthread_spin_unlock(&((avl_t *)rbt)->avl_lock);
+#	elif defined(SYNC_CG_HTM)
+	tx_end(thread_data, &((avl_t *)rbt)->avl_lock);
+#	endif
+
+	return ret;
+}
+
+//> Range scans are not supported.
+int rbt_range(void *rbt, void *thread_data, int lo, int hi,
+              void (*cb)(int key, void *value, void *arg), void *arg)
+{
+	return -1;
+}
+
 int rbt_validate(void *rbt)
 {
 	int ret = 0;
@@ -601,6 +760,12 @@ int rbt_validate(void *rbt)
 	return ret;
 }
 
+void rbt_free(void *rbt)
+{
+	_avl_free_nodes(((avl_t *)rbt)->root);
+	free(rbt);
+}
+
 int rbt_warmup(void *rbt, int nr_nodes, int max_key, 
                unsigned int seed, int force)
 {
@@ -609,6 +774,25 @@ int rbt_warmup(void *rbt, int nr_nodes, int max_key,
 	return ret;
 }
 
+int rbt_bulk_load(void *rbt, void *thread_data, bulk_load_t *bl, int tid)
+{
+	return _avl_bulk_load_helper(rbt, bl, tid);
+}
+
+int rbt_mem_stats(void *rbt, rbt_mem_stats_t *stats)
+{
+	node_stats_thread_t total;
+
+	node_stats_sum(&avl_node_stats, &total);
+	stats->node_size = sizeof(avl_node_t);
+	stats->nodes_allocated = total.allocated;
+	stats->nodes_live = _avl_count_nodes(((avl_t *)rbt)->root);
+	stats->nodes_retired = stats->nodes_allocated - stats->nodes_live;
+	stats->nodes_free = 0;
+	stats->pool_capacity = total.pool_capacity;
+	return 0;
+}
+
 char *rbt_name()
 {
 	return "avl-sequential-internal";
@@ -28,10 +28,22 @@
 #include <stdlib.h>
 #include <pthread.h>
 
+#include "key.h"
+#include "rbt/iface.h"
+#include "node_stats.h"
+
+//> Written against int keys only (see key.h).
+#if KEY_BITS != 32 || defined(KEY_CMP)
+#	error "this tree supports only the default int keys"
+#endif
+
 //RETRY_STATS_VARS;
 
 //__thread ssmem_allocator_t* alloc;
 
+//> Nothing is freed (no GC), unlinked nodes leak.
+static node_stats_t avl_node_stats;
+
 volatile node_t* bst_initialize() {
 
   volatile node_t* root = new_node(0, 0, 0, 0, NULL, NULL, NULL, TRUE);
@@ -58,6 +70,7 @@ volatile node_t* bst_initialize() {
         perror("malloc in bst create node");
         exit(1);
     }
+    node_stats_alloc(&avl_node_stats, 1);
 
     node->height = height;
     node->key = key;
@@ -1056,6 +1069,68 @@ static inline int _avl_warmup_helper(node_t *root, int nr_nodes, int max_key,
 }
 
 #define MAX(a,b) ( (a) >= (b) ? (a) : (b) )
+
+//> Nodes get value 1 like in the warmup, a null value marks a routing node.
+static volatile node_t *_avl_bulk_build(bulk_load_t *bl, int lo, int hi,
+                                        int depth, int idx)
+{
+	volatile node_t *node, *left, *right;
+	int mid;
+
+	if (lo >= hi)
+		return NULL;
+	if (bulk_load_is_built(bl, depth))
+		return bl->roots[idx];
+
+	mid = bulk_load_mid(lo, hi);
+	left = _avl_bulk_build(bl, lo, mid, depth + 1, 2 * idx);
+	right = _avl_bulk_build(bl, mid + 1, hi, depth + 1, 2 * idx + 1);
+	node = new_node(MAX(left ? left->height : 0, right ? right->height : 0) + 1,
+	                bl->keys[mid], 0, (sval_t)1, NULL, left, right, TRUE);
+	if (left)
+		left->parent = node;
+	if (right)
+		right->parent = node;
+	return node;
+}
+
+static inline int _avl_bulk_load_helper(volatile node_t *holder,
+                                        bulk_load_t *bl, int tid)
+{
+	int i, lo, hi;
+
+	for (i=tid; i < bulk_load_nr_subtrees(bl); i += bl->nthreads) {
+		bulk_load_subtree_range(bl, i, &lo, &hi);
+		bl->roots[i] = (void *)_avl_bulk_build(bl, lo, hi, bl->levels, i);
+	}
+	if (bulk_load_join(bl)) {
+		holder->right = _avl_bulk_build(bl, 0, bl->nr_keys, 0, 0);
+		if (holder->right) {
+			holder->right->parent = holder;
+			holder->height = holder->right->height + 1;
+		}
+	}
+	bulk_load_wait(bl);
+
+	return bl->nr_keys;
+}
+
+static long long _avl_count_nodes(volatile node_t *root)
+{
+	if (!root)
+		return 0;
+	return 1 + _avl_count_nodes(root->left) + _avl_count_nodes(root->right);
+}
+
+static void _avl_free_nodes(volatile node_t *root)
+{
+	if (!root)
+		return;
+	_avl_free_nodes(root->left);
+	_avl_free_nodes(root->right);
+	free((void *)root);
+}
+
 static int total_paths;
 static int min_path_len, max_path_len;
 static int total_nodes;
@@ -1146,12 +1221,14 @@ static inline int _avl_validate_helper(node_t *root)
 void *rbt_new()
 {
 	printf("Size of tree node is %lu\n", sizeof(node_t));
+	node_stats_reset(&avl_node_stats);
 	return (void *)bst_initialize();
 }
 
 void *rbt_thread_data_new(int tid)
 {
 //	return htm_fg_tdata_new(tid);
+	node_stats_register(&avl_node_stats, tid);
 	return NULL;
 }
 
@@ -1166,6 +1243,15 @@ void rbt_thread_data_add(void *d1, void *d2, void *dst)
 //	htm_fg_tdata_add(d1, d2, dst);
 }
 
+void rbt_thread_data_free(void *thread_data)
+{
+}
+
+int rbt_thread_data_tx_stats(void *thread_data, rbt_tx_stats_t *stats)
+{
+	return -1;
+}
+
 int rbt_lookup(void *avl, void *thread_data, int key)
 {
 	int ret;
@@ -1206,6 +1292,24 @@ int rbt_delete(void *avl, void *thread_data, int key)
 	return ret;
 }
 
+//> Key-value accessors are not supported.
+int rbt_get(void *rbt, void *thread_data, int key, void **value)
+{
+	return -1;
+}
+
+int rbt_update(void *rbt, void *thread_data, int key, void *value)
+{
+	return -1;
+}
+
+//> Range scans are not supported.
+int rbt_range(void *rbt, void *thread_data, int lo, int hi,
+              void (*cb)(int key, void *value, void *arg), void *arg)
+{
+	return -1;
+}
+
 int rbt_validate(void *avl)
 {
 	int ret = 1;
@@ -1214,6 +1318,12 @@ int rbt_validate(void *avl)
 	return ret;
 }
 
+//> Frees the root holder and the routing nodes as well.
+void rbt_free(void *avl)
+{
+	_avl_free_nodes(avl);
+}
+
 int rbt_warmup(void *avl, int nr_nodes, int max_key, 
                unsigned int seed, int force)
 {
@@ -1222,6 +1332,26 @@ int rbt_warmup(void *avl, int nr_nodes, int max_key,
 	return ret;
 }
 
+int rbt_bulk_load(void *avl, void *thread_data, bulk_load_t *bl, int tid)
+{
+	return _avl_bulk_load_helper(avl, bl, tid);
+}
+
+//> The root holder and the routing nodes of deleted keys count as live.
+int rbt_mem_stats(void *avl, rbt_mem_stats_t *stats)
+{
+	node_stats_thread_t total;
+
+	node_stats_sum(&avl_node_stats, &total);
+	stats->node_size = sizeof(node_t);
+	stats->nodes_allocated = total.allocated;
+	stats->nodes_live = _avl_count_nodes(avl);
+	stats->nodes_retired = stats->nodes_allocated - stats->nodes_live;
+	stats->nodes_free = 0;
+	stats->pool_capacity = total.pool_capacity;
+	return 0;
+}
+
 char *rbt_name()
 {
 	return "avl_bronson";
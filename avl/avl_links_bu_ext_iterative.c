@@ -6,6 +6,7 @@
 
 #if defined(SYNC_CG_HTM)
 #	include "htm.h"
+#	include "clargs.h"
 #	if !defined(TX_NUM_RETRIES)
 #		define TX_NUM_RETRIES 20
 #	endif
@@ -16,6 +17,13 @@
 #include "avl_utils.h"
 #include "avl_validate.h"
 #include "avl_links_bu_ext_thread_data.h"
+#include "key.h"
+#include "rbt/iface.h"
+
+//> Written against int keys only (see key.h).
+#if KEY_BITS != 32 || defined(KEY_CMP)
+#	error "this tree supports only the default int keys"
+#endif
 
 //> Returns the level at which the lookup stopped.
 static int _avl_lookup_helper(avl_t *avl, int key, int *found)
@@ -292,7 +300,7 @@ void *rbt_thread_data_new(int tid)
 	avl_thread_data_t *data = avl_thread_data_new(tid);
 
 #	if defined(SYNC_CG_HTM)
-	data->priv = tx_thread_data_new(tid);
+	data->priv = tx_thread_data_new(tid, clargs.tx_policy, clargs.tx_retries);
 #	endif
 
 	return data;
@@ -321,6 +329,29 @@ void rbt_thread_data_add(void *d1, void *d2, void *dst)
 #	endif
 }
 
+void rbt_thread_data_free(void *thread_data)
+{
+	avl_thread_data_t *tdata = thread_data;
+
+#	if defined(SYNC_CG_HTM)
+	tx_thread_data_free(tdata->priv);
+#	endif
+
+	free(tdata);
+}
+
+int rbt_thread_data_tx_stats(void *thread_data, rbt_tx_stats_t *stats)
+{
+#	if defined(SYNC_CG_HTM)
+	avl_thread_data_t *tdata = thread_data;
+	tx_thread_data_t *tx = tdata->priv;
+	TM_STATS_COPY(stats, &tx->tm.stats);
+	return 0;
+#	else
+	return -1;
+#	endif
+}
+
 int rbt_lookup(void *avl, void *thread_data, int key)
 {
 	avl_thread_data_t *tdata = thread_data;
@@ -403,6 +434,24 @@ int rbt_delete(void *avl, void *thread_data, int key)
 	return ret;
 }
 
+//> Key-value accessors are not supported.
+int rbt_get(void *avl, void *thread_data, int key, void **value)
+{
+	return -1;
+}
+
+int rbt_update(void *avl, void *thread_data, int key, void *value)
+{
+	return -1;
+}
+
+//> Range scans are not supported.
+int rbt_range(void *avl, void *thread_data, int lo, int hi,
+              void (*cb)(int key, void *value, void *arg), void *arg)
+{
+	return -1;
+}
+
 int rbt_validate(void *avl)
 {
 	int ret;
@@ -410,6 +459,21 @@ int rbt_validate(void *avl)
 	return ret;
 }
 
+static void _avl_free_nodes(avl_node_t *root)
+{
+	if (!root)
+		return;
+	_avl_free_nodes(root->link[0]);
+	_avl_free_nodes(root->link[1]);
+	free(root);
+}
+
+void rbt_free(void *avl)
+{
+	_avl_free_nodes(((avl_t *)avl)->root);
+	free(avl);
+}
+
 int rbt_warmup(void *avl, int nr_nodes, int max_key, 
                unsigned int seed, int force)
 {
@@ -418,6 +482,18 @@ int rbt_warmup(void *avl, int nr_nodes, int max_key,
 	return ret;
 }
 
+//> Bulk loading is not supported, the benchmark falls back to rbt_warmup().
+int rbt_bulk_load(void *avl, void *thread_data, bulk_load_t *bl, int tid)
+{
+	return -1;
+}
+
+//> Node memory is not accounted for.
+int rbt_mem_stats(void *avl, rbt_mem_stats_t *stats)
+{
+	return -1;
+}
+
 char *rbt_name()
 {
 	return "avl_links_bu_external";
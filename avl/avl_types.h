@@ -25,7 +25,9 @@ typedef struct avl_node {
 typedef struct {
 	avl_node_t *root;
 
-#	if defined(SYNC_CG_SPINLOCK) || defined(SYNC_CG_HTM) || defined(USE_VERSIONING)
+#	if defined(SYNC_CG_HTM)
+	tm_fallback_lock_t global_lock;
+#	elif defined(SYNC_CG_SPINLOCK) || defined(USE_VERSIONING)
 	pthread_spinlock_t global_lock;
 #	endif
 
@@ -59,7 +61,9 @@ static inline avl_t *_avl_new_helper()
 	XMALLOC(ret, 1);
 	ret->root = NULL;
 
-#	if defined(SYNC_CG_SPINLOCK) || defined(SYNC_CG_HTM) || defined(USE_VERSIONING)
+#	if defined(SYNC_CG_HTM)
+	tm_fallback_lock_init(&ret->global_lock);
+#	elif defined(SYNC_CG_SPINLOCK) || defined(USE_VERSIONING)
 	pthread_spin_init(&ret->global_lock, PTHREAD_PROCESS_SHARED);
 #	endif
 
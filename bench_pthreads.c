@@ -2,14 +2,23 @@
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <time.h> //> clock_nanosleep()
+#include <unistd.h> //> sleep(), sysconf()
 
-#ifdef WORKLOAD_TIME
-#	include <unistd.h> //> sleep()
+#if defined(WORKLOAD_RATE)
+#	include <math.h> //> log()
 #endif
 
 #include "alloc.h"
 #include "aff.h"
 #include "clargs.h"
+#include "history.h"
+#include "keydist.h"
+#include "latency.h"
+#include "perf.h"
+#include "phase.h"
+#include "record.h"
+#include "trace.h"
 #include "rbt/iface.h"
 #include "timers_lib.h"
 #include "arch.h"
@@ -20,8 +29,39 @@ enum {
 	OPS_LOOKUP,
 	OPS_INSERT,
 	OPS_DELETE,
+	OPS_RANGE,
+	OPS_UPDATE,
 	OPS_END
 };
+static const char *op_names[OPS_END] = {
+	[OPS_TOTAL] = "total", [OPS_LOOKUP] = "lookup", [OPS_INSERT] = "insert",
+	[OPS_DELETE] = "delete", [OPS_RANGE] = "range", [OPS_UPDATE] = "update",
+};
+
+/**
+ * Operation counters of a thread. They are written on every operation, so
+ * they get cache lines of their own, away from what the thread only reads,
+ * and are 64-bit, as at hundreds of Mops/sec an int wraps within seconds.
+ * There is a single writer, stat_add(), and the sampler reads them while
+ * it runs with relaxed atomic loads, so no access is ever torn.
+ **/
+typedef struct {
+	unsigned long long operations_performed[OPS_END],
+	                   operations_succeeded[OPS_END];
+
+	//> Total number of keys returned by range queries.
+	unsigned long long range_keys;
+} __attribute__((aligned(CACHE_LINE_SIZE))) thread_stats_t;
+
+static inline void stat_add(unsigned long long *counter, unsigned long long v)
+{
+	__atomic_store_n(counter, *counter + v, __ATOMIC_RELAXED);
+}
+
+static inline unsigned long long stat_read(unsigned long long *counter)
+{
+	return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
 
 typedef struct {
 	int tid;
@@ -30,39 +70,81 @@ typedef struct {
 	void *rbt;
 
 #	if defined(WORKLOAD_FIXED)
-	int nr_operations;
-#	elif defined(WORKLOAD_TIME)
+	long long nr_operations;
+#	elif defined(WORKLOAD_TIME) || defined(WORKLOAD_RATE)
 	int *time_to_leave;
 #	endif
 
-	int operations_performed[4],
-	    operations_succeeded[4];
+	//> OPS_END latency histograms, NULL unless clargs.lat_sample > 0.
+	lat_hist_t *lat;
+
+	//> Hardware event counts of the run, NULL unless clargs.perf_counters.
+	perf_counters_t *perf;
+
+	//> The clargs.op_stream operations and keys of --op-stream, kept for
+	//> --trace-out.
+	unsigned char *stream_ops;
+	map_key_t *stream_keys;
+
+	//> The operations of the run for --check, NULL unless clargs.check.
+	history_t *history;
 
 	void *rbt_thread_data;
 
-	char padding[CACHE_LINE_SIZE - 11 * sizeof(int) - sizeof(void *)];
+	thread_stats_t stats;
 } __attribute__((aligned(CACHE_LINE_SIZE))) thread_data_t;
 
 static inline thread_data_t *thread_data_new(int tid, int cpu, void *rbt)
 {
 	thread_data_t *ret;
+	int i;
 
-	XMALLOC(ret, 1);
+	XMALLOC_ALIGNED(ret, 1, CACHE_LINE_SIZE);
 	memset(ret, 0, sizeof(*ret));
 	ret->tid = tid;
 	ret->cpu = cpu;
 	ret->rbt = rbt;
 
+	if (clargs.lat_sample > 0) {
+		XMALLOC(ret->lat, OPS_END);
+		for (i=0; i < OPS_END; i++)
+			lat_hist_init(&ret->lat[i]);
+	}
+
+	if (clargs.perf_counters) {
+		XMALLOC(ret->perf, 1);
+		perf_counters_init(ret->perf);
+	}
+
+	if (clargs.check > 0) {
+		XMALLOC(ret->history, 1);
+		history_init(ret->history);
+	}
+
 	return ret;
 }
 
+//> The rbt thread data is freed by the caller, after rbt_free().
+static inline void thread_data_free(thread_data_t *data)
+{
+	free(data->lat);
+	free(data->perf);
+	if (data->history) {
+		history_free(data->history);
+		free(data->history);
+	}
+	free(data->stream_ops);
+	free(data->stream_keys);
+	free(data);
+}
+
 static inline void thread_data_print(thread_data_t *data)
 {
 	int i;
 	printf("%3d %3d", data->tid, data->cpu);
-	for (i=0; i < 4; i++)
-		printf(" %10d %10d", data->operations_performed[i], 
-		                     data->operations_succeeded[i]);
+	for (i=0; i < OPS_END; i++)
+		printf(" %10llu %10llu", data->stats.operations_performed[i], 
+		                     data->stats.operations_succeeded[i]);
 	printf("\n");
 }
 
@@ -88,80 +170,1040 @@ static inline void thread_data_add(thread_data_t *d1, thread_data_t *d2,
 #	endif
 
 	for (i=0; i < OPS_END; i++) {
-		dest->operations_performed[i] = d1->operations_performed[i] + 
-		                                d2->operations_performed[i];
-		dest->operations_succeeded[i] = d1->operations_succeeded[i] + 
-		                                d2->operations_succeeded[i];
+		dest->stats.operations_performed[i] = d1->stats.operations_performed[i] + 
+		                                d2->stats.operations_performed[i];
+		dest->stats.operations_succeeded[i] = d1->stats.operations_succeeded[i] + 
+		                                d2->stats.operations_succeeded[i];
+	}
+	dest->stats.range_keys = d1->stats.range_keys + d2->stats.range_keys;
+	if (dest->lat)
+		for (i=0; i < OPS_END; i++)
+			lat_hist_merge(&d1->lat[i], &d2->lat[i], &dest->lat[i]);
+	if (dest->perf)
+		perf_counters_add(d1->perf, d2->perf, dest->perf);
+}
+
+/**
+ * --trace replay. With --trace-mode=shared the threads take TRACE_CHUNK
+ * records at a time from trace_cursor, so that they do not all write the
+ * shared cursor on every operation. A thread leaves when the trace runs out.
+ **/
+#define TRACE_CHUNK 64
+static trace_t *trace;
+static int trace_shared;
+static uint64_t trace_cursor;
+static int nr_threads_done;
+
+static const int trace_ops[TRACE_NR_OPS] = {
+	[TRACE_LOOKUP] = OPS_LOOKUP, [TRACE_INSERT] = OPS_INSERT,
+	[TRACE_DELETE] = OPS_DELETE, [TRACE_RANGE] = OPS_RANGE,
+	[TRACE_UPDATE] = OPS_UPDATE,
+};
+static const int ops_trace[OPS_END] = {
+	[OPS_LOOKUP] = TRACE_LOOKUP, [OPS_INSERT] = TRACE_INSERT,
+	[OPS_DELETE] = TRACE_DELETE, [OPS_RANGE] = TRACE_RANGE,
+	[OPS_UPDATE] = TRACE_UPDATE,
+};
+
+//> The records [*i, *hi) to replay next, returns 0 if there are none left.
+static inline int trace_refill(uint64_t *i, uint64_t *hi)
+{
+	uint64_t nr_records = trace->hdr->nr_records;
+
+	if (!trace_shared)
+		return 0;
+	*i = __sync_fetch_and_add(&trace_cursor, TRACE_CHUNK);
+	if (*i >= nr_records)
+		return 0;
+	*hi = (*i + TRACE_CHUNK < nr_records) ? *i + TRACE_CHUNK : nr_records;
+	return 1;
+}
+
+//> Writes the streams of all threads to clargs.trace_out, one partition each.
+static void trace_write_streams(thread_data_t **threads_data, int nthreads)
+{
+	trace_writer_t *w;
+	int i, j;
+
+	w = trace_writer_open(clargs.trace_out, nthreads, 0, KEY_BITS);
+	for (i=0; i < nthreads; i++) {
+		if (i > 0)
+			trace_writer_next_partition(w);
+		for (j=0; j < clargs.op_stream; j++)
+			trace_writer_append(w, ops_trace[threads_data[i]->stream_ops[j]],
+			                    threads_data[i]->stream_keys[j], 0);
+	}
+	trace_writer_close(w);
+	printf("Trace written to %s (%d partitions of %d operations)\n",
+	       clargs.trace_out, nthreads, clargs.op_stream);
+}
+
+//> Key set at the start of the operations, for --check.
+static unsigned char *history_initial;
+//> Threads whose --check log is full. Once all are, the run is over, as the
+//> threads only wait for the phases to end from then on.
+static int nr_histories_full;
+
+static const int history_ops[OPS_END] = {
+	[OPS_LOOKUP] = HISTORY_LOOKUP, [OPS_INSERT] = HISTORY_INSERT,
+	[OPS_DELETE] = HISTORY_DELETE, [OPS_UPDATE] = HISTORY_LOOKUP,
+};
+
+//> Checks the histories of the threads, returns 1 if they are linearizable.
+static int check_histories(thread_data_t **threads_data, int nthreads)
+{
+	history_t *histories;
+	history_result_t res;
+	timer_tt *timer = timer_init();
+	int i, ret;
+
+	printf("Linearizability check\n");
+	printf("=======================\n");
+	XMALLOC(histories, nthreads);
+	for (i=0; i < nthreads; i++)
+		histories[i] = *threads_data[i]->history;
+	timer_start(timer);
+	ret = history_check(histories, nthreads, history_initial, clargs.max_key,
+	                    &res);
+	timer_stop(timer);
+	printf("  %lld operations on %lld keys, %lld not linearizable, "
+	       "%lld given up on (%5.2lf sec)\n", res.nr_events, res.nr_keys,
+	       res.nr_violations, res.nr_unknown, timer_report_sec(timer));
+	printf("  [%s]\n\n", ret ? "OK" : "FAILED");
+
+	free(timer);
+	free(histories);
+	free(history_initial);
+	history_initial = NULL;
+	return ret;
+}
+
+/**
+ * The phases of the run, see phase.h. Without --phases there is one, of the
+ * command line arguments. Threads switch phases together: at the end of a
+ * phase they wait at phase_barrier while the master collects its results,
+ * and then at start_barrier for the next one.
+ **/
+typedef struct {
+	phase_t spec;
+	//> Configured once, copied by every thread.
+	keydist_t key_dist;
+
+	//> Results of all threads.
+	double time_sec;
+	unsigned long long operations_performed[OPS_END],
+	                   operations_succeeded[OPS_END];
+	//> OPS_END latency histograms, NULL unless clargs.lat_sample > 0.
+	lat_hist_t *lat;
+} run_phase_t;
+static run_phase_t *phases;
+static int nr_phases;
+//> Whether --phases was given, and per phase results are collected.
+static int multi_phase;
+//> Whether any phase has range queries or value updates.
+static int use_range, use_update;
+pthread_barrier_t phase_barrier;
+
+static void phases_init(int nthreads)
+{
+	phase_t dflt, *specs;
+	int i, j;
+
+	memset(&dflt, 0, sizeof(dflt));
+#	if defined(WORKLOAD_TIME) || defined(WORKLOAD_RATE)
+	dflt.duration_sec = clargs.run_time_sec;
+#	endif
+	dflt.lookup_frac = clargs.lookup_frac;
+	dflt.range_frac = clargs.range_frac;
+	dflt.update_frac = clargs.update_frac;
+	dflt.insert_frac = clargs.insert_frac;
+	snprintf(dflt.key_dist, sizeof(dflt.key_dist), "%s", clargs.key_dist);
+	dflt.nr_threads = nthreads;
+
+	multi_phase = 0;
+	nr_phases = 1;
+	specs = &dflt;
+#	if defined(WORKLOAD_TIME)
+	if (clargs.phases) {
+		multi_phase = 1;
+		nr_phases = phases_parse(clargs.phases, &dflt, &specs);
+		if (nr_phases < 0) {
+			fprintf(stderr, "Bad --phases \"%s\"\n", clargs.phases);
+			exit(1);
+		}
+	}
+#	endif
+
+	XMALLOC(phases, nr_phases);
+	memset(phases, 0, nr_phases * sizeof(*phases));
+	use_range = use_update = 0;
+	for (i=0; i < nr_phases; i++) {
+		phases[i].spec = specs[i];
+		if (specs[i].nr_threads > nthreads) {
+			fprintf(stderr, "Phase %d has %d threads, more than the %d "
+			        "of --num-threads\n", i, specs[i].nr_threads, nthreads);
+			exit(1);
+		}
+		keydist_init(&phases[i].key_dist, specs[i].key_dist, clargs.max_key,
+		             clargs.zipf_theta, clargs.hot_ops_frac,
+		             clargs.hot_keys_frac);
+		use_range |= (specs[i].range_frac > 0);
+		use_update |= (specs[i].update_frac > 0);
+		if (clargs.lat_sample > 0) {
+			XMALLOC(phases[i].lat, OPS_END);
+			for (j=0; j < OPS_END; j++)
+				lat_hist_init(&phases[i].lat[j]);
+		}
+	}
+	if (specs != &dflt)
+		free(specs);
+}
+
+static void phases_free()
+{
+	int i;
+
+	for (i=0; i < nr_phases; i++) {
+		free(phases[i].lat);
+		keydist_free(&phases[i].key_dist);
+	}
+	free(phases);
+	phases = NULL;
+}
+
+/**
+ * What the threads did since the previous phase goes to phase `p`, while
+ * they wait. Their latency histograms are emptied, the run's total is the
+ * sum of those of the phases.
+ **/
+static void phase_collect(int p, thread_data_t **threads_data, int nthreads,
+                          double time_sec)
+{
+	run_phase_t *phase = &phases[p];
+	int i, j, k;
+
+	phase->time_sec = time_sec;
+	for (i=0; i < nthreads; i++) {
+		for (j=0; j < OPS_END; j++) {
+			phase->operations_performed[j] +=
+			                   threads_data[i]->stats.operations_performed[j];
+			phase->operations_succeeded[j] +=
+			                   threads_data[i]->stats.operations_succeeded[j];
+		}
+		if (!phase->lat)
+			continue;
+		for (j=0; j < OPS_END; j++) {
+			lat_hist_merge(&phase->lat[j], &threads_data[i]->lat[j],
+			               &phase->lat[j]);
+			lat_hist_init(&threads_data[i]->lat[j]);
+		}
+	}
+	for (k=0; k < p; k++)
+		for (j=0; j < OPS_END; j++) {
+			phase->operations_performed[j] -= phases[k].operations_performed[j];
+			phase->operations_succeeded[j] -= phases[k].operations_succeeded[j];
+		}
+}
+
+#if defined(WORKLOAD_TIME) || defined(WORKLOAD_RATE)
+//> Waits out a phase, or until the threads are done with the trace or with
+//> their --check logs.
+static void phase_wait(double sec, int nthreads)
+{
+	struct timespec ts;
+	int i;
+
+	if (trace || clargs.check > 0) {
+		for (i=0; i < sec * 1000; i++) {
+			if (nr_threads_done == nthreads ||
+			    nr_histories_full == nthreads)
+				break;
+			usleep(1000);
+		}
+		return;
+	}
+	ts.tv_sec = sec;
+	ts.tv_nsec = (sec - ts.tv_sec) * 1e9;
+	nanosleep(&ts, NULL);
+}
+#endif
+
+//> read_tsc() ticks per nanosecond, measured only if anything needs it.
+static double ticks_per_nsec;
+
+//> The CPU of every thread, by clargs.placement, and what it was picked from.
+static aff_cpu_t *placement;
+static aff_topology_t topology;
+
+//> The initial tree, if clargs.bulk_load, else NULL.
+static bulk_load_t *bulk_load;
+//> Set by the threads if rbt_bulk_load() is not supported by the tree.
+static int bulk_load_unsupported;
+
+/**
+ * `nr_keys` distinct keys out of [0, max_key) in ascending order, drawn by
+ * selection sampling (Knuth's Algorithm S): each key is taken with
+ * probability (keys still needed) / (keys left), so no sorting is needed.
+ **/
+#if defined(KEY_CMP)
+static int key_qsort_cmp(const void *a, const void *b)
+{
+	return KEY_CMP(*(map_key_t *)a, *(map_key_t *)b);
+}
+#endif
+static map_key_t *bulk_load_keys(int nr_keys, long long max_key,
+                                 unsigned int seed)
+{
+	struct drand48_data drand_buffer;
+	map_key_t *keys;
+	long long k;
+	double u;
+	int n = 0;
+
+	XMALLOC(keys, nr_keys);
+	srand48_r(seed, &drand_buffer);
+	for (k=0; n < nr_keys; k++) {
+		drand48_r(&drand_buffer, &u);
+		if ((max_key - k) * u < nr_keys - n)
+			keys[n++] = k;
+	}
+#	if defined(KEY_CMP)
+	qsort(keys, nr_keys, sizeof(*keys), key_qsort_cmp);
+#	endif
+	return keys;
+}
+
+static void print_placement(int nthreads)
+{
+	int i;
+
+	printf("  Topology: %u sockets, %u cores, %u CPUs available\n",
+	       topology.nr_sockets, topology.nr_cores, topology.nr_cpus);
+	printf("  Thread placement: %s, MT_CONF=", clargs.placement);
+	for (i=0; i < nthreads; i++)
+		printf("%s%u", i ? "," : "", placement[i].cpu);
+	printf("\n");
+	if ((unsigned int)nthreads > topology.nr_cpus)
+		printf("  WARNING: %d threads share %u CPUs\n", nthreads,
+		       topology.nr_cpus);
+}
+
+static void print_latencies(thread_data_t *total_data)
+{
+	int i;
+
+#	if defined(WORKLOAD_RATE)
+	printf("\nLatency from intended start (nsec, 1 in %d operations timed)\n",
+	       clargs.lat_sample);
+#	else
+	printf("\nLatency (nsec, 1 in %d operations timed)\n", clargs.lat_sample);
+#	endif
+	printf("=======================\n");
+	lat_hist_print_header();
+	for (i=OPS_LOOKUP; i < OPS_END; i++)
+		if (total_data->stats.operations_performed[i] > 0)
+			lat_hist_print(op_names[i], &total_data->lat[i], ticks_per_nsec);
+	printf("\n");
+}
+
+static void print_perf_counters(thread_data_t **threads_data, int nthreads,
+                                thread_data_t *total_data)
+{
+	int i;
+
+	printf("\nHardware performance counters (user space, \"-\" if not available)\n");
+	printf("=======================\n");
+	perf_counters_print_header();
+	for (i=0; i < nthreads; i++)
+		perf_counters_print(threads_data[i]->tid, threads_data[i]->perf);
+	printf("-----------------------\n");
+	perf_counters_print(total_data->tid, total_data->perf);
+	perf_counters_print_summary(total_data->perf,
+	                            total_data->stats.operations_performed[OPS_TOTAL]);
+	printf("\n");
+}
+
+//> Resident set size of the process in bytes, -1 if not available.
+static long long rss_bytes()
+{
+	long long pages = -1;
+	FILE *fp;
+
+	if ((fp = fopen("/proc/self/statm", "r"))) {
+		if (fscanf(fp, "%*s %lld", &pages) != 1)
+			pages = -1;
+		fclose(fp);
+	}
+	return pages < 0 ? -1 : pages * sysconf(_SC_PAGESIZE);
+}
+
+#define MBYTES(bytes) ((bytes) / (1024.0 * 1024.0))
+
+/**
+ * Node memory as reported by rbt_mem_stats(), NULL if the tree does not
+ * support it, and how much the resident set grew from before rbt_new() to
+ * the end of the run (-1 if not available). Bytes per key are over the
+ * expected size of the tree.
+ **/
+static void print_memory(rbt_mem_stats_t *mem, long long rss_delta,
+                         long long nr_keys)
+{
+	printf("\nMemory\n");
+	printf("=======================\n");
+	if (!mem) {
+		printf("  Nodes: n/a\n");
+		if (rss_delta >= 0)
+			printf("  RSS delta: %.2lf MB\n", MBYTES(rss_delta));
+		if (rss_delta >= 0 && nr_keys > 0)
+			printf("  Bytes per key: %.1lf (RSS delta)\n",
+			       (double)rss_delta / nr_keys);
+		printf("\n");
+		return;
+	}
+	printf("  Node size: %lld bytes\n", mem->node_size);
+	printf("  Allocated nodes: %12lld (%10.2lf MB)\n", mem->nodes_allocated,
+	       MBYTES(mem->nodes_allocated * mem->node_size));
+	printf("  Live nodes:      %12lld (%10.2lf MB)\n", mem->nodes_live,
+	       MBYTES(mem->nodes_live * mem->node_size));
+	printf("  Retired nodes:   %12lld (%10.2lf MB)\n", mem->nodes_retired,
+	       MBYTES(mem->nodes_retired * mem->node_size));
+	printf("  Free nodes:      %12lld (%10.2lf MB)\n", mem->nodes_free,
+	       MBYTES(mem->nodes_free * mem->node_size));
+	printf("  Pool capacity:   %12lld (%10.2lf MB)\n", mem->pool_capacity,
+	       MBYTES(mem->pool_capacity * mem->node_size));
+	if (rss_delta >= 0)
+		printf("  RSS delta: %.2lf MB\n", MBYTES(rss_delta));
+	if (nr_keys > 0) {
+		printf("  Bytes per key: %.1lf (live nodes)",
+		       (double)mem->nodes_live * mem->node_size / nr_keys);
+		if (rss_delta >= 0)
+			printf(", %.1lf (RSS delta)", (double)rss_delta / nr_keys);
+		printf("\n");
+	}
+	printf("\n");
+}
+
+/**
+ * Throughput time series. While the threads run, a sampler thread reads
+ * their counters every clargs.sample_ms msec and stores what changed since
+ * the previous read. The series is printed after the run.
+ **/
+typedef struct {
+	double time_sec;       //> End of the interval, since the start.
+	double interval_sec;
+	long long ops;         //> Operations started by all threads.
+	long long min_thread_ops,
+	          max_thread_ops;
+	int has_tx;
+	rbt_tx_stats_t tx;
+} sample_t;
+
+typedef struct {
+	thread_data_t **threads_data;
+	int nthreads;
+	volatile int stop;
+
+	sample_t *samples;
+	int nr_samples, max_samples;
+} sampler_t;
+
+static inline double timespec_diff_sec(struct timespec *t1, struct timespec *t2)
+{
+	return (t2->tv_sec - t1->tv_sec) + (t2->tv_nsec - t1->tv_nsec) / 1e9;
+}
+
+static void *sampler_fn(void *arg)
+{
+	sampler_t *sampler = arg;
+	struct timespec start, next, now;
+	rbt_tx_stats_t tx, thread_tx, prev_tx = { 0 };
+	double prev_sec = 0.0;
+	unsigned long long *prev_ops;
+	long long ops;
+	int i;
+	sample_t *s;
+
+	XMALLOC(prev_ops, sampler->nthreads);
+	memset(prev_ops, 0, sampler->nthreads * sizeof(*prev_ops));
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	next = start;
+	while (1) {
+		//> Absolute deadlines, so that the period does not drift.
+		next.tv_nsec += clargs.sample_ms % 1000 * 1000000L;
+		next.tv_sec += clargs.sample_ms / 1000 + next.tv_nsec / 1000000000L;
+		next.tv_nsec %= 1000000000L;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		if (sampler->stop)
+			break;
+
+		if (sampler->nr_samples == sampler->max_samples) {
+			sampler->max_samples = 2 * sampler->max_samples + 64;
+			sampler->samples = realloc(sampler->samples,
+			                 sampler->max_samples * sizeof(sample_t));
+			if (!sampler->samples) {
+				fprintf(stderr, "Out of memory: %s:%d\n", __FILE__, __LINE__);
+				exit(1);
+			}
+		}
+		s = &sampler->samples[sampler->nr_samples++];
+		memset(s, 0, sizeof(*s));
+		memset(&tx, 0, sizeof(tx));
+		s->has_tx = 1;
+
+		for (i=0; i < sampler->nthreads; i++) {
+			thread_data_t *data = sampler->threads_data[i];
+
+			ops = stat_read(&data->stats.operations_performed[OPS_TOTAL]) -
+			      prev_ops[i];
+			prev_ops[i] += ops;
+			s->ops += ops;
+			if (i == 0 || ops < s->min_thread_ops)
+				s->min_thread_ops = ops;
+			if (i == 0 || ops > s->max_thread_ops)
+				s->max_thread_ops = ops;
+
+			if (rbt_thread_data_tx_stats(data->rbt_thread_data,
+			                             &thread_tx) < 0) {
+				s->has_tx = 0;
+				continue;
+			}
+			tx.tx_starts += thread_tx.tx_starts;
+			tx.tx_commits += thread_tx.tx_commits;
+			tx.tx_aborts += thread_tx.tx_aborts;
+			tx.lacqs += thread_tx.lacqs;
+		}
+		s->tx.tx_starts = tx.tx_starts - prev_tx.tx_starts;
+		s->tx.tx_commits = tx.tx_commits - prev_tx.tx_commits;
+		s->tx.tx_aborts = tx.tx_aborts - prev_tx.tx_aborts;
+		s->tx.lacqs = tx.lacqs - prev_tx.lacqs;
+		prev_tx = tx;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		s->time_sec = timespec_diff_sec(&start, &now);
+		s->interval_sec = s->time_sec - prev_sec;
+		prev_sec = s->time_sec;
+	}
+
+	free(prev_ops);
+	return NULL;
+}
+
+static void print_time_series(sampler_t *sampler)
+{
+	int i;
+
+	printf("\nTime series (every %d msec)\n", clargs.sample_ms);
+	printf("=======================\n");
+	printf("  %8s %12s %10s %12s %12s %12s %12s %10s\n", "time_sec", "ops",
+	       "Mops/sec", "min_thr_ops", "max_thr_ops", "tx_commits",
+	       "tx_aborts", "lacqs");
+	for (i=0; i < sampler->nr_samples; i++) {
+		sample_t *s = &sampler->samples[i];
+
+		printf("  %8.3lf %12lld %10.3lf %12lld %12lld", s->time_sec, s->ops,
+		       s->ops / s->interval_sec / 1000000.0,
+		       s->min_thread_ops, s->max_thread_ops);
+		if (s->has_tx)
+			printf(" %12llu %12llu %10llu\n", s->tx.tx_commits,
+			       s->tx.tx_aborts, s->tx.lacqs);
+		else
+			printf(" %12s %12s %10s\n", "-", "-", "-");
+	}
+	printf("\n");
+}
+
+static void print_phases()
+{
+	run_phase_t *phase;
+	char mix[32];
+	unsigned long long ops;
+	int p, i;
+
+	printf("\nPhases (fractions of lookups/ranges/updates/inserts)\n");
+	printf("=======================\n");
+	printf("  %5s %8s %7s %15s %8s %12s %10s\n", "phase", "time_sec",
+	       "threads", "l/a/u/i", "key_dist", "ops", "Mops/sec");
+	for (p=0; p < nr_phases; p++) {
+		phase = &phases[p];
+		ops = phase->operations_performed[OPS_TOTAL];
+		snprintf(mix, sizeof(mix), "%d/%d/%d/%d", phase->spec.lookup_frac,
+		         phase->spec.range_frac, phase->spec.update_frac,
+		         phase->spec.insert_frac);
+		printf("  %5d %8.3lf %7d %15s %8s %12llu %10.3lf\n", p, phase->time_sec,
+		       phase->spec.nr_threads, mix, phase->spec.key_dist, ops,
+		       ops / phase->time_sec / 1000000.0);
+	}
+
+	for (p=0; p < nr_phases && phases[p].lat; p++) {
+		printf("\n  Phase %d latency (nsec, 1 in %d operations timed)\n", p,
+		       clargs.lat_sample);
+		lat_hist_print_header();
+		for (i=OPS_LOOKUP; i < OPS_END; i++)
+			if (phases[p].operations_performed[i] > 0)
+				lat_hist_print(op_names[i], &phases[p].lat[i], ticks_per_nsec);
+	}
+	printf("\n");
+}
+
+/**
+ * The results record of --output-format=json|csv (see record.h). It holds
+ * the same numbers as the report, with the per thread counters under
+ * "threads" and their sum under "total". Trees without transactional
+ * statistics have no "tx" objects.
+ **/
+static void ops_record(unsigned long long *operations_performed,
+                       unsigned long long *operations_succeeded)
+{
+	int i;
+
+	record_object("ops");
+	for (i=0; i < OPS_END; i++) {
+		record_object(op_names[i]);
+		record_uint("performed", operations_performed[i]);
+		record_uint("succeeded", operations_succeeded[i]);
+		record_close();
+	}
+	record_close();
+}
+
+static void latency_record(lat_hist_t *lat,
+                           unsigned long long *operations_performed)
+{
+	lat_hist_t *h;
+	int i;
+
+	record_object("latency_nsec");
+	for (i=OPS_LOOKUP; i < OPS_END; i++) {
+		if (operations_performed[i] == 0)
+			continue;
+		h = &lat[i];
+		record_object(op_names[i]);
+		record_uint("samples", h->count);
+		record_double("p50", lat_hist_percentile(h, 50.0) / ticks_per_nsec);
+		record_double("p99", lat_hist_percentile(h, 99.0) / ticks_per_nsec);
+		record_double("p99_9", lat_hist_percentile(h, 99.9) / ticks_per_nsec);
+		record_double("max", h->max / ticks_per_nsec);
+		record_close();
+	}
+	record_close();
+}
+
+static void thread_data_record(thread_data_t *data)
+{
+	rbt_tx_stats_t tx;
+	int i;
+
+	ops_record(data->stats.operations_performed, data->stats.operations_succeeded);
+	record_uint("range_keys", data->stats.range_keys);
+
+	if (rbt_thread_data_tx_stats(data->rbt_thread_data, &tx) == 0) {
+		record_object("tx");
+		record_uint("tx_starts", tx.tx_starts);
+		record_uint("tx_commits", tx.tx_commits);
+		record_uint("tx_aborts", tx.tx_aborts);
+		record_uint("lacqs", tx.lacqs);
+		record_object("tx_aborts_per_reason");
+		record_uint("conflict", tx.tx_aborts_conflict);
+		record_uint("capacity", tx.tx_aborts_capacity);
+		record_uint("validation", tx.tx_aborts_validation);
+		record_uint("gl_taken", tx.tx_aborts_gl_taken);
+		record_uint("explicit", tx.tx_aborts_explicit);
+		record_uint("other", tx.tx_aborts_other);
+		record_close();
+		record_close();
 	}
+
+	if (data->perf) {
+		record_object("perf");
+		for (i=0; i < PERF_NR_EVENTS; i++)
+			if (data->perf->has[i])
+				record_uint(perf_event_names[i], data->perf->count[i]);
+		record_close();
+	}
+}
+
+static void record_results(thread_data_t **threads_data, int nthreads,
+                           thread_data_t *total_data, sampler_t *sampler,
+                           rbt_mem_stats_t *mem, long long rss_delta,
+                           double time_elapsed, int validation)
+{
+	int i;
+
+	clargs_record();
+
+	record_object("benchmark");
+	record_str("name", "Parallel(pthreads)");
+	record_str("rbt_implementation", rbt_name());
+#	if defined(RBT_REGISTRY)
+	record_str("impl", rbt_impl->id);
+#	endif
+	record_int("key_bits", KEY_BITS);
+#	if defined(WORKLOAD_TIME)
+	record_str("workload", "time");
+#	elif defined(WORKLOAD_FIXED)
+	record_str("workload", "fixed");
+#	elif defined(WORKLOAD_RATE)
+	record_str("workload", "rate");
+#	endif
+	record_object("topology");
+	record_int("sockets", topology.nr_sockets);
+	record_int("cores", topology.nr_cores);
+	record_int("cpus", topology.nr_cpus);
+	record_close();
+	record_close();
+
+	record_array("threads");
+	for (i=0; i < nthreads; i++) {
+		record_object(NULL);
+		record_int("tid", threads_data[i]->tid);
+		record_int("cpu", threads_data[i]->cpu);
+		record_int("socket", placement[i].socket);
+		record_int("core", placement[i].core);
+		record_int("smt", placement[i].smt);
+		thread_data_record(threads_data[i]);
+		record_close();
+	}
+	record_close();
+
+	record_object("total");
+	thread_data_record(total_data);
+	record_close();
+
+	if (total_data->lat)
+		latency_record(total_data->lat, total_data->stats.operations_performed);
+
+	if (multi_phase) {
+		record_array("phases");
+		for (i=0; i < nr_phases; i++) {
+			run_phase_t *phase = &phases[i];
+
+			record_object(NULL);
+			record_double("duration_sec", phase->spec.duration_sec);
+			record_double("time_sec", phase->time_sec);
+			record_int("num_threads", phase->spec.nr_threads);
+			record_int("lookup_frac", phase->spec.lookup_frac);
+			record_int("range_frac", phase->spec.range_frac);
+			record_int("update_frac", phase->spec.update_frac);
+			record_int("insert_frac", phase->spec.insert_frac);
+			record_str("key_dist", phase->spec.key_dist);
+			ops_record(phase->operations_performed,
+			           phase->operations_succeeded);
+			record_double("throughput_ops_usec",
+			              phase->operations_performed[OPS_TOTAL] /
+			              phase->time_sec / 1000000.0);
+			if (phase->lat)
+				latency_record(phase->lat, phase->operations_performed);
+			record_close();
+		}
+		record_close();
+	}
+
+	if (clargs.sample_ms > 0) {
+		record_array("time_series");
+		for (i=0; i < sampler->nr_samples; i++) {
+			sample_t *s = &sampler->samples[i];
+
+			record_object(NULL);
+			record_double("time_sec", s->time_sec);
+			record_int("ops", s->ops);
+			record_double("mops_sec", s->ops / s->interval_sec / 1000000.0);
+			record_int("min_thread_ops", s->min_thread_ops);
+			record_int("max_thread_ops", s->max_thread_ops);
+			if (s->has_tx) {
+				record_uint("tx_commits", s->tx.tx_commits);
+				record_uint("tx_aborts", s->tx.tx_aborts);
+				record_uint("lacqs", s->tx.lacqs);
+			}
+			record_close();
+		}
+		record_close();
+	}
+
+	record_object("memory");
+	if (mem) {
+		record_int("node_size", mem->node_size);
+		record_int("nodes_allocated", mem->nodes_allocated);
+		record_int("nodes_live", mem->nodes_live);
+		record_int("nodes_retired", mem->nodes_retired);
+		record_int("nodes_free", mem->nodes_free);
+		record_int("pool_capacity", mem->pool_capacity);
+	} else {
+		record_str("nodes", "n/a");
+	}
+	if (rss_delta >= 0)
+		record_int("rss_delta_bytes", rss_delta);
+	record_close();
+
+	record_object("results");
+	record_double("time_elapsed_sec", time_elapsed);
+	record_double("throughput_ops_usec",
+	              total_data->stats.operations_performed[OPS_TOTAL] /
+	              time_elapsed / 1000000.0);
+#	if defined(WORKLOAD_RATE)
+	record_double("target_throughput_ops_usec", clargs.rate / 1000000.0);
+#	endif
+	record_int("expected_size", clargs.init_tree_size +
+	           (long long)total_data->stats.operations_succeeded[OPS_INSERT] -
+	           (long long)total_data->stats.operations_succeeded[OPS_DELETE]);
+	record_bool("validation_ok", validation);
+	record_close();
+
+	record_print();
 }
 
 pthread_barrier_t sync_barrier;
 pthread_barrier_t start_barrier;
 
+//> The operation of a choice in [0, 100), as given by the *_frac of a phase.
+static inline int op_of_choice(phase_t *phase, int choice)
+{
+	int lo = 0;
+
+	if (choice < (lo += phase->lookup_frac))
+		return OPS_LOOKUP;
+	if (choice < (lo += phase->range_frac))
+		return OPS_RANGE;
+	if (choice < (lo += phase->update_frac))
+		return OPS_UPDATE;
+	if (choice < (lo += phase->insert_frac))
+		return OPS_INSERT;
+	return OPS_DELETE;
+}
+
+/**
+ * --op-stream: the thread's first `len` operations and keys, drawn exactly
+ * as the loop would draw them. Generating them before the start takes the
+ * random number generation and the key distribution out of the measured
+ * loop, which then only reads two arrays.
+ **/
+static void op_stream_fill(unsigned char *ops, map_key_t *keys, int len,
+                           rng_t *rng, keydist_t *key_dist)
+{
+	int i;
+
+	for (i=0; i < len; i++) {
+		ops[i] = op_of_choice(&phases[0].spec, rng_below(rng, 100));
+		keys[i] = keydist_next(key_dist, rng, ops[i] == OPS_INSERT);
+	}
+}
+
 void *thread_fn(void *arg)
 {
-	int ops_performed = 0, ret;
+	long long ops_performed = 0;
+	int ret;
 	thread_data_t *data = arg;
+	thread_stats_t *stats = &data->stats;
 	int tid = data->tid, cpu = data->cpu;
 	void *rbt = data->rbt;
-	int choice, key_int;
+	int op, p = 0;
+	void *value;
+	run_phase_t *phase = &phases[0];
+	int lat_countdown = clargs.lat_sample, sampled;
+	unsigned long long tsc_start = 0;
+
+#	if defined(WORKLOAD_RATE)
+	//> Each thread issues its share of the rate with exponentially
+	//> distributed gaps, from a generator of its own so that the keys and
+	//> operations are the same as in the closed-loop workloads.
+	rng_t arrival_rng;
+	double gap_ticks = ticks_per_nsec * 1e9 * clargs.num_threads / clargs.rate;
+	unsigned long long next_arrival;
+	rng_init(&arrival_rng, rng_parse(clargs.rng),
+	         (data->tid + 1) * clargs.thread_seed + 1);
+#	endif
+	map_key_t key;
+	keydist_t key_dist = phase->key_dist;
 	
 	//> For thread_safe (and scalable) random number generation.
-	struct drand48_data drand_buffer;
-	long int drand_res;
+	rng_t rng;
+	unsigned char *stream_ops = NULL;
+	map_key_t *stream_keys = NULL;
+	int stream_i = 0;
+	trace_record_t rec;
+	uint64_t trace_i = 0, trace_hi = 0;
+	int trace_values = trace && (trace->hdr->flags & TRACE_VALUES);
+	unsigned long long invoke = 0;
+	long long k;
 
-	srand48_r((data->tid + 1) * clargs.thread_seed, &drand_buffer);
+	rng_init(&rng, rng_parse(clargs.rng), (data->tid + 1) * clargs.thread_seed);
+	keydist_thread_init(&key_dist, tid, clargs.num_threads);
 
 	//> Set affinity.
 	setaffinity_oncpu(cpu);
 
+	//> After pinning, so that the stream is in memory near our CPU.
+	if (clargs.op_stream > 0) {
+		XMALLOC(stream_ops, clargs.op_stream);
+		XMALLOC(stream_keys, clargs.op_stream);
+		op_stream_fill(stream_ops, stream_keys, clargs.op_stream, &rng,
+		               &key_dist);
+		data->stream_ops = stream_ops;
+		data->stream_keys = stream_keys;
+	}
+	if (trace && !trace_shared)
+		trace_partition(trace, tid, clargs.num_threads, &trace_i, &trace_hi);
+
 	//> Initialize per thread red-black tree data.
 	data->rbt_thread_data = rbt_thread_data_new(tid);
 
+	//> Our counters, only enabled while the operations run.
+	if (data->perf)
+		perf_counters_open(data->perf);
+
+	//> Build the initial tree with the other threads, out of our own nodes.
+	if (bulk_load) {
+		if (rbt_bulk_load(rbt, data->rbt_thread_data, bulk_load, tid) < 0)
+			bulk_load_unsupported = 1;
+		pthread_barrier_wait(&start_barrier);
+		//> Not supported, the master builds it with rbt_warmup() instead.
+		if (bulk_load_unsupported)
+			pthread_barrier_wait(&start_barrier);
+	}
+
+	if (use_range &&
+	    rbt_range(rbt, data->rbt_thread_data, 0, 0, NULL, NULL) < 0) {
+		fprintf(stderr, "%s does not support range queries\n", rbt_name());
+		exit(1);
+	}
+	if (use_update &&
+	    rbt_update(rbt, data->rbt_thread_data, -1, NULL) < 0) {
+		fprintf(stderr, "%s does not support value updates\n", rbt_name());
+		exit(1);
+	}
+
+	//> The tree is complete, what it holds is the initial key set of the
+	//> check. The master's rbt thread data cannot be used before ours is.
+	if (history_initial && tid == 0)
+		for (k=0; k < clargs.max_key; k++)
+			history_initial[k] = rbt_lookup(rbt, data->rbt_thread_data, k) != 0;
+
 	//> Wait for the master to give the starting signal.
 	pthread_barrier_wait(&start_barrier);
+	if (data->perf)
+		perf_counters_enable(data->perf);
+#	if defined(WORKLOAD_RATE)
+	next_arrival = read_tsc();
+#	endif
 
 	int i = 0;
 
 	//> Critical section.
 	while (1) {
 #		if defined(WORKLOAD_FIXED)
-		if (ops_performed >= data->nr_operations - 1)
-			break;
-#		elif defined(WORKLOAD_TIME)
-		if (*(data->time_to_leave))
+		if (ops_performed >= data->nr_operations - 1 ||
+		    (data->history && data->history->nr_events == clargs.check))
 			break;
+#		elif defined(WORKLOAD_TIME) || defined(WORKLOAD_RATE)
+		if (*(data->time_to_leave) || tid >= phase->spec.nr_threads ||
+		    (data->history && data->history->nr_events == clargs.check)) {
+			//> On to the next phase, if any, once the master has
+			//> collected this one. Threads not in a phase, or done
+			//> logging for --check, wait it out.
+			if (++p == nr_phases)
+				break;
+			pthread_barrier_wait(&phase_barrier);
+			pthread_barrier_wait(&start_barrier);
+			phase = &phases[p];
+			key_dist = phase->key_dist;
+			keydist_thread_init(&key_dist, tid, phase->spec.nr_threads);
+			continue;
+		}
 #		endif
 
-		ops_performed = data->operations_performed[OPS_TOTAL]++;
+#		if defined(WORKLOAD_RATE)
+		//> Wait for the next arrival. A thread that fell behind issues
+		//> its operations back to back until it catches up, and their
+		//> latency includes the time spent queueing.
+		next_arrival += -log(1.0 - rng_double(&arrival_rng)) * gap_ticks;
+		while (read_tsc() < next_arrival && !*(data->time_to_leave))
+			CPU_RELAX();
+#		endif
 
-		//> Generate random number;
-		lrand48_r(&drand_buffer, &drand_res);
-		choice = drand_res % 100;
-		lrand48_r(&drand_buffer, &drand_res);
-		key_int = drand_res % clargs.max_key;
-		int key = key_int;
+		//> Next operation and key, from the trace or the stream if there
+		//> is one.
+		value = NULL;
+		if (trace) {
+			if (trace_i == trace_hi && !trace_refill(&trace_i, &trace_hi))
+				break;
+			trace_read(trace, trace_i++, &rec);
+			if (rec.op >= TRACE_NR_OPS) {
+				fprintf(stderr, "Trace %s: unknown operation %d\n",
+				        clargs.trace, rec.op);
+				exit(1);
+			}
+			op = trace_ops[rec.op];
+			key = rec.key;
+			value = (void *)(long)rec.value;
+		} else if (stream_ops) {
+			op = stream_ops[stream_i];
+			key = stream_keys[stream_i];
+			if (++stream_i == clargs.op_stream)
+				stream_i = 0;
+		} else {
+			op = op_of_choice(&phase->spec, rng_below(&rng, 100));
+			key = keydist_next(&key_dist, &rng, op == OPS_INSERT);
+		}
 
-		//> Perform operation on the RBT based on choice.
-		if (choice < clargs.lookup_frac) {
-			//> Lookup
-			data->operations_performed[OPS_LOOKUP]++;
+		ops_performed = stats->operations_performed[OPS_TOTAL];
+		stat_add(&stats->operations_performed[OPS_TOTAL], 1);
+
+		//> Time one in lat_sample operations.
+		sampled = (data->lat && --lat_countdown == 0);
+		if (sampled) {
+			lat_countdown = clargs.lat_sample;
+#			if defined(WORKLOAD_RATE)
+			tsc_start = next_arrival;
+#			else
+			tsc_start = read_tsc();
+#			endif
+		}
+
+		//> Perform the operation on the RBT.
+		stat_add(&stats->operations_performed[op], 1);
+		if (data->history)
+			invoke = read_tsc_before();
+		switch (op) {
+		case OPS_LOOKUP:
 			ret = rbt_lookup(rbt, data->rbt_thread_data, key);
-			data->operations_succeeded[OPS_LOOKUP] += ret;
-		} else if (choice  < clargs.lookup_frac + clargs.insert_frac) {
-			//> Insertion
-			data->operations_performed[OPS_INSERT]++;
-			ret = rbt_insert(rbt, data->rbt_thread_data, key, NULL);
-			data->operations_succeeded[OPS_INSERT] += ret;
-		} else {
-			//> Deletion
-			data->operations_performed[OPS_DELETE]++;
+			break;
+		case OPS_RANGE:
+			//> Range query [key, key + range_len)
+			ret = rbt_range(rbt, data->rbt_thread_data, key,
+			                key + clargs.range_len, NULL, NULL);
+			stat_add(&stats->range_keys, ret);
+			ret = (ret > 0);
+			break;
+		case OPS_UPDATE:
+			//> In place value update
+			if (!trace_values)
+				value = (void *)(long)(ops_performed + 1);
+			ret = rbt_update(rbt, data->rbt_thread_data, key, value);
+			break;
+		case OPS_INSERT:
+			ret = rbt_insert(rbt, data->rbt_thread_data, key, value);
+			break;
+		default:
 			ret = rbt_delete(rbt, data->rbt_thread_data, key);
-			data->operations_succeeded[OPS_DELETE] += ret;
+			break;
 		}
-		data->operations_succeeded[OPS_TOTAL] += ret;
+		if (data->history && op != OPS_RANGE) {
+			history_add(data->history, history_ops[op], key, ret != 0, invoke,
+			            read_tsc_after());
+			if (data->history->nr_events == clargs.check)
+				__sync_add_and_fetch(&nr_histories_full, 1);
+		}
+		stat_add(&stats->operations_succeeded[op], ret);
+		stat_add(&stats->operations_succeeded[OPS_TOTAL], ret);
+
+		if (sampled)
+			lat_hist_add(&data->lat[op], read_tsc() - tsc_start);
 	}
 
+	if (data->perf)
+		perf_counters_disable(data->perf);
+
+	__sync_add_and_fetch(&nr_threads_done, 1);
 	return NULL;
 }
 
@@ -172,31 +1214,104 @@ int bench_pthreads()
 	pthread_t *threads;
 	thread_data_t **threads_data;
 	void *rbt;
-	int time_to_leave = 0;
+	int time_to_leave = 0, p;
+	struct timespec phase_start = { 0 }, now;
+	pthread_t sampler_thread;
+	sampler_t sampler = { 0 };
 	timer_tt *warmup_timer;
+	rbt_mem_stats_t mem_stats, *mem = NULL;
+	long long rss_start, rss_end, rss_delta = -1, expected_size;
+
+	//> Every long long max_key fits in 128-bit keys.
+#	if KEY_BITS < 128
+	if (clargs.max_key > KEY_MAX) {
+		fprintf(stderr, "max_key %lld does not fit in %d-bit keys\n",
+		        clargs.max_key, KEY_BITS);
+		exit(1);
+	}
+#	endif
+
+	phases_init(nthreads);
+
+	nr_threads_done = 0;
+	nr_histories_full = 0;
+	if (clargs.trace) {
+		trace = trace_open(clargs.trace);
+		if (trace->hdr->key_bits > KEY_BITS) {
+			fprintf(stderr, "Trace %s has %u-bit keys, this binary %d-bit\n",
+			        clargs.trace, trace->hdr->key_bits, KEY_BITS);
+			exit(1);
+		}
+		trace_shared = !strcmp(clargs.trace_mode, "shared");
+		trace_cursor = 0;
+	}
 
 	//> Initialize Red-Black tree.
+	rss_start = rss_bytes();
 	rbt = rbt_new();
 	printf("\nBenchmark\n");
 	printf("=======================\n");
 	printf("  Name: Parallel(pthreads)\n");
 	printf("  RBT implementation: %s\n", rbt_name());
+#	if defined(RBT_REGISTRY)
+	printf("  Impl: %s\n", rbt_impl->id);
+#	endif
+	printf("  Key size: %d bits\n", KEY_BITS);
+	if (trace) {
+		printf("  Trace: %s, %llu operations in %u partitions, %s\n",
+		       clargs.trace, (unsigned long long)trace->hdr->nr_records,
+		       trace->hdr->nr_partitions, clargs.trace_mode);
+	} else {
+		if (multi_phase)
+			printf("  Phases: %d, see below\n", nr_phases);
+		else
+			printf("  Key distribution: %s\n", clargs.key_dist);
+		printf("  RNG: %s", clargs.rng);
+		if (clargs.op_stream > 0)
+			printf(", %d operations per thread pregenerated", clargs.op_stream);
+		printf("\n");
+	}
 
-	//> Red-Black tree warmup.
-	int warmup_core = 0;
-	setaffinity_oncpu(warmup_core);
+	//> Pick the CPUs before anything is pinned, the warmup takes the first.
+	placement = aff_placement(clargs.placement, nthreads, &topology);
+	print_placement(nthreads);
+
+	//> Calibrate read_tsc() for pacing and the latency percentiles.
+#	if !defined(WORKLOAD_RATE)
+	if (clargs.lat_sample > 0)
+#	endif
+		ticks_per_nsec = lat_ticks_per_nsec(100);
+
+	//> Red-Black tree warmup, or the keys for the threads to bulk load.
+	int warmup_core = placement[0].cpu;
 	warmup_timer = timer_init();
 	printf("\n");
-	printf("Tree initialization (at core %d)...", warmup_core);
-	fflush(stdout);
-	timer_start(warmup_timer);
-	rbt_warmup(rbt, clargs.init_tree_size, clargs.max_key, clargs.init_seed, 0);
-	timer_stop(warmup_timer);
-	printf("[OK (%5.2lf sec)]\n", timer_report_sec(warmup_timer));
+	if (clargs.bulk_load) {
+		printf("Tree initialization (bulk load by %d threads)...", nthreads);
+		fflush(stdout);
+		timer_start(warmup_timer);
+		bulk_load = bulk_load_new(bulk_load_keys(clargs.init_tree_size,
+		                                         clargs.max_key,
+		                                         clargs.init_seed),
+		                          clargs.init_tree_size, nthreads);
+	} else {
+		setaffinity_oncpu(warmup_core);
+		printf("Tree initialization (at core %d)...", warmup_core);
+		fflush(stdout);
+		timer_start(warmup_timer);
+		rbt_warmup(rbt, clargs.init_tree_size, clargs.max_key,
+		           clargs.init_seed, 0);
+		timer_stop(warmup_timer);
+		printf("[OK (%5.2lf sec)]\n", timer_report_sec(warmup_timer));
+	}
+
+	if (clargs.check > 0)
+		XMALLOC(history_initial, clargs.max_key);
 
 	//> Initialize the starting barrier.
 	pthread_barrier_init(&start_barrier, NULL, nthreads+1);
 	pthread_barrier_init(&sync_barrier, NULL, nthreads);
+	pthread_barrier_init(&phase_barrier, NULL, nthreads+1);
 	
 	//> Initialize the arrays that hold the thread references and data.
 	XMALLOC(threads, nthreads);
@@ -204,18 +1319,33 @@ int bench_pthreads()
 
 	//> Initialize per thread data and spawn threads.
 	for (i=0; i < nthreads; i++) {
-		int cpu = i;
-//		if (cpu >= 22) cpu += 22;
-//		if (cpu >= 10) cpu += 10;
-		threads_data[i] = thread_data_new(i, cpu, rbt);
+		threads_data[i] = thread_data_new(i, placement[i].cpu, rbt);
 #		ifdef WORKLOAD_FIXED
 		threads_data[i]->nr_operations = clargs.nr_operations / nthreads;
-#		elif defined(WORKLOAD_TIME)
+#		elif defined(WORKLOAD_TIME) || defined(WORKLOAD_RATE)
 		threads_data[i]->time_to_leave = &time_to_leave;
 #		endif
 		pthread_create(&threads[i], NULL, thread_fn, threads_data[i]);
 	}
 
+	//> Wait until the threads have built the tree.
+	if (bulk_load) {
+		pthread_barrier_wait(&start_barrier);
+		if (bulk_load_unsupported) {
+			setaffinity_oncpu(warmup_core);
+			printf("not supported, at core %d...", warmup_core);
+			fflush(stdout);
+			rbt_warmup(rbt, clargs.init_tree_size, clargs.max_key,
+			           clargs.init_seed, 0);
+			pthread_barrier_wait(&start_barrier);
+		}
+		timer_stop(warmup_timer);
+		printf("[OK (%5.2lf sec)]\n", timer_report_sec(warmup_timer));
+		free(bulk_load->keys);
+		bulk_load_free(bulk_load);
+		bulk_load = NULL;
+	}
+
 	//> Wait until all threads go to the starting point.
 	pthread_barrier_wait(&start_barrier);
 
@@ -223,9 +1353,29 @@ int bench_pthreads()
 	timer_tt *wall_timer = timer_init();
 	timer_start(wall_timer);
 
-#	if defined(WORKLOAD_TIME)
-	sleep(clargs.run_time_sec);
-	time_to_leave = 1;
+	//> Start the time series sampler.
+	if (clargs.sample_ms > 0) {
+		sampler.threads_data = threads_data;
+		sampler.nthreads = nthreads;
+		pthread_create(&sampler_thread, NULL, sampler_fn, &sampler);
+	}
+
+#	if defined(WORKLOAD_TIME) || defined(WORKLOAD_RATE)
+	clock_gettime(CLOCK_MONOTONIC, &phase_start);
+	for (p=0; p < nr_phases; p++) {
+		if (p > 0) {
+			//> Collect the previous phase while the threads wait.
+			pthread_barrier_wait(&phase_barrier);
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			phase_collect(p - 1, threads_data, nthreads,
+			              timespec_diff_sec(&phase_start, &now));
+			time_to_leave = 0;
+			pthread_barrier_wait(&start_barrier);
+			clock_gettime(CLOCK_MONOTONIC, &phase_start);
+		}
+		phase_wait(phases[p].spec.duration_sec, nthreads);
+		time_to_leave = 1;
+	}
 #	endif
 
 	//> Join threads.
@@ -234,6 +1384,16 @@ int bench_pthreads()
 
 	//> Stop wall_timer.
 	timer_stop(wall_timer);
+	if (multi_phase) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		phase_collect(nr_phases - 1, threads_data, nthreads,
+		              timespec_diff_sec(&phase_start, &now));
+	}
+
+	if (clargs.sample_ms > 0) {
+		sampler.stop = 1;
+		pthread_join(sampler_thread, NULL);
+	}
 
 	//> Print thread statistics.
 	thread_data_t *total_data = thread_data_new(-1, -1, NULL);
@@ -245,6 +1405,12 @@ int bench_pthreads()
 	}
 	printf("-----------------------\n");
 	thread_data_print(total_data);
+	//> phase_collect() moved the latencies of the threads to the phases.
+	if (multi_phase && total_data->lat)
+		for (p=0; p < nr_phases; p++)
+			for (i=0; i < OPS_END; i++)
+				lat_hist_merge(&total_data->lat[i], &phases[p].lat[i],
+				               &total_data->lat[i]);
 
 	//> Print additional per thread statistics.
 	total_data->rbt_thread_data = rbt_thread_data_new(-1);
@@ -259,19 +1425,78 @@ int bench_pthreads()
 	thread_data_print_rbt_data(total_data);
 	printf("\n");
 
+	//> Print the memory of the tree.
+	expected_size = clargs.init_tree_size +
+	        (long long)total_data->stats.operations_succeeded[OPS_INSERT] -
+	        (long long)total_data->stats.operations_succeeded[OPS_DELETE];
+	rss_end = rss_bytes();
+	if (rss_start >= 0 && rss_end >= 0)
+		rss_delta = rss_end - rss_start;
+	if (rbt_mem_stats(rbt, &mem_stats) == 0)
+		mem = &mem_stats;
+	print_memory(mem, rss_delta, expected_size);
+
+	if (total_data->perf)
+		print_perf_counters(threads_data, nthreads, total_data);
+
+	if (clargs.sample_ms > 0)
+		print_time_series(&sampler);
+
+	if (multi_phase)
+		print_phases();
+
 	//> Validate the final RBT.
 	validation = rbt_validate(rbt);
+	if (clargs.check > 0 && !check_histories(threads_data, nthreads))
+		validation = 0;
 
 	//> Print elapsed time.
 	double time_elapsed = timer_report_sec(wall_timer);
-	double throughput_usec = total_data->operations_performed[OPS_TOTAL] / 
+	double throughput_usec = total_data->stats.operations_performed[OPS_TOTAL] / 
 	                         time_elapsed / 1000000.0;
 	printf("Time elapsed: %6.2lf\n", time_elapsed);
 	printf("Throughput(Ops/usec): %7.3lf\n", throughput_usec);
+#	if defined(WORKLOAD_RATE)
+	printf("Target throughput(Ops/usec): %7.3lf\n", clargs.rate / 1000000.0);
+#	endif
+	if (total_data->stats.operations_performed[OPS_RANGE] > 0)
+		printf("Keys per range query: %7.2lf\n", (double)total_data->stats.range_keys /
+		                              total_data->stats.operations_performed[OPS_RANGE]);
+
+	if (total_data->lat)
+		print_latencies(total_data);
+
+	printf("Expected size of RBT: %lld\n", expected_size);
+
+	if (record_format() != RECORD_TEXT)
+		record_results(threads_data, nthreads, total_data, &sampler,
+		               mem, rss_delta, time_elapsed, validation);
 
-	printf("Expected size of RBT: %d\n", clargs.init_tree_size +
-	        total_data->operations_succeeded[OPS_INSERT] - 
-	        total_data->operations_succeeded[OPS_DELETE]);
+	if (clargs.trace_out)
+		trace_write_streams(threads_data, nthreads);
+
+	//> x.all may run another tree next.
+	pthread_barrier_destroy(&start_barrier);
+	pthread_barrier_destroy(&sync_barrier);
+	pthread_barrier_destroy(&phase_barrier);
+	free(placement);
+	rbt_free(rbt);
+	for (i=0; i < nthreads; i++) {
+		rbt_thread_data_free(threads_data[i]->rbt_thread_data);
+		thread_data_free(threads_data[i]);
+	}
+	rbt_thread_data_free(total_data->rbt_thread_data);
+	thread_data_free(total_data);
+	free(threads_data);
+	free(threads);
+	free(sampler.samples);
+	free(warmup_timer);
+	free(wall_timer);
+	if (trace) {
+		trace_close(trace);
+		trace = NULL;
+	}
+	phases_free();
 
 	return validation;
 }
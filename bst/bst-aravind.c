@@ -23,14 +23,16 @@
 
 #include <stdint.h>
 #include <stdlib.h>
-#include <limits.h>
 
 #include "arch.h" /* CACHE_LINE_SIZE */
 #include "alloc.h"
+#include "key.h"
+#include "rbt/iface.h"
+#include "node_stats.h"
 
 #define CAS_PTR(a,b,c) __sync_val_compare_and_swap(a,b,c)
 
-#define MAX_KEY INT_MAX
+#define MAX_KEY KEY_MAX
 #define INF2 (MAX_KEY)
 #define INF1 (MAX_KEY - 1)
 #define INF0 (MAX_KEY - 2)
@@ -38,9 +40,9 @@
 #define max(a,b) \
 	({ __typeof__ (a) _a = (a); \
 	   __typeof__ (b) _b = (b); \
-	   _a > _b ? _a : _b; })
+	   KEY_GT(_a, _b) ? _a : _b; })
 
-typedef int skey_t;
+typedef map_key_t skey_t;
 typedef void * sval_t;
 
 typedef struct node_s {
@@ -88,10 +90,14 @@ static inline node_t* ADDRESS(volatile node_t* ptr) {
 
 __thread seek_record_t* seek_record;
 
+//> Nothing is freed, removed leaves and their parents leak.
+static node_stats_t bst_node_stats;
+
 node_t *create_node(skey_t k, sval_t value) {
 	node_t *new_node;
 
 	XMALLOC(new_node, 1);
+	node_stats_alloc(&bst_node_stats, 1);
 
 	new_node->left = NULL;
 	new_node->right = NULL;
@@ -146,7 +152,7 @@ seek_record_t *bst_seek(skey_t key, node_t *node_r, int *nr_nodes_traversed) {
 		seek_record_l.leaf = current;
 
 		parent_field = current_field;
-		if (key < current->key)
+		if (KEY_LT(key, current->key))
 			current_field = (node_t*) current->left;
 		else
 			current_field = (node_t*) current->right;
@@ -164,7 +170,7 @@ int bst_search(skey_t key, node_t *node_r) {
 	int nr_nodes;
 	bst_seek(key, node_r, &nr_nodes);
 //	printf("nr_nodes %d\n", nr_nodes);
-	return (seek_record->leaf->key == key);
+	return (KEY_EQ(seek_record->leaf->key, key));
 }
 
 int bst_cleanup(skey_t key) {
@@ -173,14 +179,14 @@ int bst_cleanup(skey_t key) {
 	node_t* parent = seek_record->parent;
 
 	node_t** succ_addr;
-	if (key < ancestor->key)
+	if (KEY_LT(key, ancestor->key))
 		succ_addr = (node_t**) &(ancestor->left);
 	else
 		succ_addr = (node_t**) &(ancestor->right);
 
 	node_t** child_addr;
 	node_t** sibling_addr;
-	if (key < parent->key) {
+	if (KEY_LT(key, parent->key)) {
 		child_addr = (node_t**) &(parent->left);
 		sibling_addr = (node_t**) &(parent->right);
 	} else {
@@ -217,14 +223,14 @@ int bst_insert(skey_t key, sval_t val, node_t *node_r) {
 	while (1) {
 		bst_seek(key, node_r, &nr_nodes);
 
-		if (seek_record->leaf->key == key)
+		if (KEY_EQ(seek_record->leaf->key, key))
             return 0;
 
 		node_t *parent = seek_record->parent;
 		node_t *leaf = seek_record->leaf;
 
 		node_t **child_addr;
-		if (key < parent->key)
+		if (KEY_LT(key, parent->key))
 			child_addr = (node_t**) &(parent->left); 
 		else
 			child_addr = (node_t**) &(parent->right);
@@ -237,7 +243,7 @@ int bst_insert(skey_t key, sval_t val, node_t *node_r) {
 			new_internal->key=max(key,leaf->key);
 		}
 
-		if ( key < leaf->key) {
+		if ( KEY_LT(key, leaf->key)) {
 			new_internal->left = new_node;
 			new_internal->right = leaf; 
 		} else {
@@ -267,14 +273,14 @@ int bst_remove(skey_t key, node_t* node_r) {
 		node_t *parent = seek_record->parent;
 
 		node_t** child_addr;
-		if (key < parent->key)
+		if (KEY_LT(key, parent->key))
 			child_addr = (node_t**) &(parent->left);
 		else
 			child_addr = (node_t**) &(parent->right);
 
 		if (injecting == 1) {
 			leaf = seek_record->leaf;
-			if (leaf->key != key)
+			if (!KEY_EQ(leaf->key, key))
 				return 0;
 
 			node_t* lf = ADDRESS(leaf);
@@ -305,7 +311,7 @@ unsigned long long bst_size(volatile node_t* node) {
 	if (node == NULL) return 0; 
 
 	if ((node->left == NULL) && (node->right == NULL))
-		if (node->key < INF0 )
+		if (KEY_LT(node->key, INF0) )
 			return 1;
 
 	unsigned long long l = 0, r = 0;
@@ -316,7 +322,7 @@ unsigned long long bst_size(volatile node_t* node) {
 	return l+r;
 }
 
-static inline int _bst_warmup_helper(node_t *root, int nr_nodes, int max_key,
+static inline int _bst_warmup_helper(node_t *root, int nr_nodes, map_key_t max_key,
                                      unsigned int seed, int force)
 {
 	int i = 0, nodes_inserted = 0, ret = 0;
@@ -325,7 +331,7 @@ static inline int _bst_warmup_helper(node_t *root, int nr_nodes, int max_key,
 	
 	srand(seed);
 	while (nodes_inserted < nr_nodes) {
-		int key = rand() % max_key;
+		map_key_t key = key_random(max_key);
 
 		ret = bst_insert(key, NULL, root);
 		nodes_inserted += ret;
@@ -334,6 +340,68 @@ static inline int _bst_warmup_helper(node_t *root, int nr_nodes, int max_key,
 	return nodes_inserted;
 }
 
+//> Leaves hold the keys, routing nodes the smallest key of their right subtree.
+static node_t *_bst_bulk_build(bulk_load_t *bl, int lo, int hi,
+                               int depth, int idx)
+{
+	node_t *node;
+	int mid;
+
+	if (lo >= hi)
+		return NULL;
+	if (bulk_load_is_built(bl, depth))
+		return bl->roots[idx];
+	if (hi - lo == 1)
+		return create_node(bl->keys[lo], NULL);
+
+	mid = bulk_load_mid(lo, hi);
+	node = create_node(bl->keys[mid], NULL);
+	node->left = _bst_bulk_build(bl, lo, mid, depth + 1, 2 * idx);
+	node->right = _bst_bulk_build(bl, mid, hi, depth + 1, 2 * idx + 1);
+	return node;
+}
+
+/**
+ * The keys go left of the INF0 leaf, under a routing node with key INF0,
+ * as if they were inserted one by one.
+ **/
+static inline int _bst_bulk_load_helper(node_t *root, bulk_load_t *bl, int tid)
+{
+	node_t *node_s = ADDRESS(root->left), *internal;
+	int i, lo, hi;
+
+	for (i=tid; i < bulk_load_nr_subtrees(bl); i += bl->nthreads) {
+		bulk_load_leaf_range(bl, i, &lo, &hi);
+		bl->roots[i] = _bst_bulk_build(bl, lo, hi, bl->levels, i);
+	}
+	if (bulk_load_join(bl) && bl->nr_keys > 0) {
+		internal = create_node(INF0, NULL);
+		internal->left = _bst_bulk_build(bl, 0, bl->nr_keys, 0, 0);
+		internal->right = node_s->left;
+		node_s->left = internal;
+	}
+	bulk_load_wait(bl);
+
+	return bl->nr_keys;
+}
+
+static long long _bst_count_nodes(volatile node_t *root)
+{
+	if (!root)
+		return 0;
+	return 1 + _bst_count_nodes(ADDRESS(root->left)) +
+	           _bst_count_nodes(ADDRESS(root->right));
+}
+
+static void _bst_free_nodes(volatile node_t *root)
+{
+	if (!root)
+		return;
+	_bst_free_nodes(ADDRESS(root->left));
+	_bst_free_nodes(ADDRESS(root->right));
+	free((void *)root);
+}
+
 static int total_paths, total_nodes, bst_violations;
 static int min_path_len, max_path_len;
 static void _bst_validate_rec(volatile node_t *root, int _th)
@@ -344,19 +412,19 @@ static void _bst_validate_rec(volatile node_t *root, int _th)
 	volatile node_t *left = root->left;
 	volatile node_t *right = root->right;
 
-	if (root->key < INF0) {
+	if (KEY_LT(root->key, INF0)) {
 		total_nodes++;
 		_th++;
 	}
 
 	/* BST violation? */
-	if (left && left->key >= root->key)
+	if (left && KEY_GE(left->key, root->key))
 		bst_violations++;
-	if (right && right->key < root->key)
+	if (right && KEY_LT(right->key, root->key))
 		bst_violations++;
 
 	/* We found a path (a node with at least one sentinel child). */
-	if (!left && !right && root->key < INF0) {
+	if (!left && !right && KEY_LT(root->key, INF0)) {
 		total_paths++;
 
 		if (_th <= min_path_len)
@@ -403,14 +471,17 @@ static inline int _bst_validate_helper(volatile node_t *root)
 void *rbt_new()
 {
 	printf("Size of tree node is %lu\n", sizeof(node_t));
+	node_stats_reset(&bst_node_stats);
 	return (void *)initialize_tree();
 }
 
 void *rbt_thread_data_new(int tid)
 {
 	XMALLOC(seek_record, 1);
+	node_stats_register(&bst_node_stats, tid);
 //	return htm_fg_tdata_new(tid);
-	return NULL;
+	//> Only for rbt_thread_data_free(), the thread uses its own pointer.
+	return seek_record;
 }
 
 void rbt_thread_data_print(void *thread_data)
@@ -424,27 +495,55 @@ void rbt_thread_data_add(void *d1, void *d2, void *dst)
 //	htm_fg_tdata_add(d1, d2, dst);
 }
 
-int rbt_lookup(void *bst, void *thread_data, int key)
+void rbt_thread_data_free(void *thread_data)
+{
+	free(thread_data);
+}
+
+int rbt_thread_data_tx_stats(void *thread_data, rbt_tx_stats_t *stats)
+{
+	return -1;
+}
+
+int rbt_lookup(void *bst, void *thread_data, map_key_t key)
 {
 	int ret;
 	ret = bst_search(key, bst);
 	return ret;
 }
 
-int rbt_insert(void *avl, void *thread_data, int key, void *value)
+int rbt_insert(void *avl, void *thread_data, map_key_t key, void *value)
 {
 	int ret = 0;
 	ret = bst_insert(key, value, avl);
 	return ret;
 }
 
-int rbt_delete(void *avl, void *thread_data, int key)
+int rbt_delete(void *avl, void *thread_data, map_key_t key)
 {
 	int ret = 0;
 	ret = bst_remove(key, avl);
 	return ret;
 }
 
+//> Key-value accessors are not supported.
+int rbt_get(void *rbt, void *thread_data, map_key_t key, void **value)
+{
+	return -1;
+}
+
+int rbt_update(void *rbt, void *thread_data, map_key_t key, void *value)
+{
+	return -1;
+}
+
+//> Range scans are not supported.
+int rbt_range(void *rbt, void *thread_data, map_key_t lo, map_key_t hi,
+              void (*cb)(map_key_t key, void *value, void *arg), void *arg)
+{
+	return -1;
+}
+
 int rbt_validate(void *avl)
 {
 	int ret = 1;
@@ -453,7 +552,12 @@ int rbt_validate(void *avl)
 	return ret;
 }
 
-int rbt_warmup(void *avl, int nr_nodes, int max_key, 
+void rbt_free(void *avl)
+{
+	_bst_free_nodes(avl);
+}
+
+int rbt_warmup(void *avl, int nr_nodes, map_key_t max_key, 
                unsigned int seed, int force)
 {
 	int ret = 0;
@@ -461,6 +565,26 @@ int rbt_warmup(void *avl, int nr_nodes, int max_key,
 	return ret;
 }
 
+int rbt_bulk_load(void *bst, void *thread_data, bulk_load_t *bl, int tid)
+{
+	return _bst_bulk_load_helper(bst, bl, tid);
+}
+
+//> The five sentinels and the routing nodes count as live.
+int rbt_mem_stats(void *bst, rbt_mem_stats_t *stats)
+{
+	node_stats_thread_t total;
+
+	node_stats_sum(&bst_node_stats, &total);
+	stats->node_size = sizeof(node_t);
+	stats->nodes_allocated = total.allocated;
+	stats->nodes_live = _bst_count_nodes(bst);
+	stats->nodes_retired = stats->nodes_allocated - stats->nodes_live;
+	stats->nodes_free = 0;
+	stats->pool_capacity = total.pool_capacity;
+	return 0;
+}
+
 char *rbt_name()
 {
 	return "bst_aravind";
@@ -4,17 +4,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
-#include <limits.h> /* for INT_MAX */
 
 #include "alloc.h"
 #include "arch.h"
+#include "key.h"
+#include "rbt/iface.h"
+#include "node_stats.h"
 
 #include "urcu.h"
 
 #include "clargs.h" /* To get clargs.num_threads */
 
 typedef struct bst_node_s {
-	int key;
+	map_key_t key;
 	void *data;
 
 	struct bst_node_s *right,
@@ -33,11 +35,15 @@ typedef struct {
 	bst_node_t *root;
 } bst_t;
 
-static bst_node_t *bst_node_new(int key, void *data)
+//> Nodes unlinked by deletions are not freed.
+static node_stats_t bst_node_stats;
+
+static bst_node_t *bst_node_new(map_key_t key, void *data)
 {
 	bst_node_t *node;
 
 	XMALLOC(node, 1);
+	node_stats_alloc(&bst_node_stats, 1);
 	node->key = key;
 	node->data = data;
 	node->right = node->left = NULL;
@@ -50,8 +56,8 @@ static bst_t *_bst_new_helper()
 {
 	bst_t *bst;
 	XMALLOC(bst, 1);
-	bst->root = bst_node_new(INT_MAX, NULL);
-	bst->root->left = bst_node_new(INT_MAX-1, NULL);
+	bst->root = bst_node_new(KEY_MAX, NULL);
+	bst->root->left = bst_node_new(KEY_MAX-1, NULL);
 	return bst;
 }
 
@@ -61,23 +67,23 @@ static bst_t *_bst_new_helper()
  * contains `key`. `parent` is either leaf's parent (if `leaf` != NULL) or
  * the node that will be the parent of the inserted node.
  **/
-static inline void _traverse(bst_t *bst, int key, bst_node_t **parent,
+static inline void _traverse(bst_t *bst, map_key_t key, bst_node_t **parent,
                                                  bst_node_t **leaf)
 {
 	*parent = bst->root->left;
 	*leaf = bst->root->left->left;
 
 	while (*leaf) {
-		int leaf_key = (*leaf)->key;
-		if (leaf_key == key)
+		map_key_t leaf_key = (*leaf)->key;
+		if (KEY_EQ(leaf_key, key))
 			return;
 
 		*parent = *leaf;
-		*leaf = (key < leaf_key) ? (*leaf)->left : (*leaf)->right;
+		*leaf = KEY_LT(key, leaf_key) ? (*leaf)->left : (*leaf)->right;
 	}
 }
 
-static int _bst_lookup_helper(bst_t *bst, int key)
+static int _bst_lookup_helper(bst_t *bst, map_key_t key)
 {
 	bst_node_t *parent, *leaf;
 
@@ -97,17 +103,17 @@ int validate(bst_node_t *prev, bst_node_t *curr, int direction){
 	return result;
 }
 
-static inline int _traverse_with_direction(bst_t *bst, int key,
+static inline int _traverse_with_direction(bst_t *bst, map_key_t key,
                                            bst_node_t **prev_p, 
                                            bst_node_t **curr_p) 
 {
 	bst_node_t *prev = bst->root, *curr = prev->left;
     int direction = 0;
-	int ckey = curr->key;
+	map_key_t ckey = curr->key;
 
-	while (curr && ckey != key) {
+	while (curr && !KEY_EQ(ckey, key)) {
 		prev = curr;
-		if (ckey > key) {
+		if (KEY_GT(ckey, key)) {
 			curr = curr->left;
 			direction = 0;
 		} else {
@@ -123,7 +129,7 @@ static inline int _traverse_with_direction(bst_t *bst, int key,
 	return direction;
 }
 
-static int _bst_insert_helper(bst_t *bst, int key, void *value)
+static int _bst_insert_helper(bst_t *bst, map_key_t key, void *value)
 {
 	bst_node_t *prev, *curr, *new;
 	int direction;
@@ -151,7 +157,7 @@ static int _bst_insert_helper(bst_t *bst, int key, void *value)
 	}
 }
 
-static int _bst_insert_helper_warmup(bst_t *bst, int key, void *value)
+static int _bst_insert_helper_warmup(bst_t *bst, map_key_t key, void *value)
 {
 	bst_node_t *parent, *leaf;
 
@@ -167,7 +173,7 @@ static int _bst_insert_helper_warmup(bst_t *bst, int key, void *value)
 	if (leaf)
 		return 0;
 
-	if (key < parent->key)
+	if (KEY_LT(key, parent->key))
 		parent->left = bst_node_new(key, value);
 	else
 		parent->right = bst_node_new(key, value);
@@ -175,7 +181,7 @@ static int _bst_insert_helper_warmup(bst_t *bst, int key, void *value)
 	return 1;
 }
 
-static int _bst_delete_helper(bst_t *bst, int key)
+static int _bst_delete_helper(bst_t *bst, map_key_t key)
 {
 	bst_node_t *prev, *curr;
 	int direction;
@@ -261,14 +267,14 @@ static int _bst_delete_helper(bst_t *bst, int key)
     }
 }
 
-static inline int _bst_warmup_helper(bst_t *bst, int nr_nodes, int max_key,
+static inline int _bst_warmup_helper(bst_t *bst, int nr_nodes, map_key_t max_key,
                                      unsigned int seed, int force)
 {
 	int i = 0, nodes_inserted = 0, ret = 0;
 	
 	srand(seed);
 	while (nodes_inserted < nr_nodes) {
-		int key = rand() % max_key;
+		map_key_t key = key_random(max_key);
 
 		ret = _bst_insert_helper_warmup(bst, key, NULL);
 		nodes_inserted += ret;
@@ -277,6 +283,56 @@ static inline int _bst_warmup_helper(bst_t *bst, int nr_nodes, int max_key,
 	return nodes_inserted;
 }
 
+static bst_node_t *_bst_bulk_build(bulk_load_t *bl, int lo, int hi,
+                                   int depth, int idx)
+{
+	bst_node_t *node;
+	int mid;
+
+	if (lo >= hi)
+		return NULL;
+	if (bulk_load_is_built(bl, depth))
+		return bl->roots[idx];
+
+	mid = bulk_load_mid(lo, hi);
+	node = bst_node_new(bl->keys[mid], NULL);
+	node->left = _bst_bulk_build(bl, lo, mid, depth + 1, 2 * idx);
+	node->right = _bst_bulk_build(bl, mid + 1, hi, depth + 1, 2 * idx + 1);
+	return node;
+}
+
+//> The keys go below the two sentinels, where _traverse() starts.
+static inline int _bst_bulk_load_helper(bst_t *bst, bulk_load_t *bl, int tid)
+{
+	int i, lo, hi;
+
+	for (i=tid; i < bulk_load_nr_subtrees(bl); i += bl->nthreads) {
+		bulk_load_subtree_range(bl, i, &lo, &hi);
+		bl->roots[i] = _bst_bulk_build(bl, lo, hi, bl->levels, i);
+	}
+	if (bulk_load_join(bl))
+		bst->root->left->left = _bst_bulk_build(bl, 0, bl->nr_keys, 0, 0);
+	bulk_load_wait(bl);
+
+	return bl->nr_keys;
+}
+
+static long long _bst_count_nodes(bst_node_t *root)
+{
+	if (!root)
+		return 0;
+	return 1 + _bst_count_nodes(root->left) + _bst_count_nodes(root->right);
+}
+
+static void _bst_free_nodes(bst_node_t *root)
+{
+	if (!root)
+		return;
+	_bst_free_nodes(root->left);
+	_bst_free_nodes(root->right);
+	free(root);
+}
+
 static int total_paths, total_nodes, bst_violations;
 static int min_path_len, max_path_len;
 static void _bst_validate_rec(bst_node_t *root, int _th)
@@ -291,9 +347,9 @@ static void _bst_validate_rec(bst_node_t *root, int _th)
 	_th++;
 
 	/* BST violation? */
-	if (left && left->key >= root->key)
+	if (left && KEY_GE(left->key, root->key))
 		bst_violations++;
-	if (right && right->key <= root->key)
+	if (right && KEY_LE(right->key, root->key))
 		bst_violations++;
 
 	/* We found a path (a node with at least one NULL child). */
@@ -354,7 +410,7 @@ static void bst_print_rec(bst_node_t *root, int level)
 		return;
 	}
 
-	printf("%d\n", root->key);
+	printf(KEY_FMT "\n", KEY_FMT_ARG(root->key));
 
 	bst_print_rec(root->left, level + 1);
 }
@@ -376,12 +432,14 @@ void *rbt_new()
 {
 	printf("Size of tree node is %lu\n", sizeof(bst_node_t));
 	initURCU(clargs.num_threads);
+	node_stats_reset(&bst_node_stats);
 	return _bst_new_helper();
 }
 
 void *rbt_thread_data_new(int tid)
 {
 	urcu_register(tid);
+	node_stats_register(&bst_node_stats, tid);
 	return NULL;
 }
 
@@ -394,27 +452,54 @@ void rbt_thread_data_add(void *d1, void *d2, void *dst)
 {
 }
 
-int rbt_lookup(void *rbt, void *thread_data, int key)
+void rbt_thread_data_free(void *thread_data)
+{
+}
+
+int rbt_thread_data_tx_stats(void *thread_data, rbt_tx_stats_t *stats)
+{
+	return -1;
+}
+
+int rbt_lookup(void *rbt, void *thread_data, map_key_t key)
 {
 	int ret = 0;
 	ret = _bst_lookup_helper(rbt, key);
 	return ret; 
 }
 
-int rbt_insert(void *rbt, void *thread_data, int key, void *value)
+int rbt_insert(void *rbt, void *thread_data, map_key_t key, void *value)
 {
 	int ret = 0;
 	ret = _bst_insert_helper(rbt, key, value);
 	return ret;
 }
 
-int rbt_delete(void *rbt, void *thread_data, int key)
+int rbt_delete(void *rbt, void *thread_data, map_key_t key)
 {
 	int ret = 0;
 	ret = _bst_delete_helper(rbt, key);
 	return ret;
 }
 
+//> Key-value accessors are not supported.
+int rbt_get(void *rbt, void *thread_data, map_key_t key, void **value)
+{
+	return -1;
+}
+
+int rbt_update(void *rbt, void *thread_data, map_key_t key, void *value)
+{
+	return -1;
+}
+
+//> Range scans are not supported.
+int rbt_range(void *rbt, void *thread_data, map_key_t lo, map_key_t hi,
+              void (*cb)(map_key_t key, void *value, void *arg), void *arg)
+{
+	return -1;
+}
+
 int rbt_validate(void *rbt)
 {
 	int ret = 0;
@@ -422,7 +507,13 @@ int rbt_validate(void *rbt)
 	return ret;
 }
 
-int rbt_warmup(void *rbt, int nr_nodes, int max_key, 
+void rbt_free(void *rbt)
+{
+	_bst_free_nodes(((bst_t *)rbt)->root);
+	free(rbt);
+}
+
+int rbt_warmup(void *rbt, int nr_nodes, map_key_t max_key, 
                unsigned int seed, int force)
 {
 	int ret = 0;
@@ -430,6 +521,26 @@ int rbt_warmup(void *rbt, int nr_nodes, int max_key,
 	return ret;
 }
 
+int rbt_bulk_load(void *rbt, void *thread_data, bulk_load_t *bl, int tid)
+{
+	return _bst_bulk_load_helper(rbt, bl, tid);
+}
+
+//> The two sentinels count as live.
+int rbt_mem_stats(void *rbt, rbt_mem_stats_t *stats)
+{
+	node_stats_thread_t total;
+
+	node_stats_sum(&bst_node_stats, &total);
+	stats->node_size = sizeof(bst_node_t);
+	stats->nodes_allocated = total.allocated;
+	stats->nodes_live = _bst_count_nodes(((bst_t *)rbt)->root);
+	stats->nodes_retired = stats->nodes_allocated - stats->nodes_live;
+	stats->nodes_free = 0;
+	stats->pool_capacity = total.pool_capacity;
+	return 0;
+}
+
 char *rbt_name()
 {
 	return "bst-citrus-mine";
@@ -3,10 +3,19 @@
 
 #include "arch.h" /* CACHE_LINE_SIZE */
 #include "alloc.h"
+#include "tm.h"
+#include "clargs.h"
+#include "key.h"
+#include "rbt/iface.h"
+
+//> Written against int keys only (see key.h).
+#if KEY_BITS != 32 || defined(KEY_CMP)
+#	error "this tree supports only the default int keys"
+#endif
 
 typedef struct {
 	int tid;
-	long long unsigned tx_starts, tx_aborts, lacqs;
+	tm_tdata_t tm;
 } tdata_t;
 
 static inline tdata_t *tdata_new(int tid)
@@ -14,52 +23,20 @@ static inline tdata_t *tdata_new(int tid)
 	tdata_t *ret;
 	XMALLOC(ret, 1);
 	ret->tid = tid;
-	ret->tx_starts = 0;
-	ret->tx_aborts = 0;
-	ret->lacqs = 0;
+	tm_tdata_init(&ret->tm, tid, clargs.tx_policy, clargs.tx_retries);
 	return ret;
 }
 
 static inline void tdata_print(tdata_t *tdata)
 {
-	printf("TID %3d: %llu %llu ( %llu )\n", tdata->tid, tdata->tx_starts,
-	                               tdata->tx_aborts, tdata->lacqs);
+	tm_tdata_print(&tdata->tm);
 }
 
 static inline void tdata_add(tdata_t *d1, tdata_t *d2, tdata_t *dst)
 {
-	dst->tx_starts = d1->tx_starts + d2->tx_starts;
-	dst->tx_aborts = d1->tx_aborts + d2->tx_aborts;
-	dst->lacqs = d1->lacqs + d2->lacqs;
+	tm_tdata_add(&d1->tm, &d2->tm, &dst->tm);
 }
 
-/* TM Interface. */
-#if !defined(TX_NUM_RETRIES)
-#	define TX_NUM_RETRIES 20
-#endif
-
-#ifdef __POWERPC64__
-#	include <htmintrin.h>
-	typedef int tm_begin_ret_t;
-#	define LOCK_FREE 0
-#	define TM_BEGIN_SUCCESS 1
-#	define ABORT_VALIDATION_FAILURE 0xee
-#	define ABORT_GL_TAKEN           0xff
-#	define TX_ABORT(code) __builtin_tabort(code)
-#	define TX_BEGIN(code) __builtin_tbegin(0)
-#	define TX_END(code)   __builtin_tend(0)
-#else
-#	include "rtm.h"
-	typedef unsigned tm_begin_ret_t;
-#	define LOCK_FREE 1
-#	define TM_BEGIN_SUCCESS _XBEGIN_STARTED
-#	define ABORT_VALIDATION_FAILURE 0xee
-#	define ABORT_GL_TAKEN           0xff
-#	define TX_ABORT(code) _xabort(code)
-#	define TX_BEGIN(code) _xbegin()
-#	define TX_END(code)   _xend()
-#endif
-/*****************/
 
 typedef enum {
 	RED = 0,
@@ -82,7 +59,7 @@ typedef struct rbt_node {
 typedef struct {
 	rbt_node_t *root;
 
-	pthread_spinlock_t rbt_lock;
+	tm_fallback_lock_t rbt_lock;
 } rbt_t;
 
 #define IS_EXTERNAL_NODE(node) \
@@ -112,7 +89,7 @@ rbt_t *_rbt_new_helper()
 	XMALLOC(rbt, 1);
 	rbt->root = NULL;
 
-	pthread_spin_init(&rbt->rbt_lock, PTHREAD_PROCESS_SHARED);
+	tm_fallback_lock_init(&rbt->rbt_lock);
 
 	return rbt;
 }
@@ -171,15 +148,16 @@ int _rbt_lookup_helper(rbt_t *rbt, int key, tdata_t *tdata)
 	rbt_node_t *place;
 	int ret, retries = -1;
 
+	tm_op_begin(&tdata->tm);
+
 try_from_scratch:
 
 	/* Global lock fallback. */
-	if (++retries >= TX_NUM_RETRIES) {
-		tdata->lacqs++;
-		pthread_spin_lock(&rbt->rbt_lock);
+	if (!tm_retry_allowed(&tdata->tm, ++retries)) {
+		tm_fallback_lock(&rbt->rbt_lock, &tdata->tm);
 		place = _traverse(rbt, key);
 		ret = (place && place->key == key);
-		pthread_spin_unlock(&rbt->rbt_lock);
+		tm_fallback_unlock(&rbt->rbt_lock, &tdata->tm);
 		return ret;
 	}
 
@@ -189,13 +167,12 @@ try_from_scratch:
 	place = _traverse(rbt, key);
 
 	/* Transactional verification. */
-	while (rbt->rbt_lock != LOCK_FREE)
-		;
+	tm_fallback_wait(&rbt->rbt_lock);
 
-	tdata->tx_starts++;
-	status = TX_BEGIN(0);
+	tm_tx_started(&tdata->tm);
+	TX_BEGIN(status);
 	if (status == TM_BEGIN_SUCCESS) {
-		if (rbt->rbt_lock != LOCK_FREE)
+		if (tm_fallback_is_locked(&rbt->rbt_lock))
 			TX_ABORT(ABORT_GL_TAKEN);
 
 		/* _lookup_verify() will abort if verification fails. */
@@ -203,8 +180,9 @@ try_from_scratch:
 		ret = (place && place->key == key);
 
 		TX_END(0);
+		tm_tx_committed(&tdata->tm);
 	} else {
-		tdata->tx_aborts++;
+		tm_tx_aborted(&tdata->tm, status);
 		goto try_from_scratch;
 	}
 
@@ -282,15 +260,16 @@ int _rbt_insert_helper(rbt_t *rbt, rbt_node_t *new_nodes[2], tdata_t *tdata)
 	rbt_node_t *place;
 	int retries = -1, ret = 0;
 
+	tm_op_begin(&tdata->tm);
+
 try_from_scratch:
 
 	/* Global lock fallback. */
-	if (++retries >= TX_NUM_RETRIES) {
-		tdata->lacqs++;
-		pthread_spin_lock(&rbt->rbt_lock);
+	if (!tm_retry_allowed(&tdata->tm, ++retries)) {
+		tm_fallback_lock(&rbt->rbt_lock, &tdata->tm);
 		place = _traverse(rbt, new_nodes[0]->key);
 		ret = _insert(rbt, place, new_nodes);
-		pthread_spin_unlock(&rbt->rbt_lock);
+		tm_fallback_unlock(&rbt->rbt_lock, &tdata->tm);
 		return ret;
 	}
 
@@ -298,13 +277,12 @@ try_from_scratch:
 	place = _traverse(rbt, new_nodes[0]->key);
 
 	/* Transactional verification. */
-	while (rbt->rbt_lock != LOCK_FREE)
-		;
+	tm_fallback_wait(&rbt->rbt_lock);
 
-	tdata->tx_starts++;
-	status = TX_BEGIN(0);
+	tm_tx_started(&tdata->tm);
+	TX_BEGIN(status);
 	if (status == TM_BEGIN_SUCCESS) {
-		if (rbt->rbt_lock != LOCK_FREE)
+		if (tm_fallback_is_locked(&rbt->rbt_lock))
 			TX_ABORT(ABORT_GL_TAKEN);
 
 		/* _lookup_verify() will abort if verification fails. */
@@ -312,8 +290,9 @@ try_from_scratch:
 		ret = _insert(rbt, place, new_nodes);
 
 		TX_END(0);
+		tm_tx_committed(&tdata->tm);
 	} else {
-		tdata->tx_aborts++;
+		tm_tx_aborted(&tdata->tm, status);
 		goto try_from_scratch;
 	}
 
@@ -391,15 +370,16 @@ static int _rbt_delete_helper(rbt_t *rbt, int key, rbt_node_t *nodes_to_free[2],
 	rbt_node_t *place;
 	int retries = -1, ret = 0;
 
+	tm_op_begin(&tdata->tm);
+
 try_from_scratch:
 
 	/* Global lock fallback. */
-	if (++retries >= TX_NUM_RETRIES) {
-		tdata->lacqs++;
-		pthread_spin_lock(&rbt->rbt_lock);
+	if (!tm_retry_allowed(&tdata->tm, ++retries)) {
+		tm_fallback_lock(&rbt->rbt_lock, &tdata->tm);
 		place = _traverse(rbt, key);
 		ret = _delete(rbt, key, place, nodes_to_free);
-		pthread_spin_unlock(&rbt->rbt_lock);
+		tm_fallback_unlock(&rbt->rbt_lock, &tdata->tm);
 		return ret;
 	}
 
@@ -407,13 +387,12 @@ try_from_scratch:
 	place = _traverse(rbt, key);
 
 	/* Transactional verification. */
-	while (rbt->rbt_lock != LOCK_FREE)
-		;
+	tm_fallback_wait(&rbt->rbt_lock);
 
-	tdata->tx_starts++;
-	status = TX_BEGIN(0);
+	tm_tx_started(&tdata->tm);
+	TX_BEGIN(status);
 	if (status == TM_BEGIN_SUCCESS) {
-		if (rbt->rbt_lock != LOCK_FREE)
+		if (tm_fallback_is_locked(&rbt->rbt_lock))
 			TX_ABORT(ABORT_GL_TAKEN);
 
 		/* _lookup_verify() will abort if verification fails. */
@@ -421,8 +400,9 @@ try_from_scratch:
 		ret = _delete(rbt, key, place, nodes_to_free);
 
 		TX_END(0);
+		tm_tx_committed(&tdata->tm);
 	} else {
-		tdata->tx_aborts++;
+		tm_tx_aborted(&tdata->tm, status);
 		goto try_from_scratch;
 	}
 
@@ -587,6 +567,18 @@ void rbt_thread_data_add(void *d1, void *d2, void *dst)
 	tdata_add(d1, d2, dst);
 }
 
+void rbt_thread_data_free(void *thread_data)
+{
+	free(thread_data);
+}
+
+int rbt_thread_data_tx_stats(void *thread_data, rbt_tx_stats_t *stats)
+{
+	tdata_t *tdata = thread_data;
+	TM_STATS_COPY(stats, &tdata->tm.stats);
+	return 0;
+}
+
 int rbt_lookup(void *rbt, void *thread_data, int key)
 {
 	int ret = 0;
@@ -635,6 +627,24 @@ int rbt_delete(void *rbt, void *thread_data, int key)
 	return ret;
 }
 
+//> Key-value accessors are not supported.
+int rbt_get(void *rbt, void *thread_data, int key, void **value)
+{
+	return -1;
+}
+
+int rbt_update(void *rbt, void *thread_data, int key, void *value)
+{
+	return -1;
+}
+
+//> Range scans are not supported.
+int rbt_range(void *rbt, void *thread_data, int lo, int hi,
+              void (*cb)(int key, void *value, void *arg), void *arg)
+{
+	return -1;
+}
+
 int rbt_validate(void *rbt)
 {
 	int ret;
@@ -642,6 +652,21 @@ int rbt_validate(void *rbt)
 	return ret;
 }
 
+static void _rbt_free_nodes(rbt_node_t *root)
+{
+	if (!root)
+		return;
+	_rbt_free_nodes(root->left);
+	_rbt_free_nodes(root->right);
+	free(root);
+}
+
+void rbt_free(void *rbt)
+{
+	_rbt_free_nodes(((rbt_t *)rbt)->root);
+	free(rbt);
+}
+
 int rbt_warmup(void *rbt, int nr_nodes, int max_key, 
                unsigned int seed, int force)
 {
@@ -650,6 +675,18 @@ int rbt_warmup(void *rbt, int nr_nodes, int max_key,
 	return ret;
 }
 
+//> Bulk loading is not supported, the benchmark falls back to rbt_warmup().
+int rbt_bulk_load(void *rbt, void *thread_data, bulk_load_t *bl, int tid)
+{
+	return -1;
+}
+
+//> Node memory is not accounted for.
+int rbt_mem_stats(void *rbt, rbt_mem_stats_t *stats)
+{
+	return -1;
+}
+
 char *rbt_name()
 {
 	return "links_bu_cop_external";
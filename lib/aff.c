@@ -7,8 +7,14 @@
 #include <sched.h>
 #include <string.h>
 
+#include "aff.h"
+
 #define MT_CONF "MT_CONF"
 
+#if !defined(SYSFS_CPU_DIR)
+#   define SYSFS_CPU_DIR "/sys/devices/system/cpu"
+#endif
+
 void setaffinity_oncpu(unsigned int cpu)
 {
     cpu_set_t cpu_mask;
@@ -99,3 +105,174 @@ void mt_conf_print(unsigned int ncpus, unsigned int *cpus)
     }
     printf("\n");
 }
+
+static int sysfs_cpu_read(unsigned int cpu, const char *file)
+{
+    char path[256];
+    FILE *fp;
+    int ret = -1;
+
+    snprintf(path, sizeof(path), SYSFS_CPU_DIR "/cpu%u/topology/%s", cpu, file);
+    fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+    if (fscanf(fp, "%d", &ret) != 1)
+        ret = -1;
+    fclose(fp);
+    return ret;
+}
+
+/**
+ * Socket and core of every CPU in `allowed`. Without sysfs, every CPU is a
+ * core of its own on socket 0. The core ids in sysfs are per socket and may
+ * have holes, `core` is the rank of the id within its socket instead.
+ **/
+static aff_cpu_t *read_topology(cpu_set_t *allowed, unsigned int *nr_cpus,
+                                aff_topology_t *topo)
+{
+    aff_cpu_t *cpus;
+    int *core_ids, socket, core_id;
+    unsigned int cpu, i, j, n = 0;
+
+    cpus = malloc(CPU_COUNT(allowed) * sizeof(*cpus));
+    core_ids = malloc(CPU_COUNT(allowed) * sizeof(*core_ids));
+    if (!cpus || !core_ids) {
+        fprintf(stderr, "read_topology: malloc failed\n");
+        exit(1);
+    }
+
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, allowed))
+            continue;
+        socket = sysfs_cpu_read(cpu, "physical_package_id");
+        core_id = sysfs_cpu_read(cpu, "core_id");
+        cpus[n].cpu = cpu;
+        cpus[n].socket = socket < 0 ? 0 : socket;
+        core_ids[n] = core_id < 0 ? (int)cpu : core_id;
+        n++;
+    }
+
+    topo->nr_sockets = topo->nr_cores = 0;
+    topo->nr_cpus = n;
+    for (i = 0; i < n; i++) {
+        cpus[i].core = cpus[i].smt = 0;
+        for (j = 0; j < n; j++) {
+            if (cpus[j].socket != cpus[i].socket)
+                continue;
+            //> Count distinct smaller core ids, and smaller siblings.
+            if (core_ids[j] < core_ids[i]) {
+                unsigned int k;
+                for (k = 0; k < j; k++)
+                    if (cpus[k].socket == cpus[j].socket &&
+                        core_ids[k] == core_ids[j])
+                        break;
+                if (k == j)
+                    cpus[i].core++;
+            } else if (core_ids[j] == core_ids[i] && j < i) {
+                cpus[i].smt++;
+            }
+        }
+        if (cpus[i].smt == 0)
+            topo->nr_cores++;
+        if (cpus[i].socket + 1 > topo->nr_sockets)
+            topo->nr_sockets = cpus[i].socket + 1;
+    }
+
+    free(core_ids);
+    *nr_cpus = n;
+    return cpus;
+}
+
+enum { PLACE_COMPACT = 0, PLACE_SCATTER, PLACE_CORES, PLACE_LIST };
+
+//> The policy placement_cmp() sorts by.
+static int placement_policy;
+
+static int placement_parse(const char *policy)
+{
+    if (!strcmp(policy, "compact")) return PLACE_COMPACT;
+    if (!strcmp(policy, "scatter")) return PLACE_SCATTER;
+    if (!strcmp(policy, "cores")) return PLACE_CORES;
+    if (!strcmp(policy, "list")) return PLACE_LIST;
+    return -1;
+}
+
+int aff_placement_valid(const char *policy)
+{
+    return placement_parse(policy) >= 0;
+}
+
+static int cmp_keys(unsigned int a1, unsigned int a2, unsigned int a3,
+                    unsigned int b1, unsigned int b2, unsigned int b3)
+{
+    if (a1 != b1) return a1 < b1 ? -1 : 1;
+    if (a2 != b2) return a2 < b2 ? -1 : 1;
+    if (a3 != b3) return a3 < b3 ? -1 : 1;
+    return 0;
+}
+
+static int placement_cmp(const void *p1, const void *p2)
+{
+    const aff_cpu_t *a = p1, *b = p2;
+    int ret = 0;
+
+    switch (placement_policy) {
+    case PLACE_COMPACT:
+        ret = cmp_keys(a->socket, a->core, a->smt, b->socket, b->core, b->smt);
+        break;
+    case PLACE_SCATTER:
+        ret = cmp_keys(a->smt, a->core, a->socket, b->smt, b->core, b->socket);
+        break;
+    case PLACE_CORES:
+        ret = cmp_keys(a->smt, a->socket, a->core, b->smt, b->socket, b->core);
+        break;
+    }
+    return ret ? ret : (a->cpu < b->cpu ? -1 : a->cpu > b->cpu);
+}
+
+aff_cpu_t *aff_placement(const char *policy, unsigned int nthreads,
+                         aff_topology_t *topo)
+{
+    cpu_set_t allowed;
+    aff_cpu_t *cpus, *ret;
+    unsigned int nr_cpus, nr_list, *list, i, j;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed)) {
+        perror("sched_getaffinity");
+        exit(1);
+    }
+    cpus = read_topology(&allowed, &nr_cpus, topo);
+    if (nr_cpus == 0) {
+        fprintf(stderr, "aff_placement: no CPUs to run on\n");
+        exit(1);
+    }
+
+    ret = malloc(nthreads * sizeof(*ret));
+    if (!ret) {
+        fprintf(stderr, "aff_placement: malloc failed\n");
+        exit(1);
+    }
+
+    placement_policy = placement_parse(policy);
+    if (placement_policy == PLACE_LIST) {
+        get_mtconf_options(&nr_list, &list);
+        for (i = 0; i < nthreads; i++) {
+            unsigned int cpu = list[i % nr_list];
+            for (j = 0; j < nr_cpus && cpus[j].cpu != cpu; j++)
+                ;
+            if (j == nr_cpus) {
+                fprintf(stderr, "%s: CPU %u is not available\n", MT_CONF, cpu);
+                exit(1);
+            }
+            ret[i] = cpus[j];
+        }
+        free(list);
+    } else {
+        qsort(cpus, nr_cpus, sizeof(*cpus), placement_cmp);
+        for (i = 0; i < nthreads; i++)
+            ret[i] = cpus[i % nr_cpus];
+    }
+
+    free(cpus);
+    return ret;
+}
@@ -5,4 +5,32 @@ void setaffinity_oncpu(unsigned int cpu);
 void get_mtconf_options(unsigned int *nr_cpus, unsigned int **cpus);
 void mt_conf_print(unsigned int ncpus, unsigned int *cpus);
 
+/**
+ * Thread placement. The CPUs the process is allowed to run on are read
+ * from sysfs and ordered by a policy:
+ *   compact  fill a socket core by core, SMT siblings of a core next to
+ *            each other, before moving on to the next socket.
+ *   scatter  round robin over the sockets, one hardware thread of every
+ *            physical core before any SMT sibling.
+ *   cores    one hardware thread of every physical core, socket by socket,
+ *            then the SMT siblings in the same order.
+ *   list     the CPUs given in the MT_CONF environment variable, in order.
+ * Thread i runs on entry i % nr_cpus of the order, so there can be more
+ * threads than CPUs.
+ **/
+typedef struct {
+    unsigned int cpu, socket, core;
+    unsigned int smt; //> Index of the CPU among the siblings of its core.
+} aff_cpu_t;
+
+typedef struct {
+    unsigned int nr_sockets, nr_cores, nr_cpus;
+} aff_topology_t;
+
+int aff_placement_valid(const char *policy);
+
+//> Returns `nthreads` CPUs, the one of thread i at index i.
+aff_cpu_t *aff_placement(const char *policy, unsigned int nthreads,
+                         aff_topology_t *topo);
+
 #endif /* __AFF_H */
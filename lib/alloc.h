@@ -13,4 +13,13 @@
 		} \
 	} while(0)
 
+//> As XMALLOC(), for types aligned beyond what malloc() guarantees.
+#define XMALLOC_ALIGNED(var,N,align) \
+	do { \
+		if (posix_memalign((void **)&(var), align, N * sizeof(*(var)))) { \
+			fprintf(stderr, "Out of memory: %s:%d\n", __FILE__, __LINE__); \
+			exit(1); \
+		} \
+	} while(0)
+
 #endif /* ALLOC_H */
@@ -15,4 +15,85 @@
 #	define CACHE_LINE_SIZE 64
 #endif
 
+//> Hint to the processor that we are busy-waiting.
+#if defined(__x86_64__) || defined(__i386__)
+#	define CPU_RELAX() __asm__ __volatile__("pause" ::: "memory")
+#elif defined(__POWERPC__)
+#	define CPU_RELAX() __asm__ __volatile__("or 27,27,27" ::: "memory")
+#else
+#	define CPU_RELAX() __asm__ __volatile__("" ::: "memory")
+#endif
+
+//> Cheap timestamp for latency measurements, see latency.h for the units.
+#if defined(__x86_64__) || defined(__i386__)
+static inline unsigned long long read_tsc(void)
+{
+	unsigned int lo, hi;
+	__asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+	return (unsigned long long)hi << 32 | lo;
+}
+#elif defined(__POWERPC64__)
+static inline unsigned long long read_tsc(void)
+{
+	unsigned long long tb;
+	__asm__ __volatile__("mfspr %0, 268" : "=r"(tb)); //> Time base
+	return tb;
+}
+#else
+#	include <time.h>
+static inline unsigned long long read_tsc(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+/**
+ * read_tsc() that is not reordered with the memory accesses around it:
+ * those after read_tsc_before() happen after its timestamp, and those
+ * before read_tsc_after() before its timestamp. They bracket operations
+ * whose intervals are compared across threads (history.h).
+ **/
+#if defined(__x86_64__) || defined(__i386__)
+static inline unsigned long long read_tsc_before(void)
+{
+	unsigned int lo, hi;
+	__asm__ __volatile__("rdtsc\n\tlfence" : "=a"(lo), "=d"(hi) :: "memory");
+	return (unsigned long long)hi << 32 | lo;
+}
+static inline unsigned long long read_tsc_after(void)
+{
+	unsigned int lo, hi;
+	__asm__ __volatile__("mfence\n\tlfence\n\trdtsc" : "=a"(lo), "=d"(hi)
+	                     :: "memory");
+	return (unsigned long long)hi << 32 | lo;
+}
+#elif defined(__POWERPC64__)
+static inline unsigned long long read_tsc_before(void)
+{
+	unsigned long long tb;
+	__asm__ __volatile__("mfspr %0, 268\n\tisync" : "=r"(tb) :: "memory");
+	return tb;
+}
+static inline unsigned long long read_tsc_after(void)
+{
+	unsigned long long tb;
+	__asm__ __volatile__("sync\n\tmfspr %0, 268" : "=r"(tb) :: "memory");
+	return tb;
+}
+#else
+static inline unsigned long long read_tsc_before(void)
+{
+	unsigned long long t = read_tsc();
+	__sync_synchronize();
+	return t;
+}
+static inline unsigned long long read_tsc_after(void)
+{
+	__sync_synchronize();
+	return read_tsc();
+}
+#endif
+
 #endif /* _ARCH_H_ */
@@ -0,0 +1,175 @@
+#ifndef _BULK_LOAD_H_
+#define _BULK_LOAD_H_
+
+/**
+ * Parallel bottom-up construction of a balanced tree out of sorted keys.
+ *
+ * The tree over keys[lo, hi) has keys[bulk_load_mid(lo, hi)] at its root
+ * and the trees over the two halves as its children. The subtree sizes of
+ * a node differ by at most one, so all levels of the tree but the last are
+ * full and it is both a valid AVL and, with the last level red, a valid
+ * red-black tree.
+ *
+ * The subtrees at depth `levels` do not depend on each other. Each of the
+ * `nthreads` threads that call rbt_bulk_load() builds every nthreads-th of
+ * them out of its own nodes, so the nodes are spread over the NUMA nodes of
+ * the threads by first touch. One thread then builds the few levels above
+ * them and installs the root. An implementation looks like:
+ *
+ *   node *build(bl, tdata, lo, hi, depth, idx)
+ *     if (lo >= hi) return NULL;
+ *     if (bulk_load_is_built(bl, depth)) return bl->roots[idx];
+ *     mid = bulk_load_mid(lo, hi);
+ *     node = new node with key bl->keys[mid];
+ *     node->left = build(bl, tdata, lo, mid, depth + 1, 2 * idx);
+ *     node->right = build(bl, tdata, mid + 1, hi, depth + 1, 2 * idx + 1);
+ *
+ *   rbt_bulk_load(rbt, tdata, bl, tid)
+ *     for (i = tid; i < bulk_load_nr_subtrees(bl); i += bl->nthreads)
+ *       bulk_load_subtree_range(bl, i, &lo, &hi);
+ *       bl->roots[i] = build(bl, tdata, lo, hi, bl->levels, i);
+ *     if (bulk_load_join(bl))
+ *       rbt->root = build(bl, tdata, 0, bl->nr_keys, 0, 0);
+ *     bulk_load_wait(bl);
+ **/
+
+#include <pthread.h>
+
+#include "alloc.h" /* XMALLOC() */
+#include "key.h"   /* map_key_t */
+
+//> Subtrees built in parallel per thread, more of them balance the load.
+#define BULK_LOAD_SUBTREES_PER_THREAD 4
+
+typedef struct {
+	map_key_t *keys;
+	int nr_keys, nthreads;
+
+	//> Depth of the subtrees built in parallel, and their roots.
+	int levels;
+	void **roots;
+	//> Set once all subtrees are built.
+	int top;
+
+	pthread_barrier_t barrier;
+} bulk_load_t;
+
+static inline int bulk_load_nr_subtrees(bulk_load_t *bl)
+{
+	return 1 << bl->levels;
+}
+
+//> `keys` are sorted and distinct. `nthreads` threads call rbt_bulk_load().
+static inline bulk_load_t *bulk_load_new(map_key_t *keys, int nr_keys,
+                                         int nthreads)
+{
+	bulk_load_t *bl;
+
+	XMALLOC(bl, 1);
+	bl->keys = keys;
+	bl->nr_keys = nr_keys;
+	bl->nthreads = nthreads;
+	bl->top = 0;
+	for (bl->levels = 0;
+	     (1 << bl->levels) < BULK_LOAD_SUBTREES_PER_THREAD * nthreads;
+	     bl->levels++)
+		;
+	XMALLOC(bl->roots, bulk_load_nr_subtrees(bl));
+	pthread_barrier_init(&bl->barrier, NULL, nthreads);
+	return bl;
+}
+
+//> Once the tree is complete. The keys belong to the caller.
+static inline void bulk_load_free(bulk_load_t *bl)
+{
+	pthread_barrier_destroy(&bl->barrier);
+	free(bl->roots);
+	free(bl);
+}
+
+static inline int bulk_load_mid(int lo, int hi)
+{
+	return lo + (hi - lo) / 2;
+}
+
+//> Keys [lo, hi) of the subtree `idx` at depth `levels`, left to right.
+static inline void bulk_load_subtree_range(bulk_load_t *bl, int idx,
+                                           int *lo, int *hi)
+{
+	int d, mid;
+
+	*lo = 0;
+	*hi = bl->nr_keys;
+	for (d=bl->levels - 1; d >= 0 && *lo < *hi; d--) {
+		mid = bulk_load_mid(*lo, *hi);
+		if (idx >> d & 1)
+			*lo = mid + 1;
+		else
+			*hi = mid;
+	}
+}
+
+/**
+ * The same for external (leaf-oriented) trees, where the routing node over
+ * keys[lo, hi) has key keys[bulk_load_mid(lo, hi)] and the trees over
+ * [lo, mid) and [mid, hi) as children, and single keys are leaves. The
+ * range is empty if a leaf is reached above depth `levels`.
+ **/
+static inline void bulk_load_leaf_range(bulk_load_t *bl, int idx,
+                                        int *lo, int *hi)
+{
+	int d, mid;
+
+	*lo = 0;
+	*hi = bl->nr_keys;
+	for (d=bl->levels - 1; d >= 0; d--) {
+		if (*hi - *lo < 2) {
+			*lo = *hi;
+			break;
+		}
+		mid = bulk_load_mid(*lo, *hi);
+		if (idx >> d & 1)
+			*lo = mid;
+		else
+			*hi = mid;
+	}
+}
+
+//> Whether the node at `depth` is the root of an already built subtree.
+static inline int bulk_load_is_built(bulk_load_t *bl, int depth)
+{
+	return bl->top && depth == bl->levels;
+}
+
+/**
+ * Waits for all threads to build their subtrees. Returns 1 in exactly one
+ * of them, which is to build the top of the tree.
+ **/
+static inline int bulk_load_join(bulk_load_t *bl)
+{
+	if (pthread_barrier_wait(&bl->barrier) != PTHREAD_BARRIER_SERIAL_THREAD)
+		return 0;
+	bl->top = 1;
+	return 1;
+}
+
+//> Waits until the root is installed.
+static inline void bulk_load_wait(bulk_load_t *bl)
+{
+	pthread_barrier_wait(&bl->barrier);
+}
+
+/**
+ * Full levels of the tree. With a partial last level, its nodes are at
+ * this depth and are the red ones of a red-black tree.
+ **/
+static inline int bulk_load_full_levels(bulk_load_t *bl)
+{
+	int l = 0;
+
+	while ((2LL << l) - 1 <= bl->nr_keys)
+		l++;
+	return l;
+}
+
+#endif /* _BULK_LOAD_H_ */
@@ -3,7 +3,16 @@
 #include <unistd.h>
 #include <assert.h>
 #include <getopt.h>
+#include <string.h>
 #include "clargs.h"
+#include "keydist.h"
+#include "rng.h"
+#include "record.h"
+#include "aff.h"
+#include "history.h"
+#if defined(RBT_REGISTRY)
+#	include "rbt/registry.h"
+#endif
 
 /* Default command line arguments */
 #define ARGUMENT_DEFAULT_NUM_THREADS 1
@@ -11,15 +20,56 @@
 #define ARGUMENT_DEFAULT_MAX_KEY (2 * ARGUMENT_DEFAULT_INIT_TREE_SIZE) 
 #define ARGUMENT_DEFAULT_LOOKUP_FRAC 0
 #define ARGUMENT_DEFAULT_INSERT_FRAC 50
+#define ARGUMENT_DEFAULT_RANGE_FRAC 0
+#define ARGUMENT_DEFAULT_RANGE_LEN 100
+#define ARGUMENT_DEFAULT_UPDATE_FRAC 0
 #define ARGUMENT_DEFAULT_INIT_SEED 1024
 #define ARGUMENT_DEFAULT_THREAD_SEED 128
-#ifdef WORKLOAD_TIME
+#define ARGUMENT_DEFAULT_KEY_DIST "uniform"
+#define ARGUMENT_DEFAULT_ZIPF_THETA 0.99
+#define ARGUMENT_DEFAULT_HOT_OPS_FRAC 90
+#define ARGUMENT_DEFAULT_HOT_KEYS_FRAC 10
+#define ARGUMENT_DEFAULT_RNG "drand48"
+#define ARGUMENT_DEFAULT_OP_STREAM 0
+#define ARGUMENT_DEFAULT_TRACE NULL
+#define ARGUMENT_DEFAULT_TRACE_MODE "partition"
+#define ARGUMENT_DEFAULT_TRACE_OUT NULL
+//> Open-loop runs are about latency, and pace themselves with read_tsc()
+//> anyway, so they time every operation by default.
+#if defined(WORKLOAD_RATE)
+#define ARGUMENT_DEFAULT_LAT_SAMPLE 1
+#else
+#define ARGUMENT_DEFAULT_LAT_SAMPLE 0
+#endif
+#define ARGUMENT_DEFAULT_SAMPLE_MS 0
+#define ARGUMENT_DEFAULT_PERF_COUNTERS 0
+#define ARGUMENT_DEFAULT_TX_POLICY "fixed"
+#define ARGUMENT_DEFAULT_BULK_LOAD 0
+#define ARGUMENT_DEFAULT_PLACEMENT "compact"
+#define ARGUMENT_DEFAULT_OUTPUT_FORMAT "text"
+#define ARGUMENT_DEFAULT_CHECK 0
+#define ARGUMENT_DEFAULT_STRESS 0
+#if defined(TX_NUM_RETRIES)
+#define ARGUMENT_DEFAULT_TX_RETRIES TX_NUM_RETRIES
+#else
+#define ARGUMENT_DEFAULT_TX_RETRIES 20
+#endif
+#if defined(WORKLOAD_TIME) || defined(WORKLOAD_RATE)
 #define ARGUMENT_DEFAULT_RUN_TIME_SEC 5
 #elif defined WORKLOAD_FIXED
 #define ARGUMENT_DEFAULT_NR_OPERATIONS 1000000
 #endif
+#if defined(WORKLOAD_RATE)
+#define ARGUMENT_DEFAULT_RATE 1000000.0
+#endif
+#if defined(WORKLOAD_TIME)
+#define ARGUMENT_DEFAULT_PHASES NULL
+#endif
+#if defined(RBT_REGISTRY)
+#define ARGUMENT_DEFAULT_IMPL "avl.int.rcu_htm"
+#endif
 
-static char *opt_string = "ht:s:m:i:l:r:e:j:o:";
+static char *opt_string = "ht:s:m:i:l:a:n:u:r:e:j:o:d:z:H:K:g:O:T:M:W:L:S:C:P:R:b:p:F:q:x:I:c:X:";
 static struct option long_options[] = {
 	{ "help",            no_argument,       NULL, 'h' },
 	{ "num-threads",     required_argument, NULL, 't' },
@@ -27,15 +77,46 @@ static struct option long_options[] = {
 	{ "max-key",         required_argument, NULL, 'm' },
 	{ "lookup-frac",     required_argument, NULL, 'l' },
 	{ "insert-frac",     required_argument, NULL, 'i' },
+	{ "range-frac",      required_argument, NULL, 'a' },
+	{ "range-len",       required_argument, NULL, 'n' },
+	{ "update-frac",     required_argument, NULL, 'u' },
 	/* FIXME better short options for these, or no short */
 	{ "init-seed",       required_argument, NULL, 'e' },
 	{ "thread-seed",     required_argument, NULL, 'j' },
+	{ "key-dist",        required_argument, NULL, 'd' },
+	{ "zipf-theta",      required_argument, NULL, 'z' },
+	{ "hot-ops-frac",    required_argument, NULL, 'H' },
+	{ "hot-keys-frac",   required_argument, NULL, 'K' },
+	{ "rng",             required_argument, NULL, 'g' },
+	{ "op-stream",       required_argument, NULL, 'O' },
+	{ "trace",           required_argument, NULL, 'T' },
+	{ "trace-mode",      required_argument, NULL, 'M' },
+	{ "trace-out",       required_argument, NULL, 'W' },
+	{ "lat-sample",      required_argument, NULL, 'L' },
+	{ "sample-ms",       required_argument, NULL, 'S' },
+	{ "perf-counters",   required_argument, NULL, 'C' },
+	{ "tx-policy",       required_argument, NULL, 'P' },
+	{ "tx-retries",      required_argument, NULL, 'R' },
+	{ "bulk-load",       required_argument, NULL, 'b' },
+	{ "placement",       required_argument, NULL, 'p' },
+	{ "output-format",   required_argument, NULL, 'F' },
+	{ "check",           required_argument, NULL, 'c' },
+	{ "stress",          required_argument, NULL, 'X' },
 
 #	if defined(WORKLOAD_FIXED)
 	{ "nr-operations",   required_argument, NULL, 'o' },
-#	elif defined(WORKLOAD_TIME)
+#	elif defined(WORKLOAD_TIME) || defined(WORKLOAD_RATE)
 	{ "run-time-sec",    required_argument, NULL, 'r' },
 #	endif
+#	if defined(WORKLOAD_RATE)
+	{ "rate",            required_argument, NULL, 'q' },
+#	endif
+#	if defined(WORKLOAD_TIME)
+	{ "phases",          required_argument, NULL, 'x' },
+#	endif
+#	if defined(RBT_REGISTRY)
+	{ "impl",            required_argument, NULL, 'I' },
+#	endif
 
 	{ NULL, 0, NULL, 0 }
 };
@@ -43,15 +124,46 @@ static struct option long_options[] = {
 clargs_t clargs = {
 	ARGUMENT_DEFAULT_NUM_THREADS,
 	ARGUMENT_DEFAULT_INIT_TREE_SIZE,
-	ARGUMENT_DEFAULT_MAX_KEY,
 	ARGUMENT_DEFAULT_LOOKUP_FRAC,
 	ARGUMENT_DEFAULT_INSERT_FRAC,
+	ARGUMENT_DEFAULT_RANGE_FRAC,
+	ARGUMENT_DEFAULT_RANGE_LEN,
+	ARGUMENT_DEFAULT_UPDATE_FRAC,
 	ARGUMENT_DEFAULT_INIT_SEED,
 	ARGUMENT_DEFAULT_THREAD_SEED,
-#	ifdef WORKLOAD_TIME
-	ARGUMENT_DEFAULT_RUN_TIME_SEC
+	ARGUMENT_DEFAULT_MAX_KEY,
+	ARGUMENT_DEFAULT_KEY_DIST,
+	ARGUMENT_DEFAULT_ZIPF_THETA,
+	ARGUMENT_DEFAULT_HOT_OPS_FRAC,
+	ARGUMENT_DEFAULT_HOT_KEYS_FRAC,
+	ARGUMENT_DEFAULT_RNG,
+	ARGUMENT_DEFAULT_OP_STREAM,
+	ARGUMENT_DEFAULT_TRACE,
+	ARGUMENT_DEFAULT_TRACE_MODE,
+	ARGUMENT_DEFAULT_TRACE_OUT,
+	ARGUMENT_DEFAULT_LAT_SAMPLE,
+	ARGUMENT_DEFAULT_SAMPLE_MS,
+	ARGUMENT_DEFAULT_PERF_COUNTERS,
+	ARGUMENT_DEFAULT_TX_POLICY,
+	ARGUMENT_DEFAULT_TX_RETRIES,
+	ARGUMENT_DEFAULT_BULK_LOAD,
+	ARGUMENT_DEFAULT_PLACEMENT,
+	ARGUMENT_DEFAULT_OUTPUT_FORMAT,
+	ARGUMENT_DEFAULT_CHECK,
+	ARGUMENT_DEFAULT_STRESS,
+#	if defined(WORKLOAD_TIME) || defined(WORKLOAD_RATE)
+	ARGUMENT_DEFAULT_RUN_TIME_SEC,
 #	elif defined(WORKLOAD_FIXED)
-	ARGUMENT_DEFAULT_NR_OPERATIONS
+	ARGUMENT_DEFAULT_NR_OPERATIONS,
+#	endif
+#	if defined(WORKLOAD_RATE)
+	ARGUMENT_DEFAULT_RATE,
+#	endif
+#	if defined(WORKLOAD_TIME)
+	ARGUMENT_DEFAULT_PHASES,
+#	endif
+#	if defined(RBT_REGISTRY)
+	ARGUMENT_DEFAULT_IMPL,
 #	endif
 };
 
@@ -65,20 +177,66 @@ static void clargs_print_usage(char *progname)
 	       "    -m,--max-key  max key to lookup,insert,delete [%d]\n"
 	       "    -l,--lookup-frac  lookup fraction of operations [%d%%]\n"
 	       "    -i,--insert-frac  insert fraction of operations [%d%%]\n"
+	       "    -a,--range-frac  range query fraction of operations [%d%%]\n"
+	       "    -n,--range-len  number of keys in [lo, lo+range-len) range queries [%d]\n"
+	       "    -u,--update-frac  in place value update fraction of operations [%d%%]\n"
 	       "    -e,--init-seed    the seed that is used for the tree initializion [%d]\n"
-	       "    -j,--thread-seed  the seed that is used for the thread operations [%d]\n",
+	       "    -j,--thread-seed  the seed that is used for the thread operations [%d]\n"
+	       "    -d,--key-dist  key distribution (uniform|zipf|hotspot|latest|seq) [%s]\n"
+	       "    -z,--zipf-theta  skew of the zipf and latest distributions, in (0, 1) [%.2lf]\n"
+	       "    -H,--hot-ops-frac  hotspot: fraction of operations on the hot keys [%d%%]\n"
+	       "    -K,--hot-keys-frac  hotspot: fraction of the key space that is hot [%d%%]\n"
+	       "    -g,--rng  random number generator of the threads (drand48|xoshiro) [%s]\n"
+	       "    -O,--op-stream  pregenerate N operations per thread and replay them, 0 for none [%d]\n"
+	       "    -T,--trace  replay the operations and keys of a trace file [none]\n"
+	       "    -M,--trace-mode  threads replay their own part of the trace or share it (partition|shared) [%s]\n"
+	       "    -W,--trace-out  write the streams of --op-stream to a trace file [none]\n"
+	       "    -L,--lat-sample  time one in N operations for latency percentiles, 0 for none [%d]\n"
+	       "    -S,--sample-ms  print a throughput time series with this period, 0 for none [%d]\n"
+	       "    -C,--perf-counters  count cycles, cache/TLB misses and TSX events per thread (0|1) [%d]\n"
+	       "    -P,--tx-policy  transactional retry policy (fixed|adaptive) [%s]\n"
+	       "    -R,--tx-retries  max transactional attempts before the fallback [%d]\n"
+	       "    -b,--bulk-load  build the initial tree bottom-up with all threads (0|1) [%d]\n"
+	       "    -p,--placement  thread placement (compact|scatter|cores|list, list reads MT_CONF) [%s]\n"
+	       "    -F,--output-format  also print the results as one record (text|json|csv) [%s]\n"
+	       "    -c,--check  log up to N operations per thread and check they are linearizable, 0 for none [%d]\n"
+	       "    -X,--stress  run N short checked rounds on random small key ranges and mixes, 0 for none [%d]\n",
 	       progname, ARGUMENT_DEFAULT_NUM_THREADS, ARGUMENT_DEFAULT_INIT_TREE_SIZE,
 	       ARGUMENT_DEFAULT_MAX_KEY, ARGUMENT_DEFAULT_LOOKUP_FRAC, 
 	       ARGUMENT_DEFAULT_INSERT_FRAC,
-	       ARGUMENT_DEFAULT_INIT_SEED, ARGUMENT_DEFAULT_THREAD_SEED);
+	       ARGUMENT_DEFAULT_RANGE_FRAC, ARGUMENT_DEFAULT_RANGE_LEN,
+	       ARGUMENT_DEFAULT_UPDATE_FRAC,
+	       ARGUMENT_DEFAULT_INIT_SEED, ARGUMENT_DEFAULT_THREAD_SEED,
+	       ARGUMENT_DEFAULT_KEY_DIST, ARGUMENT_DEFAULT_ZIPF_THETA,
+	       ARGUMENT_DEFAULT_HOT_OPS_FRAC, ARGUMENT_DEFAULT_HOT_KEYS_FRAC,
+	       ARGUMENT_DEFAULT_RNG, ARGUMENT_DEFAULT_OP_STREAM,
+	       ARGUMENT_DEFAULT_TRACE_MODE,
+	       ARGUMENT_DEFAULT_LAT_SAMPLE, ARGUMENT_DEFAULT_SAMPLE_MS,
+	       ARGUMENT_DEFAULT_PERF_COUNTERS,
+	       ARGUMENT_DEFAULT_TX_POLICY, ARGUMENT_DEFAULT_TX_RETRIES,
+	       ARGUMENT_DEFAULT_BULK_LOAD, ARGUMENT_DEFAULT_PLACEMENT,
+	       ARGUMENT_DEFAULT_OUTPUT_FORMAT,
+	       ARGUMENT_DEFAULT_CHECK, ARGUMENT_DEFAULT_STRESS);
 
-#	ifdef WORKLOAD_TIME
+#	if defined(WORKLOAD_TIME) || defined(WORKLOAD_RATE)
 	printf("    -r,--run-time-sec execution time [%d sec]\n",
 	        ARGUMENT_DEFAULT_RUN_TIME_SEC);
 #	elif defined(WORKLOAD_FIXED)
 	printf("    -o,--nr-operations number of operations to execute [%d]\n",
 	        ARGUMENT_DEFAULT_NR_OPERATIONS);
 #	endif
+#	if defined(WORKLOAD_RATE)
+	printf("    -q,--rate target operations per second, of all threads together [%.0lf]\n",
+	        ARGUMENT_DEFAULT_RATE);
+#	endif
+#	if defined(WORKLOAD_TIME)
+	printf("    -x,--phases run phases \"SEC[:l=,a=,u=,i=,d=,t=];...\" one after the other, instead of one of run-time-sec [none]\n");
+#	endif
+#	if defined(RBT_REGISTRY)
+	printf("    -I,--impl  comma separated trees to run one after the other (");
+	rbt_impl_print_list(stdout);
+	printf(") [%s]\n", ARGUMENT_DEFAULT_IMPL);
+#	endif
 }
 
 void clargs_init(int argc, char **argv)
@@ -103,7 +261,7 @@ void clargs_init(int argc, char **argv)
 			clargs.init_tree_size = atoi(optarg);
 			break;
 		case 'm':
-			clargs.max_key = atoi(optarg);
+			clargs.max_key = atoll(optarg);
 			break;
 		case 'l':
 			clargs.lookup_frac = atoi(optarg);
@@ -111,19 +269,100 @@ void clargs_init(int argc, char **argv)
 		case 'i':
 			clargs.insert_frac = atoi(optarg);
 			break;
+		case 'a':
+			clargs.range_frac = atoi(optarg);
+			break;
+		case 'n':
+			clargs.range_len = atoi(optarg);
+			break;
+		case 'u':
+			clargs.update_frac = atoi(optarg);
+			break;
 		case 'e':
 			clargs.init_seed = atoi(optarg);
 			break;
 		case 'j':
 			clargs.thread_seed = atoi(optarg);
 			break;
-#		ifdef WORKLOAD_TIME
+		case 'd':
+			clargs.key_dist = optarg;
+			break;
+		case 'z':
+			clargs.zipf_theta = atof(optarg);
+			break;
+		case 'H':
+			clargs.hot_ops_frac = atoi(optarg);
+			break;
+		case 'K':
+			clargs.hot_keys_frac = atoi(optarg);
+			break;
+		case 'g':
+			clargs.rng = optarg;
+			break;
+		case 'O':
+			clargs.op_stream = atoi(optarg);
+			break;
+		case 'T':
+			clargs.trace = optarg;
+			break;
+		case 'M':
+			clargs.trace_mode = optarg;
+			break;
+		case 'W':
+			clargs.trace_out = optarg;
+			break;
+		case 'L':
+			clargs.lat_sample = atoi(optarg);
+			break;
+		case 'S':
+			clargs.sample_ms = atoi(optarg);
+			break;
+		case 'C':
+			clargs.perf_counters = atoi(optarg);
+			break;
+		case 'P':
+			clargs.tx_policy = optarg;
+			break;
+		case 'R':
+			clargs.tx_retries = atoi(optarg);
+			break;
+		case 'b':
+			clargs.bulk_load = atoi(optarg);
+			break;
+		case 'p':
+			clargs.placement = optarg;
+			break;
+		case 'F':
+			clargs.output_format = optarg;
+			break;
+		case 'c':
+			clargs.check = atoi(optarg);
+			break;
+		case 'X':
+			clargs.stress = atoi(optarg);
+			break;
+#		if defined(WORKLOAD_TIME) || defined(WORKLOAD_RATE)
 		case 'r':
 			clargs.run_time_sec = atoi(optarg);
 			break;
 #		elif defined(WORKLOAD_FIXED)
 		case 'o':
-			clargs.nr_operations = atoi(optarg);
+			clargs.nr_operations = atoll(optarg);
+			break;
+#		endif
+#		if defined(WORKLOAD_RATE)
+		case 'q':
+			clargs.rate = atof(optarg);
+			break;
+#		endif
+#		if defined(WORKLOAD_TIME)
+		case 'x':
+			clargs.phases = optarg;
+			break;
+#		endif
+#		if defined(RBT_REGISTRY)
+		case 'I':
+			clargs.impl = optarg;
 			break;
 #		endif
 		default:
@@ -133,7 +372,45 @@ void clargs_init(int argc, char **argv)
 	}
 
 	/* Sanity checks. */
-	assert(clargs.lookup_frac + clargs.insert_frac <= 100);
+	assert(clargs.lookup_frac + clargs.range_frac + clargs.update_frac +
+	       clargs.insert_frac <= 100);
+	assert(clargs.max_key > 0);
+	assert(clargs.range_len > 0);
+	assert(keydist_parse(clargs.key_dist) >= 0);
+	assert(clargs.zipf_theta > 0 && clargs.zipf_theta < 1);
+	assert(clargs.hot_ops_frac >= 0 && clargs.hot_ops_frac <= 100);
+	assert(clargs.hot_keys_frac > 0 && clargs.hot_keys_frac <= 100);
+	assert(rng_parse(clargs.rng) >= 0);
+	assert(clargs.op_stream >= 0);
+	//> latest follows the insertions as they happen, it cannot be replayed.
+	assert(!clargs.op_stream ||
+	       keydist_parse(clargs.key_dist) != KEY_DIST_LATEST);
+	assert(!strcmp(clargs.trace_mode, "partition") ||
+	       !strcmp(clargs.trace_mode, "shared"));
+	assert(!clargs.trace || !clargs.op_stream);
+	assert(!clargs.trace_out || clargs.op_stream > 0);
+	assert(clargs.lat_sample >= 0);
+	assert(clargs.sample_ms >= 0);
+	assert(clargs.perf_counters == 0 || clargs.perf_counters == 1);
+	assert(clargs.tx_retries >= 0);
+#	if defined(WORKLOAD_RATE)
+	assert(clargs.rate > 0);
+#	endif
+#	if defined(WORKLOAD_TIME)
+	//> Both are drawn or recorded with the mix of the command line.
+	assert(!clargs.phases || (!clargs.trace && !clargs.op_stream));
+#	endif
+	assert(!strcmp(clargs.tx_policy, "fixed") ||
+	       !strcmp(clargs.tx_policy, "adaptive"));
+	assert(clargs.bulk_load == 0 || clargs.bulk_load == 1);
+	assert(!clargs.bulk_load || clargs.init_tree_size <= clargs.max_key);
+	assert(aff_placement_valid(clargs.placement));
+	assert(record_format_parse(clargs.output_format) >= 0);
+	assert(clargs.check >= 0);
+	//> The initial key set of the check is a bitmap of [0, max_key), and
+	//> trace keys need not be in it.
+	assert(!clargs.check || (clargs.max_key <= HISTORY_MAX_KEY && !clargs.trace));
+	assert(clargs.stress >= 0);
 }
 
 void clargs_print()
@@ -142,20 +419,110 @@ void clargs_print()
 	       "====================\n"
 	       "  num_threads: %d\n"
 	       "  init_tree_size: %d\n"
-	       "  max_key: %d\n"
+	       "  max_key: %lld\n"
 	       "  lookup_frac: %d\n"
 	       "  insert_frac: %d\n"
+	       "  range_frac: %d\n"
+	       "  range_len: %d\n"
+	       "  update_frac: %d\n"
 	       "  init_seed: %d\n"
-	       "  thread_seed: %d\n",
+	       "  thread_seed: %d\n"
+	       "  key_dist: %s (zipf_theta: %.2lf, hot_ops/keys_frac: %d/%d)\n"
+	       "  rng: %s\n"
+	       "  op_stream: %d\n"
+	       "  trace: %s (%s)\n"
+	       "  trace_out: %s\n"
+	       "  lat_sample: %d\n"
+	       "  sample_ms: %d\n"
+	       "  perf_counters: %d\n"
+	       "  tx_policy: %s\n"
+	       "  tx_retries: %d\n"
+	       "  bulk_load: %d\n"
+	       "  placement: %s\n"
+	       "  output_format: %s\n"
+	       "  check: %d\n"
+	       "  stress: %d\n",
 	       clargs.num_threads, clargs.init_tree_size, clargs.max_key,
 	       clargs.lookup_frac, clargs.insert_frac,
-	       clargs.init_seed, clargs.thread_seed);
+	       clargs.range_frac, clargs.range_len, clargs.update_frac,
+	       clargs.init_seed, clargs.thread_seed,
+	       clargs.key_dist, clargs.zipf_theta,
+	       clargs.hot_ops_frac, clargs.hot_keys_frac,
+	       clargs.rng, clargs.op_stream,
+	       clargs.trace ? clargs.trace : "none", clargs.trace_mode,
+	       clargs.trace_out ? clargs.trace_out : "none",
+	       clargs.lat_sample, clargs.sample_ms, clargs.perf_counters,
+	       clargs.tx_policy, clargs.tx_retries, clargs.bulk_load,
+	       clargs.placement,
+	       clargs.output_format, clargs.check, clargs.stress);
 
-#	ifdef WORKLOAD_TIME
+#	if defined(WORKLOAD_TIME) || defined(WORKLOAD_RATE)
 	printf("  run_time_sec: %d\n", clargs.run_time_sec);
 #	elif defined(WORKLOAD_FIXED)
-	printf("  nr_operations: %d\n", clargs.nr_operations);
+	printf("  nr_operations: %lld\n", clargs.nr_operations);
+#	endif
+#	if defined(WORKLOAD_RATE)
+	printf("  rate: %.0lf ops/sec\n", clargs.rate);
+#	endif
+#	if defined(WORKLOAD_TIME)
+	if (clargs.phases)
+		printf("  phases: %s\n", clargs.phases);
+#	endif
+#	if defined(RBT_REGISTRY)
+	printf("  impl: %s\n", clargs.impl);
 #	endif
 
 	printf("\n");
 }
+
+void clargs_record()
+{
+	record_object("inputs");
+	record_int("num_threads", clargs.num_threads);
+	record_int("init_tree_size", clargs.init_tree_size);
+	record_int("max_key", clargs.max_key);
+	record_int("lookup_frac", clargs.lookup_frac);
+	record_int("insert_frac", clargs.insert_frac);
+	record_int("range_frac", clargs.range_frac);
+	record_int("range_len", clargs.range_len);
+	record_int("update_frac", clargs.update_frac);
+	record_int("init_seed", clargs.init_seed);
+	record_int("thread_seed", clargs.thread_seed);
+	record_str("key_dist", clargs.key_dist);
+	record_double("zipf_theta", clargs.zipf_theta);
+	record_int("hot_ops_frac", clargs.hot_ops_frac);
+	record_int("hot_keys_frac", clargs.hot_keys_frac);
+	record_str("rng", clargs.rng);
+	record_int("op_stream", clargs.op_stream);
+	if (clargs.trace) {
+		record_str("trace", clargs.trace);
+		record_str("trace_mode", clargs.trace_mode);
+	}
+	if (clargs.trace_out)
+		record_str("trace_out", clargs.trace_out);
+	record_int("lat_sample", clargs.lat_sample);
+	record_int("sample_ms", clargs.sample_ms);
+	record_int("perf_counters", clargs.perf_counters);
+	record_str("tx_policy", clargs.tx_policy);
+	record_int("tx_retries", clargs.tx_retries);
+	record_int("bulk_load", clargs.bulk_load);
+	record_str("placement", clargs.placement);
+	record_int("check", clargs.check);
+	record_int("stress", clargs.stress);
+#	if defined(WORKLOAD_TIME) || defined(WORKLOAD_RATE)
+	record_int("run_time_sec", clargs.run_time_sec);
+#	elif defined(WORKLOAD_FIXED)
+	record_int("nr_operations", clargs.nr_operations);
+#	endif
+#	if defined(WORKLOAD_RATE)
+	record_double("rate", clargs.rate);
+#	endif
+#	if defined(WORKLOAD_TIME)
+	if (clargs.phases)
+		record_str("phases", clargs.phases);
+#	endif
+#	if defined(RBT_REGISTRY)
+	record_str("impl", clargs.impl);
+#	endif
+	record_close();
+}
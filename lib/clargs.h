@@ -4,21 +4,93 @@
 typedef struct {
 	int num_threads,
 	    init_tree_size,
-	    max_key,
 	    lookup_frac,
 		insert_frac,
+	    range_frac,
+	    range_len,
+	    update_frac,
 	    init_seed,
 	    thread_seed;
+	//> Keys are drawn from [0, max_key), see KEY_BITS in key.h.
+	long long max_key;
 
-#	ifdef WORKLOAD_TIME
+	//> Key distribution of the operations and its parameters, see keydist.h.
+	char *key_dist;
+	double zipf_theta;
+	int hot_ops_frac,
+	    hot_keys_frac;
+
+	//> Random number generator of the threads, see rng.h.
+	char *rng;
+	//> Length of the (operation, key) stream each thread generates before
+	//> the start and then replays cyclically, 0 draws them while running.
+	int op_stream;
+
+	//> Replay the operations and keys of a trace file instead of drawing
+	//> them, each thread its own "partition" or all from a "shared" cursor.
+	//> --trace-out writes the streams of --op-stream to a trace file.
+	//> NULL if not given, see trace.h.
+	char *trace,
+	     *trace_mode,
+	     *trace_out;
+
+	//> Time one in lat_sample operations for the latency histograms, 0
+	//> disables timing altogether.
+	int lat_sample;
+
+	//> Period of the throughput time series in msec, 0 disables it.
+	int sample_ms;
+
+	//> Count hardware events of every thread during the run, see perf.h.
+	int perf_counters;
+
+	//> Transactional retry policy ("fixed" or "adaptive") and the maximum
+	//> number of transactional attempts before taking the fallback lock.
+	char *tx_policy;
+	int tx_retries;
+
+	//> Build the initial tree bottom-up by all threads, instead of
+	//> inserting its keys one by one (see bulk_load.h).
+	int bulk_load;
+
+	//> Thread placement policy, see aff.h.
+	char *placement;
+
+	//> Format of the results: the human readable "text" report only, or
+	//> also one "json" or "csv" record on stdout (see record.h).
+	char *output_format;
+
+	//> Log the operations, up to `check` per thread, and check that they
+	//> are linearizable after the run (see history.h), 0 disables it.
+	int check;
+	//> Run `stress` rounds of short, high conflict runs with --check, on
+	//> random small key ranges and operation mixes, instead of one run.
+	int stress;
+
+#	if defined(WORKLOAD_TIME) || defined(WORKLOAD_RATE)
 	int run_time_sec;
 #	elif defined(WORKLOAD_FIXED)
-	int nr_operations;
+	long long nr_operations;
+#	endif
+#	if defined(WORKLOAD_RATE)
+	//> Target aggregate operations per second, arriving as a Poisson process.
+	double rate;
+#	endif
+#	if defined(WORKLOAD_TIME)
+	//> Phases of the run, see phase.h. NULL runs a single one of
+	//> run_time_sec with the arguments above.
+	char *phases;
+#	endif
+#	if defined(RBT_REGISTRY)
+	//> Comma separated ids of the trees to run in x.all, see registry.h.
+	char *impl;
 #	endif
 } clargs_t;
 extern clargs_t clargs;
 
 void clargs_init(int argc, char **argv);
 void clargs_print();
+//> Adds the inputs to the results record, as object "inputs".
+void clargs_record();
 
 #endif /* CLARGS_H_ */
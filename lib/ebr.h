@@ -0,0 +1,246 @@
+#ifndef _EBR_H_
+#define _EBR_H_
+
+/**
+ * Epoch-based memory reclamation.
+ *
+ * Every operation that dereferences shared nodes is enclosed in an
+ * ebr_enter()/ebr_exit() pair. Nodes that become unreachable (e.g., the
+ * original path of a committed RCU copy) are handed to ebr_retire() and
+ * given back through the thread's `free_fn` once the global epoch has
+ * advanced twice, i.e., once no thread can still hold a reference to them.
+ *
+ * Retired objects are kept in three per thread limbo lists, one for each of
+ * the last three epochs. Each thread only frees its own limbo lists, so
+ * `free_fn` can push into a thread-local pool without any synchronization.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch.h"  /* CACHE_LINE_SIZE */
+#include "alloc.h" /* XMALLOC() */
+
+#define EBR_MAX_THREADS 88
+#define EBR_NR_EPOCHS 3
+
+//> Try to advance the global epoch every that many retirements.
+#define EBR_ADVANCE_THRESHOLD 64
+
+#define EBR_LIMBO_INITIAL_CAPACITY 1024
+
+typedef void (ebr_free_fn_t)(void *obj, void *arg);
+
+typedef struct {
+	void **objs;
+	unsigned int len, capacity;
+} ebr_limbo_t;
+
+typedef struct {
+	//> The epoch this thread has observed, shifted left by one.
+	//> The lowest bit is set while the thread is inside a critical section.
+	volatile unsigned long local_epoch;
+	char padding[CACHE_LINE_SIZE - sizeof(unsigned long)];
+
+	unsigned long last_epoch;
+	unsigned int retired_since_advance;
+	ebr_limbo_t limbo[EBR_NR_EPOCHS];
+
+	ebr_free_fn_t *free_fn;
+	void *free_arg;
+
+	long long unsigned nr_retired, nr_reclaimed;
+} __attribute__((aligned(CACHE_LINE_SIZE))) ebr_thread_t;
+
+typedef struct {
+	volatile unsigned long global_epoch;
+	char padding[CACHE_LINE_SIZE - sizeof(unsigned long)];
+
+	int max_tid;
+	ebr_thread_t *threads[EBR_MAX_THREADS];
+} __attribute__((aligned(CACHE_LINE_SIZE))) ebr_t;
+
+#define EBR_ACTIVE 1UL
+
+static inline ebr_t *ebr_new()
+{
+	ebr_t *ret;
+
+	XMALLOC(ret, 1);
+	memset(ret, 0, sizeof(*ret));
+	ret->max_tid = -1;
+	return ret;
+}
+
+/**
+ * Registers thread `tid` with `ebr`. Threads with negative `tid` (e.g., the
+ * ones used only to accumulate statistics) are not registered and must not
+ * enter critical sections.
+ **/
+static inline ebr_thread_t *ebr_thread_new(ebr_t *ebr, int tid,
+                                           ebr_free_fn_t *free_fn, void *free_arg)
+{
+	ebr_thread_t *ret;
+	int i;
+
+	XMALLOC(ret, 1);
+	memset(ret, 0, sizeof(*ret));
+	ret->free_fn = free_fn;
+	ret->free_arg = free_arg;
+	for (i=0; i < EBR_NR_EPOCHS; i++) {
+		ret->limbo[i].capacity = EBR_LIMBO_INITIAL_CAPACITY;
+		XMALLOC(ret->limbo[i].objs, EBR_LIMBO_INITIAL_CAPACITY);
+	}
+
+	if (tid < 0)
+		return ret;
+
+	if (tid >= EBR_MAX_THREADS) {
+		fprintf(stderr, "ebr: tid %d exceeds EBR_MAX_THREADS (%d)\n",
+		        tid, EBR_MAX_THREADS);
+		exit(1);
+	}
+
+	ret->last_epoch = ebr->global_epoch;
+	ebr->threads[tid] = ret;
+	__sync_synchronize();
+	while (1) {
+		int max_tid = ebr->max_tid;
+		if (tid <= max_tid ||
+		    __sync_bool_compare_and_swap(&ebr->max_tid, max_tid, tid))
+			break;
+	}
+	return ret;
+}
+
+static inline void _ebr_limbo_free(ebr_thread_t *t, ebr_limbo_t *limbo)
+{
+	unsigned int i;
+
+	for (i=0; i < limbo->len; i++)
+		t->free_fn(limbo->objs[i], t->free_arg);
+	t->nr_reclaimed += limbo->len;
+	limbo->len = 0;
+}
+
+/**
+ * Called whenever thread `t` observes `epoch` as the global epoch.
+ * Objects retired two or more epochs ago can no longer be referenced.
+ **/
+static inline void _ebr_observe(ebr_thread_t *t, unsigned long epoch)
+{
+	int i;
+
+	if (epoch == t->last_epoch)
+		return;
+
+	if (epoch >= t->last_epoch + 2) {
+		for (i=0; i < EBR_NR_EPOCHS; i++)
+			_ebr_limbo_free(t, &t->limbo[i]);
+	} else {
+		_ebr_limbo_free(t, &t->limbo[(epoch + 1) % EBR_NR_EPOCHS]);
+	}
+	t->last_epoch = epoch;
+}
+
+static inline void _ebr_try_advance(ebr_t *ebr)
+{
+	unsigned long epoch = ebr->global_epoch;
+	int i;
+
+	for (i=0; i <= ebr->max_tid; i++) {
+		ebr_thread_t *t = ebr->threads[i];
+		if (!t)
+			continue;
+		unsigned long local = t->local_epoch;
+		if ((local & EBR_ACTIVE) && (local >> 1) != epoch)
+			return;
+	}
+
+	__sync_bool_compare_and_swap(&ebr->global_epoch, epoch, epoch + 1);
+}
+
+static inline void ebr_enter(ebr_t *ebr, ebr_thread_t *t)
+{
+	unsigned long epoch = ebr->global_epoch;
+
+	t->local_epoch = (epoch << 1) | EBR_ACTIVE;
+	__sync_synchronize();
+	_ebr_observe(t, epoch);
+}
+
+static inline void ebr_exit(ebr_t *ebr, ebr_thread_t *t)
+{
+	__atomic_store_n(&t->local_epoch, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Hands `obj` to the reclaimer. Must be called after `obj` has been made
+ * unreachable, from inside the critical section that unlinked it.
+ **/
+static inline void ebr_retire(ebr_t *ebr, ebr_thread_t *t, void *obj)
+{
+	unsigned long epoch = ebr->global_epoch;
+	ebr_limbo_t *limbo;
+
+	_ebr_observe(t, epoch);
+
+	limbo = &t->limbo[epoch % EBR_NR_EPOCHS];
+	if (limbo->len == limbo->capacity) {
+		limbo->capacity *= 2;
+		limbo->objs = realloc(limbo->objs, limbo->capacity * sizeof(void *));
+		if (!limbo->objs) {
+			fprintf(stderr, "Out of memory: %s:%d\n", __FILE__, __LINE__);
+			exit(1);
+		}
+	}
+	limbo->objs[limbo->len++] = obj;
+	t->nr_retired++;
+
+	if (++t->retired_since_advance >= EBR_ADVANCE_THRESHOLD) {
+		t->retired_since_advance = 0;
+		_ebr_try_advance(ebr);
+	}
+}
+
+/**
+ * Frees `ebr` and all of its threads, once none of them runs anymore. The
+ * objects still in the limbo lists are given back through `free_fn` first.
+ **/
+static inline void ebr_free(ebr_t *ebr)
+{
+	ebr_thread_t *t;
+	int i, j;
+
+	for (i=0; i <= ebr->max_tid; i++) {
+		if (!(t = ebr->threads[i]))
+			continue;
+		for (j=0; j < EBR_NR_EPOCHS; j++) {
+			_ebr_limbo_free(t, &t->limbo[j]);
+			free(t->limbo[j].objs);
+		}
+		free(t);
+	}
+	free(ebr);
+}
+
+//> Objects handed to ebr_retire() by `t` that have not been freed yet.
+static inline long long unsigned ebr_thread_pending(ebr_thread_t *t)
+{
+	return t->nr_retired - t->nr_reclaimed;
+}
+
+//> ebr_thread_pending() of all registered threads.
+static inline long long unsigned ebr_pending(ebr_t *ebr)
+{
+	long long unsigned ret = 0;
+	int i;
+
+	for (i=0; i <= ebr->max_tid; i++)
+		if (ebr->threads[i])
+			ret += ebr_thread_pending(ebr->threads[i]);
+	return ret;
+}
+
+#endif /* _EBR_H_ */
@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "history.h"
+
+//> The operations of at most so many keys that fail are printed.
+#define HISTORY_MAX_REPORTS 3
+#define HISTORY_MAX_REPORT_OPS 40
+
+static const char *history_op_names[] = {
+	[HISTORY_LOOKUP] = "lookup",
+	[HISTORY_INSERT] = "insert",
+	[HISTORY_DELETE] = "delete",
+};
+
+/**
+ * The search of one key. The key's operations by (local) thread t are
+ * ops[start[t], start[t+1]), in program order. A configuration is how many
+ * of its operations each thread has linearized, followed by whether the
+ * key is in the set: nthreads + 1 ints of the `configs` arena. The hash
+ * table holds their indices + 1, valid only if their `gen` is that of the
+ * current key, so that it need not be cleared between keys.
+ **/
+typedef struct {
+	history_event_t **ops;
+	long long *start;
+	int nthreads;
+
+	unsigned int *configs;
+	long long nr_configs, max_configs;
+
+	long long *table;
+	unsigned int *gen, cur_gen;
+	long long table_size;
+
+	struct search_frame {
+		long long config;
+		int next;  //> Next thread whose operation to try.
+	} *stack;
+	long long max_stack;
+} search_t;
+
+static unsigned long long config_hash(unsigned int *c, int width)
+{
+	unsigned long long h = 14695981039346656037ULL;
+	int i;
+
+	for (i=0; i < width; i++)
+		h = (h ^ c[i]) * 1099511628211ULL;
+	return h;
+}
+
+static void search_grow_table(search_t *s)
+{
+	long long i, j, old_size = s->table_size, *old_table = s->table;
+	unsigned int *old_gen = s->gen;
+	int width = s->nthreads + 1;
+
+	s->table_size = old_size ? 2 * old_size : 1024;
+	XMALLOC(s->table, s->table_size);
+	XMALLOC(s->gen, s->table_size);
+	memset(s->gen, 0, s->table_size * sizeof(*s->gen));
+	for (i=0; i < old_size; i++) {
+		if (old_gen[i] != s->cur_gen)
+			continue;
+		j = config_hash(&s->configs[(old_table[i] - 1) * width], width) &
+		    (s->table_size - 1);
+		while (s->gen[j] == s->cur_gen)
+			j = (j + 1) & (s->table_size - 1);
+		s->table[j] = old_table[i];
+		s->gen[j] = s->cur_gen;
+	}
+	free(old_table);
+	free(old_gen);
+}
+
+//> Adds configuration `c`, returns its index, or -1 if it was seen before.
+static long long search_add_config(search_t *s, unsigned int *c)
+{
+	int width = s->nthreads + 1;
+	long long j;
+
+	if (2 * (s->nr_configs + 1) > s->table_size)
+		search_grow_table(s);
+	j = config_hash(c, width) & (s->table_size - 1);
+	for (; s->gen[j] == s->cur_gen; j=(j + 1) & (s->table_size - 1))
+		if (!memcmp(&s->configs[(s->table[j] - 1) * width], c,
+		            width * sizeof(*c)))
+			return -1;
+
+	if (s->nr_configs == s->max_configs) {
+		s->max_configs = 2 * s->max_configs + 1024;
+		s->configs = realloc(s->configs,
+		                     s->max_configs * width * sizeof(*c));
+		if (!s->configs) {
+			fprintf(stderr, "Out of memory: %s:%d\n", __FILE__, __LINE__);
+			exit(1);
+		}
+	}
+	memcpy(&s->configs[s->nr_configs * width], c, width * sizeof(*c));
+	s->table[j] = ++s->nr_configs;
+	s->gen[j] = s->cur_gen;
+	return s->nr_configs - 1;
+}
+
+//> Applies `e` to `*present`, returns 0 if its result contradicts it.
+static inline int history_apply(history_event_t *e, unsigned int *present)
+{
+	switch (e->op) {
+	case HISTORY_INSERT:
+		if (e->ret == *present)
+			return 0;
+		*present = 1;
+		return 1;
+	case HISTORY_DELETE:
+		if (e->ret != *present)
+			return 0;
+		*present = 0;
+		return 1;
+	default:
+		return e->ret == *present;
+	}
+}
+
+/**
+ * Depth-first search for an order of the key's operations. Returns 1 if
+ * there is one, 0 if there is none and -1 if it gave up.
+ **/
+static int search_key(search_t *s, long long nr_ops, int initial)
+{
+	int width = s->nthreads + 1, t;
+	unsigned int c[width], *cur;
+	unsigned long long min_response;
+	history_event_t *e;
+	long long depth, idx = -1;
+
+	s->nr_configs = 0;
+	if (++s->cur_gen == 0) {
+		memset(s->gen, 0, s->table_size * sizeof(*s->gen));
+		s->cur_gen = 1;
+	}
+	if (nr_ops + 1 > s->max_stack) {
+		s->max_stack = nr_ops + 1;
+		free(s->stack);
+		XMALLOC(s->stack, s->max_stack);
+	}
+
+	memset(c, 0, sizeof(c));
+	c[s->nthreads] = initial;
+	s->stack[0].config = search_add_config(s, c);
+	s->stack[0].next = 0;
+	depth = 0;
+
+	while (depth >= 0) {
+		//> All of them are linearized.
+		if (depth == nr_ops)
+			return 1;
+		if (s->nr_configs > HISTORY_MAX_CONFIGS)
+			return -1;
+
+		cur = &s->configs[s->stack[depth].config * width];
+		//> Only operations that started before the first of the others
+		//> returned can go next.
+		min_response = ~0ULL;
+		for (t=0; t < s->nthreads; t++)
+			if (s->start[t] + cur[t] < s->start[t+1] &&
+			    s->ops[s->start[t] + cur[t]]->response < min_response)
+				min_response = s->ops[s->start[t] + cur[t]]->response;
+
+		for (t=s->stack[depth].next; t < s->nthreads; t++) {
+			if (s->start[t] + cur[t] == s->start[t+1])
+				continue;
+			e = s->ops[s->start[t] + cur[t]];
+			if (e->invoke > min_response)
+				continue;
+			memcpy(c, cur, sizeof(c));
+			if (!history_apply(e, &c[s->nthreads]))
+				continue;
+			c[t]++;
+			if ((idx = search_add_config(s, c)) < 0)
+				continue;
+			break;
+		}
+		s->stack[depth].next = t + 1;
+		if (t == s->nthreads) {
+			depth--;
+			continue;
+		}
+		depth++;
+		s->stack[depth].config = idx;
+		s->stack[depth].next = 0;
+	}
+	return 0;
+}
+
+static void report_key(long long key, history_event_t **ops, int *tids,
+                       long long nr_ops, int initial)
+{
+	unsigned long long t0 = ~0ULL;
+	long long i;
+
+	for (i=0; i < nr_ops; i++)
+		if (ops[i]->invoke < t0)
+			t0 = ops[i]->invoke;
+	printf("  Key %lld is not linearizable, initially %s, %lld operations "
+	       "(thread [invoke, response] in ticks):\n", key,
+	       initial ? "present" : "absent", nr_ops);
+	for (i=0; i < nr_ops && i < HISTORY_MAX_REPORT_OPS; i++)
+		printf("    %3d [%10llu, %10llu] %s -> %d\n", tids[i],
+		       ops[i]->invoke - t0, ops[i]->response - t0,
+		       history_op_names[ops[i]->op], ops[i]->ret);
+	if (nr_ops > HISTORY_MAX_REPORT_OPS)
+		printf("    ...\n");
+}
+
+int history_check(history_t *threads, int nthreads,
+                  const unsigned char *initial, long long max_key,
+                  history_result_t *res)
+{
+	history_event_t **ops, *e;
+	long long *offset, k, i, lo, hi;
+	int *tids, t, ret;
+	search_t s;
+
+	memset(res, 0, sizeof(*res));
+	memset(&s, 0, sizeof(s));
+	XMALLOC(s.start, (nthreads + 1));
+
+	//> Group the events by key, and within a key by thread in program
+	//> order (a stable counting sort).
+	XMALLOC(offset, (max_key + 1));
+	memset(offset, 0, (max_key + 1) * sizeof(*offset));
+	for (t=0; t < nthreads; t++) {
+		res->nr_events += threads[t].nr_events;
+		for (i=0; i < threads[t].nr_events; i++)
+			offset[threads[t].events[i].key + 1]++;
+	}
+	for (k=0; k < max_key; k++)
+		offset[k+1] += offset[k];
+	XMALLOC(ops, (res->nr_events + 1));
+	XMALLOC(tids, (res->nr_events + 1));
+	for (t=0; t < nthreads; t++)
+		for (i=0; i < threads[t].nr_events; i++) {
+			e = &threads[t].events[i];
+			tids[offset[e->key]] = t;
+			ops[offset[e->key]++] = e;
+		}
+	//> offset[k] is now where the events of key k + 1 start.
+
+	for (k=0, lo=0; k < max_key; lo=hi, k++) {
+		hi = offset[k];
+		if (lo == hi)
+			continue;
+		res->nr_keys++;
+
+		s.ops = &ops[lo];
+		s.nthreads = 0;
+		for (i=lo; i < hi; i++)
+			if (i == lo || tids[i] != tids[i-1])
+				s.start[s.nthreads++] = i - lo;
+		s.start[s.nthreads] = hi - lo;
+
+		ret = search_key(&s, hi - lo, initial[k] != 0);
+		if (ret < 0) {
+			res->nr_unknown++;
+		} else if (ret == 0) {
+			if (res->nr_violations++ < HISTORY_MAX_REPORTS)
+				report_key(k, &ops[lo], &tids[lo], hi - lo, initial[k]);
+		}
+	}
+
+	free(s.start);
+	free(s.configs);
+	free(s.table);
+	free(s.gen);
+	free(s.stack);
+	free(offset);
+	free(ops);
+	free(tids);
+	return res->nr_violations == 0;
+}
@@ -0,0 +1,101 @@
+#ifndef _HISTORY_H_
+#define _HISTORY_H_
+
+/**
+ * Operation histories and a per key linearizability checker, for --check.
+ *
+ * Every thread logs each lookup, insert, delete and update it performs,
+ * with its key, its result and the read_tsc_before()/read_tsc_after()
+ * timestamps around it. After the run history_check() verifies that the
+ * results can be explained by some order of the operations that respects
+ * real time, i.e., an operation that returned before another one started
+ * comes first. A set is linearizable iff the history of every key is on
+ * its own, so keys are checked one at a time, with the search of Wing and
+ * Gong over the threads' next operations on the key, and configurations
+ * that were seen before are not explored again (as in Lowe's and Horn and
+ * Kroening's checkers).
+ *
+ * Updates are checked as lookups, they tell whether the key was there.
+ * Range queries are not logged. Timestamps of different CPUs are compared,
+ * which needs a constant, synchronized TSC (time base on POWER).
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//> Keys must be in [0, HISTORY_MAX_KEY), for the initial key set.
+#define HISTORY_MAX_KEY (1LL << 24)
+
+//> The search of a key gives up after so many configurations.
+#define HISTORY_MAX_CONFIGS (1 << 20)
+
+enum {
+	HISTORY_LOOKUP = 0,
+	HISTORY_INSERT,
+	HISTORY_DELETE
+};
+
+typedef struct {
+	unsigned long long invoke, response;
+	long long key;
+	unsigned char op;
+	unsigned char ret;
+} history_event_t;
+
+typedef struct {
+	history_event_t *events;
+	long long nr_events, max_events;
+} history_t;
+
+static inline void history_init(history_t *h)
+{
+	h->events = NULL;
+	h->nr_events = h->max_events = 0;
+}
+
+static inline void history_free(history_t *h)
+{
+	free(h->events);
+	history_init(h);
+}
+
+static inline void history_add(history_t *h, int op, long long key, int ret,
+                               unsigned long long invoke,
+                               unsigned long long response)
+{
+	history_event_t *e;
+
+	if (h->nr_events == h->max_events) {
+		h->max_events = 2 * h->max_events + 4096;
+		h->events = realloc(h->events, h->max_events * sizeof(*e));
+		if (!h->events) {
+			fprintf(stderr, "Out of memory: %s:%d\n", __FILE__, __LINE__);
+			exit(1);
+		}
+	}
+	e = &h->events[h->nr_events++];
+	e->invoke = invoke;
+	e->response = response;
+	e->key = key;
+	e->op = op;
+	e->ret = ret;
+}
+
+typedef struct {
+	long long nr_events,
+	          nr_keys,        //> Keys with at least one operation.
+	          nr_violations,  //> Keys whose history is not linearizable.
+	          nr_unknown;     //> Keys given up on, see HISTORY_MAX_CONFIGS.
+} history_result_t;
+
+/**
+ * Checks the histories of `nthreads` threads, on a set that initially held
+ * the keys `k` in [0, max_key) with initial[k] != 0. The first violations
+ * are printed with the operations on their key. Returns 1 if no key was
+ * found not linearizable.
+ **/
+int history_check(history_t *threads, int nthreads,
+                  const unsigned char *initial, long long max_key,
+                  history_result_t *res);
+
+#endif /* _HISTORY_H_ */
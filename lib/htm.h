@@ -1,12 +1,118 @@
 #ifndef _HTM_H_
 #define _HTM_H_
 
+/**
+ * Lock elision on top of the TM runtime (tm.h).
+ *
+ * tx_start() executes the critical section transactionally and resorts to
+ * acquiring `fallback_lock` after at most `num_retries` aborts, or earlier if
+ * the retry policy of tm.h gives up. tx_end() commits the transaction or
+ * releases the lock, depending on how the section was entered.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "arch.h"
+#include "alloc.h" /* XMALLOC() */
+#include "tm.h"
 
-#if defined __POWERPC64__
-#	include "htm_power.h"
-#else
-#	include "htm_intel.h"
+//> The transaction outlives tx_start(), which the setjmp() of the software
+//> backend can not do, and the critical sections do not use TX_STORE().
+#if defined(TM_SW)
+#	error "lock elision is not supported by the software TM backend"
 #endif
 
+typedef struct {
+	tm_tdata_t tm;
+	//> Set while the current critical section runs under the fallback lock.
+	int in_fallback;
+} tx_thread_data_t;
+
+static inline void *tx_thread_data_new(int tid, const char *tx_policy,
+                                       int tx_retries)
+{
+	tx_thread_data_t *ret;
+
+	XMALLOC(ret, 1);
+	memset(ret, 0, sizeof(*ret));
+	tm_tdata_init(&ret->tm, tid, tx_policy, tx_retries);
+	return ret;
+}
+
+static inline void tx_thread_data_free(void *thread_data)
+{
+	free(thread_data);
+}
+
+static inline void tx_thread_data_print(void *thread_data)
+{
+	tx_thread_data_t *tdata = thread_data;
+
+	if (!tdata)
+		return;
+
+	tm_tdata_print(&tdata->tm);
+}
+
+static inline void tx_thread_data_add(void *d1, void *d2, void *dst)
+{
+	tx_thread_data_t *data1 = d1, *data2 = d2, *dest = dst;
+
+	tm_tdata_add(&data1->tm, &data2->tm, &dest->tm);
+}
+
+/**
+ * Returns the number of aborted attempts before entering the critical
+ * section.
+ **/
+static inline int tx_start(int num_retries, void *thread_data,
+                           tm_fallback_lock_t *fallback_lock)
+{
+	tx_thread_data_t *tdata = thread_data;
+	tm_begin_ret_t status;
+	int retries;
+
+	tm_op_begin(&tdata->tm);
+	for (retries=0; retries < num_retries &&
+	                tm_retry_allowed(&tdata->tm, retries); retries++) {
+		tm_fallback_wait(fallback_lock);
+
+		tm_tx_started(&tdata->tm);
+		TX_BEGIN(status);
+		if (status == TM_BEGIN_SUCCESS) {
+			if (tm_fallback_is_locked(fallback_lock))
+				TX_ABORT(ABORT_GL_TAKEN);
+			tdata->in_fallback = 0;
+			return retries;
+		}
+
+		/* Abort comes here. */
+		tm_tx_aborted(&tdata->tm, status);
+	}
+
+	tm_fallback_lock(fallback_lock, &tdata->tm);
+	tdata->in_fallback = 1;
+	return retries;
+}
+
+/**
+ * Returns 1 if the critical section was executed under the fallback lock,
+ * 0 if it was committed transactionally.
+ **/
+static inline int tx_end(void *thread_data, tm_fallback_lock_t *fallback_lock)
+{
+	tx_thread_data_t *tdata = thread_data;
+
+	if (tdata->in_fallback) {
+		tm_fallback_unlock(fallback_lock, &tdata->tm);
+		return 1;
+	}
+
+	TX_END(0);
+	tm_tx_committed(&tdata->tm);
+	return 0;
+}
+
 #endif /* _HTM_H_ */
@@ -0,0 +1,80 @@
+#ifndef _KEY_H_
+#define _KEY_H_
+
+/**
+ * Key type of the trees, fixed at build time.
+ *
+ *   -DKEY_BITS=32 (default), 64 or 128 selects a signed integer key.
+ *   -DKEY_CMP_H='"my_cmp.h"' replaces the natural integer order. The header
+ *   defines KEY_CMP(a, b), returning <0, 0 or >0, and may redefine KEY_MIN
+ *   and KEY_MAX to the smallest and largest key of its order.
+ *
+ * Trees compare keys only through the KEY_*() macros below. They expand
+ * to a bare comparison, or to the KEY_CMP() of the custom header, so
+ * the comparison is always inlined at the call site.
+ *
+ * Only the RCU-HTM trees and the BST baselines are written against
+ * map_key_t; the rest still use int keys and refuse to build otherwise.
+ **/
+
+#include <stdlib.h> /* rand(), RAND_MAX */
+#include <stdint.h>
+
+#if !defined(KEY_BITS)
+#	define KEY_BITS 32
+#endif
+
+#if KEY_BITS == 32
+typedef int32_t map_key_t;
+#	define _KEY_MAX INT32_MAX
+#elif KEY_BITS == 64
+typedef int64_t map_key_t;
+#	define _KEY_MAX INT64_MAX
+#elif KEY_BITS == 128
+typedef __int128 map_key_t;
+#	define _KEY_MAX ((map_key_t)(~(unsigned __int128)0 >> 1))
+#else
+#	error "KEY_BITS must be 32, 64 or 128"
+#endif
+
+#if defined(KEY_CMP_H)
+#	include KEY_CMP_H
+#endif
+
+#if !defined(KEY_MAX)
+#	define KEY_MAX _KEY_MAX
+#endif
+#if !defined(KEY_MIN)
+#	define KEY_MIN (-KEY_MAX - 1)
+#endif
+
+#if defined(KEY_CMP)
+#	define KEY_EQ(a,b) (KEY_CMP((a), (b)) == 0)
+#	define KEY_LT(a,b) (KEY_CMP((a), (b)) < 0)
+#else
+#	define KEY_EQ(a,b) ((a) == (b))
+#	define KEY_LT(a,b) ((a) < (b))
+#endif
+#define KEY_LE(a,b) (!KEY_LT((b), (a)))
+#define KEY_GT(a,b) KEY_LT((b), (a))
+#define KEY_GE(a,b) (!KEY_LT((a), (b)))
+
+//> For printing; 128-bit keys are truncated to their lower 64 bits.
+#define KEY_FMT "%lld"
+#define KEY_FMT_ARG(k) ((long long)(k))
+
+/**
+ * A key uniformly distributed in [0, max_key), drawn from rand(), so that
+ * warmups stay reproducible through srand(). For max_key <= RAND_MAX this
+ * is the `rand() % max_key` the trees always used.
+ **/
+static inline map_key_t key_random(map_key_t max_key)
+{
+	unsigned long long r = rand();
+
+	if (max_key > RAND_MAX)
+		r = (r << 31 | rand()) << 31 | rand();
+	return (map_key_t)(r % (unsigned long long)max_key);
+}
+
+#endif /* _KEY_H_ */
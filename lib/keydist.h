@@ -0,0 +1,177 @@
+#ifndef _KEYDIST_H_
+#define _KEYDIST_H_
+
+/**
+ * Key distributions of the benchmark threads, all over [0, max_key).
+ *
+ *   uniform  every key equally likely.
+ *   zipf     the key of rank r is drawn with probability ~ 1/r^theta
+ *            (0 < theta < 1, YCSB uses 0.99). Ranks are scattered over the
+ *            key space, so the hottest keys do not all share a subtree.
+ *   hotspot  hot_ops% of the operations go to the lowest hot_keys% keys,
+ *            the rest to the remaining keys, uniformly within each set.
+ *   latest   insertions take ever increasing keys (modulo max_key) and the
+ *            other operations pick the key inserted r insertions ago, with
+ *            r zipf distributed.
+ *   seq      each thread walks its own slice of the key space in order.
+ *
+ * Generators are per thread and draw from the thread's rng_t (rng.h). With
+ * the drand48 one, uniform returns the same keys as before skewed
+ * distributions were introduced.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "alloc.h" /* XMALLOC() */
+#include "rng.h"
+
+typedef enum {
+	KEY_DIST_UNIFORM = 0,
+	KEY_DIST_ZIPF,
+	KEY_DIST_HOTSPOT,
+	KEY_DIST_LATEST,
+	KEY_DIST_SEQ
+} key_dist_t;
+
+typedef struct {
+	key_dist_t dist;
+	long long max_key;
+
+	//> Zipf constants, see Gray et al., "Quickly generating billion-record
+	//> synthetic databases", SIGMOD'94.
+	double theta, alpha, eta, zetan, zeta2;
+
+	//> Hotspot: the first hot_keys keys receive hot_ops of the operations.
+	long long hot_keys;
+	double hot_ops;
+
+	//> Last key handed out by seq, shared last insertion of latest.
+	long long next;
+	long long *latest;
+} keydist_t;
+
+//> The key_dist_t of a name, -1 if there is none.
+static inline int keydist_parse(const char *name)
+{
+	if (!strcmp(name, "uniform")) return KEY_DIST_UNIFORM;
+	if (!strcmp(name, "zipf")) return KEY_DIST_ZIPF;
+	if (!strcmp(name, "hotspot")) return KEY_DIST_HOTSPOT;
+	if (!strcmp(name, "latest")) return KEY_DIST_LATEST;
+	if (!strcmp(name, "seq")) return KEY_DIST_SEQ;
+	return -1;
+}
+
+/**
+ * sum(1 / i^theta) for i in [1, n]. Beyond the first million terms the sum
+ * is approximated by the integral, which is accurate to well below 1e-6.
+ **/
+static inline double _keydist_zeta(long long n, double theta)
+{
+	long long i, m = n < 1000000 ? n : 1000000;
+	double sum = 0.0;
+
+	for (i=1; i <= m; i++)
+		sum += 1.0 / pow((double)i, theta);
+	if (n > m)
+		sum += (pow((double)n + 0.5, 1.0 - theta) -
+		        pow((double)m + 0.5, 1.0 - theta)) / (1.0 - theta);
+	return sum;
+}
+
+/**
+ * Initializes the generator that the threads copy, `hot_ops` and `hot_keys`
+ * are percentages. Call keydist_thread_init() on each copy.
+ **/
+static inline void keydist_init(keydist_t *kd, const char *name,
+                                long long max_key, double theta,
+                                int hot_ops, int hot_keys)
+{
+	memset(kd, 0, sizeof(*kd));
+	kd->dist = keydist_parse(name);
+	kd->max_key = max_key;
+
+	if (kd->dist == KEY_DIST_ZIPF || kd->dist == KEY_DIST_LATEST) {
+		kd->theta = theta;
+		kd->alpha = 1.0 / (1.0 - theta);
+		kd->zetan = _keydist_zeta(max_key, theta);
+		kd->zeta2 = _keydist_zeta(2, theta);
+		kd->eta = (1.0 - pow(2.0 / max_key, 1.0 - theta)) /
+		          (1.0 - kd->zeta2 / kd->zetan);
+	}
+
+	kd->hot_keys = (double)max_key * hot_keys / 100;
+	if (kd->hot_keys == 0)
+		kd->hot_keys = 1;
+	kd->hot_ops = hot_ops / 100.0;
+
+	XMALLOC(kd->latest, 1);
+	*kd->latest = 0;
+}
+
+//> Only for the distribution keydist_init() set up, not the threads' copies.
+static inline void keydist_free(keydist_t *kd)
+{
+	free(kd->latest);
+	kd->latest = NULL;
+}
+
+//> Thread `tid` of `nthreads` starts seq at the beginning of its slice.
+static inline void keydist_thread_init(keydist_t *kd, int tid, int nthreads)
+{
+	kd->next = kd->max_key / nthreads * tid - 1;
+}
+
+//> Rank in [0, max_key), 0 being the most popular.
+static inline long long _keydist_zipf_rank(keydist_t *kd, rng_t *rng)
+{
+	double u, uz;
+	long long rank;
+
+	u = rng_double(rng);
+	uz = u * kd->zetan;
+	if (uz < 1.0)
+		return 0;
+	if (uz < 1.0 + pow(0.5, kd->theta))
+		return 1;
+	rank = kd->max_key * pow(kd->eta * u - kd->eta + 1.0, kd->alpha);
+	return rank < kd->max_key ? rank : kd->max_key - 1;
+}
+
+/**
+ * The key of the next operation. Only `latest` distinguishes insertions
+ * from the other operations.
+ **/
+static inline long long keydist_next(keydist_t *kd, rng_t *rng,
+                                     int is_insert)
+{
+	long long max = kd->max_key, hot = kd->hot_keys, rank;
+	double u;
+
+	switch (kd->dist) {
+	case KEY_DIST_ZIPF:
+		rank = _keydist_zipf_rank(kd, rng);
+		//> Fibonacci hashing scatters neighbouring ranks.
+		return (unsigned long long)rank * 0x9E3779B97F4A7C15ULL % max;
+	case KEY_DIST_HOTSPOT:
+		u = rng_double(rng);
+		if (u < kd->hot_ops || hot == max)
+			return rng_below(rng, hot);
+		return hot + rng_below(rng, max - hot);
+	case KEY_DIST_LATEST:
+		if (is_insert)
+			return __sync_add_and_fetch(kd->latest, 1) % max;
+		rank = _keydist_zipf_rank(kd, rng);
+		return ((*kd->latest - rank) % max + max) % max;
+	case KEY_DIST_SEQ:
+		kd->next = (kd->next + 1) % max;
+		return kd->next;
+	case KEY_DIST_UNIFORM:
+	default:
+		return rng_below(rng, max);
+	}
+}
+
+#endif /* _KEYDIST_H_ */
@@ -0,0 +1,136 @@
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+
+/**
+ * Latency histograms in the style of HdrHistogram.
+ *
+ * Values are read_tsc() ticks. Values below 2^(LAT_SUB_BITS+1) get a
+ * bucket each. Every power of two above that is split into 2^LAT_SUB_BITS
+ * linear buckets, so a bucket is at most 1/32 (~3%) wider than the
+ * values it holds, from nanoseconds up to the full 64-bit range. Recording
+ * is a shift and an increment. Histograms of different threads are merged
+ * by adding their buckets.
+ **/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "arch.h" /* read_tsc() */
+
+#define LAT_SUB_BITS 5
+#define LAT_SUB_BUCKETS (1 << LAT_SUB_BITS)
+#define LAT_NR_BUCKETS ((64 - LAT_SUB_BITS + 1) * LAT_SUB_BUCKETS)
+
+typedef struct {
+	unsigned long long count, max;
+	unsigned long long buckets[LAT_NR_BUCKETS];
+} lat_hist_t;
+
+static inline void lat_hist_init(lat_hist_t *h)
+{
+	memset(h, 0, sizeof(*h));
+}
+
+static inline int _lat_bucket(unsigned long long v)
+{
+	int shift;
+
+	if (v < 2 * LAT_SUB_BUCKETS)
+		return v;
+	shift = 63 - __builtin_clzll(v) - LAT_SUB_BITS;
+	return shift * LAT_SUB_BUCKETS + (v >> shift);
+}
+
+//> Largest value that falls into bucket `b`.
+static inline unsigned long long _lat_bucket_top(int b)
+{
+	int shift;
+
+	if (b < 2 * LAT_SUB_BUCKETS)
+		return b;
+	shift = b / LAT_SUB_BUCKETS - 1;
+	return ((unsigned long long)(b - shift * LAT_SUB_BUCKETS + 1) << shift) - 1;
+}
+
+static inline void lat_hist_add(lat_hist_t *h, unsigned long long v)
+{
+	h->buckets[_lat_bucket(v)]++;
+	h->count++;
+	if (v > h->max)
+		h->max = v;
+}
+
+static inline void lat_hist_merge(lat_hist_t *h1, lat_hist_t *h2,
+                                  lat_hist_t *dst)
+{
+	int i;
+
+	for (i=0; i < LAT_NR_BUCKETS; i++)
+		dst->buckets[i] = h1->buckets[i] + h2->buckets[i];
+	dst->count = h1->count + h2->count;
+	dst->max = h1->max > h2->max ? h1->max : h2->max;
+}
+
+/**
+ * The value below which `p` percent of the recorded values fall, rounded
+ * up to the top of its bucket but never above the maximum.
+ **/
+static inline unsigned long long lat_hist_percentile(lat_hist_t *h, double p)
+{
+	unsigned long long rank, seen = 0, top;
+	int i;
+
+	if (h->count == 0)
+		return 0;
+
+	rank = (unsigned long long)(p / 100.0 * h->count + 0.5);
+	if (rank == 0)
+		rank = 1;
+	for (i=0; i < LAT_NR_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= rank)
+			break;
+	}
+	top = _lat_bucket_top(i);
+	return top < h->max ? top : h->max;
+}
+
+/**
+ * read_tsc() ticks per nanosecond, measured against CLOCK_MONOTONIC over
+ * `msec` milliseconds.
+ **/
+static inline double lat_ticks_per_nsec(int msec)
+{
+	struct timespec t1, t2, req = { 0, msec * 1000000L };
+	unsigned long long tsc1, tsc2;
+	double nsec;
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	tsc1 = read_tsc();
+	nanosleep(&req, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	tsc2 = read_tsc();
+
+	nsec = (t2.tv_sec - t1.tv_sec) * 1e9 + (t2.tv_nsec - t1.tv_nsec);
+	return (tsc2 - tsc1) / nsec;
+}
+
+static inline void lat_hist_print_header()
+{
+	printf("  %-8s %12s %10s %10s %10s %12s\n", "op", "samples",
+	       "p50", "p99", "p99.9", "max");
+}
+
+//> One row of percentiles, in nanoseconds.
+static inline void lat_hist_print(const char *name, lat_hist_t *h,
+                                  double ticks_per_nsec)
+{
+	printf("  %-8s %12llu %10.0lf %10.0lf %10.0lf %12.0lf\n", name, h->count,
+	       lat_hist_percentile(h, 50.0) / ticks_per_nsec,
+	       lat_hist_percentile(h, 99.0) / ticks_per_nsec,
+	       lat_hist_percentile(h, 99.9) / ticks_per_nsec,
+	       h->max / ticks_per_nsec);
+}
+
+#endif /* _LATENCY_H_ */
@@ -0,0 +1,76 @@
+#ifndef _NODE_LAYOUT_H_
+#define _NODE_LAYOUT_H_
+
+/**
+ * Memory layout of the RCU-HTM tree nodes, fixed at build time.
+ *
+ *   -DNODE_LAYOUT_PACKED (default) no padding at all. Smallest nodes, but
+ *                        a node may straddle two cache lines.
+ *   -DNODE_LAYOUT_NATURAL every field at its natural alignment.
+ *   -DNODE_LAYOUT_LINE   one node per cache line.
+ *   -DNODE_LAYOUT_SPLIT  hot/cold split. The fields read while traversing
+ *                        (children and key) come first and the rest (data,
+ *                        height/color) after them. Nodes are aligned to
+ *                        NODE_SPLIT_ALIGN, so the hot part never straddles
+ *                        a line.
+ *
+ * The trees order their fields for NODE_LAYOUT_SPLIT and append
+ * NODE_ATTRS to their node type. Nodes must be allocated with
+ * XMALLOC_ALIGNED(var, N, NODE_ALIGN).
+ **/
+
+#include <stddef.h> /* offsetof() */
+#include <stdint.h>
+
+#include "arch.h" /* CACHE_LINE_SIZE */
+
+//> Two children already take 16 bytes, so the hot part of a node with
+//> 32-bit keys is 20 bytes and a whole node fits in 32. With wider keys
+//> the node no longer fits and is rounded up to 64.
+#if !defined(NODE_SPLIT_ALIGN)
+#	define NODE_SPLIT_ALIGN 32
+#endif
+
+#if defined(NODE_LAYOUT_NATURAL)
+#	define NODE_LAYOUT_NAME "natural"
+#	define NODE_ATTRS
+#	define NODE_ALIGN 16
+#elif defined(NODE_LAYOUT_LINE)
+#	define NODE_LAYOUT_NAME "line"
+#	define NODE_ATTRS __attribute__((aligned(CACHE_LINE_SIZE)))
+#	define NODE_ALIGN CACHE_LINE_SIZE
+#elif defined(NODE_LAYOUT_SPLIT)
+#	define NODE_LAYOUT_NAME "split"
+#	define NODE_ATTRS __attribute__((aligned(NODE_SPLIT_ALIGN)))
+#	define NODE_ALIGN (NODE_SPLIT_ALIGN > 16 ? NODE_SPLIT_ALIGN : 16)
+#else
+#	define NODE_LAYOUT_PACKED
+#	define NODE_LAYOUT_NAME "packed"
+#	define NODE_ATTRS __attribute__((packed))
+#	define NODE_ALIGN 16
+#endif
+
+//> Number of cache lines holding bytes [lo, hi) of the object at `p`.
+static inline int cache_lines_spanned(const void *p, size_t lo, size_t hi)
+{
+	uintptr_t first = ((uintptr_t)p + lo) / CACHE_LINE_SIZE;
+	uintptr_t last = ((uintptr_t)p + hi - 1) / CACHE_LINE_SIZE;
+
+	return last - first + 1;
+}
+
+/**
+ * Cache lines a traversal touches at `node` of type `type`, i.e., those
+ * holding its key and its children. `left` precedes `right` in every layout.
+ **/
+#define _NODE_HOT_LO(type) \
+	(offsetof(type, key) < offsetof(type, left) ? \
+	 offsetof(type, key) : offsetof(type, left))
+#define _NODE_HOT_HI(type) \
+	(offsetof(type, key) > offsetof(type, right) ? \
+	 offsetof(type, key) + sizeof(((type *)0)->key) : \
+	 offsetof(type, right) + sizeof(((type *)0)->right))
+#define NODE_TRAVERSAL_LINES(type, node) \
+	cache_lines_spanned((node), _NODE_HOT_LO(type), _NODE_HOT_HI(type))
+
+#endif /* _NODE_LAYOUT_H_ */
@@ -0,0 +1,139 @@
+#ifndef _NODE_POOL_H_
+#define _NODE_POOL_H_
+
+/**
+ * Per thread node pool.
+ *
+ * A pool only reserves address space when it is created. The space is
+ * mapped NODE_POOL_CHUNK_BYTES at a time as nodes are handed out, and each
+ * chunk is populated by the thread that allocates from the pool. The
+ * benchmark pins its threads before creating their thread data, so with
+ * the kernel's first-touch policy each thread's nodes are local to its NUMA
+ * node. Nothing is touched before the first operation.
+ *
+ * -DNODE_POOL_HUGEPAGES backs the chunks with 2MB huge pages. It uses the
+ * hugetlbfs pool when it has free pages and transparent huge pages
+ * otherwise.
+ *
+ * Pools are single threaded and never shrink. Callers recycle nodes
+ * themselves and fall back to malloc() when node_pool_alloc() returns NULL,
+ * so when a tree is freed only the nodes that node_pool_owns() does not
+ * claim are free()d, and node_pool_destroy() unmaps the rest at once.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#if !defined(NODE_POOL_CHUNK_BYTES)
+#	define NODE_POOL_CHUNK_BYTES (2UL << 20)
+#endif
+
+typedef struct {
+	char *base;
+	size_t obj_size;
+	//> Offsets from `base`; [0, next) is handed out, [0, mapped) usable.
+	size_t next, mapped, reserved;
+	//> The whole reservation, of which `base` is the aligned part.
+	void *map;
+	size_t map_len;
+} node_pool_t;
+
+/**
+ * Reserves room for `max_objs` objects of `obj_size` bytes each. Objects
+ * are aligned to the largest power of two that divides `obj_size`, up to
+ * the page size. A pool with `max_objs` == 0 hands out nothing.
+ **/
+static inline void node_pool_init(node_pool_t *pool, size_t obj_size,
+                                  size_t max_objs)
+{
+	size_t len;
+	uintptr_t aligned;
+
+	pool->base = pool->map = NULL;
+	pool->obj_size = obj_size;
+	pool->next = pool->mapped = pool->reserved = pool->map_len = 0;
+	if (max_objs == 0)
+		return;
+
+	pool->reserved = (obj_size * max_objs + NODE_POOL_CHUNK_BYTES - 1) /
+	                 NODE_POOL_CHUNK_BYTES * NODE_POOL_CHUNK_BYTES;
+
+	//> One extra chunk to align the base to a chunk (huge page) boundary.
+	len = pool->reserved + NODE_POOL_CHUNK_BYTES;
+	pool->base = mmap(NULL, len, PROT_NONE,
+	                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (pool->base == MAP_FAILED) {
+		perror("node_pool_init: mmap");
+		exit(1);
+	}
+	pool->map = pool->base;
+	pool->map_len = len;
+	aligned = ((uintptr_t)pool->base + NODE_POOL_CHUNK_BYTES - 1) &
+	          ~(NODE_POOL_CHUNK_BYTES - 1);
+	pool->base = (char *)aligned;
+}
+
+static inline void _node_pool_map_chunk(node_pool_t *pool)
+{
+	char *chunk = pool->base + pool->mapped;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED;
+	void *ret = MAP_FAILED;
+
+#	if defined(NODE_POOL_HUGEPAGES)
+	ret = mmap(chunk, NODE_POOL_CHUNK_BYTES, PROT_READ | PROT_WRITE,
+	           flags | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+	if (ret == MAP_FAILED) {
+		ret = mmap(chunk, NODE_POOL_CHUNK_BYTES, PROT_READ | PROT_WRITE,
+		           flags, -1, 0);
+		if (ret != MAP_FAILED) {
+			char *p;
+			madvise(chunk, NODE_POOL_CHUNK_BYTES, MADV_HUGEPAGE);
+			//> Fault the chunk in from this thread.
+			for (p=chunk; p < chunk + NODE_POOL_CHUNK_BYTES; p += 4096)
+				*(volatile char *)p = 0;
+		}
+	}
+#	else
+	ret = mmap(chunk, NODE_POOL_CHUNK_BYTES, PROT_READ | PROT_WRITE,
+	           flags | MAP_POPULATE, -1, 0);
+#	endif
+	if (ret == MAP_FAILED) {
+		perror("node_pool: mmap");
+		exit(1);
+	}
+	pool->mapped += NODE_POOL_CHUNK_BYTES;
+}
+
+//> Returns zeroed memory for one object, or NULL if the pool is exhausted.
+static inline void *node_pool_alloc(node_pool_t *pool)
+{
+	void *ret;
+
+	if (pool->next + pool->obj_size > pool->mapped) {
+		if (pool->mapped + NODE_POOL_CHUNK_BYTES > pool->reserved)
+			return NULL;
+		_node_pool_map_chunk(pool);
+	}
+
+	ret = pool->base + pool->next;
+	pool->next += pool->obj_size;
+	return ret;
+}
+
+//> Returns non-zero if `obj` was handed out by `pool`.
+static inline int node_pool_owns(node_pool_t *pool, void *obj)
+{
+	return (char *)obj >= pool->base && (char *)obj < pool->base + pool->next;
+}
+
+//> Unmaps the pool with all the objects it handed out.
+static inline void node_pool_destroy(node_pool_t *pool)
+{
+	if (pool->map)
+		munmap(pool->map, pool->map_len);
+	node_pool_init(pool, pool->obj_size, 0);
+}
+
+#endif /* _NODE_POOL_H_ */
@@ -0,0 +1,82 @@
+#ifndef _NODE_STATS_H_
+#define _NODE_STATS_H_
+
+/**
+ * Node accounting of a tree, for rbt_mem_stats().
+ *
+ * Every node that a tree takes from malloc() or a node pool is counted with
+ * node_stats_alloc(), and every one it free()s with node_stats_free(). The
+ * counts go to the calling thread's own cache line, which
+ * node_stats_register() picks from rbt_thread_data_new(), so the operations
+ * do not share any counter. Threads that never registered, i.e., the master
+ * during rbt_warmup(), count atomically in a shared one. The counts are only
+ * summed after the run.
+ **/
+
+#include <string.h>
+
+#include "arch.h" /* CACHE_LINE_SIZE */
+
+//> Threads with a larger tid count in the shared counter.
+#define NODE_STATS_MAX_THREADS 128
+
+typedef struct {
+	long long allocated,
+	          pool_capacity;
+} __attribute__((aligned(CACHE_LINE_SIZE))) node_stats_thread_t;
+
+typedef struct {
+	node_stats_thread_t threads[NODE_STATS_MAX_THREADS];
+	node_stats_thread_t shared;
+} node_stats_t;
+
+//> The counters of this thread, in the tree's node_stats_t.
+static __thread node_stats_thread_t *node_stats_mine;
+
+//> Called by rbt_new(), a tree counts from zero.
+static inline void node_stats_reset(node_stats_t *s)
+{
+	memset(s, 0, sizeof(*s));
+}
+
+static inline void node_stats_register(node_stats_t *s, int tid)
+{
+	if (tid >= 0 && tid < NODE_STATS_MAX_THREADS)
+		node_stats_mine = &s->threads[tid];
+}
+
+static inline void node_stats_alloc(node_stats_t *s, long long nr_nodes)
+{
+	if (node_stats_mine)
+		node_stats_mine->allocated += nr_nodes;
+	else
+		__sync_fetch_and_add(&s->shared.allocated, nr_nodes);
+}
+
+static inline void node_stats_free(node_stats_t *s, long long nr_nodes)
+{
+	node_stats_alloc(s, -nr_nodes);
+}
+
+//> A node pool of `nr_nodes` was reserved for the calling thread.
+static inline void node_stats_pool(node_stats_t *s, long long nr_nodes)
+{
+	if (node_stats_mine)
+		node_stats_mine->pool_capacity += nr_nodes;
+	else
+		__sync_fetch_and_add(&s->shared.pool_capacity, nr_nodes);
+}
+
+//> Sums the counters of all threads into *total.
+static inline void node_stats_sum(node_stats_t *s, node_stats_thread_t *total)
+{
+	int i;
+
+	*total = s->shared;
+	for (i=0; i < NODE_STATS_MAX_THREADS; i++) {
+		total->allocated += s->threads[i].allocated;
+		total->pool_capacity += s->threads[i].pool_capacity;
+	}
+}
+
+#endif /* _NODE_STATS_H_ */
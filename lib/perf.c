@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perf.h"
+
+//> The core PMU, whose sysfs directory names the TSX events.
+#if !defined(PERF_SYSFS_DIR)
+#	define PERF_SYSFS_DIR "/sys/bus/event_source/devices/cpu"
+#endif
+
+const char *perf_event_names[PERF_NR_EVENTS] = {
+	[PERF_CYCLES] = "cycles",
+	[PERF_INSTRUCTIONS] = "instructions",
+	[PERF_LLC_MISSES] = "llc-misses",
+	[PERF_DTLB_MISSES] = "dtlb-misses",
+	[PERF_TX_START] = "tx-start",
+	[PERF_TX_ABORT] = "tx-abort",
+	[PERF_TX_CAPACITY] = "tx-capacity",
+};
+
+#define HW_CACHE_READ_MISS(cache) \
+	((cache) | PERF_COUNT_HW_CACHE_OP_READ << 8 | \
+	 PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+
+static int sysfs_read(const char *path, char *buf, int len)
+{
+	FILE *fp;
+	char *nl;
+
+	if (!(fp = fopen(path, "r")))
+		return -1;
+	if (!fgets(buf, len, fp)) {
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+	if ((nl = strchr(buf, '\n')))
+		*nl = '\0';
+	return 0;
+}
+
+/**
+ * The type and config of a named event of the core PMU. The event is a
+ * list of terms like "event=0xc9,umask=0x1" and format/<term> gives the
+ * config bits of each, e.g., "config:8-15". Returns -1 if it is not there.
+ **/
+static int sysfs_event(const char *name, __u32 *type, __u64 *config)
+{
+	char path[256], buf[256], fmt[64], *term, *val, *saveptr;
+	unsigned long long v, mask;
+	int lo, hi;
+
+	if (sysfs_read(PERF_SYSFS_DIR "/type", buf, sizeof(buf)) < 0)
+		return -1;
+	*type = strtoul(buf, NULL, 0);
+
+	snprintf(path, sizeof(path), PERF_SYSFS_DIR "/events/%s", name);
+	if (sysfs_read(path, buf, sizeof(buf)) < 0)
+		return -1;
+
+	*config = 0;
+	for (term=strtok_r(buf, ",", &saveptr); term;
+	     term=strtok_r(NULL, ",", &saveptr)) {
+		v = 1;
+		if ((val = strchr(term, '='))) {
+			*val++ = '\0';
+			v = strtoull(val, NULL, 0);
+		}
+		snprintf(path, sizeof(path), PERF_SYSFS_DIR "/format/%s", term);
+		if (sysfs_read(path, fmt, sizeof(fmt)) < 0)
+			return -1;
+		switch (sscanf(fmt, "config:%d-%d", &lo, &hi)) {
+		case 1:
+			hi = lo;
+			break;
+		case 2:
+			break;
+		default:
+			return -1; //> config1/config2 terms are not needed here.
+		}
+		mask = (hi - lo >= 63) ? ~0ULL : (1ULL << (hi - lo + 1)) - 1;
+		*config |= (v & mask) << lo;
+	}
+	return 0;
+}
+
+static int perf_event_attr_of(int event, struct perf_event_attr *attr)
+{
+	memset(attr, 0, sizeof(*attr));
+	attr->size = sizeof(*attr);
+
+	switch (event) {
+	case PERF_CYCLES:
+		attr->type = PERF_TYPE_HARDWARE;
+		attr->config = PERF_COUNT_HW_CPU_CYCLES;
+		break;
+	case PERF_INSTRUCTIONS:
+		attr->type = PERF_TYPE_HARDWARE;
+		attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+		break;
+	case PERF_LLC_MISSES:
+		attr->type = PERF_TYPE_HW_CACHE;
+		attr->config = HW_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL);
+		break;
+	case PERF_DTLB_MISSES:
+		attr->type = PERF_TYPE_HW_CACHE;
+		attr->config = HW_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB);
+		break;
+	default:
+		if (sysfs_event(perf_event_names[event], &attr->type,
+		                &attr->config) < 0)
+			return -1;
+	}
+
+	attr->disabled = 1;
+	attr->exclude_kernel = 1;
+	attr->exclude_hv = 1;
+	attr->read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+	                    PERF_FORMAT_TOTAL_TIME_RUNNING;
+	return 0;
+}
+
+void perf_counters_init(perf_counters_t *pc)
+{
+	int i;
+
+	for (i=0; i < PERF_NR_EVENTS; i++) {
+		pc->fd[i] = -1;
+		pc->has[i] = 1;
+		pc->count[i] = 0;
+	}
+}
+
+void perf_counters_open(perf_counters_t *pc)
+{
+	struct perf_event_attr attr;
+	int i;
+
+	perf_counters_init(pc);
+	for (i=0; i < PERF_NR_EVENTS; i++) {
+		if (perf_event_attr_of(i, &attr) == 0)
+			pc->fd[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+		pc->has[i] = (pc->fd[i] >= 0);
+	}
+}
+
+void perf_counters_enable(perf_counters_t *pc)
+{
+	int i;
+
+	for (i=0; i < PERF_NR_EVENTS; i++) {
+		if (pc->fd[i] < 0)
+			continue;
+		ioctl(pc->fd[i], PERF_EVENT_IOC_RESET, 0);
+		ioctl(pc->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+void perf_counters_disable(perf_counters_t *pc)
+{
+	//> value, time enabled, time running
+	unsigned long long buf[3];
+	int i;
+
+	for (i=0; i < PERF_NR_EVENTS; i++) {
+		if (pc->fd[i] < 0)
+			continue;
+		ioctl(pc->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+		if (read(pc->fd[i], buf, sizeof(buf)) != sizeof(buf))
+			pc->has[i] = 0;
+		else if (buf[2] == 0)
+			pc->count[i] = 0;
+		else if (buf[2] < buf[1])
+			pc->count[i] = (double)buf[0] * buf[1] / buf[2];
+		else
+			pc->count[i] = buf[0];
+		close(pc->fd[i]);
+		pc->fd[i] = -1;
+	}
+}
+
+void perf_counters_add(perf_counters_t *p1, perf_counters_t *p2,
+                       perf_counters_t *dst)
+{
+	int i;
+
+	for (i=0; i < PERF_NR_EVENTS; i++) {
+		dst->has[i] = p1->has[i] && p2->has[i];
+		dst->count[i] = p1->count[i] + p2->count[i];
+	}
+}
+
+void perf_counters_print_header()
+{
+	int i;
+
+	printf("%3s", "tid");
+	for (i=0; i < PERF_NR_EVENTS; i++)
+		printf(" %14s", perf_event_names[i]);
+	printf("\n");
+}
+
+void perf_counters_print(int tid, perf_counters_t *pc)
+{
+	int i;
+
+	printf("%3d", tid);
+	for (i=0; i < PERF_NR_EVENTS; i++) {
+		if (pc->has[i])
+			printf(" %14llu", pc->count[i]);
+		else
+			printf(" %14s", "-");
+	}
+	printf("\n");
+}
+
+void perf_counters_print_summary(perf_counters_t *pc, long long ops)
+{
+	unsigned long long *c = pc->count;
+	int *has = pc->has;
+	int i, nr_has = 0;
+
+	for (i=0; i < PERF_NR_EVENTS; i++)
+		nr_has += has[i];
+	if (nr_has == 0)
+		printf("  No events available, is there a PMU (VM?) and does "
+		       "/proc/sys/kernel/perf_event_paranoid allow it?\n");
+	if (ops <= 0)
+		return;
+
+	if (has[PERF_CYCLES] && has[PERF_INSTRUCTIONS] && c[PERF_CYCLES])
+		printf("  IPC: %.2lf\n", (double)c[PERF_INSTRUCTIONS] / c[PERF_CYCLES]);
+	if (has[PERF_CYCLES])
+		printf("  cycles/op: %.1lf\n", (double)c[PERF_CYCLES] / ops);
+	if (has[PERF_INSTRUCTIONS])
+		printf("  instructions/op: %.1lf\n",
+		       (double)c[PERF_INSTRUCTIONS] / ops);
+	if (has[PERF_LLC_MISSES])
+		printf("  llc-misses/op: %.3lf\n", (double)c[PERF_LLC_MISSES] / ops);
+	if (has[PERF_DTLB_MISSES])
+		printf("  dtlb-misses/op: %.3lf\n", (double)c[PERF_DTLB_MISSES] / ops);
+	if (has[PERF_TX_START] && has[PERF_TX_ABORT] && c[PERF_TX_START])
+		printf("  tx-abort/tx-start: %.3lf\n",
+		       (double)c[PERF_TX_ABORT] / c[PERF_TX_START]);
+	if (has[PERF_TX_ABORT] && has[PERF_TX_CAPACITY] && c[PERF_TX_ABORT])
+		printf("  tx-capacity/tx-abort: %.3lf\n",
+		       (double)c[PERF_TX_CAPACITY] / c[PERF_TX_ABORT]);
+}
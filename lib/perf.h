@@ -0,0 +1,52 @@
+#ifndef _PERF_H_
+#define _PERF_H_
+
+/**
+ * Hardware performance counters of a thread, with perf_event_open(2).
+ *
+ * A thread opens its own counters with perf_counters_open(), enables them
+ * around the measured phase and reads them with perf_counters_disable().
+ * Every event is opened on its own, so an event that the CPU, the kernel or
+ * perf_event_paranoid does not allow (e.g., in most VMs) is only reported
+ * as not available. The transactional events are looked up by name in
+ * sysfs, where the kernel lists them on CPUs with TSX. Only user space is
+ * counted, and counts are scaled up if the kernel had to multiplex them.
+ **/
+
+enum {
+	PERF_CYCLES = 0,
+	PERF_INSTRUCTIONS,
+	PERF_LLC_MISSES,
+	PERF_DTLB_MISSES,
+	PERF_TX_START,
+	PERF_TX_ABORT,
+	PERF_TX_CAPACITY,
+	PERF_NR_EVENTS
+};
+extern const char *perf_event_names[PERF_NR_EVENTS];
+
+typedef struct {
+	int fd[PERF_NR_EVENTS];
+	//> Whether count[i] is valid, i.e., the event could be counted.
+	int has[PERF_NR_EVENTS];
+	unsigned long long count[PERF_NR_EVENTS];
+} perf_counters_t;
+
+//> Zero counts, all valid, which is what perf_counters_add() starts from.
+void perf_counters_init(perf_counters_t *pc);
+//> Opens the counters of the calling thread, disabled.
+void perf_counters_open(perf_counters_t *pc);
+void perf_counters_enable(perf_counters_t *pc);
+//> Stops the counters, reads them and closes them.
+void perf_counters_disable(perf_counters_t *pc);
+//> Events are valid in `dst` only if they are in both `p1` and `p2`.
+void perf_counters_add(perf_counters_t *p1, perf_counters_t *p2,
+                       perf_counters_t *dst);
+
+void perf_counters_print_header();
+//> One line of counts, "-" for those not available.
+void perf_counters_print(int tid, perf_counters_t *pc);
+//> Per operation and relative figures of the counts of `ops` operations.
+void perf_counters_print_summary(perf_counters_t *pc, long long ops);
+
+#endif /* _PERF_H_ */
@@ -0,0 +1,117 @@
+#ifndef _PHASE_H_
+#define _PHASE_H_
+
+/**
+ * Phases of a run, by --phases "SPEC". The spec is a ';' separated list of
+ * "SEC[:FIELD=VALUE,...]", run one after the other, with the fields named
+ * after the options that they override:
+ *
+ *   l, a, u, i  lookup, range, update and insert fractions [%]
+ *   d           key distribution
+ *   t           number of threads that run the phase, the rest wait
+ *
+ * A field that a phase leaves out keeps the value of the command line,
+ * e.g., "10:l=90,i=5;5:l=0,i=50,t=4" runs ten seconds of lookups, then five
+ * of insertions and deletions on 4 threads.
+ **/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "keydist.h"
+
+typedef struct {
+	double duration_sec;
+	int lookup_frac,
+	    range_frac,
+	    update_frac,
+	    insert_frac;
+	char key_dist[16];
+	int nr_threads;
+} phase_t;
+
+static inline int _phase_parse_field(phase_t *phase, char *field)
+{
+	char *val = strchr(field, '='), *end;
+	long v;
+
+	if (!val || val - field != 1)
+		return -1;
+	val++;
+
+	if (field[0] == 'd') {
+		if (keydist_parse(val) < 0 || strlen(val) >= sizeof(phase->key_dist))
+			return -1;
+		strcpy(phase->key_dist, val);
+		return 0;
+	}
+
+	v = strtol(val, &end, 10);
+	if (*end != '\0' || v < 0)
+		return -1;
+	switch (field[0]) {
+	case 'l': phase->lookup_frac = v; break;
+	case 'a': phase->range_frac = v; break;
+	case 'u': phase->update_frac = v; break;
+	case 'i': phase->insert_frac = v; break;
+	case 't': phase->nr_threads = v; break;
+	default: return -1;
+	}
+	return 0;
+}
+
+/**
+ * Parses `spec` into a malloc()ed array in *phases, starting every phase
+ * from `dflt`. Returns the number of phases, or -1 if the spec is not
+ * valid.
+ **/
+static inline int phases_parse(const char *spec, const phase_t *dflt,
+                               phase_t **phases)
+{
+	char *buf, *s, *field, *end, *save1, *save2;
+	phase_t *p;
+	int n = 0, max = 0;
+
+	*phases = NULL;
+	buf = strdup(spec);
+	for (s=strtok_r(buf, ";", &save1); s; s=strtok_r(NULL, ";", &save1)) {
+		if (n == max) {
+			max = 2 * max + 4;
+			*phases = realloc(*phases, max * sizeof(phase_t));
+			if (!*phases) {
+				fprintf(stderr, "Out of memory: %s:%d\n", __FILE__, __LINE__);
+				exit(1);
+			}
+		}
+		p = &(*phases)[n++];
+		*p = *dflt;
+
+		p->duration_sec = strtod(s, &end);
+		if (end == s || p->duration_sec <= 0 || (*end && *end != ':'))
+			goto bad;
+		if (*end == ':')
+			for (field=strtok_r(end + 1, ",", &save2); field;
+			     field=strtok_r(NULL, ",", &save2))
+				if (_phase_parse_field(p, field) < 0)
+					goto bad;
+
+		if (p->lookup_frac > 100 || p->range_frac > 100 ||
+		    p->update_frac > 100 || p->insert_frac > 100 ||
+		    p->lookup_frac + p->range_frac + p->update_frac +
+		    p->insert_frac > 100 || p->nr_threads < 1)
+			goto bad;
+	}
+	free(buf);
+	if (n == 0)
+		return -1;
+	return n;
+
+bad:
+	free(buf);
+	free(*phases);
+	*phases = NULL;
+	return -1;
+}
+
+#endif /* _PHASE_H_ */
@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h> //> dup(), dup2()
+#include <math.h>   //> isfinite()
+
+#include "record.h"
+
+#define RECORD_MAX_DEPTH 8
+
+typedef struct {
+	char *s;
+	size_t len, size;
+} strbuf_t;
+
+static struct {
+	int format;
+	FILE *out;
+
+	//> JSON goes to `body`. CSV names go to `head` and values to `body`.
+	strbuf_t head, body;
+	int nr_columns;
+
+	//> Current nesting and, for CSV, the dotted path that leads to it.
+	int depth;
+	int is_array[RECORD_MAX_DEPTH],
+	    nr_items[RECORD_MAX_DEPTH];
+	size_t path_len[RECORD_MAX_DEPTH];
+	char path[512];
+} rec;
+
+static void strbuf_printf(strbuf_t *sb, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	while (1) {
+		va_start(ap, fmt);
+		n = vsnprintf(sb->s + sb->len, sb->size - sb->len, fmt, ap);
+		va_end(ap);
+		if (n >= 0 && sb->len + n < sb->size)
+			break;
+
+		sb->size = 2 * sb->size + n + 1;
+		sb->s = realloc(sb->s, sb->size);
+		if (!sb->s) {
+			fprintf(stderr, "Out of memory: %s:%d\n", __FILE__, __LINE__);
+			exit(1);
+		}
+	}
+	sb->len += n;
+}
+
+int record_format_parse(const char *name)
+{
+	if (!strcmp(name, "text")) return RECORD_TEXT;
+	if (!strcmp(name, "json")) return RECORD_JSON;
+	if (!strcmp(name, "csv")) return RECORD_CSV;
+	return -1;
+}
+
+//> Starts a new, empty record.
+static void record_reset()
+{
+	rec.head.len = rec.body.len = 0;
+	if (rec.head.s)
+		rec.head.s[0] = '\0';
+	if (rec.body.s)
+		rec.body.s[0] = '\0';
+	rec.nr_columns = 0;
+	rec.depth = 0;
+	rec.is_array[0] = 0;
+	rec.nr_items[0] = 0;
+	rec.path_len[0] = 0;
+	rec.path[0] = '\0';
+	if (rec.format == RECORD_JSON)
+		strbuf_printf(&rec.body, "{");
+}
+
+void record_init(int format)
+{
+	rec.format = format;
+	rec.out = stdout;
+	record_reset();
+}
+
+int record_format()
+{
+	return rec.format;
+}
+
+void record_redirect_stdout()
+{
+	int fd;
+
+	if (rec.format == RECORD_TEXT)
+		return;
+
+	fflush(stdout);
+	fd = dup(STDOUT_FILENO);
+	rec.out = fdopen(fd, "w");
+	dup2(STDERR_FILENO, STDOUT_FILENO);
+}
+
+//> Starts a new field. For CSV, also appends its column name.
+static void record_field(const char *name)
+{
+	int idx = rec.nr_items[rec.depth]++;
+
+	if (rec.format == RECORD_JSON) {
+		if (idx > 0)
+			strbuf_printf(&rec.body, ",");
+		if (!rec.is_array[rec.depth])
+			strbuf_printf(&rec.body, "\"%s\":", name);
+	} else if (rec.format == RECORD_CSV) {
+		if (rec.nr_columns++ > 0) {
+			strbuf_printf(&rec.head, ",");
+			strbuf_printf(&rec.body, ",");
+		}
+		if (rec.is_array[rec.depth])
+			strbuf_printf(&rec.head, "%s%d", rec.path, idx);
+		else
+			strbuf_printf(&rec.head, "%s%s", rec.path, name);
+	}
+}
+
+static void record_nest(const char *name, int is_array)
+{
+	int idx = rec.nr_items[rec.depth]++;
+	char comp[64];
+	size_t len;
+
+	if (rec.format == RECORD_TEXT)
+		return;
+
+	if (rec.is_array[rec.depth])
+		snprintf(comp, sizeof(comp), "%d.", idx);
+	else
+		snprintf(comp, sizeof(comp), "%s.", name);
+
+	if (rec.format == RECORD_JSON) {
+		if (idx > 0)
+			strbuf_printf(&rec.body, ",");
+		if (!rec.is_array[rec.depth])
+			strbuf_printf(&rec.body, "\"%s\":", name);
+		strbuf_printf(&rec.body, is_array ? "[" : "{");
+	}
+
+	if (rec.depth + 1 >= RECORD_MAX_DEPTH) {
+		fprintf(stderr, "record: nested too deep\n");
+		exit(1);
+	}
+	rec.depth++;
+	rec.is_array[rec.depth] = is_array;
+	rec.nr_items[rec.depth] = 0;
+	len = strlen(rec.path);
+	rec.path_len[rec.depth] = len;
+	snprintf(rec.path + len, sizeof(rec.path) - len, "%s", comp);
+}
+
+void record_object(const char *name)
+{
+	record_nest(name, 0);
+}
+
+void record_array(const char *name)
+{
+	record_nest(name, 1);
+}
+
+void record_close()
+{
+	if (rec.format == RECORD_TEXT)
+		return;
+
+	if (rec.format == RECORD_JSON)
+		strbuf_printf(&rec.body, rec.is_array[rec.depth] ? "]" : "}");
+	rec.path[rec.path_len[rec.depth]] = '\0';
+	rec.depth--;
+}
+
+void record_int(const char *name, long long val)
+{
+	if (rec.format == RECORD_TEXT)
+		return;
+	record_field(name);
+	strbuf_printf(&rec.body, "%lld", val);
+}
+
+void record_uint(const char *name, unsigned long long val)
+{
+	if (rec.format == RECORD_TEXT)
+		return;
+	record_field(name);
+	strbuf_printf(&rec.body, "%llu", val);
+}
+
+void record_double(const char *name, double val)
+{
+	if (rec.format == RECORD_TEXT)
+		return;
+	record_field(name);
+	if (isfinite(val))
+		strbuf_printf(&rec.body, "%.10g", val);
+	else if (rec.format == RECORD_JSON)
+		strbuf_printf(&rec.body, "null");
+}
+
+void record_str(const char *name, const char *val)
+{
+	const char *c;
+
+	if (rec.format == RECORD_TEXT)
+		return;
+	record_field(name);
+
+	strbuf_printf(&rec.body, "\"");
+	for (c=val; *c; c++) {
+		if (rec.format == RECORD_JSON && (*c == '"' || *c == '\\'))
+			strbuf_printf(&rec.body, "\\%c", *c);
+		else if (rec.format == RECORD_JSON && (unsigned char)*c < 0x20)
+			strbuf_printf(&rec.body, "\\u%04x", *c);
+		else if (rec.format == RECORD_CSV && *c == '"')
+			strbuf_printf(&rec.body, "\"\"");
+		else
+			strbuf_printf(&rec.body, "%c", *c);
+	}
+	strbuf_printf(&rec.body, "\"");
+}
+
+void record_bool(const char *name, int val)
+{
+	if (rec.format == RECORD_TEXT)
+		return;
+	record_field(name);
+	if (rec.format == RECORD_JSON)
+		strbuf_printf(&rec.body, val ? "true" : "false");
+	else
+		strbuf_printf(&rec.body, "%d", !!val);
+}
+
+void record_print()
+{
+	if (rec.format == RECORD_TEXT)
+		return;
+
+	fflush(stdout);
+	if (rec.format == RECORD_JSON)
+		fprintf(rec.out, "%s}\n", rec.body.s);
+	else
+		fprintf(rec.out, "%s\n%s\n", rec.head.s ? rec.head.s : "",
+		        rec.body.s ? rec.body.s : "");
+	fflush(rec.out);
+	record_reset();
+}
@@ -0,0 +1,45 @@
+#ifndef _RECORD_H_
+#define _RECORD_H_
+
+/**
+ * The results of a run as one structured record, in JSON or CSV.
+ *
+ * Fields are added in order with record_int() and friends and grouped with
+ * record_object() or record_array() ... record_close(). Array elements have
+ * no name, pass NULL. JSON keeps the nesting on a single line. CSV flattens
+ * it into a line of dotted column names, e.g., "threads.0.tx.tx_aborts",
+ * followed by a line of values.
+ *
+ * The human readable report is printed as well. With a structured format,
+ * record_redirect_stdout() sends it to stderr, so that stdout carries
+ * nothing but the record.
+ **/
+
+enum {
+	RECORD_TEXT = 0,
+	RECORD_JSON,
+	RECORD_CSV
+};
+
+//> Returns RECORD_* for "text", "json" or "csv" and -1 for anything else.
+int record_format_parse(const char *name);
+
+void record_init(int format);
+int record_format();
+void record_redirect_stdout();
+
+void record_object(const char *name);
+void record_array(const char *name);
+void record_close();
+
+void record_int(const char *name, long long val);
+void record_uint(const char *name, unsigned long long val);
+void record_double(const char *name, double val);
+void record_str(const char *name, const char *val);
+void record_bool(const char *name, int val);
+
+//> Prints the record to the original stdout and starts the next one, e.g.,
+//> for the next tree of x.all. A no-op for RECORD_TEXT.
+void record_print();
+
+#endif /* _RECORD_H_ */
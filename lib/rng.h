@@ -0,0 +1,127 @@
+#ifndef _RNG_H_
+#define _RNG_H_
+
+/**
+ * Per thread random number generators of the benchmark, by --rng.
+ *
+ *   drand48  drand48_r()/lrand48_r(), 31 bits per draw, reduced to a range
+ *            with a modulo. The default, as it gives the keys and
+ *            operations of all runs before the others were added.
+ *   xoshiro  xoshiro256** (Blackman and Vigna), seeded by splitmix64, 64
+ *            bits per draw, reduced to a range with Lemire's multiply-shift
+ *            method ("Fast random integer generation in an interval",
+ *            TOMACS'19), which needs a division only once in 2^64/n draws.
+ **/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+typedef enum {
+	RNG_DRAND48 = 0,
+	RNG_XOSHIRO
+} rng_kind_t;
+
+typedef struct {
+	rng_kind_t kind;
+	uint64_t s[4];
+	struct drand48_data drand;
+} rng_t;
+
+//> The rng_kind_t of a name, -1 if there is none.
+static inline int rng_parse(const char *name)
+{
+	if (!strcmp(name, "drand48")) return RNG_DRAND48;
+	if (!strcmp(name, "xoshiro")) return RNG_XOSHIRO;
+	return -1;
+}
+
+static inline uint64_t _rng_splitmix64(uint64_t *x)
+{
+	uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+static inline void rng_init(rng_t *rng, rng_kind_t kind, long seed)
+{
+	uint64_t x = seed;
+	int i;
+
+	rng->kind = kind;
+	if (kind == RNG_DRAND48) {
+		srand48_r(seed, &rng->drand);
+		return;
+	}
+	for (i=0; i < 4; i++)
+		rng->s[i] = _rng_splitmix64(&x);
+}
+
+static inline uint64_t _rng_rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t _rng_xoshiro(rng_t *rng)
+{
+	uint64_t *s = rng->s;
+	uint64_t ret = _rng_rotl(s[1] * 5, 7) * 9;
+	uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = _rng_rotl(s[3], 45);
+	return ret;
+}
+
+//> Uniform in [0, n), n > 0.
+static inline unsigned long long rng_below(rng_t *rng, unsigned long long n)
+{
+	unsigned __int128 m;
+	uint64_t low, threshold;
+	long int res;
+	unsigned long long r;
+
+	if (rng->kind == RNG_DRAND48) {
+		//> lrand48_r() returns 31 random bits, wider ranges need more draws.
+		lrand48_r(&rng->drand, &res);
+		r = res;
+		if (n > (1ULL << 31)) {
+			lrand48_r(&rng->drand, &res);
+			r = r << 31 | res;
+			lrand48_r(&rng->drand, &res);
+			r = r << 31 | res;
+		}
+		return r % n;
+	}
+
+	m = (unsigned __int128)_rng_xoshiro(rng) * n;
+	low = m;
+	if (low < n) {
+		threshold = -n % n;
+		while (low < threshold) {
+			m = (unsigned __int128)_rng_xoshiro(rng) * n;
+			low = m;
+		}
+	}
+	return m >> 64;
+}
+
+//> Uniform in [0, 1).
+static inline double rng_double(rng_t *rng)
+{
+	double u;
+
+	if (rng->kind == RNG_DRAND48) {
+		drand48_r(&rng->drand, &u);
+		return u;
+	}
+	return (_rng_xoshiro(rng) >> 11) * 0x1.0p-53;
+}
+
+#endif /* _RNG_H_ */
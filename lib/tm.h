@@ -0,0 +1,560 @@
+#ifndef _TM_H_
+#define _TM_H_
+
+/**
+ * Transactional memory runtime shared by all HTM-based trees.
+ *
+ * It provides:
+ *  - The TX_BEGIN()/TX_END()/TX_ABORT()/TX_STORE() interface and the
+ *    macros that decode an abort status, for three backends: Intel RTM
+ *    (default), POWER8 HTM (__POWERPC64__) and the software emulation of
+ *    tm_sw.h (-DTM_SW). Stores of a transaction to shared memory go
+ *    through TX_STORE(), which the software backend needs to lock, and
+ *    locals that live across TX_BEGIN() are declared TX_VOLATILE.
+ *  - tm_tdata_t, the per thread TM context: abort-reason accounting and the
+ *    state of the retry policy.
+ *  - The retry policy: tm_retry_allowed() decides whether another
+ *    transactional attempt should be made before resorting to the fallback.
+ *    It is selected at runtime with --tx-policy and bounded by --tx-retries
+ *    (TX_NUM_RETRIES by default):
+ *      fixed:    up to `tx_retries` attempts.
+ *      adaptive: give up immediately after a capacity abort, back off
+ *                exponentially after conflicts and keep a per thread budget
+ *                in [1, tx_retries] that is halved whenever the budget is
+ *                exhausted and grows by one whenever a transaction commits
+ *                after having aborted.
+ *  - tm_fallback_lock_t, the global lock used as the non-transactional
+ *    fallback, which transactions subscribe to via tm_fallback_is_locked().
+ *    See below for the available lock types.
+ *
+ * The policy and the retry budget are given to tm_tdata_init() by the tree,
+ * usually from clargs, and every operation calls tm_op_begin() before its
+ * first attempt. A tree built on top of it looks like:
+ *
+ *   tm_op_begin(&tdata->tm);
+ *   int retries = -1;
+ *   retry:
+ *     if (!tm_retry_allowed(&tdata->tm, ++retries)) {
+ *         tm_fallback_lock(&tree->lock, &tdata->tm);
+ *         ... non-transactional version ...
+ *         tm_fallback_unlock(&tree->lock, &tdata->tm);
+ *         return;
+ *     }
+ *     tm_fallback_wait(&tree->lock);
+ *     tm_tx_started(&tdata->tm);
+ *     TX_BEGIN(status);
+ *     if (status == TM_BEGIN_SUCCESS) {
+ *         if (tm_fallback_is_locked(&tree->lock))
+ *             TX_ABORT(ABORT_GL_TAKEN);
+ *         ... reads, TX_ABORT() ...
+ *         TX_STORE(node->left, copy);
+ *         TX_END(0);
+ *         tm_tx_committed(&tdata->tm);
+ *     } else {
+ *         tm_tx_aborted(&tdata->tm, status);
+ *         goto retry;
+ *     }
+ **/
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h> /* pthread_spinlock_t */
+#include <sched.h> /* sched_yield() */
+
+#include "arch.h"
+
+/* Number of transactional retries before resorting to the fallback lock. */
+#if !defined(TX_NUM_RETRIES)
+#	define TX_NUM_RETRIES 20
+#endif
+
+/* Codes of explicit aborts. */
+#define ABORT_VALIDATION_FAILURE 0xee
+#define ABORT_GL_TAKEN           0xff
+
+/******************************************************************************/
+/* Backends                                                                   */
+/******************************************************************************/
+#if defined(TM_SW)
+#	include "tm_sw.h"
+	typedef unsigned tm_begin_ret_t;
+#	define TM_BACKEND_NAME "software"
+#	define TM_BEGIN_SUCCESS TM_SW_STARTED
+#	define ABORT_IS_CONFLICT(status) ((status) & TM_SW_ABORT_CONFLICT)
+#	define ABORT_IS_CAPACITY(status) 0
+#	define ABORT_IS_EXPLICIT(status) ((status) & TM_SW_ABORT_EXPLICIT)
+#	define ABORT_CODE(status) TM_SW_ABORT_CODE(status)
+#	define TX_ABORT(code) tm_sw_abort(code)
+#	define TX_BEGIN(status) tm_sw_begin(status)
+#	define TX_END(code)   tm_sw_end()
+#	define TX_STORE(lval, val) tm_sw_store(lval, val)
+#	define TX_FALLBACK_ACQUIRED() tm_sw_fallback_acquired()
+	//> Aborts longjmp() back to TX_BEGIN(), see tm_sw.h.
+#	define TX_VOLATILE volatile
+#elif defined(__POWERPC64__)
+#	include <htmintrin.h>
+	//> On failure TX_BEGIN() sets TEXASRU, which never equals -1.
+	typedef long tm_begin_ret_t;
+#	define TM_BACKEND_NAME "power8"
+#	define TM_BEGIN_SUCCESS (-1L)
+#	define ABORT_IS_CONFLICT(status) \
+	        (_TEXASRU_TRANSACTION_CONFLICT(status) || \
+	         _TEXASRU_NON_TRANSACTIONAL_CONFLICT(status))
+#	define ABORT_IS_CAPACITY(status) _TEXASRU_FOOTPRINT_OVERFLOW(status)
+#	define ABORT_IS_EXPLICIT(status) _TEXASRU_ABORT(status)
+#	define ABORT_CODE(status) _TEXASRU_FAILURE_CODE(status)
+#	define TX_ABORT(code) __builtin_tabort(code)
+#	define TX_BEGIN(status) \
+	        ((status) = __builtin_tbegin(0) ? TM_BEGIN_SUCCESS \
+	                           : (tm_begin_ret_t)__builtin_get_texasru())
+#	define TX_END(code)   __builtin_tend(0)
+#	define TX_STORE(lval, val) ((lval) = (val))
+#	define TX_FALLBACK_ACQUIRED()
+#	define TX_VOLATILE
+#else
+#	include "rtm.h"
+	typedef unsigned tm_begin_ret_t;
+#	define TM_BACKEND_NAME "rtm"
+#	define TM_BEGIN_SUCCESS _XBEGIN_STARTED
+#	define ABORT_IS_CONFLICT(status) ((status) & _XABORT_CONFLICT)
+#	define ABORT_IS_CAPACITY(status) ((status) & _XABORT_CAPACITY)
+#	define ABORT_IS_EXPLICIT(status) ((status) & _XABORT_EXPLICIT)
+#	define ABORT_CODE(status) _XABORT_CODE(status)
+#	define TX_ABORT(code) _xabort(code)
+#	define TX_BEGIN(status) ((status) = _xbegin())
+#	define TX_END(code)   _xend()
+#	define TX_STORE(lval, val) ((lval) = (val))
+#	define TX_FALLBACK_ACQUIRED()
+#	define TX_VOLATILE
+#endif
+
+#define ABORT_IS_VALIDATION(status) \
+	(ABORT_IS_EXPLICIT(status) && ABORT_CODE(status) == ABORT_VALIDATION_FAILURE)
+
+/******************************************************************************/
+/* Fallback lock                                                              */
+/******************************************************************************/
+/**
+ * The fallback lock is selected at compile time:
+ *   -DTM_FALLBACK_TICKET (default with transactions): a ticket lock whose
+ *                         `next` and `owner` halves share one word, so a
+ *                         transaction subscribes to the lock with a single
+ *                         read. Waiters back off proportionally to their
+ *                         distance from the owner.
+ *   -DTM_FALLBACK_MCS:    an MCS queue lock. Waiters spin on their own
+ *                         tm_tdata_t, transactions read the `tail` word.
+ *   -DTM_FALLBACK_SPIN (default with TX_NUM_RETRIES=0): pthread_spinlock_t.
+ * The first two are FIFO, so a thread that resorts to the fallback can not
+ * be starved by the ones that keep re-acquiring it. The price is that the
+ * lock is handed to a thread that may not be running: with more threads than
+ * CPUs everyone waits for the preempted owner or next in line. So waiters
+ * only spin for TM_SPIN_RELAX_MAX rounds and sched_yield() from then on,
+ * which lets the preempted thread run. Still, every handoff then costs a
+ * context switch, while the spinlock's owner keeps it for as long as it runs.
+ * Without transactions there is nothing to starve and the lock is all there
+ * is to measure, so the lock-only builds (the rcu_sgl baselines) keep the
+ * spinlock unless told otherwise.
+ **/
+#if !defined(TM_FALLBACK_TICKET) && !defined(TM_FALLBACK_MCS) && \
+    !defined(TM_FALLBACK_SPIN)
+#	if TX_NUM_RETRIES == 0
+#		define TM_FALLBACK_SPIN
+#	else
+#		define TM_FALLBACK_TICKET
+#	endif
+#endif
+
+#define TM_SPIN_RELAX_MAX 1024
+
+//> One poll of a lock that is not free yet: `relax` CPU_RELAX() rounds, or
+//> sched_yield() once the waiter spun TM_SPIN_RELAX_MAX rounds in `*spun`.
+static inline void tm_spin_poll(unsigned int *spun, unsigned int relax)
+{
+	unsigned int i;
+
+	if (*spun >= TM_SPIN_RELAX_MAX) {
+		sched_yield();
+		return;
+	}
+	*spun += relax;
+	for (i=0; i < relax; i++)
+		CPU_RELAX();
+}
+
+//> Per thread queue node of the MCS lock, kept in tm_tdata_t.
+typedef struct tm_mcs_node_s {
+	struct tm_mcs_node_s *volatile next;
+	volatile int locked;
+	char padding[CACHE_LINE_SIZE - sizeof(void *) - sizeof(int)];
+} tm_mcs_node_t;
+
+#if defined(TM_FALLBACK_TICKET)
+#	define TM_FALLBACK_NAME "ticket"
+	typedef union {
+		volatile unsigned long long word;
+		struct {
+#		if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+			volatile unsigned int owner, next;
+#		else
+			volatile unsigned int next, owner;
+#		endif
+		} t;
+	} tm_fallback_lock_t;
+#	define TM_TICKET_BACKOFF 64
+
+	static inline void tm_fallback_lock_init(tm_fallback_lock_t *lock)
+	{
+		lock->word = 0;
+	}
+
+	static inline int tm_fallback_is_locked(tm_fallback_lock_t *lock)
+	{
+		unsigned long long word = lock->word;
+		return (unsigned int)word != (unsigned int)(word >> 32);
+	}
+
+	static inline void _tm_fallback_acquire(tm_fallback_lock_t *lock,
+	                                        tm_mcs_node_t *node)
+	{
+		unsigned int ticket, owner, spun = 0;
+
+		ticket = __sync_fetch_and_add(&lock->t.next, 1);
+		while ((owner = lock->t.owner) != ticket)
+			tm_spin_poll(&spun, (ticket - owner) * TM_TICKET_BACKOFF);
+	}
+
+	static inline void _tm_fallback_release(tm_fallback_lock_t *lock,
+	                                        tm_mcs_node_t *node)
+	{
+		__atomic_store_n(&lock->t.owner, lock->t.owner + 1, __ATOMIC_RELEASE);
+	}
+#elif defined(TM_FALLBACK_MCS)
+#	define TM_FALLBACK_NAME "mcs"
+	typedef struct {
+		tm_mcs_node_t *volatile tail;
+	} tm_fallback_lock_t;
+
+	static inline void tm_fallback_lock_init(tm_fallback_lock_t *lock)
+	{
+		lock->tail = NULL;
+	}
+
+	static inline int tm_fallback_is_locked(tm_fallback_lock_t *lock)
+	{
+		return lock->tail != NULL;
+	}
+
+	static inline void _tm_fallback_acquire(tm_fallback_lock_t *lock,
+	                                        tm_mcs_node_t *node)
+	{
+		tm_mcs_node_t *pred;
+		unsigned int spun = 0;
+
+		node->next = NULL;
+		node->locked = 1;
+		pred = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+		if (!pred)
+			return;
+		pred->next = node;
+		while (__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE))
+			tm_spin_poll(&spun, 1);
+	}
+
+	static inline void _tm_fallback_release(tm_fallback_lock_t *lock,
+	                                        tm_mcs_node_t *node)
+	{
+		unsigned int spun = 0;
+
+		if (!node->next) {
+			if (__sync_bool_compare_and_swap(&lock->tail, node, NULL))
+				return;
+			//> The successor swapped `tail` but has not linked itself yet.
+			while (!node->next)
+				tm_spin_poll(&spun, 1);
+		}
+		__atomic_store_n(&node->next->locked, 0, __ATOMIC_RELEASE);
+	}
+#else
+#	define TM_FALLBACK_NAME "spin"
+	typedef pthread_spinlock_t tm_fallback_lock_t;
+#	ifdef __POWERPC64__
+#		define LOCK_FREE 0
+#	else
+#		define LOCK_FREE 1
+#	endif
+
+	static inline void tm_fallback_lock_init(tm_fallback_lock_t *lock)
+	{
+		pthread_spin_init(lock, PTHREAD_PROCESS_SHARED);
+	}
+
+	static inline int tm_fallback_is_locked(tm_fallback_lock_t *lock)
+	{
+		return *(volatile tm_fallback_lock_t *)lock != LOCK_FREE;
+	}
+
+	static inline void _tm_fallback_acquire(tm_fallback_lock_t *lock,
+	                                        tm_mcs_node_t *node)
+	{
+		pthread_spin_lock(lock);
+	}
+
+	static inline void _tm_fallback_release(tm_fallback_lock_t *lock,
+	                                        tm_mcs_node_t *node)
+	{
+		pthread_spin_unlock(lock);
+	}
+#endif
+
+/**
+ * Avoid the lemming effect: do not start a transaction while the lock is
+ * held or anyone is queued for it. The lock word is only read, with
+ * exponential backoff, so the waiters do not steal it from the owner, and
+ * yielding as the FIFO waiters do, in case the owner is preempted.
+ **/
+static inline void tm_fallback_wait(tm_fallback_lock_t *lock)
+{
+	unsigned int rounds = 1, spun = 0;
+
+	while (tm_fallback_is_locked(lock)) {
+		tm_spin_poll(&spun, rounds);
+		if (rounds < 1024)
+			rounds <<= 1;
+	}
+}
+
+/******************************************************************************/
+/* Per thread TM context: statistics and retry policy                         */
+/******************************************************************************/
+enum {
+	TM_ABORT_CONFLICT = 0,
+	TM_ABORT_CAPACITY,
+	TM_ABORT_VALIDATION,
+	TM_ABORT_GL_TAKEN,
+	TM_ABORT_EXPLICIT_OTHER,
+	TM_ABORT_OTHER,
+	TM_ABORT_REASONS_END
+};
+
+static const char *tm_abort_reason_names[TM_ABORT_REASONS_END] = {
+	"conflict", "capacity", "validation", "gl_taken", "explicit", "other"
+};
+
+typedef struct {
+	long long unsigned tx_starts,
+	                   tx_commits,
+	                   tx_aborts,
+	                   lacqs;
+	long long unsigned tx_aborts_per_reason[TM_ABORT_REASONS_END];
+} tm_stats_t;
+
+enum {
+	TM_POLICY_FIXED = 0,
+	TM_POLICY_ADAPTIVE
+};
+
+//> Bounds of the exponential backoff after conflicts, in CPU_RELAX() rounds.
+#define TM_BACKOFF_MIN 16
+#define TM_BACKOFF_MAX 4096
+
+typedef struct {
+	int tid;
+	tm_stats_t stats;
+
+	tm_mcs_node_t mcs_node;
+
+	//> Retry policy state.
+	int policy;
+	int max_retries,        /* --tx-retries */
+	    budget;             /* current budget of the adaptive policy */
+	int attempts;           /* attempts of the current operation */
+	int doomed;             /* the current operation can not commit in HTM */
+	unsigned int backoff;
+	unsigned int seed;
+} tm_tdata_t;
+
+/**
+ * `policy` is the name of the retry policy ("fixed" or "adaptive") and
+ * `max_retries` the bound of transactional attempts per operation.
+ **/
+static inline void tm_tdata_init(tm_tdata_t *tm, int tid, const char *policy,
+                                 int max_retries)
+{
+	memset(tm, 0, sizeof(*tm));
+	tm->tid = tid;
+	tm->policy = strcmp(policy, "adaptive") ? TM_POLICY_FIXED
+	                                        : TM_POLICY_ADAPTIVE;
+#	if TX_NUM_RETRIES == 0
+	//> Built to always take the lock (x.avl.int.rcu_sgl), also in x.all
+	//> where --tx-retries defaults to the value of the other trees.
+	tm->max_retries = 0;
+#	else
+	tm->max_retries = max_retries;
+#	endif
+	tm->budget = tm->max_retries;
+	tm->backoff = TM_BACKOFF_MIN;
+	tm->seed = tid + 1;
+}
+
+static inline int tm_abort_reason(tm_begin_ret_t status)
+{
+	if (ABORT_IS_EXPLICIT(status)) {
+		if (ABORT_CODE(status) == ABORT_VALIDATION_FAILURE)
+			return TM_ABORT_VALIDATION;
+		if (ABORT_CODE(status) == ABORT_GL_TAKEN)
+			return TM_ABORT_GL_TAKEN;
+		return TM_ABORT_EXPLICIT_OTHER;
+	}
+	if (ABORT_IS_CAPACITY(status))
+		return TM_ABORT_CAPACITY;
+	if (ABORT_IS_CONFLICT(status))
+		return TM_ABORT_CONFLICT;
+	return TM_ABORT_OTHER;
+}
+
+/**
+ * Returns non-zero if attempt number `retries` (counting from 0) should
+ * still be executed transactionally, zero if the fallback must be taken.
+ **/
+static inline int tm_retry_allowed(tm_tdata_t *tm, int retries)
+{
+	if (tm->policy == TM_POLICY_FIXED)
+		return retries < tm->max_retries;
+	return !tm->doomed && retries < tm->budget;
+}
+
+//> Spins for a random number of rounds in [0, tm->backoff).
+static inline void tm_backoff(tm_tdata_t *tm)
+{
+	unsigned int i, rounds;
+
+	tm->seed ^= tm->seed << 13;
+	tm->seed ^= tm->seed >> 17;
+	tm->seed ^= tm->seed << 5;
+	rounds = tm->seed & (tm->backoff - 1);
+	for (i=0; i < rounds; i++)
+		CPU_RELAX();
+	if (tm->backoff < TM_BACKOFF_MAX)
+		tm->backoff <<= 1;
+}
+
+//> Resets the per operation state, an operation may have returned between
+//> attempts without committing or taking the fallback.
+static inline void tm_op_begin(tm_tdata_t *tm)
+{
+	tm->attempts = 0;
+	tm->doomed = 0;
+}
+
+static inline void tm_tx_started(tm_tdata_t *tm)
+{
+	tm->stats.tx_starts++;
+	tm->attempts++;
+}
+
+static inline void tm_tx_committed(tm_tdata_t *tm)
+{
+	tm->stats.tx_commits++;
+
+	if (tm->policy == TM_POLICY_ADAPTIVE) {
+		//> We had to retry, a smaller budget might not have been enough.
+		if (tm->attempts > 1 && tm->budget < tm->max_retries)
+			tm->budget++;
+		tm->backoff = TM_BACKOFF_MIN;
+	}
+	tm->attempts = 0;
+	tm->doomed = 0;
+}
+
+static inline void tm_tx_aborted(tm_tdata_t *tm, tm_begin_ret_t status)
+{
+	int reason = tm_abort_reason(status);
+
+	tm->stats.tx_aborts++;
+	tm->stats.tx_aborts_per_reason[reason]++;
+
+	if (tm->policy == TM_POLICY_FIXED)
+		return;
+
+	if (reason == TM_ABORT_CAPACITY)
+		tm->doomed = 1;
+	else if (reason == TM_ABORT_CONFLICT)
+		tm_backoff(tm);
+}
+
+static inline void tm_fallback_lock(tm_fallback_lock_t *lock, tm_tdata_t *tm)
+{
+	_tm_fallback_acquire(lock, &tm->mcs_node);
+	TX_FALLBACK_ACQUIRED();
+	tm->stats.lacqs++;
+
+	//> The budget was spent without a commit; spend less next time.
+	if (tm->policy == TM_POLICY_ADAPTIVE && !tm->doomed && tm->budget > 1)
+		tm->budget >>= 1;
+	tm->attempts = 0;
+	tm->doomed = 0;
+	tm->backoff = TM_BACKOFF_MIN;
+}
+
+static inline void tm_fallback_unlock(tm_fallback_lock_t *lock, tm_tdata_t *tm)
+{
+	_tm_fallback_release(lock, &tm->mcs_node);
+}
+
+static inline void tm_stats_add(tm_stats_t *d1, tm_stats_t *d2, tm_stats_t *dst)
+{
+	int i;
+
+	dst->tx_starts = d1->tx_starts + d2->tx_starts;
+	dst->tx_commits = d1->tx_commits + d2->tx_commits;
+	dst->tx_aborts = d1->tx_aborts + d2->tx_aborts;
+	dst->lacqs = d1->lacqs + d2->lacqs;
+	for (i=0; i < TM_ABORT_REASONS_END; i++)
+		dst->tx_aborts_per_reason[i] = d1->tx_aborts_per_reason[i] +
+		                               d2->tx_aborts_per_reason[i];
+}
+
+//> Copies the counters to any struct with the same field names, such as the
+//> rbt_tx_stats_t of the interface, which has one field per abort reason.
+#define TM_STATS_COPY(dst, src) \
+	do { \
+		(dst)->tx_starts = (src)->tx_starts; \
+		(dst)->tx_commits = (src)->tx_commits; \
+		(dst)->tx_aborts = (src)->tx_aborts; \
+		(dst)->lacqs = (src)->lacqs; \
+		(dst)->tx_aborts_conflict = \
+			(src)->tx_aborts_per_reason[TM_ABORT_CONFLICT]; \
+		(dst)->tx_aborts_capacity = \
+			(src)->tx_aborts_per_reason[TM_ABORT_CAPACITY]; \
+		(dst)->tx_aborts_validation = \
+			(src)->tx_aborts_per_reason[TM_ABORT_VALIDATION]; \
+		(dst)->tx_aborts_gl_taken = \
+			(src)->tx_aborts_per_reason[TM_ABORT_GL_TAKEN]; \
+		(dst)->tx_aborts_explicit = \
+			(src)->tx_aborts_per_reason[TM_ABORT_EXPLICIT_OTHER]; \
+		(dst)->tx_aborts_other = \
+			(src)->tx_aborts_per_reason[TM_ABORT_OTHER]; \
+	} while (0)
+
+static inline void tm_tdata_add(tm_tdata_t *d1, tm_tdata_t *d2, tm_tdata_t *dst)
+{
+	tm_stats_add(&d1->stats, &d2->stats, &dst->stats);
+}
+
+static inline void tm_tdata_print(tm_tdata_t *tm)
+{
+	int i;
+
+	printf("TXSTATS(%s/%s): %3d %12llu %12llu %12llu (", TM_BACKEND_NAME,
+	       TM_FALLBACK_NAME, tm->tid,
+	       tm->stats.tx_starts, tm->stats.tx_commits, tm->stats.tx_aborts);
+	for (i=0; i < TM_ABORT_REASONS_END; i++)
+		printf(" %s: %llu", tm_abort_reason_names[i],
+		       tm->stats.tx_aborts_per_reason[i]);
+	printf(" ) lacqs: %llu", tm->stats.lacqs);
+	if (tm->policy == TM_POLICY_ADAPTIVE && tm->tid >= 0)
+		printf(" budget: %d", tm->budget);
+	printf("\n");
+}
+
+#endif /* _TM_H_ */
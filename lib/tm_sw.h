@@ -0,0 +1,138 @@
+#ifndef _TM_SW_H_
+#define _TM_SW_H_
+
+/**
+ * Software emulation of the HTM interface for CPUs without (usable) TSX.
+ *
+ * The RCU-HTM trees only use transactions to validate a privately built
+ * path copy and connect it to the tree: the transaction reads a path and a
+ * few words and then stores a single pointer, with TX_STORE(). This is
+ * emulated with a global sequence lock, whose version is odd while a
+ * transaction writes back its stores, in the style of NOrec:
+ *  - tm_sw_start() takes a snapshot of the (even) version, without writing
+ *    anything, so transactions validate concurrently.
+ *  - The first TX_STORE() takes the lock only if the version is still the
+ *    snapshot, i.e., nothing committed since the reads started; otherwise
+ *    the transaction aborts with a conflict and is retried. The lock is
+ *    released, with the version two past the snapshot, by tm_sw_end().
+ *  - A transaction without stores commits in tm_sw_end() if the version
+ *    is still the snapshot, without writing the lock.
+ * The reads are not instrumented, so a transaction is validated as a whole
+ * by the version: any commit while it runs aborts it, and only the short
+ * write-back of the transactions that store is serialized.
+ *
+ * Transactions abort with longjmp() to the setjmp() of TX_BEGIN(), which
+ * sets the status word encoded exactly as the RTM one (_XABORT_EXPLICIT |
+ * code << 24, or _XABORT_CONFLICT), so the abort accounting of the trees
+ * works unmodified. Stores are not undone, so a transaction must not call
+ * TX_ABORT() after its first TX_STORE(). Locals that a transaction
+ * modifies and that are read after an abort must be volatile.
+ *
+ * Writers that bypass transactions (the global lock fallback) must call
+ * tm_sw_fallback_acquired() right after taking their lock. It advances the
+ * version, which aborts the transactions that checked the lock before it
+ * was taken.
+ **/
+
+#include <setjmp.h>
+
+#include "arch.h" /* CACHE_LINE_SIZE, CPU_RELAX() */
+
+#define TM_SW_STARTED        (~0u)
+#define TM_SW_ABORT_EXPLICIT (1 << 0)
+#define TM_SW_ABORT_CONFLICT (1 << 2)
+#define TM_SW_ABORT_CODE(x)  (((x) >> 24) & 0xff)
+
+static struct {
+	volatile unsigned long version;
+	char padding[CACHE_LINE_SIZE - sizeof(unsigned long)];
+} __attribute__((aligned(CACHE_LINE_SIZE))) tm_sw_seqlock;
+
+static __thread jmp_buf tm_sw_jmpbuf;
+static __thread unsigned tm_sw_abort_status;
+static __thread unsigned long tm_sw_snapshot;
+static __thread int tm_sw_writing;
+
+static inline unsigned tm_sw_start(void)
+{
+	unsigned long version;
+
+	while ((version = __atomic_load_n(&tm_sw_seqlock.version,
+	                                  __ATOMIC_ACQUIRE)) & 1)
+		CPU_RELAX();
+	tm_sw_snapshot = version;
+	tm_sw_writing = 0;
+
+	return TM_SW_STARTED;
+}
+
+static inline void tm_sw_rollback(unsigned status)
+{
+	if (tm_sw_writing) {
+		__atomic_store_n(&tm_sw_seqlock.version, tm_sw_snapshot + 2,
+		                 __ATOMIC_RELEASE);
+		tm_sw_writing = 0;
+	}
+	tm_sw_abort_status = status;
+	longjmp(tm_sw_jmpbuf, 1);
+}
+
+//> Called before every store of the transaction, locks at the first one.
+static inline void tm_sw_write(void)
+{
+	if (tm_sw_writing)
+		return;
+	if (!__sync_bool_compare_and_swap(&tm_sw_seqlock.version, tm_sw_snapshot,
+	                                  tm_sw_snapshot + 1))
+		tm_sw_rollback(TM_SW_ABORT_CONFLICT);
+	tm_sw_writing = 1;
+}
+
+static inline void tm_sw_end(void)
+{
+	if (tm_sw_writing) {
+		__atomic_store_n(&tm_sw_seqlock.version, tm_sw_snapshot + 2,
+		                 __ATOMIC_RELEASE);
+		tm_sw_writing = 0;
+		return;
+	}
+	//> Read-only, the reads above are consistent if nothing committed.
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (tm_sw_seqlock.version != tm_sw_snapshot)
+		tm_sw_rollback(TM_SW_ABORT_CONFLICT);
+}
+
+static inline void tm_sw_fallback_acquired(void)
+{
+	unsigned long version;
+
+	while (1) {
+		version = tm_sw_seqlock.version;
+		if (!(version & 1) &&
+		    __sync_bool_compare_and_swap(&tm_sw_seqlock.version, version,
+		                                 version + 2))
+			break;
+		CPU_RELAX();
+	}
+}
+
+//> setjmp() must be called in the caller's frame, and ISO C only allows it
+//> as the whole controlling expression of an if, hence a statement macro.
+#define tm_sw_begin(status) \
+	do { \
+		if (setjmp(tm_sw_jmpbuf)) \
+			(status) = tm_sw_abort_status; \
+		else \
+			(status) = tm_sw_start(); \
+	} while (0)
+
+#define tm_sw_abort(code) \
+	tm_sw_rollback(TM_SW_ABORT_EXPLICIT | ((code) << 24))
+
+#define tm_sw_store(lval, val) \
+	do { \
+		tm_sw_write(); \
+		(lval) = (val); \
+	} while (0)
+
+#endif /* _TM_SW_H_ */
@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "alloc.h"
+#include "trace.h"
+
+static void trace_error(const char *path, const char *why)
+{
+	fprintf(stderr, "Trace %s: %s\n", path, why);
+	exit(1);
+}
+
+trace_t *trace_open(const char *path)
+{
+	trace_t *trace;
+	struct stat st;
+	size_t table_size;
+	uint32_t i;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) < 0)
+		trace_error(path, "cannot open");
+	if ((size_t)st.st_size < sizeof(trace_header_t))
+		trace_error(path, "too short for a header");
+
+	XMALLOC(trace, 1);
+	trace->map_size = st.st_size;
+	trace->map = mmap(NULL, trace->map_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (trace->map == MAP_FAILED)
+		trace_error(path, "cannot map");
+	//> Read once, front to back, by every thread.
+	madvise(trace->map, trace->map_size, MADV_SEQUENTIAL);
+
+	trace->hdr = trace->map;
+	if (memcmp(trace->hdr->magic, TRACE_MAGIC, sizeof(trace->hdr->magic)))
+		trace_error(path, "not a trace");
+	if (trace->hdr->version != TRACE_VERSION)
+		trace_error(path, "unknown version");
+	if (trace->hdr->nr_partitions == 0)
+		trace_error(path, "no partitions");
+
+	table_size = ((size_t)trace->hdr->nr_partitions + 1) * sizeof(uint64_t);
+	trace->record_size = TRACE_RECORD_SIZE(trace->hdr->flags);
+	if (trace->map_size < sizeof(trace_header_t) + table_size ||
+	    (trace->map_size - sizeof(trace_header_t) - table_size) /
+	    trace->record_size < trace->hdr->nr_records)
+		trace_error(path, "truncated");
+
+	trace->part = (uint64_t *)(trace->hdr + 1);
+	trace->records = (unsigned char *)trace->part + table_size;
+	if (trace->part[0] != 0 ||
+	    trace->part[trace->hdr->nr_partitions] != trace->hdr->nr_records)
+		trace_error(path, "bad partition table");
+	for (i=0; i < trace->hdr->nr_partitions; i++)
+		if (trace->part[i] > trace->part[i+1])
+			trace_error(path, "bad partition table");
+
+	return trace;
+}
+
+void trace_close(trace_t *trace)
+{
+	munmap(trace->map, trace->map_size);
+	free(trace);
+}
+
+void trace_partition(trace_t *trace, int tid, int nthreads,
+                     uint64_t *lo, uint64_t *hi)
+{
+	uint64_t n = trace->hdr->nr_records;
+
+	if (trace->hdr->nr_partitions == (uint32_t)nthreads) {
+		*lo = trace->part[tid];
+		*hi = trace->part[tid+1];
+	} else {
+		*lo = n * tid / nthreads;
+		*hi = n * (tid + 1) / nthreads;
+	}
+}
+
+struct trace_writer {
+	const char *path;
+	FILE *fp;
+	trace_header_t hdr;
+	uint64_t *part;
+	uint32_t cur;
+};
+
+trace_writer_t *trace_writer_open(const char *path, uint32_t nr_partitions,
+                                  uint32_t flags, uint32_t key_bits)
+{
+	trace_writer_t *w;
+	uint32_t i;
+
+	XMALLOC(w, 1);
+	memset(&w->hdr, 0, sizeof(w->hdr));
+	memcpy(w->hdr.magic, TRACE_MAGIC, sizeof(w->hdr.magic));
+	w->hdr.version = TRACE_VERSION;
+	w->hdr.flags = flags;
+	w->hdr.nr_partitions = nr_partitions;
+	w->hdr.key_bits = key_bits;
+	XMALLOC(w->part, (nr_partitions + 1));
+	for (i=0; i <= nr_partitions; i++)
+		w->part[i] = 0;
+	w->cur = 0;
+	w->path = path;
+
+	if (!(w->fp = fopen(path, "w")))
+		trace_error(path, "cannot create");
+	//> The header and the table are written last, over this space.
+	if (fseek(w->fp, sizeof(w->hdr) + (nr_partitions + 1) * sizeof(uint64_t),
+	          SEEK_SET) < 0)
+		trace_error(path, "cannot seek");
+	return w;
+}
+
+void trace_writer_next_partition(trace_writer_t *w)
+{
+	if (w->cur + 1 >= w->hdr.nr_partitions)
+		return;
+	w->cur++;
+	w->part[w->cur] = w->hdr.nr_records;
+}
+
+void trace_writer_append(trace_writer_t *w, int op, int64_t key,
+                         uint64_t value)
+{
+	unsigned char op8 = op;
+
+	fwrite(&op8, 1, 1, w->fp);
+	fwrite(&key, sizeof(key), 1, w->fp);
+	if (w->hdr.flags & TRACE_VALUES)
+		fwrite(&value, sizeof(value), 1, w->fp);
+	w->hdr.nr_records++;
+}
+
+void trace_writer_close(trace_writer_t *w)
+{
+	uint32_t i;
+
+	//> Partitions never started are empty.
+	for (i=w->cur + 1; i <= w->hdr.nr_partitions; i++)
+		w->part[i] = w->hdr.nr_records;
+
+	if (fseek(w->fp, 0, SEEK_SET) < 0 ||
+	    fwrite(&w->hdr, sizeof(w->hdr), 1, w->fp) != 1 ||
+	    fwrite(w->part, sizeof(uint64_t), w->hdr.nr_partitions + 1,
+	           w->fp) != w->hdr.nr_partitions + 1 ||
+	    fclose(w->fp) != 0)
+		trace_error(w->path, "write failed");
+	free(w->part);
+	free(w);
+}
@@ -0,0 +1,104 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+/**
+ * Binary traces of (operation, key[, value]) records, replayed with --trace
+ * and written from the generated streams with --trace-out.
+ *
+ * A trace file is, in host byte order:
+ *   trace_header_t
+ *   uint64_t part[nr_partitions + 1]  record index where partition i starts,
+ *                                     part[nr_partitions] == nr_records
+ *   records                           TRACE_RECORD_SIZE(flags) bytes each,
+ *                                     op (uint8_t), key (int64_t) and, with
+ *                                     TRACE_VALUES, value (uint64_t), packed
+ *
+ * The file is mapped, not read, so traces larger than memory stream from
+ * the page cache. A partition is the operations of one thread, e.g., as
+ * captured. Traces of another byte order fail the magic check.
+ **/
+
+#include <stdint.h>
+#include <string.h>
+
+#define TRACE_MAGIC "RBTTRACE"
+#define TRACE_VERSION 1
+
+//> The record has a value, given to insert and update.
+#define TRACE_VALUES 0x1
+
+enum {
+	TRACE_LOOKUP = 0,
+	TRACE_INSERT,
+	TRACE_DELETE,
+	TRACE_RANGE,
+	TRACE_UPDATE,
+	TRACE_NR_OPS
+};
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t flags;
+	uint64_t nr_records;
+	uint32_t nr_partitions;
+	//> Width of the keys it was written with, see KEY_BITS in key.h.
+	uint32_t key_bits;
+} trace_header_t;
+
+#define TRACE_RECORD_SIZE(flags) \
+	(1 + sizeof(int64_t) + (((flags) & TRACE_VALUES) ? sizeof(uint64_t) : 0))
+
+typedef struct {
+	int op;
+	int64_t key;
+	uint64_t value;
+} trace_record_t;
+
+typedef struct {
+	void *map;
+	size_t map_size;
+	trace_header_t *hdr;
+	uint64_t *part;
+	unsigned char *records;
+	size_t record_size;
+} trace_t;
+
+//> Maps a trace, exits with the reason if it is not a valid one.
+trace_t *trace_open(const char *path);
+void trace_close(trace_t *trace);
+
+/**
+ * The records [*lo, *hi) of thread `tid` out of `nthreads`. The trace's own
+ * partitions if it has one per thread, otherwise an even split of all of
+ * its records.
+ **/
+void trace_partition(trace_t *trace, int tid, int nthreads,
+                     uint64_t *lo, uint64_t *hi);
+
+static inline void trace_read(trace_t *trace, uint64_t i, trace_record_t *rec)
+{
+	unsigned char *p = trace->records + i * trace->record_size;
+
+	rec->op = p[0];
+	memcpy(&rec->key, p + 1, sizeof(rec->key));
+	rec->value = 0;
+	if (trace->hdr->flags & TRACE_VALUES)
+		memcpy(&rec->value, p + 1 + sizeof(rec->key), sizeof(rec->value));
+}
+
+/**
+ * Writing a trace: the records are appended partition by partition and
+ * the header and partition table are filled in by trace_writer_close().
+ **/
+typedef struct trace_writer trace_writer_t;
+
+trace_writer_t *trace_writer_open(const char *path, uint32_t nr_partitions,
+                                  uint32_t flags, uint32_t key_bits);
+//> Ends the current partition, the next records go to the next one.
+void trace_writer_next_partition(trace_writer_t *w);
+void trace_writer_append(trace_writer_t *w, int op, int64_t key,
+                         uint64_t value);
+void trace_writer_close(trace_writer_t *w);
+
+#endif /* _TRACE_H_ */
@@ -1,15 +1,124 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "arch.h"
 #include "clargs.h"
+#include "record.h"
+#include "rng.h"
 #include "benchmarks.h"
+#if defined(RBT_REGISTRY)
+#	include "rbt/registry.h"
+#endif
 
 void get_clargs(int argc, char **argv)
 {
 	clargs_init(argc, argv);
+
+	//> With a structured format the report goes to stderr, and stdout only
+	//> gets the record printed at the end of the run.
+	record_init(record_format_parse(clargs.output_format));
+	record_redirect_stdout();
+
 	clargs_print();
 }
 
+#if defined(RBT_REGISTRY)
+/**
+ * Runs the benchmark for every tree of --impl, one after the other, with the
+ * same inputs and seeds, so each one gets the same initial tree and the
+ * same operations. Returns 1 if all of them validate.
+ **/
+static int bench_impls()
+{
+	char *ids, *id, *saveptr;
+	int ret = 1;
+
+	ids = strdup(clargs.impl);
+	for (id=strtok_r(ids, ",", &saveptr); id; id=strtok_r(NULL, ",", &saveptr)) {
+		if (rbt_impl_find(id))
+			continue;
+		fprintf(stderr, "Unknown --impl %s, this binary has: ", id);
+		rbt_impl_print_list(stderr);
+		fprintf(stderr, "\n");
+		exit(1);
+	}
+
+	strcpy(ids, clargs.impl);
+	for (id=strtok_r(ids, ",", &saveptr); id; id=strtok_r(NULL, ",", &saveptr)) {
+		rbt_impl = rbt_impl_find(id);
+		if (!bench_pthreads())
+			ret = 0;
+	}
+
+	free(ids);
+	return ret;
+}
+#endif
+
+//> Runs the benchmark, for every tree of --impl in x.all.
+static int bench_run()
+{
+#	if defined(RBT_REGISTRY)
+	return bench_impls();
+#	else
+	return bench_pthreads();
+#	endif
+}
+
+//> Operations that --stress logs per thread and round, unless --check.
+#define STRESS_CHECK_OPS 100000
+
+/**
+ * Rounds of short runs with --check on at most 512 keys, so that the threads
+ * keep conflicting, each round with a random key range, initial size,
+ * operation mix, key distribution and seeds, drawn from --thread-seed.
+ * The trees start at least half full and insert as often as they delete,
+ * the RCU AVL trees assume that no insertion is above depth 2.
+ * Returns 1 if all of them validate.
+ **/
+static int bench_stress()
+{
+	clargs_t base = clargs;
+	int round, rest, ret = 1, failed = 0;
+	rng_t rng;
+
+	rng_init(&rng, RNG_XOSHIRO, base.thread_seed);
+	for (round=0; round < base.stress; round++) {
+		clargs = base;
+		clargs.max_key = 64 + rng_below(&rng, 449);
+		clargs.init_tree_size = clargs.max_key / 2 +
+		                        rng_below(&rng, clargs.max_key / 2 + 1);
+		//> Deletions take what is left, as many as insertions.
+		rest = 100 - base.range_frac - base.update_frac;
+		clargs.insert_frac = rng_below(&rng, rest / 2 + 1);
+		clargs.lookup_frac = rest - 2 * clargs.insert_frac;
+		clargs.key_dist = rng_below(&rng, 2) ? "zipf" : "uniform";
+		clargs.init_seed = 1 + rng_below(&rng, 1 << 30);
+		clargs.thread_seed = 1 + rng_below(&rng, 1 << 30);
+		if (!clargs.check)
+			clargs.check = STRESS_CHECK_OPS;
+#		if defined(WORKLOAD_TIME) || defined(WORKLOAD_RATE)
+		clargs.run_time_sec = 1;
+#		endif
+
+		printf("\nStress round %d/%d: max_key %lld, init_tree %d, "
+		       "lookup/insert/delete %d/%d/%d%%, key_dist %s, seeds %d/%d\n",
+		       round + 1, base.stress, clargs.max_key, clargs.init_tree_size,
+		       clargs.lookup_frac, clargs.insert_frac,
+		       rest - clargs.lookup_frac - clargs.insert_frac,
+		       clargs.key_dist, clargs.init_seed, clargs.thread_seed);
+		if (!bench_run()) {
+			ret = 0;
+			failed++;
+		}
+	}
+	printf("\nStress: %d of %d rounds failed\n", failed, base.stress);
+
+	clargs = base;
+	return ret;
+}
+
 int main(int argc, char **argv)
 {
 	int ret = 0;
@@ -17,7 +126,10 @@ int main(int argc, char **argv)
 	get_clargs(argc, argv);
 
 //	ret = bench_serial();
-	ret = bench_pthreads();
+	if (clargs.stress > 0)
+		ret = bench_stress();
+	else
+		ret = bench_run();
 
 	return ret;
 }
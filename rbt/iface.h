@@ -1,31 +1,98 @@
 #ifndef _RBT_IFACE_H_
 #define _RBT_IFACE_H_
 
+#include "key.h" /* map_key_t */
+#include "bulk_load.h"
+
 //> Not thread-safe interface functions.
 //> Should only be called during initialization and termination phase
 //> by one thread.
 void *rbt_new();
 char *rbt_name();
-int rbt_warmup(void *rbt, int nr_nodes, int max_key, 
+int rbt_warmup(void *rbt, int nr_nodes, map_key_t max_key, 
                unsigned int seed, int force);
 int rbt_validate(void *rbt);
 
+//> Frees the tree and the nodes that it can reach or still keeps for reuse,
+//> after the run. Trees without reclamation cannot find the nodes that they
+//> unlinked, which stay allocated. Called before rbt_thread_data_free() of
+//> the threads, whose node pools may hold nodes of the tree.
+void rbt_free(void *rbt);
+
+//> Builds an empty tree out of the sorted keys of `bl` (lib/bulk_load.h),
+//> instead of rbt_warmup(). Called by bl->nthreads threads at once, each
+//> with its own thread data, and returns in all of them once the tree is
+//> complete. Returns the number of keys, or -1 if not supported.
+int rbt_bulk_load(void *rbt, void *thread_data, bulk_load_t *bl, int tid);
+
+//> Memory of the tree's nodes, after the run. Nodes are `allocated` from
+//> malloc() or the node pools and not freed, and each of them is either
+//> `live` (reachable from the root, including sentinel and routing nodes),
+//> `retired` (unlinked but not reclaimed yet, or never, by trees without
+//> reclamation) or `free` (reclaimed, cached for reuse). `pool_capacity`
+//> is the number of nodes the preallocated pools of all threads can hold,
+//> 0 for trees that malloc() every node (see lib/node_stats.h). Returns 0,
+//> or -1 if not supported.
+typedef struct {
+	long long node_size,
+	          nodes_allocated,
+	          nodes_live,
+	          nodes_retired,
+	          nodes_free,
+	          pool_capacity;
+} rbt_mem_stats_t;
+int rbt_mem_stats(void *rbt, rbt_mem_stats_t *stats);
+
 //> Initialize per thread statistics.
 void *rbt_thread_data_new(int tid);
 void rbt_thread_data_print(void *thread_data);
 void rbt_thread_data_add(void *d1, void *d2, void *dst);
+void rbt_thread_data_free(void *thread_data);
+
+//> Transactional counters of a thread. May be called by another thread while
+//> the owner runs, e.g., to sample them, in which case the snapshot is only
+//> approximate. Returns -1 if the implementation keeps no such counters.
+//> The tx_aborts_<reason> counters split tx_aborts by the reasons of tm.h.
+typedef struct {
+	unsigned long long tx_starts, tx_commits, tx_aborts, lacqs;
+	unsigned long long tx_aborts_conflict, tx_aborts_capacity,
+	                   tx_aborts_validation, tx_aborts_gl_taken,
+	                   tx_aborts_explicit, tx_aborts_other;
+} rbt_tx_stats_t;
+int rbt_thread_data_tx_stats(void *thread_data, rbt_tx_stats_t *stats);
 
 //> Thread-safe interface functions.
 //> Can handle multiple threads at the same time and produce correct results.
 //> XXX: the 'serial' versions are not thread-safe and are provided only for
 //>      testing that an error is produced while called by multiple threads.
-int rbt_lookup(void *rbt, void *thread_data, int key);
-int rbt_insert(void *rbt, void *thread_data, int key, void *value);
-int rbt_delete(void *rbt, void *thread_data, int key);
+int rbt_lookup(void *rbt, void *thread_data, map_key_t key);
+int rbt_insert(void *rbt, void *thread_data, map_key_t key, void *value);
+int rbt_delete(void *rbt, void *thread_data, map_key_t key);
+
+//> Key-value accessors. rbt_get() stores the value of `key` in `*value` and
+//> returns 1 if `key` is present, 0 otherwise. rbt_update() replaces the
+//> value of a present `key` without restructuring the tree and returns 1,
+//> or 0 if `key` is absent (an upsert is rbt_update() || rbt_insert()).
+//> Both return -1 if the implementation does not support them.
+int rbt_get(void *rbt, void *thread_data, map_key_t key, void **value);
+int rbt_update(void *rbt, void *thread_data, map_key_t key, void *value);
+
+//> Ordered range scan. Calls `cb` for every key in [lo, hi) in ascending
+//> order and returns the number of keys reported, or -1 if the
+//> implementation does not support range scans. See each implementation
+//> for the consistency it guarantees under concurrent updates.
+typedef void (rbt_range_cb_t)(map_key_t key, void *value, void *arg);
+int rbt_range(void *rbt, void *thread_data, map_key_t lo, map_key_t hi,
+              rbt_range_cb_t *cb, void *arg);
 //int rbt_lookup(void *rbt, void *thread_data, char *key);
 //int rbt_insert(void *rbt, void *thread_data, char *key, void *value);
 //int rbt_delete(void *rbt, void *thread_data, char *key);
 
 int rbt_print(void *rbt);
 
+//> In x.all the calls above go to the tree picked with --impl.
+#if defined(RBT_REGISTRY)
+#	include "registry.h"
+#endif
+
 #endif /* _RBT_IFACE_H_ */
@@ -4,6 +4,7 @@
 
 #if defined(SYNC_CG_HTM)
 #	include "htm.h"
+#	include "clargs.h"
 #	if !defined(TX_NUM_RETRIES)
 #		define TX_NUM_RETRIES 20
 #	endif
@@ -39,8 +40,10 @@ typedef struct rbt_node {
 typedef struct {
 	rbt_node_t *root;
 
-#	if defined(SYNC_CG_SPINLOCK) || defined(SYNC_CG_HTM)
+#	if defined(SYNC_CG_SPINLOCK)
 	pthread_spinlock_t rbt_lock;
+#	elif defined(SYNC_CG_HTM)
+	tm_fallback_lock_t rbt_lock;
 #	endif
 } rbt_t;
 
@@ -66,8 +69,10 @@ static inline rbt_t *_rbt_new_helper()
 	XMALLOC(ret, 1);
 	ret->root = NULL;
 
-#	if defined(SYNC_CG_SPINLOCK) || defined(SYNC_CG_HTM)
+#	if defined(SYNC_CG_SPINLOCK)
 	pthread_spin_init(&ret->rbt_lock, PTHREAD_PROCESS_SHARED);
+#	elif defined(SYNC_CG_HTM)
+	tm_fallback_lock_init(&ret->rbt_lock);
 #	endif
 
 	return ret;
@@ -599,7 +604,7 @@ void *rbt_new()
 void *rbt_thread_data_new(int tid)
 {
 #	if defined(SYNC_CG_HTM)
-	return tx_thread_data_new(tid);
+	return tx_thread_data_new(tid, clargs.tx_policy, clargs.tx_retries);
 #	else
 	return NULL;
 #	endif
@@ -1,9 +1,15 @@
-#include "rtm.h"
 #include <assert.h>
 #include <pthread.h>  /* pthread_spinlock_t */
 
 #include "arch.h" /* CACHE_LINE_SIZE */
 #include "alloc.h"
+#include "tm.h"
+#include "clargs.h"
+
+//> Transactions store to the tree directly, which TM_SW can not track.
+#if defined(TM_SW)
+#	error "The fine-grained HTM trees need hardware transactions"
+#endif
 
 //#include "rbt_links_bu_ext_fg_htm_thread_data.h"
 #define TX_STATS_ARRAY_NR_TRANS 3
@@ -16,9 +22,6 @@
 #define GET_VERSION(node) ( (!(node)) ? 0 : (node)->version )
 #define INC_VERSION(node) (node)->version++
 
-#define IMPLICIT_ABORT_GLOBAL_LOCK_TAKEN 0xfe
-#define IMPLICIT_ABORT_VERSION_ERROR 0xee
-
 #ifdef USE_CPU_LOCK
 #	define NR_CPUS 8
 #endif
@@ -39,7 +42,7 @@ typedef struct {
 	rbt_node_t *root;
 	unsigned long long version;
 
-	pthread_spinlock_t spinlock; /* Used as htm fallback */
+	tm_fallback_lock_t lock; /* Used as htm fallback */
 
 } rbt_t;
 
@@ -74,7 +77,7 @@ static inline rbt_t *_rbt_new_helper()
 	ret->root = NULL;
 	ret->version = 1;
 
-	pthread_spin_init(&ret->spinlock, PTHREAD_PROCESS_SHARED);
+	tm_fallback_lock_init(&ret->lock);
 
 #	ifdef USE_CPU_LOCK
 	int i;
@@ -130,7 +133,7 @@ static int _rbt_lookup_helper(rbt_t *rbt, htm_fg_tdata_t *tdata, int key)
 	unsigned long long window_versions[1]; /* curr version */
 	int retries = -1;
 	int window_retries = -1;
-	unsigned status;
+	tm_begin_ret_t status;
 
 #	ifdef USE_CPU_LOCK
 	int tid = tdata->tid;
@@ -145,9 +148,9 @@ try_from_scratch:
 	if (retries >= TX_NUM_RETRIES) {
 		tdata->tx_lacqs++;
 		int ret = 0;
-		pthread_spin_lock(&rbt->spinlock);
+		tm_fallback_lock(&rbt->lock, &tdata->tm);
 		ret = _rbt_lookup_helper_serial(rbt, key);
-		pthread_spin_unlock(&rbt->spinlock);
+		tm_fallback_unlock(&rbt->lock, &tdata->tm);
 		return ret;
 	}
 
@@ -159,45 +162,43 @@ try_from_scratch:
 		;
 #	endif
 
-	while (rbt->spinlock == 0)
-		;
+	tm_fallback_wait(&rbt->lock);
 
 	/* First transaction at the root. */
 	tdata->tx_starts++;
 	tdata->tx_stats[0][0][0]++;
-	status = _xbegin();
-	if (status == _XBEGIN_STARTED) {
+	TX_BEGIN(status);
+	if (status == TM_BEGIN_SUCCESS) {
 #		ifdef USE_CPU_LOCK
 		if (cpu_locks[my_cpu_lock].owner > 0 &&
 		    cpu_locks[my_cpu_lock].owner != tid &&
 		    cpu_locks[my_cpu_lock].spinlock == 0)
-			_xabort(0x77);
+			TX_ABORT(0x77);
 #		endif
 
-		if (rbt->spinlock == 0)
-			_xabort(IMPLICIT_ABORT_GLOBAL_LOCK_TAKEN);
+		if (tm_fallback_is_locked(&rbt->lock))
+			TX_ABORT(ABORT_GL_TAKEN);
 
 		/* Empty tree. */
 		if (!rbt->root) {
-			_xend();
+			TX_END(0);
 			return 0;
 		}
 
 		curr = rbt->root;
 		window_versions[0] = GET_VERSION(curr);
-		_xend();
+		TX_END(0);
 	} else {
 		tdata->tx_aborts++;
 		tdata->tx_stats[0][0][1]++;
 
-		if ((status & _XABORT_EXPLICIT) &&
-		     (_XABORT_CODE(status) == IMPLICIT_ABORT_VERSION_ERROR)) {
+		if (ABORT_IS_VALIDATION(status)) {
 			tdata->tx_stats[0][0][5]++;
 			tdata->tx_aborts_version_error++;
-		} else if (status & _XABORT_CAPACITY) {
+		} else if (ABORT_IS_CAPACITY(status)) {
 			tdata->tx_stats[0][0][4]++;
 			tdata->tx_aborts_footprint_overflow++;
-		} else if (status & _XABORT_CONFLICT) {
+		} else if (ABORT_IS_CONFLICT(status)) {
 			tdata->tx_stats[0][0][2]++;
 			tdata->tx_aborts_transaction_conflict++;
 		} else {
@@ -225,29 +226,28 @@ retry_window:
 			;
 #		endif
 
-		while (rbt->spinlock == 0)
-			;
+		tm_fallback_wait(&rbt->lock);
 
 		tdata->tx_starts++;
 		tdata->tx_stats[0][1][0]++;
-		status = _xbegin();
-		if (status == _XBEGIN_STARTED) {
+		TX_BEGIN(status);
+		if (status == TM_BEGIN_SUCCESS) {
 #			ifdef USE_CPU_LOCK
 			if (cpu_locks[my_cpu_lock].owner > 0 && 
 			    cpu_locks[my_cpu_lock].owner != tid &&
 			    cpu_locks[my_cpu_lock].spinlock == 0)
-				_xabort(0x77);
+				TX_ABORT(0x77);
 #			endif
 
-			if (rbt->spinlock == 0)
-				_xabort(IMPLICIT_ABORT_GLOBAL_LOCK_TAKEN);
+			if (tm_fallback_is_locked(&rbt->lock))
+				TX_ABORT(ABORT_GL_TAKEN);
 			if (window_versions[0] != GET_VERSION(curr))
-				_xabort(IMPLICIT_ABORT_VERSION_ERROR);
+				TX_ABORT(ABORT_VALIDATION_FAILURE);
 
 			/* External node reached. */
 			if (IS_EXTERNAL_NODE(curr)) {
 				found = (curr->key == key);
-				_xend();
+				TX_END(0);
 				return found;
 			}
 
@@ -257,20 +257,19 @@ retry_window:
 
 			window_versions[0] = GET_VERSION(curr);
 
-			_xend();
+			TX_END(0);
 		} else {
 			tdata->tx_aborts++;
 			tdata->tx_stats[0][1][1]++;
 
-			if ((status & _XABORT_EXPLICIT) &&
-			     (_XABORT_CODE(status) == IMPLICIT_ABORT_VERSION_ERROR)) {
+			if (ABORT_IS_VALIDATION(status)) {
 				tdata->tx_stats[0][1][5]++;
 				tdata->tx_aborts_version_error++;
 				goto try_from_scratch;
-			} else if (status & _XABORT_CAPACITY) {
+			} else if (ABORT_IS_CAPACITY(status)) {
 				tdata->tx_stats[0][1][4]++;
 				tdata->tx_aborts_footprint_overflow++;
-			} else if (status & _XABORT_CONFLICT) {
+			} else if (ABORT_IS_CONFLICT(status)) {
 				tdata->tx_stats[0][1][2]++;
 				tdata->tx_aborts_transaction_conflict++;
 			} else {
@@ -332,7 +331,7 @@ static inline void _rbt_insert_fixup(rbt_t *rbt, int key,
 	 * I could not figure why, but without this, rbt errors occur.
 	 **/
 	if (stack_versions[0] != GET_VERSION(node_stack[0]))
-		_xabort(IMPLICIT_ABORT_VERSION_ERROR);
+		TX_ABORT(ABORT_VALIDATION_FAILURE);
 
 	/* Consume the newly inserted RED node from the stack. */
 	top--;
@@ -340,7 +339,7 @@ static inline void _rbt_insert_fixup(rbt_t *rbt, int key,
 	while (top >= 0) {
 		parent = node_stack[top--];
 		if (stack_versions[top+1] != GET_VERSION(parent))
-			_xabort(IMPLICIT_ABORT_VERSION_ERROR);
+			TX_ABORT(ABORT_VALIDATION_FAILURE);
 
 		/* parent is BLACK, we are done. */
 		if (IS_BLACK(parent))
@@ -349,7 +348,7 @@ static inline void _rbt_insert_fixup(rbt_t *rbt, int key,
 		/* parent is RED so it cannot be root => it must have a parent. */
 		gparent = node_stack[top--];
 		if (stack_versions[top+1] != GET_VERSION(gparent))
-			_xabort(IMPLICIT_ABORT_VERSION_ERROR);
+			TX_ABORT(ABORT_VALIDATION_FAILURE);
 
 		/* What is the direction we followed from gparent to parent? */
 		int dir = gparent->key < key;
@@ -359,7 +358,7 @@ static inline void _rbt_insert_fixup(rbt_t *rbt, int key,
 		if (top >= 0) {
 			ggparent = node_stack[top];
 			if (stack_versions[top] != GET_VERSION(ggparent))
-				_xabort(IMPLICIT_ABORT_VERSION_ERROR);
+				TX_ABORT(ABORT_VALIDATION_FAILURE);
 		}
 
 		if (IS_RED(uncle)) {              /* Case 1 (Recolor and move up) */
@@ -380,7 +379,7 @@ static inline void _rbt_insert_fixup(rbt_t *rbt, int key,
 			int dir_from_parent = parent->key < key;
 
 			if (stack_versions[top] != GET_VERSION(ggparent))
-				_xabort(IMPLICIT_ABORT_VERSION_ERROR);
+				TX_ABORT(ABORT_VALIDATION_FAILURE);
 
 			INC_VERSION(gparent);
 			INC_VERSION(parent);
@@ -466,7 +465,7 @@ static inline int _rbt_insert_helper(rbt_t *rbt, rbt_node_t *nodes[2],
 	int top = -1, i;
 	int retries = -1;
 	int insert_fixup_retries = -1, window_retries = -1;
-	unsigned status;
+	tm_begin_ret_t status;
 
 #	ifdef USE_CPU_LOCK
 	int tid = tdata->tid;
@@ -484,9 +483,9 @@ try_from_scratch:
 		if (cpu_locks[my_cpu_lock].owner == tid)
 			pthread_spin_unlock(&cpu_locks[my_cpu_lock].spinlock);
 #		endif
-		pthread_spin_lock(&rbt->spinlock);
+		tm_fallback_lock(&rbt->lock, &tdata->tm);
 		ret = _rbt_insert_helper_serial(rbt, nodes);
-		pthread_spin_unlock(&rbt->spinlock);
+		tm_fallback_unlock(&rbt->lock, &tdata->tm);
 		return ret;
 	}
 
@@ -500,22 +499,21 @@ try_from_scratch:
 		;
 #	endif
 
-	while (rbt->spinlock == 0)
-		;
+	tm_fallback_wait(&rbt->lock);
 
 	tdata->tx_starts++;
 	tdata->tx_stats[1][0][0]++;
-	status = _xbegin();
-	if (status == _XBEGIN_STARTED) {
+	TX_BEGIN(status);
+	if (status == TM_BEGIN_SUCCESS) {
 #		ifdef USE_CPU_LOCK
 		if (cpu_locks[my_cpu_lock].owner > 0 &&
 		    cpu_locks[my_cpu_lock].owner != tid &&
 		    cpu_locks[my_cpu_lock].spinlock == 0)
-			_xabort(0x77);
+			TX_ABORT(0x77);
 #		endif
 
-		if (rbt->spinlock == 0)
-			_xabort(IMPLICIT_ABORT_GLOBAL_LOCK_TAKEN);
+		if (tm_fallback_is_locked(&rbt->lock))
+			TX_ABORT(ABORT_GL_TAKEN);
 
 		/* Empty tree */
 		if (!rbt->root) {
@@ -524,7 +522,7 @@ try_from_scratch:
 
 			INC_VERSION(rbt->root);
 			rbt->version++;
-			_xend();
+			TX_END(0);
 			return 1;
 		}
 
@@ -532,19 +530,18 @@ try_from_scratch:
 		node_stack[++top] = curr;
 		stack_versions[top] = GET_VERSION(curr);
 
-		_xend();
+		TX_END(0);
 	} else {
 		tdata->tx_aborts++;
 		tdata->tx_stats[1][0][1]++;
 
-		if ((status & _XABORT_EXPLICIT) &&
-		     (_XABORT_CODE(status) == IMPLICIT_ABORT_VERSION_ERROR)) {
+		if (ABORT_IS_VALIDATION(status)) {
 			tdata->tx_stats[1][0][5]++;
 			tdata->tx_aborts_version_error++;
-		} else if (status & _XABORT_CAPACITY) {
+		} else if (ABORT_IS_CAPACITY(status)) {
 			tdata->tx_stats[1][0][4]++;
 			tdata->tx_aborts_footprint_overflow++;
-		} else if (status & _XABORT_CONFLICT) {
+		} else if (ABORT_IS_CONFLICT(status)) {
 			tdata->tx_stats[1][0][2]++;
 			tdata->tx_aborts_transaction_conflict++;
 		} else {
@@ -581,25 +578,24 @@ retry_window:
 		}
 #		endif
 
-		while (rbt->spinlock == 0)
-			;
+		tm_fallback_wait(&rbt->lock);
 
 		tdata->tx_starts++;
 		tdata->tx_stats[1][1][0]++;
-		status = _xbegin();
-		if (status == _XBEGIN_STARTED) {
+		TX_BEGIN(status);
+		if (status == TM_BEGIN_SUCCESS) {
 #			ifdef USE_CPU_LOCK
 			if (cpu_locks[my_cpu_lock].owner > 0 && 
 			    cpu_locks[my_cpu_lock].owner != tid &&
 			    cpu_locks[my_cpu_lock].spinlock == 0)
-				_xabort(0x77);
+				TX_ABORT(0x77);
 #			endif
 
-			if (rbt->spinlock == 0)
-				_xabort(IMPLICIT_ABORT_GLOBAL_LOCK_TAKEN);
+			if (tm_fallback_is_locked(&rbt->lock))
+				TX_ABORT(ABORT_GL_TAKEN);
 			/* Check that window version is unchanged. */
 			if (stack_versions[top] != GET_VERSION(curr))
-				_xabort(IMPLICIT_ABORT_VERSION_ERROR);
+				TX_ABORT(ABORT_VALIDATION_FAILURE);
 
 			/* Traverse as deep as we want. */
 			for (i=0; i < PATH_TRAVERSE_LEN; i++) {
@@ -616,7 +612,7 @@ retry_window:
 			/* Did we find the external node we were looking for? */
 			if (IS_EXTERNAL_NODE(curr)) {
 				if (curr->key == nodes[0]->key) {
-					_xend();
+					TX_END(0);
 #					ifdef USE_CPU_LOCK
 					if (cpu_locks[my_cpu_lock].owner == tid) {
 						cpu_locks[my_cpu_lock].owner = -1;
@@ -625,7 +621,7 @@ retry_window:
 #					endif
 					return 0;
 				}
-				_xend();
+				TX_END(0);
 #				ifdef USE_CPU_LOCK
 				if (cpu_locks[my_cpu_lock].owner == tid) {
 					cpu_locks[my_cpu_lock].owner = -1;
@@ -635,7 +631,7 @@ retry_window:
 				break;
 			}
 
-			_xend();
+			TX_END(0);
 #			ifdef USE_CPU_LOCK
 			if (cpu_locks[my_cpu_lock].owner == tid) {
 				cpu_locks[my_cpu_lock].owner = -1;
@@ -649,8 +645,7 @@ retry_window:
 			tdata->tx_aborts++;
 			tdata->tx_stats[1][1][1]++;
 
-			if ((status & _XABORT_EXPLICIT) &&
-			     (_XABORT_CODE(status) == IMPLICIT_ABORT_VERSION_ERROR)) {
+			if (ABORT_IS_VALIDATION(status)) {
 				tdata->tx_stats[1][1][5]++;
 				tdata->tx_aborts_version_error++;
 #				ifdef USE_CPU_LOCK
@@ -660,10 +655,10 @@ retry_window:
 				}
 #				endif
 				goto try_from_scratch;
-			} else if (status & _XABORT_CAPACITY) {
+			} else if (ABORT_IS_CAPACITY(status)) {
 				tdata->tx_stats[1][1][4]++;
 				tdata->tx_aborts_footprint_overflow++;
-			} else if (status & _XABORT_CONFLICT) {
+			} else if (ABORT_IS_CONFLICT(status)) {
 				tdata->tx_stats[1][1][2]++;
 				tdata->tx_aborts_transaction_conflict++;
 			} else {
@@ -698,45 +693,43 @@ retry_insertion:
 #	endif
 
 	/* Last transaction to insert the node and fixup. */
-	while (rbt->spinlock == 0)
-		;
+	tm_fallback_wait(&rbt->lock);
 
 	tdata->tx_starts++;
 	tdata->tx_stats[1][2][0]++;
-	status = _xbegin();
-	if (status == _XBEGIN_STARTED) {
+	TX_BEGIN(status);
+	if (status == TM_BEGIN_SUCCESS) {
 #		ifdef USE_CPU_LOCK
 		if (cpu_locks[my_cpu_lock].owner > 0 &&
 		    cpu_locks[my_cpu_lock].owner != tid &&
 		    cpu_locks[my_cpu_lock].spinlock == 0)
-			_xabort(0x77);
+			TX_ABORT(0x77);
 #		endif
 
-		if (rbt->spinlock == 0)
-			_xabort(IMPLICIT_ABORT_GLOBAL_LOCK_TAKEN);
+		if (tm_fallback_is_locked(&rbt->lock))
+			TX_ABORT(ABORT_GL_TAKEN);
 		/* Check that window version is unchanged. */
 		if (stack_versions[top] != GET_VERSION(curr))
-			_xabort(IMPLICIT_ABORT_VERSION_ERROR);
+			TX_ABORT(ABORT_VALIDATION_FAILURE);
 
 		/* Insert the new node and fixup any violations. */
 		replace_external_node(curr, nodes);
 		INC_VERSION(curr);
 
 		_rbt_insert_fixup(rbt, nodes[0]->key, node_stack, stack_versions, top);
-		_xend();
+		TX_END(0);
 	} else {
 		tdata->tx_aborts++;
 		tdata->tx_stats[1][2][1]++;
 
-		if ((status & _XABORT_EXPLICIT) &&
-		     (_XABORT_CODE(status) == IMPLICIT_ABORT_VERSION_ERROR)) {
+		if (ABORT_IS_VALIDATION(status)) {
 			tdata->tx_stats[1][2][5]++;
 			tdata->tx_aborts_version_error++;
 			goto try_from_scratch;
-		} else if (status & _XABORT_CAPACITY) {
+		} else if (ABORT_IS_CAPACITY(status)) {
 			tdata->tx_stats[1][2][4]++;
 			tdata->tx_aborts_footprint_overflow++;
-		} else if (status & _XABORT_CONFLICT) {
+		} else if (ABORT_IS_CONFLICT(status)) {
 			tdata->tx_stats[1][2][2]++;
 			tdata->tx_aborts_transaction_conflict++;
 		} else {
@@ -771,16 +764,16 @@ static inline void _rbt_delete_fixup(rbt_t *rbt, int key,
 	while (top > 0) {
 		curr = node_stack[top--];
 		if (stack_versions[top+1] != GET_VERSION(curr))
-			_xabort(IMPLICIT_ABORT_VERSION_ERROR);
+			TX_ABORT(ABORT_VALIDATION_FAILURE);
 
 		parent = node_stack[top--];
 		if (stack_versions[top+1] != GET_VERSION(parent))
-			_xabort(IMPLICIT_ABORT_VERSION_ERROR);
+			TX_ABORT(ABORT_VALIDATION_FAILURE);
 
 		if (top >= 0) {
 			gparent = node_stack[top];
 			if (stack_versions[top] != GET_VERSION(gparent))
-				_xabort(IMPLICIT_ABORT_VERSION_ERROR);
+				TX_ABORT(ABORT_VALIDATION_FAILURE);
 		}
 
 		if (IS_RED(curr)) {
@@ -802,7 +795,7 @@ static inline void _rbt_delete_fixup(rbt_t *rbt, int key,
 			sibling->is_red = 0;
 			gparent = (top >= 0) ? node_stack[top] : NULL;
 			if (stack_versions[top] != GET_VERSION(gparent))
-				_xabort(IMPLICIT_ABORT_VERSION_ERROR - 6);
+				TX_ABORT(ABORT_VALIDATION_FAILURE - 6);
 
 			if (gparent) {
 				INC_VERSION(gparent);
@@ -979,7 +972,7 @@ static inline int _rbt_delete_helper(rbt_t *rbt, int key,
 	unsigned long long stack_versions[MAX_PATH_LEN];
 	int top = -1, i;
 	int retries = -1, window_retries = -1, delete_fixup_retries = -1;
-	unsigned status;
+	tm_begin_ret_t status;
 
 #	ifdef USE_CPU_LOCK
 	int tid = tdata->tid;
@@ -996,9 +989,9 @@ try_from_scratch:
 		if (cpu_locks[my_cpu_lock].owner == tid)
 			pthread_spin_unlock(&cpu_locks[my_cpu_lock].spinlock);
 #		endif
-		pthread_spin_lock(&rbt->spinlock);
+		tm_fallback_lock(&rbt->lock, &tdata->tm);
 		ret = _rbt_delete_helper_serial(rbt, key, nodes_to_delete);
-		pthread_spin_unlock(&rbt->spinlock);
+		tm_fallback_unlock(&rbt->lock, &tdata->tm);
 		return ret;
 	}
 
@@ -1012,26 +1005,25 @@ try_from_scratch:
 		;
 #	endif
 
-	while (rbt->spinlock == 0)
-		;
+	tm_fallback_wait(&rbt->lock);
 
 	tdata->tx_starts++;
 	tdata->tx_stats[2][0][0]++;
-	status = _xbegin();
-	if (status == _XBEGIN_STARTED) {
+	TX_BEGIN(status);
+	if (status == TM_BEGIN_SUCCESS) {
 #		ifdef USE_CPU_LOCK
 		if (cpu_locks[my_cpu_lock].owner > 0 &&
 		    cpu_locks[my_cpu_lock].owner != tid &&
 		    cpu_locks[my_cpu_lock].spinlock == 0)
-			_xabort(0x77);
+			TX_ABORT(0x77);
 #		endif
 
-		if (rbt->spinlock == 0)
-			_xabort(IMPLICIT_ABORT_GLOBAL_LOCK_TAKEN);
+		if (tm_fallback_is_locked(&rbt->lock))
+			TX_ABORT(ABORT_GL_TAKEN);
 
 		/* Empty tree */
 		if (!rbt->root) {
-			_xend();
+			TX_END(0);
 			return 0;
 		}
 
@@ -1039,19 +1031,18 @@ try_from_scratch:
 		node_stack[++top] = curr;
 		stack_versions[top] = GET_VERSION(curr);
 
-		_xend();
+		TX_END(0);
 	} else {
 		tdata->tx_aborts++;
 		tdata->tx_stats[2][0][1]++;
 
-		if ((status & _XABORT_EXPLICIT) &&
-		     (_XABORT_CODE(status) == IMPLICIT_ABORT_VERSION_ERROR)) {
+		if (ABORT_IS_VALIDATION(status)) {
 			tdata->tx_stats[2][0][5]++;
 			tdata->tx_aborts_version_error++;
-		} else if (status & _XABORT_CAPACITY) {
+		} else if (ABORT_IS_CAPACITY(status)) {
 			tdata->tx_stats[2][0][4]++;
 			tdata->tx_aborts_footprint_overflow++;
-		} else if (status & _XABORT_CONFLICT) {
+		} else if (ABORT_IS_CONFLICT(status)) {
 			tdata->tx_stats[2][0][2]++;
 			tdata->tx_aborts_transaction_conflict++;
 		} else {
@@ -1081,25 +1072,24 @@ retry_window:
 			;
 #		endif
 
-		while (rbt->spinlock == 0)
-			;
+		tm_fallback_wait(&rbt->lock);
 
 		tdata->tx_starts++;
 		tdata->tx_stats[2][1][0]++;
-		status = _xbegin();
-		if (status == _XBEGIN_STARTED) {
+		TX_BEGIN(status);
+		if (status == TM_BEGIN_SUCCESS) {
 #			ifdef USE_CPU_LOCK
 			if (cpu_locks[my_cpu_lock].owner > 0 &&
 			    cpu_locks[my_cpu_lock].owner != tid &&
 			    cpu_locks[my_cpu_lock].spinlock == 0)
-				_xabort(0x77);
+				TX_ABORT(0x77);
 #			endif
 
-			if (rbt->spinlock == 0)
-				_xabort(IMPLICIT_ABORT_GLOBAL_LOCK_TAKEN);
+			if (tm_fallback_is_locked(&rbt->lock))
+				TX_ABORT(ABORT_GL_TAKEN);
 			/* Check that window version is unchanged. */
 			if (stack_versions[top] != GET_VERSION(curr))
-				_xabort(IMPLICIT_ABORT_VERSION_ERROR);
+				TX_ABORT(ABORT_VALIDATION_FAILURE);
 
 			/* Traverse as deep as we want. */
 			for (i=0; i < PATH_TRAVERSE_LEN; i++) {
@@ -1116,7 +1106,7 @@ retry_window:
 			/* External node reached. */
 			if (IS_EXTERNAL_NODE(curr)) {
 				if (curr->key != key) {
-					_xend();
+					TX_END(0);
 					#ifdef USE_CPU_LOCK
 					/* FIXME free cpu_lock here? */
 					if (cpu_locks[my_cpu_lock].owner == tid)
@@ -1124,25 +1114,24 @@ retry_window:
 					#endif
 					return 0;
 				}
-				_xend();
+				TX_END(0);
 				break;
 			}
 
-			_xend();
+			TX_END(0);
 			continue;
 		} else {
 			tdata->tx_aborts++;
 			tdata->tx_stats[2][1][1]++;
 
-			if ((status & _XABORT_EXPLICIT) &&
-			     (_XABORT_CODE(status) == IMPLICIT_ABORT_VERSION_ERROR)) {
+			if (ABORT_IS_VALIDATION(status)) {
 				tdata->tx_stats[2][1][5]++;
 				tdata->tx_aborts_version_error++;
 				goto try_from_scratch;
-			} else if (status & _XABORT_CAPACITY) {
+			} else if (ABORT_IS_CAPACITY(status)) {
 				tdata->tx_stats[2][1][4]++;
 				tdata->tx_aborts_footprint_overflow++;
-			} else if (status & _XABORT_CONFLICT) {
+			} else if (ABORT_IS_CONFLICT(status)) {
 				tdata->tx_stats[2][1][2]++;
 				tdata->tx_aborts_transaction_conflict++;
 			} else {
@@ -1177,25 +1166,24 @@ retry_deletion:
 #	endif
 
 	/* Last transaction to delete the node and fixup. */
-	while (rbt->spinlock == 0)
-		;
+	tm_fallback_wait(&rbt->lock);
 
 	tdata->tx_starts++;
 	tdata->tx_stats[2][2][0]++;
-	status = _xbegin();
-	if (status == _XBEGIN_STARTED) {
+	TX_BEGIN(status);
+	if (status == TM_BEGIN_SUCCESS) {
 #		ifdef USE_CPU_LOCK
 		if (cpu_locks[my_cpu_lock].owner > 0 &&
 		    cpu_locks[my_cpu_lock].owner != tid &&
 		    cpu_locks[my_cpu_lock].spinlock == 0)
-			_xabort(0x77);
+			TX_ABORT(0x77);
 #		endif
 
-		if (rbt->spinlock == 0)
-			_xabort(IMPLICIT_ABORT_GLOBAL_LOCK_TAKEN);
+		if (tm_fallback_is_locked(&rbt->lock))
+			TX_ABORT(ABORT_GL_TAKEN);
 		/* Check that window version is unchanged. */
 		if (stack_versions[top] != GET_VERSION(curr))
-			_xabort(IMPLICIT_ABORT_VERSION_ERROR);
+			TX_ABORT(ABORT_VALIDATION_FAILURE);
 
 		/* Delete the node and fixup any violations. */
 		parent = (top >= 1) ? node_stack[top-1] : NULL;
@@ -1207,7 +1195,7 @@ retry_deletion:
 			rbt->root = NULL;
 			INC_VERSION(curr);
 			rbt->version++;
-			_xend();
+			TX_END(0);
 #			ifdef USE_CPU_LOCK
 			if (cpu_locks[my_cpu_lock].owner == tid) {
 				cpu_locks[my_cpu_lock].owner = -1;
@@ -1217,7 +1205,7 @@ retry_deletion:
 			return 1; /* No fixup necessary. */
 		} else if (!gparent) { /* We don't have gparent so parent is the root. */
 			if (stack_versions[top-1] != GET_VERSION(parent))
-				_xabort(IMPLICIT_ABORT_VERSION_ERROR);
+				TX_ABORT(ABORT_VALIDATION_FAILURE);
 
 			int dir_from_parent = parent->key < key;
 	
@@ -1228,7 +1216,7 @@ retry_deletion:
 			INC_VERSION(curr);
 			INC_VERSION(parent->link[!dir_from_parent]);
 			rbt->version++;
-			_xend();
+			TX_END(0);
 #			ifdef USE_CPU_LOCK
 			if (cpu_locks[my_cpu_lock].owner == tid) {
 				cpu_locks[my_cpu_lock].owner = -1;
@@ -1239,7 +1227,7 @@ retry_deletion:
 		} else {
 			if (stack_versions[top-1] != GET_VERSION(parent) ||
 			    stack_versions[top-2] != GET_VERSION(gparent))
-				_xabort(IMPLICIT_ABORT_VERSION_ERROR);
+				TX_ABORT(ABORT_VALIDATION_FAILURE);
 
 			INC_VERSION(curr);
 			INC_VERSION(parent);
@@ -1266,7 +1254,7 @@ retry_deletion:
 			if (IS_BLACK(parent))
 				_rbt_delete_fixup(rbt, key, node_stack, stack_versions, top);
 
-			_xend();
+			TX_END(0);
 #			ifdef USE_CPU_LOCK
 			if (cpu_locks[my_cpu_lock].owner == tid) {
 				cpu_locks[my_cpu_lock].owner = -1;
@@ -1282,15 +1270,14 @@ retry_deletion:
 		tdata->tx_aborts++;
 		tdata->tx_stats[2][2][1]++;
 
-		if ((status & _XABORT_EXPLICIT) &&
-		     (_XABORT_CODE(status) == IMPLICIT_ABORT_VERSION_ERROR)) {
+		if (ABORT_IS_VALIDATION(status)) {
 			tdata->tx_stats[2][2][5]++;
 			tdata->tx_aborts_version_error++;
 			goto try_from_scratch;
-		} else if (status & _XABORT_CAPACITY) {
+		} else if (ABORT_IS_CAPACITY(status)) {
 			tdata->tx_stats[2][2][4]++;
 			tdata->tx_aborts_footprint_overflow++;
-		} else if (status & _XABORT_CONFLICT) {
+		} else if (ABORT_IS_CONFLICT(status)) {
 			tdata->tx_stats[2][2][2]++;
 			tdata->tx_aborts_transaction_conflict++;
 		} else {
@@ -1517,7 +1504,10 @@ void *rbt_new()
 
 void *rbt_thread_data_new(int tid)
 {
-	return htm_fg_tdata_new(tid);
+	htm_fg_tdata_t *tdata = htm_fg_tdata_new(tid);
+
+	tm_tdata_init(&tdata->tm, tid, clargs.tx_policy, clargs.tx_retries);
+	return tdata;
 }
 
 void rbt_thread_data_print(void *thread_data)
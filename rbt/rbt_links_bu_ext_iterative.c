@@ -6,6 +6,7 @@
 
 #if defined(SYNC_CG_HTM)
 #	include "htm.h"
+#	include "clargs.h"
 #	if !defined(TX_NUM_RETRIES)
 #		define TX_NUM_RETRIES 20
 #	endif
@@ -14,6 +15,13 @@
 #include "arch.h" /* CACHE_LINE_SIZE */
 #include "alloc.h"
 #include "rbt_links_td_ext_thread_data.h" /* verbose stats */
+#include "key.h"
+#include "rbt/iface.h"
+
+//> Written against int keys only (see key.h).
+#if KEY_BITS != 32 || defined(KEY_CMP)
+#	error "this tree supports only the default int keys"
+#endif
 
 #define IS_EXTERNAL_NODE(node) \
     ( (node)->link[0] == NULL && (node)->link[1] == NULL )
@@ -34,8 +42,10 @@ typedef struct rbt_node {
 typedef struct {
 	rbt_node_t *root;
 
-#	if defined(SYNC_CG_SPINLOCK) || defined(SYNC_CG_HTM)
+#	if defined(SYNC_CG_SPINLOCK)
 	pthread_spinlock_t rbt_lock;
+#	elif defined(SYNC_CG_HTM)
+	tm_fallback_lock_t rbt_lock;
 #	endif
 } rbt_t;
 
@@ -60,8 +70,10 @@ static inline rbt_t *_rbt_new_helper()
 	XMALLOC(ret, 1);
 	ret->root = NULL;
 
-#	if defined(SYNC_CG_SPINLOCK) || defined(SYNC_CG_HTM)
+#	if defined(SYNC_CG_SPINLOCK)
 	pthread_spin_init(&ret->rbt_lock, PTHREAD_PROCESS_SHARED);
+#	elif defined(SYNC_CG_HTM)
+	tm_fallback_lock_init(&ret->rbt_lock);
 #	endif
 
 	return ret;
@@ -680,7 +692,7 @@ void *rbt_thread_data_new(int tid)
 	td_ext_thread_data_t *data = td_ext_thread_data_new(tid);
 
 #	if defined(SYNC_CG_HTM)
-	data->priv = tx_thread_data_new(tid);
+	data->priv = tx_thread_data_new(tid, clargs.tx_policy, clargs.tx_retries);
 #	endif
 
 	return data;
@@ -725,6 +737,29 @@ void rbt_thread_data_add(void *d1, void *d2, void *dst)
 #	endif
 }
 
+void rbt_thread_data_free(void *thread_data)
+{
+	td_ext_thread_data_t *tdata = thread_data;
+
+#	if defined(SYNC_CG_HTM)
+	tx_thread_data_free(tdata->priv);
+#	endif
+
+	free(tdata);
+}
+
+int rbt_thread_data_tx_stats(void *thread_data, rbt_tx_stats_t *stats)
+{
+#	if defined(SYNC_CG_HTM)
+	td_ext_thread_data_t *tdata = thread_data;
+	tx_thread_data_t *tx = tdata->priv;
+	TM_STATS_COPY(stats, &tx->tm.stats);
+	return 0;
+#	else
+	return -1;
+#	endif
+}
+
 int rbt_lookup(void *rbt, void *thread_data, int key)
 {
 	int ret;
@@ -814,6 +849,24 @@ int rbt_delete(void *rbt, void *thread_data, int key)
 	return ret;
 }
 
+//> Key-value accessors are not supported.
+int rbt_get(void *rbt, void *thread_data, int key, void **value)
+{
+	return -1;
+}
+
+int rbt_update(void *rbt, void *thread_data, int key, void *value)
+{
+	return -1;
+}
+
+//> Range scans are not supported.
+int rbt_range(void *rbt, void *thread_data, int lo, int hi,
+              void (*cb)(int key, void *value, void *arg), void *arg)
+{
+	return -1;
+}
+
 int rbt_validate(void *rbt)
 {
 	int ret;
@@ -821,6 +874,21 @@ int rbt_validate(void *rbt)
 	return ret;
 }
 
+static void _rbt_free_nodes(rbt_node_t *root)
+{
+	if (!root)
+		return;
+	_rbt_free_nodes(root->link[0]);
+	_rbt_free_nodes(root->link[1]);
+	free(root);
+}
+
+void rbt_free(void *rbt)
+{
+	_rbt_free_nodes(((rbt_t *)rbt)->root);
+	free(rbt);
+}
+
 int rbt_warmup(void *rbt, int nr_nodes, int max_key, 
                unsigned int seed, int force)
 {
@@ -829,6 +897,18 @@ int rbt_warmup(void *rbt, int nr_nodes, int max_key,
 	return ret;
 }
 
+//> Bulk loading is not supported, the benchmark falls back to rbt_warmup().
+int rbt_bulk_load(void *rbt, void *thread_data, bulk_load_t *bl, int tid)
+{
+	return -1;
+}
+
+//> Node memory is not accounted for.
+int rbt_mem_stats(void *rbt, rbt_mem_stats_t *stats)
+{
+	return -1;
+}
+
 char *rbt_name()
 {
 	return "links_bu_external";
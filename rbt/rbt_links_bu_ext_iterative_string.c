@@ -7,6 +7,7 @@
 
 #if defined(SYNC_CG_HTM)
 #	include "htm.h"
+#	include "clargs.h"
 #	if !defined(TX_NUM_RETRIES)
 #		define TX_NUM_RETRIES 20
 #	endif
@@ -34,8 +35,10 @@ typedef struct rbt_node {
 typedef struct {
 	rbt_node_t *root;
 
-#	if defined(SYNC_CG_SPINLOCK) || defined(SYNC_CG_HTM)
+#	if defined(SYNC_CG_SPINLOCK)
 	pthread_spinlock_t rbt_lock;
+#	elif defined(SYNC_CG_HTM)
+	tm_fallback_lock_t rbt_lock;
 #	endif
 } rbt_t;
 
@@ -60,8 +63,10 @@ static inline rbt_t *_rbt_new_helper()
 	XMALLOC(ret, 1);
 	ret->root = NULL;
 
-#	if defined(SYNC_CG_SPINLOCK) || defined(SYNC_CG_HTM)
+#	if defined(SYNC_CG_SPINLOCK)
 	pthread_spin_init(&ret->rbt_lock, PTHREAD_PROCESS_SHARED);
+#	elif defined(SYNC_CG_HTM)
+	tm_fallback_lock_init(&ret->rbt_lock);
 #	endif
 
 	return ret;
@@ -716,7 +721,7 @@ void *rbt_thread_data_new(int tid)
 	td_ext_thread_data_t *data = td_ext_thread_data_new(tid);
 
 #	if defined(SYNC_CG_HTM)
-	data->priv = tx_thread_data_new(tid);
+	data->priv = tx_thread_data_new(tid, clargs.tx_policy, clargs.tx_retries);
 #	endif
 
 	return data;
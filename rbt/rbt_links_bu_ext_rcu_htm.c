@@ -4,6 +4,15 @@
 
 #include "arch.h" /* CACHE_LINE_SIZE */
 #include "alloc.h"
+#include "tm.h"
+#include "clargs.h"
+#include "key.h"
+#include "rbt/iface.h"
+
+//> Written against int keys only (see key.h).
+#if KEY_BITS != 32 || defined(KEY_CMP)
+#	error "this tree supports only the default int keys"
+#endif
 
 /******************************************************************************/
 /* A simple hash table implementation.                                        */
@@ -74,8 +83,7 @@ void ht_print(ht_t *ht)
 
 typedef struct {
 	int tid;
-	long long unsigned tx_starts, tx_aborts, 
-	                   tx_aborts_explicit_validation, lacqs;
+	tm_tdata_t tm;
 	unsigned int next_node_to_allocate;
 	ht_t *ht;
 } tdata_t;
@@ -85,9 +93,7 @@ static inline tdata_t *tdata_new(int tid)
 	tdata_t *ret;
 	XMALLOC(ret, 1);
 	ret->tid = tid;
-	ret->tx_starts = 0;
-	ret->tx_aborts = 0;
-	ret->lacqs = 0;
+	tm_tdata_init(&ret->tm, tid, clargs.tx_policy, clargs.tx_retries);
 	ret->next_node_to_allocate = 0;
 	ret->ht = ht_new();
 	return ret;
@@ -95,49 +101,14 @@ static inline tdata_t *tdata_new(int tid)
 
 static inline void tdata_print(tdata_t *tdata)
 {
-	printf("TID %3d: %llu %llu %llu ( %llu )\n", tdata->tid, tdata->tx_starts,
-	      tdata->tx_aborts, tdata->tx_aborts_explicit_validation, tdata->lacqs);
+	tm_tdata_print(&tdata->tm);
 }
 
 static inline void tdata_add(tdata_t *d1, tdata_t *d2, tdata_t *dst)
 {
-	dst->tx_starts = d1->tx_starts + d2->tx_starts;
-	dst->tx_aborts = d1->tx_aborts + d2->tx_aborts;
-	dst->tx_aborts_explicit_validation = d1->tx_aborts_explicit_validation +
-	                                     d2->tx_aborts_explicit_validation;
-	dst->lacqs = d1->lacqs + d2->lacqs;
+	tm_tdata_add(&d1->tm, &d2->tm, &dst->tm);
 }
 
-/* TM Interface. */
-#if !defined(TX_NUM_RETRIES)
-#	define TX_NUM_RETRIES 20
-#endif
-
-#ifdef __POWERPC64__
-#	include <htmintrin.h>
-	typedef int tm_begin_ret_t;
-#	define LOCK_FREE 0
-#	define TM_BEGIN_SUCCESS 1
-#	define ABORT_VALIDATION_FAILURE 0xee
-#	define ABORT_GL_TAKEN           0xff
-#	define TX_ABORT(code) __builtin_tabort(code)
-#	define TX_BEGIN(code) __builtin_tbegin(0)
-#	define TX_END(code)   __builtin_tend(0)
-#else
-#	include "rtm.h"
-	typedef unsigned tm_begin_ret_t;
-#	define LOCK_FREE 1
-#	define TM_BEGIN_SUCCESS _XBEGIN_STARTED
-#	define ABORT_VALIDATION_FAILURE 0xee
-#	define ABORT_GL_TAKEN           0xff
-#	define ABORT_IS_CONFLICT(status) ((status) & _XABORT_CONFLICT)
-#	define ABORT_IS_EXPLICIT(status) ((status) & _XABORT_EXPLICIT)
-#	define ABORT_CODE(status) _XABORT_CODE(status)
-#	define TX_ABORT(code) _xabort(code)
-#	define TX_BEGIN(code) _xbegin()
-#	define TX_END(code)   _xend()
-#endif
-/*****************/
 
 typedef enum {
 	RED = 0,
@@ -159,10 +130,11 @@ typedef struct rbt_node {
 typedef struct {
 	rbt_node_t *root;
 
-	pthread_spinlock_t rbt_lock;
+	tm_fallback_lock_t rbt_lock;
 } rbt_t;
 
 unsigned int next_node_to_allocate;
+#define NODES_PER_ALLOCATOR 10000000
 rbt_node_t *per_thread_node_allocators[56];
 
 #define IS_EXTERNAL_NODE(node) \
@@ -211,7 +183,7 @@ rbt_t *_rbt_new_helper()
 	XMALLOC(rbt, 1);
 	rbt->root = NULL;
 
-	pthread_spin_init(&rbt->rbt_lock, PTHREAD_PROCESS_SHARED);
+	tm_fallback_lock_init(&rbt->rbt_lock);
 
 	return rbt;
 }
@@ -459,15 +431,17 @@ int _rbt_insert_helper(rbt_t *rbt, int key, void *value, tdata_t *tdata)
 	int connection_point_stack_index = -1;
 	int i;
 
+	tm_op_begin(&tdata->tm);
+
 try_from_scratch:
 
 	/* Global lock fallback. */
-	if (++retries >= TX_NUM_RETRIES) {
-		tdata->lacqs++;
+	if (!tm_retry_allowed(&tdata->tm, ++retries)) {
+		tdata->tm.stats.lacqs++;
 //		pthread_spin_lock(&rbt->rbt_lock);
 //		place = _traverse(rbt, key);
 //		ret = _insert(rbt, place, new_nodes);
-//		pthread_spin_unlock(&rbt->rbt_lock);
+//		tm_fallback_unlock(&rbt->rbt_lock, &tdata->tm);
 //		return ret;
 		return 0;
 	}
@@ -665,13 +639,12 @@ try_from_scratch:
 
 validate_and_connect_copy:
 	/* Transactional verification. */
-	while (rbt->rbt_lock != LOCK_FREE)
-		;
+	tm_fallback_wait(&rbt->rbt_lock);
 
-	tdata->tx_starts++;
-	status = TX_BEGIN(0);
+	tm_tx_started(&tdata->tm);
+	TX_BEGIN(status);
 	if (status == TM_BEGIN_SUCCESS) {
-		if (rbt->rbt_lock != LOCK_FREE)
+		if (tm_fallback_is_locked(&rbt->rbt_lock))
 			TX_ABORT(ABORT_GL_TAKEN);
 
 		// Verify that the access path is untouched.
@@ -728,11 +701,10 @@ validate_and_connect_copy:
 		}
 
 		TX_END(0);
+		tm_tx_committed(&tdata->tm);
 	} else {
-		tdata->tx_aborts++;
-		if (ABORT_IS_EXPLICIT(status) && 
-		    ABORT_CODE(status) == ABORT_VALIDATION_FAILURE) {
-			tdata->tx_aborts_explicit_validation++;
+		tm_tx_aborted(&tdata->tm, status);
+		if (ABORT_IS_VALIDATION(status)) {
 			goto try_from_scratch;
 		} else {
 			goto validate_and_connect_copy;
@@ -885,15 +857,17 @@ static int _rbt_delete_helper(rbt_t *rbt, int key, rbt_node_t *nodes_to_free[2],
 	int connection_point_stack_index = -1;
 	int i;
 
+	tm_op_begin(&tdata->tm);
+
 try_from_scratch:
 
 	/* Global lock fallback. */
-	if (++retries >= TX_NUM_RETRIES) {
-		tdata->lacqs++;
+	if (!tm_retry_allowed(&tdata->tm, ++retries)) {
+		tdata->tm.stats.lacqs++;
 //		pthread_spin_lock(&rbt->rbt_lock);
 //		place = _traverse(rbt, key);
 //		ret = _delete(rbt, key, place, nodes_to_free);
-//		pthread_spin_unlock(&rbt->rbt_lock);
+//		tm_fallback_unlock(&rbt->rbt_lock, &tdata->tm);
 //		return ret;
 		return 0;
 	}
@@ -1251,13 +1225,12 @@ try_from_scratch:
 
 validate_and_connect_copy:
 	/* Transactional verification. */
-	while (rbt->rbt_lock != LOCK_FREE)
-		;
+	tm_fallback_wait(&rbt->rbt_lock);
 
-	tdata->tx_starts++;
-	status = TX_BEGIN(0);
+	tm_tx_started(&tdata->tm);
+	TX_BEGIN(status);
 	if (status == TM_BEGIN_SUCCESS) {
-		if (rbt->rbt_lock != LOCK_FREE)
+		if (tm_fallback_is_locked(&rbt->rbt_lock))
 			TX_ABORT(ABORT_GL_TAKEN);
 
 		// Verify that the access path is untouched.
@@ -1314,11 +1287,10 @@ validate_and_connect_copy:
 		}
 
 		TX_END(0);
+		tm_tx_committed(&tdata->tm);
 	} else {
-		tdata->tx_aborts++;
-		if (ABORT_IS_EXPLICIT(status) && 
-		    ABORT_CODE(status) == ABORT_VALIDATION_FAILURE) {
-			tdata->tx_aborts_explicit_validation++;
+		tm_tx_aborted(&tdata->tm, status);
+		if (ABORT_IS_VALIDATION(status)) {
 			goto try_from_scratch;
 		} else {
 			goto validate_and_connect_copy;
@@ -1464,8 +1436,8 @@ void *rbt_new()
 void *rbt_thread_data_new(int tid)
 {
 	// Pre allocate a large amount of nodes for each thread
-	per_thread_node_allocators[tid] = malloc(10000000*sizeof(rbt_node_t));
-	memset(per_thread_node_allocators[tid], 0, 10000000*sizeof(rbt_node_t));
+	per_thread_node_allocators[tid] = malloc(NODES_PER_ALLOCATOR*sizeof(rbt_node_t));
+	memset(per_thread_node_allocators[tid], 0, NODES_PER_ALLOCATOR*sizeof(rbt_node_t));
 
 	tdata_t *tdata = tdata_new(tid);
 
@@ -1484,6 +1456,25 @@ void rbt_thread_data_add(void *d1, void *d2, void *dst)
 	tdata_add(d1, d2, dst);
 }
 
+void rbt_thread_data_free(void *thread_data)
+{
+	tdata_t *tdata = thread_data;
+
+	if (tdata->tid >= 0) {
+		free(per_thread_node_allocators[tdata->tid]);
+		per_thread_node_allocators[tdata->tid] = NULL;
+	}
+	free(tdata->ht);
+	free(tdata);
+}
+
+int rbt_thread_data_tx_stats(void *thread_data, rbt_tx_stats_t *stats)
+{
+	tdata_t *tdata = thread_data;
+	TM_STATS_COPY(stats, &tdata->tm.stats);
+	return 0;
+}
+
 int rbt_lookup(void *rbt, void *thread_data, int key)
 {
 	int ret = 0;
@@ -1523,6 +1514,24 @@ int rbt_delete(void *rbt, void *thread_data, int key)
 	return ret;
 }
 
+//> Key-value accessors are not supported.
+int rbt_get(void *rbt, void *thread_data, int key, void **value)
+{
+	return -1;
+}
+
+int rbt_update(void *rbt, void *thread_data, int key, void *value)
+{
+	return -1;
+}
+
+//> Range scans are not supported.
+int rbt_range(void *rbt, void *thread_data, int lo, int hi,
+              void (*cb)(int key, void *value, void *arg), void *arg)
+{
+	return -1;
+}
+
 int rbt_validate(void *rbt)
 {
 	int ret;
@@ -1530,6 +1539,35 @@ int rbt_validate(void *rbt)
 	return ret;
 }
 
+//> The path copies come from the allocators, see rbt_node_new_copy().
+static int rbt_node_in_allocator(rbt_node_t *node)
+{
+	int i;
+
+	for (i=0; i < 56; i++)
+		if (per_thread_node_allocators[i] &&
+		    node >= per_thread_node_allocators[i] &&
+		    node < per_thread_node_allocators[i] + NODES_PER_ALLOCATOR)
+			return 1;
+	return 0;
+}
+
+static void _rbt_free_nodes(rbt_node_t *root)
+{
+	if (!root)
+		return;
+	_rbt_free_nodes(root->left);
+	_rbt_free_nodes(root->right);
+	if (!rbt_node_in_allocator(root))
+		free(root);
+}
+
+void rbt_free(void *rbt)
+{
+	_rbt_free_nodes(((rbt_t *)rbt)->root);
+	free(rbt);
+}
+
 int rbt_warmup(void *rbt, int nr_nodes, int max_key, 
                unsigned int seed, int force)
 {
@@ -1538,6 +1576,18 @@ int rbt_warmup(void *rbt, int nr_nodes, int max_key,
 	return ret;
 }
 
+//> Bulk loading is not supported, the benchmark falls back to rbt_warmup().
+int rbt_bulk_load(void *rbt, void *thread_data, bulk_load_t *bl, int tid)
+{
+	return -1;
+}
+
+//> Node memory is not accounted for.
+int rbt_mem_stats(void *rbt, rbt_mem_stats_t *stats)
+{
+	return -1;
+}
+
 char *rbt_name()
 {
 	return "links_bu_rcu_htm_external";
@@ -1,9 +1,16 @@
 #include <assert.h>
 #include <pthread.h> //> pthread_spinlock_t
-#include <string.h>  //> memset() for per thread allocator
+#include <string.h>  //> memset()
 
 #include "arch.h" /* CACHE_LINE_SIZE */
 #include "alloc.h"
+#include "key.h"
+#include "rbt/iface.h"
+#include "node_layout.h"
+#include "node_pool.h"
+#include "node_stats.h"
+#include "tm.h"
+#include "clargs.h"
 
 /******************************************************************************/
 /* A simple hash table implementation.                                        */
@@ -73,12 +80,14 @@ void ht_print(ht_t *ht)
 }
 /******************************************************************************/
 
-typedef struct {
+typedef struct tdata_s {
 	int tid;
-	long long unsigned tx_starts, tx_aborts, 
-	                   tx_aborts_explicit_validation, lacqs;
-	unsigned int next_node_to_allocate;
+	tm_tdata_t tm;
+	node_pool_t node_pool;
 	ht_t *ht;
+
+	//> The other threads of the tree, see rbt_free().
+	struct tdata_s *next;
 } tdata_t;
 
 static inline tdata_t *tdata_new(int tid)
@@ -86,60 +95,23 @@ static inline tdata_t *tdata_new(int tid)
 	tdata_t *ret;
 	XMALLOC(ret, 1);
 	ret->tid = tid;
-	ret->tx_starts = 0;
-	ret->tx_aborts = 0;
-	ret->tx_aborts_explicit_validation = 0;
-	ret->lacqs = 0;
-	ret->next_node_to_allocate = 0;
+	tm_tdata_init(&ret->tm, tid, clargs.tx_policy, clargs.tx_retries);
+	node_pool_init(&ret->node_pool, 0, 0);
 	ret->ht = ht_new();
+	ret->next = NULL;
 	return ret;
 }
 
 static inline void tdata_print(tdata_t *tdata)
 {
-	printf("TID %3d: %llu %llu %llu ( %llu )\n", tdata->tid, tdata->tx_starts,
-	      tdata->tx_aborts, tdata->tx_aborts_explicit_validation, tdata->lacqs);
+	tm_tdata_print(&tdata->tm);
 }
 
 static inline void tdata_add(tdata_t *d1, tdata_t *d2, tdata_t *dst)
 {
-	dst->tx_starts = d1->tx_starts + d2->tx_starts;
-	dst->tx_aborts = d1->tx_aborts + d2->tx_aborts;
-	dst->tx_aborts_explicit_validation = d1->tx_aborts_explicit_validation +
-	                                     d2->tx_aborts_explicit_validation;
-	dst->lacqs = d1->lacqs + d2->lacqs;
+	tm_tdata_add(&d1->tm, &d2->tm, &dst->tm);
 }
 
-/* TM Interface. */
-#if !defined(TX_NUM_RETRIES)
-#	define TX_NUM_RETRIES 20
-#endif
-
-#ifdef __POWERPC64__
-#	include <htmintrin.h>
-	typedef int tm_begin_ret_t;
-#	define LOCK_FREE 0
-#	define TM_BEGIN_SUCCESS 1
-#	define ABORT_VALIDATION_FAILURE 0xee
-#	define ABORT_GL_TAKEN           0xff
-#	define TX_ABORT(code) __builtin_tabort(code)
-#	define TX_BEGIN(code) __builtin_tbegin(0)
-#	define TX_END(code)   __builtin_tend(0)
-#else
-#	include "rtm.h"
-	typedef unsigned tm_begin_ret_t;
-#	define LOCK_FREE 1
-#	define TM_BEGIN_SUCCESS _XBEGIN_STARTED
-#	define ABORT_VALIDATION_FAILURE 0xee
-#	define ABORT_GL_TAKEN           0xff
-#	define ABORT_IS_CONFLICT(status) ((status) & _XABORT_CONFLICT)
-#	define ABORT_IS_EXPLICIT(status) ((status) & _XABORT_EXPLICIT)
-#	define ABORT_CODE(status) _XABORT_CODE(status)
-#	define TX_ABORT(code) _xabort(code)
-#	define TX_BEGIN(code) _xbegin()
-#	define TX_END(code)   _xend()
-#endif
-/*****************/
 
 #define MAX_HEIGHT 50
 
@@ -148,17 +120,23 @@ typedef enum {
 	BLACK
 } color_t;
 
+//> See lib/node_layout.h for the NODE_LAYOUT_* build options.
 typedef struct rbt_node {
+#if defined(NODE_LAYOUT_SPLIT)
+	//> Hot: read at every level of a traversal.
+	struct rbt_node *left, *right;
+	map_key_t key;
+
+	//> Cold: read only by updaters and when the key is found.
+	color_t color;
+	void *data;
+#else
 	color_t color;
-	int key;
+	map_key_t key;
 	void *data;
 	struct rbt_node *left, *right;
-
-//	char padding[CACHE_LINE_SIZE - sizeof(color_t) - sizeof(int) -
-//	             sizeof(void *) - 2 * sizeof(struct rbt_node *)];
-//} __attribute__((aligned(CACHE_LINE_SIZE))) rbt_node_t;
-} __attribute__((packed)) rbt_node_t;
-//} __attribute__((aligned(CACHE_LINE_SIZE))) rbt_node_t;
+#endif
+} NODE_ATTRS rbt_node_t;
 
 typedef struct {
 	rbt_node_t *root;
@@ -167,20 +145,37 @@ typedef struct {
 	// same cache line with the lock.
 	char padding[CACHE_LINE_SIZE - sizeof(rbt_node_t *)];
 
-	pthread_spinlock_t rbt_lock;
+	tm_fallback_lock_t rbt_lock;
 } rbt_t;
 
+//> Capacity of each thread's node pool, beyond which nodes are malloc()ed.
 #define NODES_PER_ALLOCATOR 10000000
-rbt_node_t *per_thread_node_allocators[88];
+
+//> Nodes are never reclaimed, the ones that path copies replace leak.
+static node_stats_t rbt_node_stats;
+//> The thread data of all threads, whose pools hold most of the nodes.
+static tdata_t *rbt_tdatas;
+
+//> Nodes outside the pools were malloc()ed and are free()d one by one.
+static int rbt_node_in_pool(struct rbt_node *node)
+{
+	tdata_t *tdata;
+
+	for (tdata=rbt_tdatas; tdata; tdata=tdata->next)
+		if (node_pool_owns(&tdata->node_pool, node))
+			return 1;
+	return 0;
+}
 
 #define IS_BLACK(node) ( !(node) || (node)->color == BLACK )
 #define IS_RED(node) ( !IS_BLACK(node) )
 
-static rbt_node_t *rbt_node_new(int key, color_t color, void *data)
+static rbt_node_t *rbt_node_new(map_key_t key, color_t color, void *data)
 {
 	rbt_node_t *node;
 	
-	XMALLOC(node, 1);
+	XMALLOC_ALIGNED(node, 1, NODE_ALIGN);
+	node_stats_alloc(&rbt_node_stats, 1);
 	node->color = color;
 	node->key = key;
 	node->data = data;
@@ -194,6 +189,7 @@ static void rbt_node_copy(rbt_node_t *dest, rbt_node_t *src)
 {
 	dest->color = src->color;
 	dest->key = src->key;
+	dest->data = src->data;
 	dest->left = src->left;
 	dest->right = src->right;
 	__sync_synchronize();
@@ -201,12 +197,15 @@ static void rbt_node_copy(rbt_node_t *dest, rbt_node_t *src)
 
 static rbt_node_t *rbt_node_new_copy(rbt_node_t *src, tdata_t *tdata)
 {
-	rbt_node_t *node;
-	if (tdata->next_node_to_allocate >= NODES_PER_ALLOCATOR)
-		node = rbt_node_new(0, BLACK, NULL);
+	rbt_node_t *node = node_pool_alloc(&tdata->node_pool);
+	if (node)
+		node_stats_alloc(&rbt_node_stats, 1);
 	else
-		node = &per_thread_node_allocators[tdata->tid][tdata->next_node_to_allocate++];
+		node = rbt_node_new(0, BLACK, NULL);
 	rbt_node_copy(node, src);
+	//> Values are updated in place (_rbt_update_helper()), so the copy is
+	//> only valid as long as the original value is still there.
+	ht_insert(tdata->ht, &src->data, node->data);
 	return node;
 
 }
@@ -218,7 +217,7 @@ rbt_t *_rbt_new_helper()
 	XMALLOC(rbt, 1);
 	rbt->root = NULL;
 
-	pthread_spin_init(&rbt->rbt_lock, PTHREAD_PROCESS_SHARED);
+	tm_fallback_lock_init(&rbt->rbt_lock);
 
 	return rbt;
 }
@@ -254,53 +253,114 @@ static inline rbt_node_t *rbt_rotate_right(rbt_node_t *node)
  * the node that will be the parent of the inserted node.
  * In the case of an empty tree both `parent` and `leaf` are NULL.
  **/
-static inline void _traverse(rbt_t *rbt, int key, rbt_node_t **parent,
+static inline void _traverse(rbt_t *rbt, map_key_t key, rbt_node_t **parent,
                                                   rbt_node_t **leaf)
 {
 	*parent = NULL;
 	*leaf = rbt->root;
 
 	while (*leaf) {
-		int leaf_key = (*leaf)->key;
-		if (leaf_key == key)
+		map_key_t leaf_key = (*leaf)->key;
+		if (KEY_EQ(leaf_key, key))
 			return;
 
 		*parent = *leaf;
-		*leaf = (key < leaf_key) ? (*leaf)->left : (*leaf)->right;
+		*leaf = KEY_LT(key, leaf_key) ? (*leaf)->left : (*leaf)->right;
 	}
 }
-static inline void _traverse_with_stack(rbt_t *rbt, int key,
+static inline void _traverse_with_stack(rbt_t *rbt, map_key_t key,
                                         rbt_node_t *node_stack[MAX_HEIGHT],
-                                        int *stack_top)
+                                        TX_VOLATILE int *stack_top)
 {
 	rbt_node_t *parent, *leaf;
+	int top = -1;
 
 	parent = NULL;
 	leaf = rbt->root;
-	*stack_top = -1;
 
 	while (leaf) {
-		node_stack[++(*stack_top)] = leaf;
+		node_stack[++top] = leaf;
 
-		int leaf_key = leaf->key;
-		if (leaf_key == key)
-			return;
+		map_key_t leaf_key = leaf->key;
+		if (KEY_EQ(leaf_key, key))
+			break;
 
 		parent = leaf;
-		leaf = (key < leaf_key) ? leaf->left : leaf->right;
+		leaf = KEY_LT(key, leaf_key) ? leaf->left : leaf->right;
 	}
+	*stack_top = top;
 }
 
 /**
  * Returns 1 if found, else 0.
  **/
-int _rbt_lookup_helper(rbt_t *rbt, int key, tdata_t *tdata)
+int _rbt_lookup_helper(rbt_t *rbt, map_key_t key, tdata_t *tdata)
 {
 	rbt_node_t *parent, *leaf;
 	_traverse(rbt, key, &parent, &leaf);
 	return (leaf != NULL);
 }
 
+int _rbt_get_helper(rbt_t *rbt, map_key_t key, void **value)
+{
+	rbt_node_t *parent, *leaf;
+	_traverse(rbt, key, &parent, &leaf);
+	if (!leaf)
+		return 0;
+	*value = leaf->data;
+	return 1;
+}
+
+/**
+ * In-order scan of the keys in [lo, hi) without synchronization.
+ * As in the RCU-HTM AVL tree, an update only swings one child pointer of
+ * a published node to a private copy of the subtree below it, so the scan
+ * is atomic per subtree: keys come in strictly ascending order, keys
+ * present throughout the scan are reported and keys absent throughout the
+ * scan are not. Keys updated during the scan may or may not be reported.
+ * Values are updated in place (_rbt_update_helper()) and a reported value
+ * is whichever one the scan read.
+ * Nodes are never reused, so no reclamation protection is needed.
+ **/
+static int _rbt_range_helper(rbt_t *rbt, map_key_t lo, map_key_t hi,
+                             void (*cb)(map_key_t, void *, void *), void *arg)
+{
+	rbt_node_t *node_stack[MAX_HEIGHT];
+	int stack_top = -1;
+	rbt_node_t *curr = rbt->root;
+	int nkeys = 0;
+	map_key_t last_key = lo;
+
+	while (curr || stack_top >= 0) {
+		while (curr) {
+			if (KEY_LT(curr->key, lo)) {
+				curr = curr->right;
+				continue;
+			}
+			assert(stack_top < MAX_HEIGHT - 1);
+			node_stack[++stack_top] = curr;
+			curr = curr->left;
+		}
+		//> The rest of the subtree lies below lo.
+		if (stack_top < 0)
+			break;
+
+		curr = node_stack[stack_top--];
+		if (KEY_GE(curr->key, hi))
+			break;
+		//> Guards the ascending order against concurrent restructuring.
+		if (nkeys == 0 || KEY_GT(curr->key, last_key)) {
+			if (cb)
+				cb(curr->key, curr->data, arg);
+			last_key = curr->key;
+			nkeys++;
+		}
+		curr = curr->right;
+	}
+
+	return nkeys;
+}
+
 /*********************    FOR DEBUGGING ONLY    *******************************/
 static void rbt_print_rec(rbt_node_t *root, int level)
 {
@@ -317,7 +377,7 @@ static void rbt_print_rec(rbt_node_t *root, int level)
 		return;
 	}
 
-	printf("%d[%s][%p (%p,%p)]\n", root->key, IS_RED(root) ? "RED" : "BLA", root, 
+	printf(KEY_FMT "[%s][%p (%p,%p)]\n", KEY_FMT_ARG(root->key), IS_RED(root) ? "RED" : "BLA", root, 
 	                               &root->left, &root->right);
 
 	rbt_print_rec(root->left, level + 1);
@@ -333,7 +393,7 @@ static void rbt_print_struct(rbt_t *rbt)
 }
 /******************************************************************************/
 
-static int _insert_rebalance(rbt_t *rbt, int key, rbt_node_t *node_stack[MAX_HEIGHT],
+static int _insert_rebalance(rbt_t *rbt, map_key_t key, rbt_node_t *node_stack[MAX_HEIGHT],
                               int stack_top, rbt_node_t **tree_cp_root, rbt_node_t **conn_point,
                               tdata_t *tdata)
 {
@@ -355,7 +415,7 @@ static int _insert_rebalance(rbt_t *rbt, int key, rbt_node_t *node_stack[MAX_HEI
 			break;
 
 		grandparent = node_stack[stack_top--];
-		if (key < grandparent->key) {
+		if (KEY_LT(key, grandparent->key)) {
 			uncle = grandparent->right;
 
 			// Copy parent and grandparent ...
@@ -364,7 +424,7 @@ static int _insert_rebalance(rbt_t *rbt, int key, rbt_node_t *node_stack[MAX_HEI
 			parent_cp      = rbt_node_new_copy(parent, tdata);
 			// ... and connect them with each other and with the previous copy
 			grandparent_cp->left = parent_cp;
-			if (key < parent->key) {
+			if (KEY_LT(key, parent->key)) {
 				ht_insert(tdata->ht, &parent->right, parent_cp->right);
 				parent_cp->left = *tree_cp_root;
 			} else {
@@ -389,7 +449,7 @@ static int _insert_rebalance(rbt_t *rbt, int key, rbt_node_t *node_stack[MAX_HEI
 				continue;
 			}
 
-			if (key < parent->key) { // CASE 2
+			if (KEY_LT(key, parent->key)) { // CASE 2
 				if (stack_top == -1) {
 					*conn_point = NULL;
 					*tree_cp_root = rbt_rotate_right(grandparent_cp);
@@ -424,7 +484,7 @@ static int _insert_rebalance(rbt_t *rbt, int key, rbt_node_t *node_stack[MAX_HEI
 			parent_cp      = rbt_node_new_copy(parent, tdata);
 			// ... and connect them with each other and with the previous copy
 			grandparent_cp->right = parent_cp;
-			if (key < parent->key) {
+			if (KEY_LT(key, parent->key)) {
 				ht_insert(tdata->ht, &parent->right, parent_cp->right);
 				parent_cp->left = *tree_cp_root;
 			} else {
@@ -449,7 +509,7 @@ static int _insert_rebalance(rbt_t *rbt, int key, rbt_node_t *node_stack[MAX_HEI
 				continue;
 			}
 
-			if (key > parent->key) { // CASE 2
+			if (KEY_GT(key, parent->key)) { // CASE 2
 				if (stack_top == -1) {
 					*conn_point = NULL;
 					*tree_cp_root = rbt_rotate_left(grandparent_cp);
@@ -481,7 +541,7 @@ static int _insert_rebalance(rbt_t *rbt, int key, rbt_node_t *node_stack[MAX_HEI
 	return 1;
 }
 
-static int _insert(rbt_t *rbt, int key, void *data, rbt_node_t *node_stack[MAX_HEIGHT],
+static int _insert(rbt_t *rbt, map_key_t key, void *data, rbt_node_t *node_stack[MAX_HEIGHT],
                    int stack_top, rbt_node_t **tree_cp_root, rbt_node_t **conn_point,
                    tdata_t *tdata)
 {
@@ -494,53 +554,54 @@ static int _insert(rbt_t *rbt, int key, void *data, rbt_node_t *node_stack[MAX_H
 	}
 
 	rbt_node_t *parent = node_stack[stack_top];
-	if (key == parent->key)     return 0;
+	if (KEY_EQ(key, parent->key))     return 0;
 
 	*conn_point = parent;
 	*tree_cp_root = rbt_node_new(key, RED, data);
-	if (key < parent->key) ht_insert(tdata->ht, &parent->left, NULL);
+	if (KEY_LT(key, parent->key)) ht_insert(tdata->ht, &parent->left, NULL);
 	else                   ht_insert(tdata->ht, &parent->right, NULL);
 
 	return 1;
 }
 
-static int _rbt_insert_helper(rbt_t *rbt, int key, void *data, tdata_t *tdata)
+static int _rbt_insert_helper(rbt_t *rbt, map_key_t key, void *data, tdata_t *tdata)
 {
 	rbt_node_t *tree_cp_root, *connection_point;
 	rbt_node_t *node_stack[MAX_HEIGHT];
-	int stack_top;
-	int retries = -1;
+	TX_VOLATILE int stack_top;
+	TX_VOLATILE int retries = -1;
 	tm_begin_ret_t status;
 
+	tm_op_begin(&tdata->tm);
+
 try_from_scratch:
 
 	ht_reset(tdata->ht);
 
-	if (++retries >= TX_NUM_RETRIES) {
-		tdata->lacqs++;
-		pthread_spin_lock(&rbt->rbt_lock);
+	if (!tm_retry_allowed(&tdata->tm, ++retries)) {
+		tm_fallback_lock(&rbt->rbt_lock, &tdata->tm);
 		_traverse_with_stack(rbt, key, node_stack, &stack_top);
 		int ret = _insert(rbt, key, data, node_stack, stack_top,
 		                  &tree_cp_root, &connection_point, tdata);
 		if (ret == 0) {
-			pthread_spin_unlock(&rbt->rbt_lock);
+			tm_fallback_unlock(&rbt->rbt_lock, &tdata->tm);
 			return 0;
 		}
 		ret = _insert_rebalance(rbt, key, node_stack, stack_top,
 		                  &tree_cp_root, &connection_point, tdata);
 		if (ret == 0) {
-			pthread_spin_unlock(&rbt->rbt_lock);
+			tm_fallback_unlock(&rbt->rbt_lock, &tdata->tm);
 			return 0;
 		}
 
 		if (!connection_point) {
 			rbt->root = tree_cp_root;
 		} else {
-			if (key < connection_point->key) connection_point->left = tree_cp_root;
+			if (KEY_LT(key, connection_point->key)) connection_point->left = tree_cp_root;
 			else                             connection_point->right  = tree_cp_root;
 		}
 
-		pthread_spin_unlock(&rbt->rbt_lock);
+		tm_fallback_unlock(&rbt->rbt_lock, &tdata->tm);
 		return 1;
 	}
 
@@ -555,20 +616,19 @@ try_from_scratch:
 	                  &tree_cp_root, &connection_point, tdata);
 	if (ret == 0) return 0;
 
-	int validation_retries = -1;
+	TX_VOLATILE int validation_retries = -1;
 validate_and_connect_copy:
 
-	if (++validation_retries >= TX_NUM_RETRIES)
+	if (!tm_retry_allowed(&tdata->tm, ++validation_retries))
 		goto try_from_scratch;
 
 	/* Transactional verification. */
-	while (rbt->rbt_lock != LOCK_FREE)
-		;
+	tm_fallback_wait(&rbt->rbt_lock);
 
-	tdata->tx_starts++;
-	status = TX_BEGIN(0);
+	tm_tx_started(&tdata->tm);
+	TX_BEGIN(status);
 	if (status == TM_BEGIN_SUCCESS) {
-		if (rbt->rbt_lock != LOCK_FREE)
+		if (tm_fallback_is_locked(&rbt->rbt_lock))
 			TX_ABORT(ABORT_GL_TAKEN);
 
 		// Validate copy
@@ -576,7 +636,7 @@ validate_and_connect_copy:
 		if (rbt->root != node_stack[0])
 			TX_ABORT(ABORT_VALIDATION_FAILURE);
 		for (i=0; i < stack_top; i++) {
-			if (key <= node_stack[i]->key) {
+			if (KEY_LE(key, node_stack[i]->key)) {
 				if (node_stack[i]->left != node_stack[i+1])
 					TX_ABORT(ABORT_VALIDATION_FAILURE);
 			} else {
@@ -592,26 +652,25 @@ validate_and_connect_copy:
 					TX_ABORT(ABORT_VALIDATION_FAILURE);
 			}
 		}
-		if (key < node_stack[stack_top]->key && node_stack[stack_top]->left != NULL)
+		if (KEY_LT(key, node_stack[stack_top]->key) && node_stack[stack_top]->left != NULL)
 			TX_ABORT(ABORT_VALIDATION_FAILURE);
-		if (key > node_stack[stack_top]->key && node_stack[stack_top]->right != NULL)
+		if (KEY_GT(key, node_stack[stack_top]->key) && node_stack[stack_top]->right != NULL)
 			TX_ABORT(ABORT_VALIDATION_FAILURE);
 
 
 		// Install the modified copy!
 		if (!connection_point) {
-			rbt->root = tree_cp_root;
+			TX_STORE(rbt->root, tree_cp_root);
 		} else {
-			if (key < connection_point->key) connection_point->left = tree_cp_root;
-			else                             connection_point->right  = tree_cp_root;
+			if (KEY_LT(key, connection_point->key)) TX_STORE(connection_point->left, tree_cp_root);
+			else                             TX_STORE(connection_point->right, tree_cp_root);
 		}
 
 		TX_END(0);
+		tm_tx_committed(&tdata->tm);
 	} else {
-		tdata->tx_aborts++;
-		if (ABORT_IS_EXPLICIT(status) && 
-		    ABORT_CODE(status) == ABORT_VALIDATION_FAILURE) {
-			tdata->tx_aborts_explicit_validation++;
+		tm_tx_aborted(&tdata->tm, status);
+		if (ABORT_IS_VALIDATION(status)) {
 			goto try_from_scratch;
 		} else {
 			goto validate_and_connect_copy;
@@ -645,13 +704,13 @@ static void _find_successor_with_stack(rbt_node_t *node_stack[MAX_HEIGHT],
 	}
 }
 
-static int _delete_and_rebalance(rbt_t *rbt, int key, 
+static int _delete_and_rebalance(rbt_t *rbt, map_key_t key, 
                                  rbt_node_t *node_stack[MAX_HEIGHT], int stack_top,
                                  rbt_node_t **tree_cp_root, rbt_node_t **conn_point,
                                  tdata_t *tdata)
 {
 	int original_node_stack_index = stack_top;
-	int original_key = key;
+	map_key_t original_key = key;
 	rbt_node_t *original_node = node_stack[stack_top];
 	rbt_node_t *curr, *parent, *gparent, *sibling;
 	rbt_node_t *curr_cp, *parent_cp, *gparent_cp, *sibling_cp;
@@ -675,6 +734,9 @@ static int _delete_and_rebalance(rbt_t *rbt, int key,
 	node_stack[stack_top] = *tree_cp_root;
 	ht_insert(tdata->ht, &leaf->left, l);
 	ht_insert(tdata->ht, &leaf->right, r);
+	//> The successor's value moves along with its key.
+	void *data = leaf->data;
+	ht_insert(tdata->ht, &leaf->data, data);
 
 	// ------------------------------------------------------------------------
 	// From now on is the rebalancing
@@ -683,7 +745,7 @@ static int _delete_and_rebalance(rbt_t *rbt, int key,
 	// The deleted node was RED, no rebalance necessary
 	if (deleted_node_color == RED) {
 		if (*conn_point) {
-			if (key < (*conn_point)->key)
+			if (KEY_LT(key, (*conn_point)->key))
 				ht_insert(tdata->ht, &((*conn_point)->left), leaf);
 			else
 				ht_insert(tdata->ht, &((*conn_point)->right), leaf);
@@ -693,7 +755,7 @@ static int _delete_and_rebalance(rbt_t *rbt, int key,
 	// The replacement node was RED, just make it BLACK
 	if (IS_RED(*tree_cp_root)) {
 		if (*conn_point) {
-			if (key < (*conn_point)->key)
+			if (KEY_LT(key, (*conn_point)->key))
 				ht_insert(tdata->ht, &((*conn_point)->left), leaf);
 			else
 				ht_insert(tdata->ht, &((*conn_point)->right), leaf);
@@ -715,7 +777,7 @@ static int _delete_and_rebalance(rbt_t *rbt, int key,
 
 		parent = node_stack[stack_top];
 		
-		if (key < parent->key) { // `curr` is left child
+		if (KEY_LT(key, parent->key)) { // `curr` is left child
 			sibling = parent->right;
 
 			// Copy parent and sibling
@@ -726,8 +788,10 @@ static int _delete_and_rebalance(rbt_t *rbt, int key,
 			ht_insert(tdata->ht, &sibling->right, sibling_cp->right);
 			parent_cp->left = *tree_cp_root;
 			parent_cp->right = sibling_cp;
-			if (stack_top == original_node_stack_index)
+			if (stack_top == original_node_stack_index) {
 				parent_cp->key = key;
+				parent_cp->data = data;
+			}
 
 			if (IS_RED(sibling_cp)) { // CASE 1
 				sibling_cp->color = BLACK;
@@ -768,7 +832,7 @@ static int _delete_and_rebalance(rbt_t *rbt, int key,
 				*conn_point = (stack_top - 1 >= 0) ? node_stack[stack_top - 1] : NULL;
 
 				if (*conn_point) {
-					if (key < (*conn_point)->key)
+					if (KEY_LT(key, (*conn_point)->key))
 						ht_insert(tdata->ht, &((*conn_point)->left), node_stack[stack_top]);
 					else
 						ht_insert(tdata->ht, &((*conn_point)->right), node_stack[stack_top]);
@@ -785,7 +849,7 @@ static int _delete_and_rebalance(rbt_t *rbt, int key,
 
 				if (IS_RED(parent_cp)) {
 					if (*conn_point) {
-						if (key < (*conn_point)->key)
+						if (KEY_LT(key, (*conn_point)->key))
 							ht_insert(tdata->ht, &((*conn_point)->left), node_stack[stack_top]);
 						else
 							ht_insert(tdata->ht, &((*conn_point)->right), node_stack[stack_top]);
@@ -811,7 +875,7 @@ static int _delete_and_rebalance(rbt_t *rbt, int key,
 					*conn_point = (stack_top - 1 >= 0) ? node_stack[stack_top - 1] : NULL;
 
 					if (*conn_point) {
-						if (key < (*conn_point)->key)
+						if (KEY_LT(key, (*conn_point)->key))
 							ht_insert(tdata->ht, &((*conn_point)->left), node_stack[stack_top]);
 						else
 							ht_insert(tdata->ht, &((*conn_point)->right), node_stack[stack_top]);
@@ -831,7 +895,7 @@ static int _delete_and_rebalance(rbt_t *rbt, int key,
 					*conn_point = (stack_top - 1 >= 0) ? node_stack[stack_top - 1] : NULL;
 
 					if (*conn_point) {
-						if (key < (*conn_point)->key)
+						if (KEY_LT(key, (*conn_point)->key))
 							ht_insert(tdata->ht, &((*conn_point)->left), node_stack[stack_top]);
 						else
 							ht_insert(tdata->ht, &((*conn_point)->right), node_stack[stack_top]);
@@ -851,8 +915,10 @@ static int _delete_and_rebalance(rbt_t *rbt, int key,
 			ht_insert(tdata->ht, &sibling->right, sibling_cp->right);
 			parent_cp->left = sibling_cp;
 			parent_cp->right = *tree_cp_root;
-			if (stack_top == original_node_stack_index)
+			if (stack_top == original_node_stack_index) {
 				parent_cp->key = key;
+				parent_cp->data = data;
+			}
 
 			if (IS_RED(sibling_cp)) { // CASE 1
 				sibling_cp->color = BLACK;
@@ -893,7 +959,7 @@ static int _delete_and_rebalance(rbt_t *rbt, int key,
 				*conn_point = (stack_top - 1 >= 0) ? node_stack[stack_top - 1] : NULL;
 
 				if (*conn_point) {
-					if (key < (*conn_point)->key)
+					if (KEY_LT(key, (*conn_point)->key))
 						ht_insert(tdata->ht, &((*conn_point)->left), node_stack[stack_top]);
 					else
 						ht_insert(tdata->ht, &((*conn_point)->right), node_stack[stack_top]);
@@ -910,7 +976,7 @@ static int _delete_and_rebalance(rbt_t *rbt, int key,
 
 				if (IS_RED(parent_cp)) {
 					if (*conn_point) {
-						if (key < (*conn_point)->key)
+						if (KEY_LT(key, (*conn_point)->key))
 							ht_insert(tdata->ht, &((*conn_point)->left), node_stack[stack_top]);
 						else
 							ht_insert(tdata->ht, &((*conn_point)->right), node_stack[stack_top]);
@@ -935,7 +1001,7 @@ static int _delete_and_rebalance(rbt_t *rbt, int key,
 					*conn_point = (stack_top - 1 >= 0) ? node_stack[stack_top - 1] : NULL;
 
 					if (*conn_point) {
-						if (key < (*conn_point)->key)
+						if (KEY_LT(key, (*conn_point)->key))
 							ht_insert(tdata->ht, &((*conn_point)->left), node_stack[stack_top]);
 						else
 							ht_insert(tdata->ht, &((*conn_point)->right), node_stack[stack_top]);
@@ -955,7 +1021,7 @@ static int _delete_and_rebalance(rbt_t *rbt, int key,
 					*conn_point = (stack_top - 1 >= 0) ? node_stack[stack_top - 1] : NULL;
 
 					if (*conn_point) {
-						if (key < (*conn_point)->key)
+						if (KEY_LT(key, (*conn_point)->key))
 							ht_insert(tdata->ht, &((*conn_point)->left), node_stack[stack_top]);
 						else
 							ht_insert(tdata->ht, &((*conn_point)->right), node_stack[stack_top]);
@@ -974,66 +1040,69 @@ replace_original_node_key:
 			curr_cp = rbt_node_new_copy(node_stack[i], tdata);
 			ht_insert(tdata->ht, &node_stack[i]->left, curr_cp->left);
 			ht_insert(tdata->ht, &node_stack[i]->right, curr_cp->right);
-			if (key < curr_cp->key) curr_cp->left = *tree_cp_root;
+			if (KEY_LT(key, curr_cp->key)) curr_cp->left = *tree_cp_root;
 			else                    curr_cp->right = *tree_cp_root;
 			*tree_cp_root = curr_cp;
 			*conn_point = (i - 1 >= 0) ? node_stack[i-1] : NULL;
 
 			if (*conn_point) {
-				if (key < (*conn_point)->key)
+				if (KEY_LT(key, (*conn_point)->key))
 					ht_insert(tdata->ht, &((*conn_point)->left), node_stack[i]);
 				else
 					ht_insert(tdata->ht, &((*conn_point)->right), node_stack[i]);
 			}
 		}
 		curr_cp->key = key;
+		curr_cp->data = data;
 	}
 
 	return 1;
 }
 
-static int _rbt_delete_helper(rbt_t *rbt, int key, tdata_t *tdata)
+static int _rbt_delete_helper(rbt_t *rbt, map_key_t key, tdata_t *tdata)
 {
 	rbt_node_t *tree_cp_root, *connection_point;
 	rbt_node_t *node_stack[MAX_HEIGHT];
-	int stack_top;
+	TX_VOLATILE int stack_top;
 	color_t deleted_node_color;
-	int succ_key, original_node_stack_index;
-	int retries = -1;
+	map_key_t succ_key;
+	int original_node_stack_index;
+	TX_VOLATILE int retries = -1;
 	tm_begin_ret_t status;
 
+	tm_op_begin(&tdata->tm);
+
 try_from_scratch:
 
 	ht_reset(tdata->ht);
 
-	if (++retries >= TX_NUM_RETRIES) {
-		tdata->lacqs++;
-		pthread_spin_lock(&rbt->rbt_lock);
+	if (!tm_retry_allowed(&tdata->tm, ++retries)) {
+		tm_fallback_lock(&rbt->rbt_lock, &tdata->tm);
 		_traverse_with_stack(rbt, key, node_stack, &stack_top);
-		if (stack_top < 0 || node_stack[stack_top]->key != key) {
-			pthread_spin_unlock(&rbt->rbt_lock);
+		if (stack_top < 0 || !KEY_EQ(node_stack[stack_top]->key, key)) {
+			tm_fallback_unlock(&rbt->rbt_lock, &tdata->tm);
 			return 0;
 		}
 		int ret = _delete_and_rebalance(rbt, key, node_stack, stack_top,
 		                                &tree_cp_root, &connection_point,
 		                                tdata);
 		if (ret == 0) {
-			pthread_spin_unlock(&rbt->rbt_lock);
+			tm_fallback_unlock(&rbt->rbt_lock, &tdata->tm);
 			return 0;
 		}
 		if (!connection_point) {
 			rbt->root = tree_cp_root;
 		} else {
-			if (key < connection_point->key) connection_point->left  = tree_cp_root;
+			if (KEY_LT(key, connection_point->key)) connection_point->left  = tree_cp_root;
 			else                             connection_point->right = tree_cp_root;
 		}
-		pthread_spin_unlock(&rbt->rbt_lock);
+		tm_fallback_unlock(&rbt->rbt_lock, &tdata->tm);
 		return 1;
 	}
 
 	// Asynchronized traversal
 	_traverse_with_stack(rbt, key, node_stack, &stack_top);
-	if (stack_top < 0 || node_stack[stack_top]->key != key)
+	if (stack_top < 0 || !KEY_EQ(node_stack[stack_top]->key, key))
 		return 0;
 
 	int ret = _delete_and_rebalance(rbt, key, node_stack, stack_top,
@@ -1041,20 +1110,19 @@ try_from_scratch:
 	                                tdata);
 	if (ret == 0) return 0;
 
-	int validation_retries = -1;
+	TX_VOLATILE int validation_retries = -1;
 validate_and_connect_copy:
 
-	if (++validation_retries >= TX_NUM_RETRIES)
+	if (!tm_retry_allowed(&tdata->tm, ++validation_retries))
 		goto try_from_scratch;
 
 	/* Transactional verification. */
-	while (rbt->rbt_lock != LOCK_FREE)
-		;
+	tm_fallback_wait(&rbt->rbt_lock);
 
-	tdata->tx_starts++;
-	status = TX_BEGIN(0);
+	tm_tx_started(&tdata->tm);
+	TX_BEGIN(status);
 	if (status == TM_BEGIN_SUCCESS) {
-		if (rbt->rbt_lock != LOCK_FREE)
+		if (tm_fallback_is_locked(&rbt->rbt_lock))
 			TX_ABORT(ABORT_GL_TAKEN);
 
 		// FIXME Validate copy
@@ -1062,7 +1130,7 @@ validate_and_connect_copy:
 		if (rbt->root != node_stack[0])
 			TX_ABORT(ABORT_VALIDATION_FAILURE);
 		for (i=0; i < stack_top-1; i++) {
-			if (key < node_stack[i]->key) {
+			if (KEY_LT(key, node_stack[i]->key)) {
 				if (node_stack[i]->left != node_stack[i+1])
 					TX_ABORT(ABORT_VALIDATION_FAILURE);
 			} else {
@@ -1081,18 +1149,17 @@ validate_and_connect_copy:
 
 		// Install the modified copy!
 		if (!connection_point) {
-			rbt->root = tree_cp_root;
+			TX_STORE(rbt->root, tree_cp_root);
 		} else {
-			if (key < connection_point->key) connection_point->left = tree_cp_root;
-			else                             connection_point->right  = tree_cp_root;
+			if (KEY_LT(key, connection_point->key)) TX_STORE(connection_point->left, tree_cp_root);
+			else                             TX_STORE(connection_point->right, tree_cp_root);
 		}
 
 		TX_END(0);
+		tm_tx_committed(&tdata->tm);
 	} else {
-		tdata->tx_aborts++;
-		if (ABORT_IS_EXPLICIT(status) && 
-		    ABORT_CODE(status) == ABORT_VALIDATION_FAILURE) {
-			tdata->tx_aborts_explicit_validation++;
+		tm_tx_aborted(&tdata->tm, status);
+		if (ABORT_IS_VALIDATION(status)) {
 			goto try_from_scratch;
 		} else {
 			goto validate_and_connect_copy;
@@ -1102,14 +1169,85 @@ validate_and_connect_copy:
 	return 1;
 }
 
-static int key_in_min_path, key_in_max_path;
+/**
+ * Replaces the value of `key` in place, without copying any node.
+ * The transaction re-traverses the path to `key`, so the node it writes is
+ * still reachable, and the only word it writes is `data`. Path copies that
+ * started from the old value fail their validation of `&node->data`.
+ **/
+static int _rbt_update_helper(rbt_t *rbt, map_key_t key, void *data, tdata_t *tdata)
+{
+	rbt_node_t *parent, *leaf;
+	TX_VOLATILE int retries = -1;
+	tm_begin_ret_t status;
+
+	// Asynchronized traversal
+	_traverse(rbt, key, &parent, &leaf);
+	if (!leaf)
+		return 0;
+
+	tm_op_begin(&tdata->tm);
+
+try_again:
+
+	if (!tm_retry_allowed(&tdata->tm, ++retries)) {
+		tm_fallback_lock(&rbt->rbt_lock, &tdata->tm);
+		_traverse(rbt, key, &parent, &leaf);
+		if (leaf)
+			leaf->data = data;
+		tm_fallback_unlock(&rbt->rbt_lock, &tdata->tm);
+		return (leaf != NULL);
+	}
+
+	tm_fallback_wait(&rbt->rbt_lock);
+
+	tm_tx_started(&tdata->tm);
+	TX_BEGIN(status);
+	if (status == TM_BEGIN_SUCCESS) {
+		if (tm_fallback_is_locked(&rbt->rbt_lock))
+			TX_ABORT(ABORT_GL_TAKEN);
+
+		_traverse(rbt, key, &parent, &leaf);
+		if (leaf)
+			TX_STORE(leaf->data, data);
+
+		TX_END(0);
+		tm_tx_committed(&tdata->tm);
+	} else {
+		tm_tx_aborted(&tdata->tm, status);
+		goto try_again;
+	}
+
+	return (leaf != NULL);
+}
+
+static map_key_t key_in_min_path, key_in_max_path;
 static int bh;
 static int paths_with_bh_diff;
+static long long _rbt_count_nodes(rbt_node_t *root)
+{
+	if (!root)
+		return 0;
+	return 1 + _rbt_count_nodes(root->left) + _rbt_count_nodes(root->right);
+}
+
+static void _rbt_free_nodes(rbt_node_t *root)
+{
+	if (!root)
+		return;
+	_rbt_free_nodes(root->left);
+	_rbt_free_nodes(root->right);
+	if (!rbt_node_in_pool(root))
+		free(root);
+}
+
 static int total_paths;
 static int min_path_len, max_path_len;
 static int total_nodes, red_nodes, black_nodes;
 static int red_red_violations, bst_violations;
-static void _rbt_validate(rbt_node_t *root, int _bh, int _th)
+//> Summed over all nodes, for the cost of finding each key from the root.
+static long long total_depth, total_lines;
+static void _rbt_validate(rbt_node_t *root, int _bh, int _th, int _lines)
 {
 	if (!root)
 		return;
@@ -1122,11 +1260,14 @@ static void _rbt_validate(rbt_node_t *root, int _bh, int _th)
 	red_nodes += (IS_RED(root));
 	_th++;
 	_bh += (IS_BLACK(root));
+	_lines += NODE_TRAVERSAL_LINES(rbt_node_t, root);
+	total_depth += _th;
+	total_lines += _lines;
 
 	/* BST violation? */
-	if (left && left->key >= root->key)
+	if (left && KEY_GE(left->key, root->key))
 		bst_violations++;
-	if (right && right->key <= root->key)
+	if (right && KEY_LE(right->key, root->key))
 		bst_violations++;
 
 	/* Red-Red violation? */
@@ -1153,9 +1294,9 @@ static void _rbt_validate(rbt_node_t *root, int _bh, int _th)
 
 	/* Check subtrees. */
 	if (left)
-		_rbt_validate(left, _bh, _th);
+		_rbt_validate(left, _bh, _th, _lines);
 	if (right)
-		_rbt_validate(right, _bh, _th);
+		_rbt_validate(right, _bh, _th, _lines);
 }
 
 static inline int _rbt_validate_helper(rbt_node_t *root)
@@ -1170,8 +1311,9 @@ static inline int _rbt_validate_helper(rbt_node_t *root)
 	total_nodes = black_nodes = red_nodes = 0;
 	red_red_violations = 0;
 	bst_violations = 0;
+	total_depth = total_lines = 0;
 
-	_rbt_validate(root, 0, 0);
+	_rbt_validate(root, 0, 0, 0);
 
 	check_bh = (paths_with_bh_diff == 0);
 	check_red_red = (red_red_violations == 0);
@@ -1192,14 +1334,19 @@ static inline int _rbt_validate_helper(rbt_node_t *root)
 	       total_nodes, black_nodes, red_nodes);
 	printf("  Total paths: %d\n", total_paths);
 	printf("  Min/max paths length: %d/%d\n", min_path_len, max_path_len);
-	printf("  Key in min path: %d\n", key_in_min_path);
-	printf("  Key in max path: %d\n", key_in_max_path);
+	printf("  Key in min path: " KEY_FMT "\n", KEY_FMT_ARG(key_in_min_path));
+	printf("  Key in max path: " KEY_FMT "\n", KEY_FMT_ARG(key_in_max_path));
+	printf("  Node layout: %s, %lu bytes per node\n", NODE_LAYOUT_NAME,
+	       sizeof(rbt_node_t));
+	printf("  Avg nodes / cache lines per traversal: %.2lf / %.2lf\n",
+	       total_nodes ? (double)total_depth / total_nodes : 0.0,
+	       total_nodes ? (double)total_lines / total_nodes : 0.0);
 	printf("\n");
 
 	return check_rbt;
 }
 
-static void _insert_rebalance_warmup(rbt_t *rbt, int key,
+static void _insert_rebalance_warmup(rbt_t *rbt, map_key_t key,
                     rbt_node_t *node_stack[MAX_HEIGHT], int stack_top)
 {
 	rbt_node_t *parent, *grandparent, *grandgrandparent, *uncle;
@@ -1215,7 +1362,7 @@ static void _insert_rebalance_warmup(rbt_t *rbt, int key,
 			break;
 
 		grandparent = node_stack[stack_top--];
-		if (key < grandparent->key) {
+		if (KEY_LT(key, grandparent->key)) {
 			uncle = grandparent->right;
 			if (IS_RED(uncle)) {
 				parent->color = BLACK;
@@ -1224,12 +1371,12 @@ static void _insert_rebalance_warmup(rbt_t *rbt, int key,
 				continue;
 			}
 
-			if (key < parent->key) {
+			if (KEY_LT(key, parent->key)) {
 				if (stack_top == -1) {
 					rbt->root = rbt_rotate_right(grandparent);
 				} else {
 					grandgrandparent = node_stack[stack_top];
-					if (key < grandgrandparent->key)
+					if (KEY_LT(key, grandgrandparent->key))
 						grandgrandparent->left = rbt_rotate_right(grandparent);
 					else
 						grandgrandparent->right = rbt_rotate_right(grandparent);
@@ -1243,7 +1390,7 @@ static void _insert_rebalance_warmup(rbt_t *rbt, int key,
 					rbt->root->color = BLACK;
 				} else {
 					grandgrandparent = node_stack[stack_top];
-					if (key < grandgrandparent->key) {
+					if (KEY_LT(key, grandgrandparent->key)) {
 						grandgrandparent->left = rbt_rotate_right(grandparent);
 						grandgrandparent->left->color = BLACK;
 					} else {
@@ -1263,12 +1410,12 @@ static void _insert_rebalance_warmup(rbt_t *rbt, int key,
 				continue;
 			}
 
-			if (key > parent->key) {
+			if (KEY_GT(key, parent->key)) {
 				if (stack_top == -1) {
 					rbt->root = rbt_rotate_left(grandparent);
 				} else {
 					grandgrandparent = node_stack[stack_top];
-					if (key < grandgrandparent->key)
+					if (KEY_LT(key, grandgrandparent->key))
 						grandgrandparent->left = rbt_rotate_left(grandparent);
 					else
 						grandgrandparent->right = rbt_rotate_left(grandparent);
@@ -1282,7 +1429,7 @@ static void _insert_rebalance_warmup(rbt_t *rbt, int key,
 					rbt->root->color = BLACK;
 				} else {
 					grandgrandparent = node_stack[stack_top];
-					if (key < grandgrandparent->key) {
+					if (KEY_LT(key, grandgrandparent->key)) {
 						grandgrandparent->left = rbt_rotate_left(grandparent);
 						grandgrandparent->left->color = BLACK;
 					} else {
@@ -1297,7 +1444,7 @@ static void _insert_rebalance_warmup(rbt_t *rbt, int key,
 	}
 }
 
-static int _insert_warmup(rbt_t *rbt, int key, void *data,
+static int _insert_warmup(rbt_t *rbt, map_key_t key, void *data,
                    rbt_node_t *node_stack[MAX_HEIGHT], int stack_top)
 {
 	// Empty tree
@@ -1307,13 +1454,13 @@ static int _insert_warmup(rbt_t *rbt, int key, void *data,
 	}
 
 	rbt_node_t *parent = node_stack[stack_top];
-	if (key == parent->key)     return 0;
-	else if (key < parent->key) parent->left = rbt_node_new(key, RED, data);
+	if (KEY_EQ(key, parent->key))     return 0;
+	else if (KEY_LT(key, parent->key)) parent->left = rbt_node_new(key, RED, data);
 	else                        parent->right = rbt_node_new(key, RED, data);
 	return 1;
 }
 
-static int _rbt_insert_helper_warmup(rbt_t *rbt, int key, void *data)
+static int _rbt_insert_helper_warmup(rbt_t *rbt, map_key_t key, void *data)
 {
 	rbt_node_t *node_stack[MAX_HEIGHT];
 	int stack_top;
@@ -1326,14 +1473,14 @@ static int _rbt_insert_helper_warmup(rbt_t *rbt, int key, void *data)
 	return 1;
 }
 
-static inline int _rbt_warmup_helper(rbt_t *rbt, int nr_nodes, int max_key,
+static inline int _rbt_warmup_helper(rbt_t *rbt, int nr_nodes, map_key_t max_key,
                                      unsigned int seed, int force)
 {
 	int i = 0, nodes_inserted = 0, ret = 0;
 	
 	srand(seed);
 	while (nodes_inserted < nr_nodes) {
-		int key = rand() % max_key;
+		map_key_t key = key_random(max_key);
 		ret = _rbt_insert_helper_warmup(rbt, key, NULL);
 		nodes_inserted += ret;
 	}
@@ -1341,24 +1488,80 @@ static inline int _rbt_warmup_helper(rbt_t *rbt, int nr_nodes, int max_key,
 	return nodes_inserted;
 }
 
+//> Nodes at depth `red_depth`, the partial last level, are red.
+static rbt_node_t *_rbt_bulk_build(bulk_load_t *bl, tdata_t *tdata,
+                                   int lo, int hi, int depth, int idx,
+                                   int red_depth)
+{
+	rbt_node_t *node;
+	int mid;
+
+	if (lo >= hi)
+		return NULL;
+	if (bulk_load_is_built(bl, depth))
+		return bl->roots[idx];
+
+	if (!(node = node_pool_alloc(&tdata->node_pool)))
+		XMALLOC_ALIGNED(node, 1, NODE_ALIGN);
+	node_stats_alloc(&rbt_node_stats, 1);
+	mid = bulk_load_mid(lo, hi);
+	node->color = depth == red_depth ? RED : BLACK;
+	node->key = bl->keys[mid];
+	node->data = NULL;
+	node->left = _rbt_bulk_build(bl, tdata, lo, mid, depth + 1, 2 * idx,
+	                             red_depth);
+	node->right = _rbt_bulk_build(bl, tdata, mid + 1, hi, depth + 1,
+	                              2 * idx + 1, red_depth);
+	return node;
+}
+
+static inline int _rbt_bulk_load_helper(rbt_t *rbt, tdata_t *tdata,
+                                        bulk_load_t *bl, int tid)
+{
+	int i, lo, hi, red_depth = bulk_load_full_levels(bl);
+
+	for (i=tid; i < bulk_load_nr_subtrees(bl); i += bl->nthreads) {
+		bulk_load_subtree_range(bl, i, &lo, &hi);
+		bl->roots[i] = _rbt_bulk_build(bl, tdata, lo, hi, bl->levels, i,
+		                               red_depth);
+	}
+	if (bulk_load_join(bl))
+		rbt->root = _rbt_bulk_build(bl, tdata, 0, bl->nr_keys, 0, 0,
+		                            red_depth);
+	bulk_load_wait(bl);
+
+	return bl->nr_keys;
+}
+
 
 /******************************************************************************/
 /* Red-Black tree interface implementation                                    */
 /******************************************************************************/
 void *rbt_new()
 {
-	printf("Size of tree node is %lu\n", sizeof(rbt_node_t));
+	printf("Size of tree node is %lu (%s layout)\n", sizeof(rbt_node_t),
+	       NODE_LAYOUT_NAME);
+	node_stats_reset(&rbt_node_stats);
 	return _rbt_new_helper();
 }
 
 void *rbt_thread_data_new(int tid)
 {
-	// Pre allocate a large amount of nodes for each thread
-	per_thread_node_allocators[tid] = malloc(NODES_PER_ALLOCATOR*sizeof(rbt_node_t));
-	memset(per_thread_node_allocators[tid], 0, NODES_PER_ALLOCATOR*sizeof(rbt_node_t));
-
 	tdata_t *tdata = tdata_new(tid);
 
+	// tid == -1 is only used to accumulate statistics.
+	if (tid < 0)
+		return tdata;
+
+	//> Only reserved here, the calling thread maps it as it allocates.
+	node_pool_init(&tdata->node_pool, sizeof(rbt_node_t), NODES_PER_ALLOCATOR);
+	node_stats_register(&rbt_node_stats, tid);
+	node_stats_pool(&rbt_node_stats, NODES_PER_ALLOCATOR);
+
+	do {
+		tdata->next = rbt_tdatas;
+	} while (!__sync_bool_compare_and_swap(&rbt_tdatas, tdata->next, tdata));
+
 	return tdata;
 }
 
@@ -1374,7 +1577,24 @@ void rbt_thread_data_add(void *d1, void *d2, void *dst)
 	tdata_add(d1, d2, dst);
 }
 
-int rbt_lookup(void *rbt, void *thread_data, int key)
+//> The pool goes with all of its nodes, rbt_free() freed the rest.
+void rbt_thread_data_free(void *thread_data)
+{
+	tdata_t *tdata = thread_data;
+
+	node_pool_destroy(&tdata->node_pool);
+	free(tdata->ht);
+	free(tdata);
+}
+
+int rbt_thread_data_tx_stats(void *thread_data, rbt_tx_stats_t *stats)
+{
+	tdata_t *tdata = thread_data;
+	TM_STATS_COPY(stats, &tdata->tm.stats);
+	return 0;
+}
+
+int rbt_lookup(void *rbt, void *thread_data, map_key_t key)
 {
 	int ret = 0;
 	tdata_t *tdata = thread_data;
@@ -1384,7 +1604,7 @@ int rbt_lookup(void *rbt, void *thread_data, int key)
 	return ret; 
 }
 
-int rbt_insert(void *rbt, void *thread_data, int key, void *value)
+int rbt_insert(void *rbt, void *thread_data, map_key_t key, void *value)
 {
 	int ret = 0;
 	tdata_t *tdata = thread_data;
@@ -1394,7 +1614,7 @@ int rbt_insert(void *rbt, void *thread_data, int key, void *value)
 	return ret;
 }
 
-int rbt_delete(void *rbt, void *thread_data, int key)
+int rbt_delete(void *rbt, void *thread_data, map_key_t key)
 {
 	int ret = 0;
 	tdata_t *tdata = thread_data;
@@ -1402,6 +1622,25 @@ int rbt_delete(void *rbt, void *thread_data, int key)
 	return ret;
 }
 
+int rbt_get(void *rbt, void *thread_data, map_key_t key, void **value)
+{
+	return _rbt_get_helper(rbt, key, value);
+}
+
+int rbt_update(void *rbt, void *thread_data, map_key_t key, void *value)
+{
+	int ret = 0;
+	tdata_t *tdata = thread_data;
+	ret = _rbt_update_helper(rbt, key, value, tdata);
+	return ret;
+}
+
+int rbt_range(void *rbt, void *thread_data, map_key_t lo, map_key_t hi,
+              void (*cb)(map_key_t key, void *value, void *arg), void *arg)
+{
+	return _rbt_range_helper(rbt, lo, hi, cb, arg);
+}
+
 int rbt_validate(void *rbt)
 {
 	int ret = 0;
@@ -1410,7 +1649,15 @@ int rbt_validate(void *rbt)
 	return ret;
 }
 
-int rbt_warmup(void *rbt, int nr_nodes, int max_key, 
+//> The replaced nodes that are not in a pool are lost, see rbt_node_stats.
+void rbt_free(void *rbt)
+{
+	_rbt_free_nodes(((rbt_t *)rbt)->root);
+	rbt_tdatas = NULL;
+	free(rbt);
+}
+
+int rbt_warmup(void *rbt, int nr_nodes, map_key_t max_key, 
                unsigned int seed, int force)
 {
 	int ret = 0;
@@ -1418,6 +1665,25 @@ int rbt_warmup(void *rbt, int nr_nodes, int max_key,
 	return ret;
 }
 
+int rbt_bulk_load(void *rbt, void *thread_data, bulk_load_t *bl, int tid)
+{
+	return _rbt_bulk_load_helper(rbt, thread_data, bl, tid);
+}
+
+int rbt_mem_stats(void *rbt, rbt_mem_stats_t *stats)
+{
+	node_stats_thread_t total;
+
+	node_stats_sum(&rbt_node_stats, &total);
+	stats->node_size = sizeof(rbt_node_t);
+	stats->nodes_allocated = total.allocated;
+	stats->nodes_live = _rbt_count_nodes(((rbt_t *)rbt)->root);
+	stats->nodes_retired = stats->nodes_allocated - stats->nodes_live;
+	stats->nodes_free = 0;
+	stats->pool_capacity = total.pool_capacity;
+	return 0;
+}
+
 char *rbt_name()
 {
 	return "links_bu_rcu_htm_internal";
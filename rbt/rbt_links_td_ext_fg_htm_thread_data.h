@@ -46,6 +46,11 @@ typedef struct {
 	                     7 -> retries_from_scratch
 	 */
 	unsigned long long tx_stats[3][TX_STATS_ARRAY_NR_TRANS][8];
+
+	//> Fallback lock state, only for the trees built on top of tm.h.
+#	if defined(_TM_H_)
+	tm_tdata_t tm;
+#	endif
 } htm_fg_tdata_t;
 
 static htm_fg_tdata_t *htm_fg_tdata_new(int tid)
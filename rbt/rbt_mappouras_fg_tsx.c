@@ -3,9 +3,17 @@
 #include <string.h>
 #include <time.h>
 #include <pthread.h>
-#include <xmmintrin.h>
 
-#include "rtm.h"
+#include "arch.h" /* CPU_RELAX() */
+#include "tm.h"
+
+//> Transactions store to the tree directly, which TM_SW can not track.
+#if defined(TM_SW)
+#	error "The fine-grained HTM trees need hardware transactions"
+#endif
+
+//> Explicit abort code for a transaction that found a node locked.
+#define ABORT_NODE_LOCKED 0xfe
 //data = key//
 
 struct jsw_node {
@@ -17,7 +25,7 @@ struct jsw_node {
 
 struct jsw_tree {
   struct jsw_node *root;
-  pthread_spinlock_t spinlock;
+  tm_fallback_lock_t lock;
 };
 
 #define IS_BLACK(node) ( !(node) || !(node)->red )
@@ -130,7 +138,7 @@ int jsw_insert2(struct jsw_tree *tree, int data) {
 	return inserted;
 }
 
-int jsw_insert ( struct jsw_tree *tree, int data, long int *aborts,pthread_spinlock_t *lock ){
+int jsw_insert ( struct jsw_tree *tree, int data, long int *aborts,tm_fallback_lock_t *lock ){
   int count=0,count2=0;
   struct jsw_node *save = NULL;
   struct jsw_node *z = make_node ( data );
@@ -145,53 +153,54 @@ int jsw_insert ( struct jsw_tree *tree, int data, long int *aborts,pthread_spinl
   //State that you are suppose to use the root - make initializations//
   while(1){
   
-	unsigned status = _xbegin();
-	if (status == _XBEGIN_STARTED) {
-		if (((int)(*lock)) != 1) _xabort (0xfe);
+	tm_begin_ret_t status;
+	TX_BEGIN(status);
+	if (status == TM_BEGIN_SUCCESS) {
+		if (tm_fallback_is_locked(lock)) TX_ABORT(ABORT_GL_TAKEN);
 		if (tree->root == NULL){
 			tree->root = z;
 			tree->root->red = 0;
-			_xend();
+			TX_END(0);
 			return (1);
 		}	
 		if (tree->root->lock == 1) 
-			_xabort(0xff);
+			TX_ABORT(ABORT_NODE_LOCKED);
 		tree->root->lock = 1;
 		t = &head;
 		g = p = NULL;
 		q = t->link[1] = tree->root;
-		_xend();
+		TX_END(0);
 		break;
 	}
 	else{
-		if (status & _XABORT_CONFLICT)
+		if (ABORT_IS_CONFLICT(status))
 		{
 			aborts[0]++;
 			count++;
 			count2++;
 			if (count>9){
-				_mm_pause();
+				CPU_RELAX();
 				//nanosleep(&tim , &tim2);
 				count = 0;
 			}
 			if (count2<0)
 			 return(-2);			
 		}
-		else if (status & _XABORT_CAPACITY){
+		else if (ABORT_IS_CAPACITY(status)){
 			aborts[1]++;			
 			count2++;
 			if (count2<0)
 			 return(-2);			
 		}	
-		else if (status & _XABORT_EXPLICIT)
+		else if (ABORT_IS_EXPLICIT(status))
 		{
 			aborts[2]++;
-			if (_XABORT_CODE(status) == 0xfe)
+			if (ABORT_CODE(status) == ABORT_GL_TAKEN)
 				goto start_over;
 			count++;
 			count2++;
 			if (count>9){
-				_mm_pause();
+				CPU_RELAX();
 				//nanosleep(&tim , &tim2);
 				count = 0;
 			}
@@ -212,9 +221,10 @@ count = 0;
 count2 = 0;
  while(1){
 	
-	unsigned status = _xbegin();
-	if (status == _XBEGIN_STARTED){
-	  if (((int)(*lock)) != 1) _xabort (0xfe);	
+	tm_begin_ret_t status;
+	TX_BEGIN(status);
+	if (status == TM_BEGIN_SUCCESS){
+	  if (tm_fallback_is_locked(lock)) TX_ABORT(ABORT_GL_TAKEN);	
 	  /* Search down the tree */
       if ( q == NULL ) {
         /* Insert new node at the bottom */
@@ -256,7 +266,7 @@ count2 = 0;
 			tree->root->red = 0;
 		}
 	      
-		_xend();
+		TX_END(0);
 		if (placed == 0) free(z);
 		return 1;
 	  }
@@ -288,16 +298,16 @@ count2 = 0;
 	  
 	  if(q!=NULL)
 		if (q->lock ==1)
-			_xabort(0xff);
+			TX_ABORT(ABORT_NODE_LOCKED);
 	  if(t!=NULL)
 		if (t->lock ==1)
-			_xabort(0xff);
+			TX_ABORT(ABORT_NODE_LOCKED);
 	  if(g!=NULL)
 		if (g->lock ==1)
-			_xabort(0xff);
+			TX_ABORT(ABORT_NODE_LOCKED);
 	  if(p!=NULL)
 		if (p->lock ==1)
-			_xabort(0xff);		
+			TX_ABORT(ABORT_NODE_LOCKED);		
 	  
 	  
 	  if (q!=NULL)
@@ -310,39 +320,39 @@ count2 = 0;
 		p->lock = 1;
 	  
 
-	  _xend();
+	  TX_END(0);
 	  count2 = 0;
 	  count = 0;
     }
 	else{
-		if (status & _XABORT_CONFLICT)
+		if (ABORT_IS_CONFLICT(status))
 		{
 			aborts[0]++;
 			count++;
 			count2++;
 			if (count>9){
-				_mm_pause();
+				CPU_RELAX();
 				//nanosleep(&tim , &tim2);
 				count = 0;
 			}
 			if (count2<0)
 			 return(-2);			
 		}
-		else if (status & _XABORT_CAPACITY){
+		else if (ABORT_IS_CAPACITY(status)){
 			aborts[1]++;			
 			count2++;
 			if (count2<0)
 			 return(-2);			
 		}	
-		else if (status & _XABORT_EXPLICIT)
+		else if (ABORT_IS_EXPLICIT(status))
 		{
 			aborts[2]++;
-			if (_XABORT_CODE(status) == 0xfe)
+			if (ABORT_CODE(status) == ABORT_GL_TAKEN)
 				goto start_over;
 			count++;
 			count2++;
 			if (count>9){
-				_mm_pause();
+				CPU_RELAX();
 				//nanosleep(&tim , &tim2);
 				count = 0;
 			}
@@ -435,7 +445,7 @@ int jsw_remove2 ( struct jsw_tree *tree, int data ){
   return 1;
 }
 
-int jsw_remove ( struct jsw_tree *tree, int data, long int *aborts,pthread_spinlock_t *lock ){
+int jsw_remove ( struct jsw_tree *tree, int data, long int *aborts,tm_fallback_lock_t *lock ){
  struct jsw_node *save=NULL;
  struct jsw_node head = {0}; /* False tree root */
  struct jsw_node *q, *p=NULL, *g=NULL; /* Helpers */
@@ -449,15 +459,16 @@ int jsw_remove ( struct jsw_tree *tree, int data, long int *aborts,pthread_spinl
  tim.tv_nsec = 1; 
  start_over:
  while(1){
-	unsigned status = _xbegin();
-	if (status == _XBEGIN_STARTED){
-		if (((int)(*lock)) != 1) _xabort (0xfe);
+	tm_begin_ret_t status;
+	TX_BEGIN(status);
+	if (status == TM_BEGIN_SUCCESS){
+		if (tm_fallback_is_locked(lock)) TX_ABORT(ABORT_GL_TAKEN);
 		if (tree->root == NULL){
-			_xend();
+			TX_END(0);
 			return 1;
 		}	
 		if (tree->root->lock == 1) 
-			_xabort(0xff);			
+			TX_ABORT(ABORT_NODE_LOCKED);			
 		tree->root->lock = 1;	
 
 		
@@ -470,38 +481,38 @@ int jsw_remove ( struct jsw_tree *tree, int data, long int *aborts,pthread_spinl
 		dir = q->data < data;
 		last = 1;
 		
-		_xend();
+		TX_END(0);
 		break;
 	}
 	else{
-		if (status & _XABORT_CONFLICT)
+		if (ABORT_IS_CONFLICT(status))
 		{
 			aborts[0]++;
 			count++;
 			count2++;
 			if (count>9){
-//				_mm_pause();
+//				CPU_RELAX();
 				//nanosleep(&tim , &tim2);
 				count = 0;
 			}
 			if (count2<0)
 			 return(-2);			
 		}
-		else if (status & _XABORT_CAPACITY){
+		else if (ABORT_IS_CAPACITY(status)){
 			aborts[1]++;			
 			count2++;
 			if (count2<0)
 			 return(-2);			
 		}	
-		else if (status & _XABORT_EXPLICIT)
+		else if (ABORT_IS_EXPLICIT(status))
 		{
 			aborts[2]++;
-			if (_XABORT_CODE(status) == 0xfe)
+			if (ABORT_CODE(status) == ABORT_GL_TAKEN)
 				goto start_over;
 			count++;
 			count2++;
 			if (count>9){
-//				_mm_pause();
+//				CPU_RELAX();
 				//nanosleep(&tim , &tim2);
 				count = 0;
 			}
@@ -523,10 +534,11 @@ int jsw_remove ( struct jsw_tree *tree, int data, long int *aborts,pthread_spinl
   //q->link[0]->lock = 1;
   while(1){
 
-	unsigned status = _xbegin();
-	if (status == _XBEGIN_STARTED){
+	tm_begin_ret_t status;
+	TX_BEGIN(status);
+	if (status == TM_BEGIN_SUCCESS){
 	  
-	  if (((int)(*lock)) != 1) _xabort (0xfe);
+	  if (tm_fallback_is_locked(lock)) TX_ABORT(ABORT_GL_TAKEN);
 				  	
 	 // fprintf(stderr, "here1\n");
       /* Search and push a red down */
@@ -534,7 +546,7 @@ int jsw_remove ( struct jsw_tree *tree, int data, long int *aborts,pthread_spinl
  	  if (p!=NULL)
 		if (p->link[!last]!=NULL)
 			if(p->link[!last]->lock==1)
-				_xabort(0xff);	
+				TX_ABORT(ABORT_NODE_LOCKED);	
 	  
 	  q1=q;
 	  p1=p;
@@ -615,7 +627,7 @@ int jsw_remove ( struct jsw_tree *tree, int data, long int *aborts,pthread_spinl
 		}  
 		
 	 // fprintf(stderr, "found\n");
-		_xend();
+		TX_END(0);
 		if ( f != NULL ) free(q);
 		return 1;
 	  }
@@ -648,14 +660,14 @@ int jsw_remove ( struct jsw_tree *tree, int data, long int *aborts,pthread_spinl
 	
 	  if(q!=NULL){
 		if (q->lock ==1)
-			_xabort(0xff);	
+			TX_ABORT(ABORT_NODE_LOCKED);	
 	  }
 	  if(g!=NULL)
 		if (g->lock ==1)
-			_xabort(0xff);
+			TX_ABORT(ABORT_NODE_LOCKED);
 	  if(p!=NULL){
 		if (p->lock ==1)
-			_xabort(0xff);
+			TX_ABORT(ABORT_NODE_LOCKED);
 	  }
 	
 		 
@@ -669,40 +681,40 @@ int jsw_remove ( struct jsw_tree *tree, int data, long int *aborts,pthread_spinl
 		p->lock=1;
 	  }	
 	  
-	  _xend();
+	  TX_END(0);
 	  count = 0;
 	  count2 = 0;
 	  
 	}
 		else{
-		if (status & _XABORT_CONFLICT)
+		if (ABORT_IS_CONFLICT(status))
 		{
 			aborts[0]++;
 			count++;
 			count2++;
 			if (count>9){
-//				_mm_pause();
+//				CPU_RELAX();
 				//nanosleep(&tim , &tim2);
 				count = 0;
 			}
 			if (count2<0)
 			 return(-2);			
 		}
-		else if (status & _XABORT_CAPACITY){
+		else if (ABORT_IS_CAPACITY(status)){
 			aborts[1]++;			
 			count2++;
 			if (count2<0)
 			 return(-2);			
 		}	
-		else if (status & _XABORT_EXPLICIT)
+		else if (ABORT_IS_EXPLICIT(status))
 		{
 			aborts[2]++;
-			if (_XABORT_CODE(status) == 0xfe)
+			if (ABORT_CODE(status) == ABORT_GL_TAKEN)
 				goto start_over;
 			count++;
 			count2++;
 			if (count>9){
-//				_mm_pause();
+//				CPU_RELAX();
 				//nanosleep(&tim , &tim2);
 				count = 0;
 			}
@@ -741,54 +753,55 @@ int jsw_lookup2(struct jsw_tree *tree, int data){
   return (-1);
 }
 
-int jsw_lookup(struct jsw_tree *tree, int data, long int * aborts,pthread_spinlock_t *lock){
+int jsw_lookup(struct jsw_tree *tree, int data, long int * aborts,tm_fallback_lock_t *lock){
   struct jsw_node * p;
   int count=0,count2=0;
   start_over:
   while(1){
-	unsigned status = _xbegin();
-	if (status == _XBEGIN_STARTED){
-		if (((int)(*lock)) != 1) _xabort (0xfe);
+	tm_begin_ret_t status;
+	TX_BEGIN(status);
+	if (status == TM_BEGIN_SUCCESS){
+		if (tm_fallback_is_locked(lock)) TX_ABORT(ABORT_GL_TAKEN);
 		if (tree->root == NULL){
-			_xend();
+			TX_END(0);
 			return (0);
 		}	
 		if (tree->root->lock == 1) 
-			_xabort(0xff);
+			TX_ABORT(ABORT_NODE_LOCKED);
 		tree->root->lock = 1;
 		p = tree->root;
-		_xend();
+		TX_END(0);
 		break;
 	}
 	else{
-		if (status & _XABORT_CONFLICT)
+		if (ABORT_IS_CONFLICT(status))
 		{
 			aborts[0]++;
 			count++;
 			count2++;
 			if (count>9){
-				_mm_pause();
+				CPU_RELAX();
 				//nanosleep(&tim , &tim2);
 				count = 0;
 			}
 			if (count2<0)
 			 return(-2);			
 		}
-		else if (status & _XABORT_CAPACITY){
+		else if (ABORT_IS_CAPACITY(status)){
 			aborts[1]++;			
 			count2++;
 			if (count2<0)
 			 return(-2);			
 		}	
-		else if (status & _XABORT_EXPLICIT)
+		else if (ABORT_IS_EXPLICIT(status))
 		{
 			aborts[2]++;
-//			if (_XABORT_CODE(status) == 0xfe)
+//			if (ABORT_CODE(status) == ABORT_GL_TAKEN)
 //				goto start_over;
 			count++;
 			count2++;
 			if (count>9){
-				_mm_pause();
+				CPU_RELAX();
 				//nanosleep(&tim , &tim2);
 				count = 0;
 			}
@@ -806,64 +819,65 @@ int jsw_lookup(struct jsw_tree *tree, int data, long int * aborts,pthread_spinlo
   count=0;
   count2=0;
   while(1){
-	unsigned status = _xbegin();
-	if (status == _XBEGIN_STARTED){
-		if (((int)(*lock)) != 1) _xabort (0xfe);
+	tm_begin_ret_t status;
+	TX_BEGIN(status);
+	if (status == TM_BEGIN_SUCCESS){
+		if (tm_fallback_is_locked(lock)) TX_ABORT(ABORT_GL_TAKEN);
 		if (data < p->data){
 			p->lock = 0; 
-			if (p->link[0] == NULL) {_xend(); return 0;}
+			if (p->link[0] == NULL) {TX_END(0); return 0;}
 			if (p->link[0]->lock==1) 
-				_xabort(0xff); 
+				TX_ABORT(ABORT_NODE_LOCKED); 
 			else
 				p->link[0]->lock = 1;
 			p = p->link[0]; 
-			_xend();
+			TX_END(0);
 			count=0;
 			count2=0;
 		}
 		else if (data > p->data){
 			p->lock = 0;
-			if (p->link[1] == NULL) {_xend(); return 0;}
+			if (p->link[1] == NULL) {TX_END(0); return 0;}
 			if (p->link[1]->lock==1) 
-				_xabort(0xff); 
+				TX_ABORT(ABORT_NODE_LOCKED); 
 			else
 				p->link[1]->lock = 1;
 				p = p->link[1]; 
-			_xend();
+			TX_END(0);
 			count=0;
 			count2=0;
 		}
-		else{ p->lock=0; _xend(); return 1;}				
+		else{ p->lock=0; TX_END(0); return 1;}				
 	}
 	else{
-		if (status & _XABORT_CONFLICT)
+		if (ABORT_IS_CONFLICT(status))
 		{
 			aborts[0]++;
 			count++;
 			count2++;
 			if (count>9){
-				_mm_pause();
+				CPU_RELAX();
 				//nanosleep(&tim , &tim2);
 				count = 0;
 			}
 			if (count2<0)
 			 return(-2);			
 		}
-		else if (status & _XABORT_CAPACITY){
+		else if (ABORT_IS_CAPACITY(status)){
 			aborts[1]++;			
 			count2++;
 			if (count2<0)
 			 return(-2);			
 		}	
-		else if (status & _XABORT_EXPLICIT)
+		else if (ABORT_IS_EXPLICIT(status))
 		{
 			aborts[2]++;
-//			if (_XABORT_CODE(status) == 0xfe)
+//			if (ABORT_CODE(status) == ABORT_GL_TAKEN)
 //				goto start_over;
 			count++;
 			count2++;
 			if (count>9){
-				_mm_pause();
+				CPU_RELAX();
 				//nanosleep(&tim , &tim2);
 				count = 0;
 			}
@@ -955,7 +969,7 @@ struct jsw_tree * jsw_create(void){
     exit(1);
   }
 
-  pthread_spin_init(&t->spinlock, PTHREAD_PROCESS_SHARED);
+  tm_fallback_lock_init(&t->lock);
   t->root = NULL;
   return t;
 }
@@ -1094,7 +1108,7 @@ int rbt_lookup(void *rbt, void *thread_data, int key)
 	int ret;
 	long int aborts[4] = {0};
 
-	ret = jsw_lookup(rbt, key, aborts, &((struct jsw_tree *)rbt)->spinlock);
+	ret = jsw_lookup(rbt, key, aborts, &((struct jsw_tree *)rbt)->lock);
 
 	return ret;
 }
@@ -1104,7 +1118,7 @@ int rbt_insert(void *rbt, void *thread_data, int key, void *value)
 	int ret = 0;
 	long int aborts[4] = {0};
 
-	ret = jsw_insert (rbt, key, aborts, &((struct jsw_tree *)rbt)->spinlock);
+	ret = jsw_insert (rbt, key, aborts, &((struct jsw_tree *)rbt)->lock);
 
 	return ret;
 }
@@ -1114,7 +1128,7 @@ int rbt_delete(void *rbt, void *thread_data, int key)
 	int ret;
 	long int aborts[4] = {0};
 
-	ret = jsw_remove(rbt, key, aborts, &((struct jsw_tree *)rbt)->spinlock);
+	ret = jsw_remove(rbt, key, aborts, &((struct jsw_tree *)rbt)->lock);
 
 	return ret;
 }
@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "rbt/registry.h"
+
+/**
+ * The entries of all trees, in the order of the Makefile. They are weak, so
+ * that a binary may leave some out, e.g., x.all.k64 has only the trees that
+ * support 64-bit keys.
+ **/
+extern rbt_impl_t rbt_impl_avl_int_seq __attribute__((weak));
+extern rbt_impl_t rbt_impl_avl_int_rcu_htm __attribute__((weak));
+extern rbt_impl_t rbt_impl_avl_int_rcu_sgl __attribute__((weak));
+extern rbt_impl_t rbt_impl_avl_int_rcu_sw __attribute__((weak));
+extern rbt_impl_t rbt_impl_avl_int_cop __attribute__((weak));
+extern rbt_impl_t rbt_impl_avl_bronson __attribute__((weak));
+extern rbt_impl_t rbt_impl_bst_aravind __attribute__((weak));
+extern rbt_impl_t rbt_impl_bst_citrus __attribute__((weak));
+extern rbt_impl_t rbt_impl_rbt_int_rcu_htm __attribute__((weak));
+extern rbt_impl_t rbt_impl_rbt_int_rcu_sw __attribute__((weak));
+
+static rbt_impl_t *impls[] = {
+	&rbt_impl_avl_int_seq,
+	&rbt_impl_avl_int_rcu_htm,
+	&rbt_impl_avl_int_rcu_sgl,
+	&rbt_impl_avl_int_rcu_sw,
+	&rbt_impl_avl_int_cop,
+	&rbt_impl_avl_bronson,
+	&rbt_impl_bst_aravind,
+	&rbt_impl_bst_citrus,
+	&rbt_impl_rbt_int_rcu_htm,
+	&rbt_impl_rbt_int_rcu_sw,
+};
+#define NR_IMPLS (sizeof(impls) / sizeof(*impls))
+
+rbt_impl_t *rbt_impl;
+
+rbt_impl_t *rbt_impl_find(const char *id)
+{
+	unsigned int i;
+
+	for (i=0; i < NR_IMPLS; i++)
+		if (impls[i] && !strcmp(impls[i]->id, id))
+			return impls[i];
+	return NULL;
+}
+
+void rbt_impl_print_list(FILE *fp)
+{
+	unsigned int i;
+	int first = 1;
+
+	for (i=0; i < NR_IMPLS; i++) {
+		if (!impls[i])
+			continue;
+		fprintf(fp, "%s%s", first ? "" : ",", impls[i]->id);
+		first = 0;
+	}
+}
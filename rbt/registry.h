@@ -0,0 +1,79 @@
+#ifndef _RBT_REGISTRY_H_
+#define _RBT_REGISTRY_H_
+
+/**
+ * All trees in one binary (x.all), selected at runtime with --impl.
+ *
+ * Every tree implements the same rbt_* functions of iface.h, so they cannot
+ * be linked together as they are. Instead, each one is linked on its own
+ * with registry_entry.c, which puts its functions in an rbt_impl_t, and all
+ * of its symbols but that rbt_impl_t are made local (see the Makefile).
+ * registry.c lists the rbt_impl_t of every tree.
+ *
+ * Code compiled with -DRBT_REGISTRY includes this header through iface.h,
+ * and its rbt_*() calls go to the implementation in `rbt_impl`.
+ **/
+
+#include <stdio.h> /* FILE */
+
+#include "iface.h"
+
+//> rbt_print() is left out, only few trees have it.
+typedef struct {
+	//> The suffix of the tree's own x.* binary, e.g., "avl.int.rcu_htm".
+	const char *id;
+
+	void *(*new)();
+	char *(*name)();
+	int (*warmup)(void *rbt, int nr_nodes, map_key_t max_key,
+	              unsigned int seed, int force);
+	int (*validate)(void *rbt);
+	void (*free)(void *rbt);
+	int (*bulk_load)(void *rbt, void *thread_data, bulk_load_t *bl, int tid);
+	int (*mem_stats)(void *rbt, rbt_mem_stats_t *stats);
+
+	void *(*thread_data_new)(int tid);
+	void (*thread_data_print)(void *thread_data);
+	void (*thread_data_add)(void *d1, void *d2, void *dst);
+	void (*thread_data_free)(void *thread_data);
+	int (*thread_data_tx_stats)(void *thread_data, rbt_tx_stats_t *stats);
+
+	int (*lookup)(void *rbt, void *thread_data, map_key_t key);
+	int (*insert)(void *rbt, void *thread_data, map_key_t key, void *value);
+	int (*delete)(void *rbt, void *thread_data, map_key_t key);
+	int (*get)(void *rbt, void *thread_data, map_key_t key, void **value);
+	int (*update)(void *rbt, void *thread_data, map_key_t key, void *value);
+	int (*range)(void *rbt, void *thread_data, map_key_t lo, map_key_t hi,
+	             rbt_range_cb_t *cb, void *arg);
+} rbt_impl_t;
+
+//> The implementation that rbt_*() calls go to.
+extern rbt_impl_t *rbt_impl;
+
+//> Returns the implementation with the given id, or NULL.
+rbt_impl_t *rbt_impl_find(const char *id);
+//> Prints the ids of all implementations in the binary.
+void rbt_impl_print_list(FILE *fp);
+
+#if defined(RBT_REGISTRY)
+#	define rbt_new                  rbt_impl->new
+#	define rbt_name                 rbt_impl->name
+#	define rbt_warmup               rbt_impl->warmup
+#	define rbt_validate             rbt_impl->validate
+#	define rbt_free                 rbt_impl->free
+#	define rbt_bulk_load            rbt_impl->bulk_load
+#	define rbt_mem_stats            rbt_impl->mem_stats
+#	define rbt_thread_data_new      rbt_impl->thread_data_new
+#	define rbt_thread_data_print    rbt_impl->thread_data_print
+#	define rbt_thread_data_add      rbt_impl->thread_data_add
+#	define rbt_thread_data_free     rbt_impl->thread_data_free
+#	define rbt_thread_data_tx_stats rbt_impl->thread_data_tx_stats
+#	define rbt_lookup               rbt_impl->lookup
+#	define rbt_insert               rbt_impl->insert
+#	define rbt_delete               rbt_impl->delete
+#	define rbt_get                  rbt_impl->get
+#	define rbt_update               rbt_impl->update
+#	define rbt_range                rbt_impl->range
+#endif
+
+#endif /* _RBT_REGISTRY_H_ */
@@ -0,0 +1,31 @@
+/**
+ * The rbt_impl_t of one tree, linked with it into a single object (see
+ * registry.h). Built with -DRBT_IMPL_ID="<id>" and -DRBT_IMPL_SYM=<symbol>.
+ **/
+#include "rbt/iface.h"
+#include "rbt/registry.h"
+
+rbt_impl_t RBT_IMPL_SYM = {
+	.id = RBT_IMPL_ID,
+
+	.new = rbt_new,
+	.name = rbt_name,
+	.warmup = rbt_warmup,
+	.validate = rbt_validate,
+	.free = rbt_free,
+	.bulk_load = rbt_bulk_load,
+	.mem_stats = rbt_mem_stats,
+
+	.thread_data_new = rbt_thread_data_new,
+	.thread_data_print = rbt_thread_data_print,
+	.thread_data_add = rbt_thread_data_add,
+	.thread_data_free = rbt_thread_data_free,
+	.thread_data_tx_stats = rbt_thread_data_tx_stats,
+
+	.lookup = rbt_lookup,
+	.insert = rbt_insert,
+	.delete = rbt_delete,
+	.get = rbt_get,
+	.update = rbt_update,
+	.range = rbt_range,
+};
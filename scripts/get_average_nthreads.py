@@ -1,6 +1,7 @@
 #!/usr/bin/env python2
 
 import sys
+from results import read_runs
 
 if (len(sys.argv) <= 1):
 	print "usage: " + sys.argv[0] + " file1 file2 ... fileN"
@@ -12,21 +13,11 @@ def avg(a):
 d = dict() # [ nthreads: [val1, val2, ...], ... ]
 
 for filename in sys.argv[1:]:
-	fp = open(filename, "r")
-
-	line = fp.readline()
-	while line:
-		tokens = line.split()
-
-		if line.startswith("  num_threads:"):
-			nthreads = int(tokens[1])
-			if not nthreads in d:
-				d[nthreads] = []
-		elif line.startswith("Throughput(Ops/usec):"):
-			throughput = float(tokens[1])
-			d[nthreads].append(throughput)
-
-		line = fp.readline()
+	for run in read_runs(filename):
+		nthreads = run["num_threads"]
+		if not nthreads in d:
+			d[nthreads] = []
+		d[nthreads].append(run["throughput"])
 
 keys = d.keys()
 keys.sort()
@@ -5,6 +5,7 @@ import matplotlib
 matplotlib.use('Agg')
 import matplotlib.pyplot as plt
 import numpy as np
+from results import read_runs
 
 def prefix_large_number(number, divider = 1000):
 	prefixes = [ "", "K", "M", "G" ]
@@ -79,35 +80,20 @@ d = dict()
 nthreads_axis = []
 
 for filename in sys.argv[1:]:
-	fp = open(filename, "r")
-
 	file_basename = '.'.join(os.path.basename(filename).split('.')[0:-2])
 
 	if not file_basename in d:
 		d[file_basename] = []
 
-	throughput_axis = []
-	nthreads_axis = []
-
-	line = fp.readline()
-	while line:
-		tokens = line.split()
-		if line.startswith("  num_threads:"):
-			nthreads_axis.append(int(tokens[1]))
-		elif line.startswith("Throughput(Ops/usec):"):
-			throughput_axis.append(float(tokens[1]))
-		elif line.startswith("  lookup_frac:"):
-			lookups_pct = int(tokens[1])
-		elif line.startswith("  insert_frac:"):
-			inserts_pct = int(tokens[1])
-			deletes_pct = 100 - lookups_pct - inserts_pct
-		elif line.startswith("  max_key"):
-			max_key = int(tokens[1])
-
-		line = fp.readline()
-	
+	runs = read_runs(filename)
+	throughput_axis = [ run["throughput"] for run in runs ]
+	nthreads_axis = [ run["num_threads"] for run in runs ]
+	lookups_pct = runs[-1]["lookup_frac"]
+	inserts_pct = runs[-1]["insert_frac"]
+	deletes_pct = 100 - lookups_pct - inserts_pct
+	max_key = runs[-1]["max_key"]
+
 	d[file_basename].append(throughput_axis)
-	fp.close()
 
 
 ax = plt.subplot("111")
@@ -0,0 +1,44 @@
+## Reads the runs out of benchmark output files.
+##
+## Runs with --output-format=json leave one JSON record per line, starting
+## with '{', next to the text report. Files that contain records are read
+## from those only. Older files are scraped from the text report.
+
+import json
+
+def _run_from_record(rec):
+	return { "num_threads": rec["inputs"]["num_threads"],
+	         "lookup_frac": rec["inputs"]["lookup_frac"],
+	         "insert_frac": rec["inputs"]["insert_frac"],
+	         "max_key": rec["inputs"]["max_key"],
+	         "throughput": rec["results"]["throughput_ops_usec"],
+	         "record": rec }
+
+def _runs_from_text(lines):
+	runs = []
+	run = dict()
+	for line in lines:
+		tokens = line.split()
+		if line.startswith("  num_threads:"):
+			run = { "num_threads": int(tokens[1]) }
+		elif line.startswith("  lookup_frac:"):
+			run["lookup_frac"] = int(tokens[1])
+		elif line.startswith("  insert_frac:"):
+			run["insert_frac"] = int(tokens[1])
+		elif line.startswith("  max_key:"):
+			run["max_key"] = int(tokens[1])
+		elif line.startswith("Throughput(Ops/usec):"):
+			run["throughput"] = float(tokens[1])
+			runs.append(run)
+	return runs
+
+## Returns a list with one dict per run, in the order of the file.
+def read_runs(filename):
+	fp = open(filename, "r")
+	lines = fp.readlines()
+	fp.close()
+
+	records = [ json.loads(l) for l in lines if l.startswith("{") ]
+	if records:
+		return [ _run_from_record(r) for r in records ]
+	return _runs_from_text(lines)
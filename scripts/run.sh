@@ -7,6 +7,7 @@ INIT_SIZES=$RCU_HTM_INIT_SIZES
 THREADS_CONF=$RCU_HTM_THREADS_CONF
 EXECUTABLES=$RCU_HTM_EXECUTABLES
 SERIAL_EXE=$RCU_HTM_SERIAL_EXE
+PLACEMENT=${RCU_HTM_PLACEMENT:-compact}
 if [ "$TIMES" == "" -o "$RUNTIME" == "" -o "$INIT_SIZES" == "" \
 	  -o "$WORKLOADS" == "" -o "$THREADS_CONF" == "" -o "$EXECUTABLES" == "" \
 	  -o "$SERIAL_EXE" == "" ]; then
@@ -50,7 +51,8 @@ for thr in $THREADS_CONF; do
 	./$EXECUTABLE -s$init_size -m$((2*init_size)) \
 	              -l$lookup_pct -i$insert_pct -t$thr \
 				  -r$RUNTIME \
-				  -e$SEED1 -j$SEED2 \
+				  -e$SEED1 -j$SEED2 -p$PLACEMENT \
+				  --output-format=json \
 	              &>> $DIRNAME/$FILENAME
 
 	## Move the outputs of the serial execution in SERIAL dir
@@ -25,13 +25,24 @@ outputs_dir=$1
 THREADS_CONF_LEN=$(echo "$THREADS_CONF" | wc -w)
 ERROR_FOUND=0
 
+## Runs with --output-format=json end with a JSON record, count those if the
+## file has any. A run that crashes after the report leaves no record.
+count_runs() {
+	nr_records=$(grep -c "^{" $1)
+	if [ "$nr_records" != "0" ]; then
+		echo $nr_records
+	else
+		grep "Throughput(Ops/usec):" $1 | wc -l
+	fi
+}
+
 for n in `seq 0 $((NR_EXECUTIONS-1))`; do
 for w in $RCU_HTM_WORKLOADS; do
 for i in $INIT_SIZES; do
 
 for e in $EXECUTABLES; do
 	filename="$outputs_dir/${e}.${i}_init.${w}.${n}.output"
-	nr_throughput_lines=$(grep "Throughput(Ops/usec):" $filename | wc -l)
+	nr_throughput_lines=$(count_runs $filename)
 	if [ "$nr_throughput_lines" != "$THREADS_CONF_LEN" ]; then
 		echo "ERROR: filename $filename has $nr_throughput_lines throughput values instead of $THREADS_CONF_LEN"
 		ERROR_FOUND=1
@@ -39,7 +50,7 @@ for e in $EXECUTABLES; do
 done
 
 	serial_filename="$outputs_dir/SERIAL/${SERIAL_EXE}.${i}_init.${w}.${n}.output"
-	nr_throughput_lines_serial=$(grep "Throughput(Ops/usec):" $serial_filename | wc -l)
+	nr_throughput_lines_serial=$(count_runs $serial_filename)
 	if [ "$nr_throughput_lines_serial" != "1" ]; then
 		echo "ERROR: filename $serial_filename filename has $nr_throughput_lines_serial throughput values instead of 1"
 		ERROR_FOUND=1